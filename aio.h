@@ -0,0 +1,347 @@
+#ifndef C_AIO_HEADER
+#define C_AIO_HEADER
+
+// === aio.h: Linux AIO O_DIRECT engine with userspace completion reaping =====
+//
+// Contents:
+//   * engine                       (jump: Init_aio)
+//   * buffer pool                  (jump: Get_aio)
+//   * requests                     (jump: Read_aio)
+//   * completions                  (jump: Reap_aio)
+//
+// Usage:
+//   aio.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/aio.h" // use as header file
+//
+//   #define C_AIO_IMPLEMENTATION
+//   #include "c/aio.h" // use as implementation file
+//
+//   Native AIO predates io_uring and is not subject to the
+//   kernel.io_uring_disabled sysctl: on O_DIRECT files it is truly
+//   asynchronous. The engine queues requests as iocbs and submits up to
+//   BATCH_aio of them per io_submit_linux. Buffers come from a pool of
+//   blocks aligned for O_DIRECT (Align_aio asks statx for STATX_DIOALIGN).
+//
+//     Init_aio(&e, 64, 4096, 64, 512); // queue depth, block size, blocks, alignment
+//     void *buf = Get_aio(&e);
+//     Read_aio(&e, fd, buf, 4096, offset, job); // queued
+//     Submit_aio(&e);                           // one io_submit for the batch
+//     long n = Reap_aio(&e, done, 64, 1);       // done[i].user == job
+//
+//   The context id io_setup returns is the address of the completion ring,
+//   mapped in our memory: Reap_aio takes events straight from it and
+//   advances its head, like the kernel's own reader, and only calls
+//   io_getevents to sleep when fewer than `min` events are there. The ring
+//   header's magic and feature words are checked once; a layout we don't
+//   know falls back to io_getevents for everything. One thread reaps.
+//
+//   Every request carries IOCB_FLAG_RESFD: the kernel bumps `e.eventfd` at
+//   each completion, so an epoll set can watch the engine with the rest of
+//   a program's fds. Reap_aio drains the eventfd before reading the ring,
+//   so a level-triggered epoll doesn't wake again for events already taken,
+//   and writes back what it leaves behind (more than `max` ready, requests
+//   io_submit refused): the eventfd stays readable while anything is left.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "aio.h depends on linux.h, include it first"
+#endif
+
+#define BATCH_aio 64         // iocbs per io_submit
+#define MAGIC_aio 0xa10a10a1 // AIO_RING_MAGIC
+
+// The kernel's struct aio_ring, at the address of the context id.
+typedef struct {
+  unsigned int id;
+  unsigned int nr; // events in the ring
+  unsigned int head;
+  unsigned int tail;
+  unsigned int magic;
+  unsigned int compat_features;
+  unsigned int incompat_features;
+  unsigned int header_length;
+  io_event_linux events[];
+} Ring_aio;
+
+typedef struct {
+  void *user;
+  long long result; // bytes transferred, or -errno
+} Completion_aio;
+
+typedef struct {
+  unsigned long ctx;
+  Ring_aio *ring; // 0 if its layout is unknown: reap with io_getevents
+  int eventfd;    // counts completions, for epoll
+  unsigned int depth;
+  iocb_linux *iocbs;   // depth slots
+  void **users;        // by slot
+  unsigned int *free_slots;
+  unsigned int free_count;
+  iocb_linux *pending[BATCH_aio]; // queued for the next io_submit
+  unsigned int queued;
+  Completion_aio failed[BATCH_aio]; // refused by io_submit, delivered by Reap_aio
+  unsigned int failed_count;
+  unsigned int inflight;
+  unsigned char *pool; // blocks of `block` bytes, aligned
+  unsigned long block;
+  unsigned int blocks;
+  void **free_blocks;
+  unsigned int free_block_count;
+  unsigned long size; // mapping of the slots and the pool
+  unsigned long long submits;      // io_submit calls
+  unsigned long long ring_events;  // reaped from the ring in userspace
+  unsigned long long waits;        // io_getevents calls
+} Engine_aio;
+
+//
+// Engine
+//
+long Align_aio(int fd, unsigned int *memory, unsigned int *offset);
+long Init_aio(Engine_aio *e, unsigned int depth, unsigned long block, unsigned int blocks, unsigned long alignment);
+void Free_aio(Engine_aio *e);
+//
+// Buffer pool
+//
+void *Get_aio(Engine_aio *e);
+void Put_aio(Engine_aio *e, void *block);
+//
+// Requests
+//
+long Read_aio(Engine_aio *e, int fd, void *buf, unsigned long len, long long offset, void *user);
+long Write_aio(Engine_aio *e, int fd, const void *buf, unsigned long len, long long offset, void *user);
+long Readv_aio(Engine_aio *e, int fd, const iovec_linux *iov, unsigned int count, long long offset, void *user);
+long Submit_aio(Engine_aio *e);
+//
+// Completions
+//
+long Reap_aio(Engine_aio *e, Completion_aio *out, unsigned int max, unsigned int min);
+
+#endif // C_AIO_HEADER
+#ifdef C_AIO_IMPLEMENTATION
+
+long Align_aio(int fd, unsigned int *memory, unsigned int *offset) {
+  statx_t_linux st;
+  long ret = statx_linux(fd, "", AT_EMPTY_PATH_linux, STATX_DIOALIGN_linux, &st);
+  if (ret < 0) {
+    return ret;
+  }
+  if (!(st.stx_mask & STATX_DIOALIGN_linux) || !st.stx_dio_offset_align) {
+    return -EINVAL_linux; // no O_DIRECT here
+  }
+  *memory = st.stx_dio_mem_align;
+  *offset = st.stx_dio_offset_align;
+  return 0;
+}
+
+long Init_aio(Engine_aio *e, unsigned int depth, unsigned long block, unsigned int blocks, unsigned long alignment) {
+  if (!depth || !alignment || alignment & (alignment - 1) || block % alignment) {
+    return -EINVAL_linux;
+  }
+  // Slots, then the pool on a boundary of max(alignment, page)
+  unsigned long slots = depth * (sizeof(iocb_linux) + sizeof(void *) + sizeof(unsigned int)) + blocks * sizeof(void *);
+  unsigned long start = (slots + 4095) & ~4095UL;
+  start = (start + alignment - 1) & ~(alignment - 1);
+  e->size = start + block * blocks + (alignment > 4096 ? alignment : 0);
+  long ret = mmap_linux(0, e->size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  unsigned char *base = (unsigned char *)ret;
+  e->iocbs = (iocb_linux *)base;
+  e->users = (void **)(e->iocbs + depth);
+  e->free_blocks = e->users + depth;
+  e->free_slots = (unsigned int *)(e->free_blocks + blocks);
+  e->pool = (unsigned char *)(((unsigned long)base + start + alignment - 1) & ~(alignment - 1));
+  e->depth = depth;
+  e->block = block;
+  e->blocks = blocks;
+  for (unsigned int i = 0; i < depth; ++i) {
+    e->free_slots[i] = depth - 1 - i;
+  }
+  e->free_count = depth;
+  for (unsigned int i = 0; i < blocks; ++i) {
+    e->free_blocks[i] = e->pool + (unsigned long)(blocks - 1 - i) * block;
+  }
+  e->free_block_count = blocks;
+  e->queued = e->inflight = e->failed_count = 0;
+  e->submits = e->ring_events = e->waits = 0;
+
+  e->ctx = 0;
+  ret = io_setup_linux(depth, &e->ctx);
+  if (ret < 0) {
+    munmap_linux(base, e->size);
+    return ret;
+  }
+  ret = eventfd2_linux(0, EFD_NONBLOCK_linux | EFD_CLOEXEC_linux);
+  if (ret < 0) {
+    io_destroy_linux(e->ctx);
+    munmap_linux(base, e->size);
+    return ret;
+  }
+  e->eventfd = (int)ret;
+  e->ring = (Ring_aio *)e->ctx;
+  if (e->ring->magic != MAGIC_aio || e->ring->incompat_features || e->ring->header_length != sizeof(Ring_aio)) {
+    e->ring = 0;
+  }
+  return 0;
+}
+
+void Free_aio(Engine_aio *e) {
+  io_destroy_linux(e->ctx); // waits for requests in flight
+  close_linux((unsigned int)e->eventfd);
+  munmap_linux(e->iocbs, e->size);
+}
+
+//
+// Buffer pool
+//
+void *Get_aio(Engine_aio *e) {
+  return e->free_block_count ? e->free_blocks[--e->free_block_count] : 0;
+}
+
+void Put_aio(Engine_aio *e, void *block) {
+  e->free_blocks[e->free_block_count++] = block;
+}
+
+//
+// Requests
+//
+static long Queue_aio(Engine_aio *e, unsigned short opcode, int fd, unsigned long long buf, unsigned long long len, long long offset, void *user) {
+  if (!e->free_count) {
+    return -EAGAIN_linux;
+  }
+  if (e->queued == BATCH_aio) {
+    long ret = Submit_aio(e);
+    if (ret < 0) {
+      return ret;
+    }
+    if (e->queued == BATCH_aio) {
+      return -EAGAIN_linux;
+    }
+  }
+  unsigned int slot = e->free_slots[--e->free_count];
+  iocb_linux *cb = &e->iocbs[slot];
+  *cb = (iocb_linux){0};
+  cb->aio_data = slot;
+  cb->aio_lio_opcode = opcode;
+  cb->aio_fildes = (unsigned int)fd;
+  cb->aio_buf = buf;
+  cb->aio_nbytes = len;
+  cb->aio_offset = offset;
+  cb->aio_flags = IOCB_FLAG_RESFD_linux;
+  cb->aio_resfd = (unsigned int)e->eventfd;
+  e->users[slot] = user;
+  e->pending[e->queued++] = cb;
+  return 0;
+}
+
+long Read_aio(Engine_aio *e, int fd, void *buf, unsigned long len, long long offset, void *user) {
+  return Queue_aio(e, IOCB_CMD_PREAD_linux, fd, (unsigned long)buf, len, offset, user);
+}
+
+long Write_aio(Engine_aio *e, int fd, const void *buf, unsigned long len, long long offset, void *user) {
+  return Queue_aio(e, IOCB_CMD_PWRITE_linux, fd, (unsigned long)buf, len, offset, user);
+}
+
+// The iovecs are read at submission: keep them until Submit_aio.
+long Readv_aio(Engine_aio *e, int fd, const iovec_linux *iov, unsigned int count, long long offset, void *user) {
+  return Queue_aio(e, IOCB_CMD_PREADV_linux, fd, (unsigned long)iov, count, offset, user);
+}
+
+static void Signal_aio(Engine_aio *e, unsigned long long count) {
+  write_linux((unsigned int)e->eventfd, &count, sizeof(count));
+}
+
+long Submit_aio(Engine_aio *e) {
+  unsigned int done = 0, taken = 0;
+  long ret = 0;
+  while (done < e->queued && e->failed_count < BATCH_aio) {
+    ret = io_submit_linux(e->ctx, e->queued - done, e->pending + done);
+    ++e->submits;
+    if (ret > 0) {
+      done += (unsigned int)ret;
+      taken += (unsigned int)ret;
+      continue;
+    }
+    if (ret == 0 || ret == -EAGAIN_linux || ret == -EINTR_linux) {
+      break;
+    }
+    // The first request was refused outright (bad fd, misaligned O_DIRECT):
+    // it completes with the error through Reap_aio like any other.
+    unsigned int slot = (unsigned int)e->pending[done++]->aio_data;
+    e->failed[e->failed_count++] = (Completion_aio){e->users[slot], ret};
+    e->free_slots[e->free_count++] = slot;
+    Signal_aio(e, 1); // no RESFD bump for it, wake epoll ourselves
+  }
+  e->inflight += taken;
+  for (unsigned int i = done; i < e->queued; ++i) {
+    e->pending[i - done] = e->pending[i];
+  }
+  e->queued -= done;
+  return ret == -EAGAIN_linux && !taken ? ret : (long)taken;
+}
+
+//
+// Completions
+//
+static void Complete_aio(Engine_aio *e, const io_event_linux *ev, Completion_aio *out) {
+  unsigned int slot = (unsigned int)ev->data;
+  out->user = e->users[slot];
+  out->result = ev->res;
+  e->free_slots[e->free_count++] = slot;
+  --e->inflight;
+}
+
+long Reap_aio(Engine_aio *e, Completion_aio *out, unsigned int max, unsigned int min) {
+  unsigned long long count;
+  read_linux((unsigned int)e->eventfd, &count, sizeof(count)); // nonblocking
+  unsigned int got = 0;
+  while (got < max && e->failed_count) {
+    out[got++] = e->failed[--e->failed_count];
+  }
+  if (e->ring) {
+    Ring_aio *r = e->ring;
+    unsigned int head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);
+    unsigned int tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    unsigned int before = got;
+    while (got < max && head != tail) {
+      Complete_aio(e, &r->events[head], &out[got++]);
+      head = head + 1 == r->nr ? 0 : head + 1;
+    }
+    __atomic_store_n(&r->head, head, __ATOMIC_RELEASE);
+    e->ring_events += got - before;
+    // Completions landing after our look at tail bump the eventfd themselves.
+    unsigned int left = e->failed_count + (tail >= head ? tail - head : r->nr - head + tail);
+    if (left) {
+      Signal_aio(e, left);
+    }
+  } else if (e->failed_count || got == max) {
+    Signal_aio(e, 1); // the kernel's ring is out of sight, assume more is ready
+  }
+  if (got >= min || got == max) {
+    return (long)got;
+  }
+  io_event_linux events[BATCH_aio];
+  unsigned int want = max - got < BATCH_aio ? max - got : BATCH_aio;
+  unsigned int need = min - got < want ? min - got : want;
+  long ret = io_getevents_linux(e->ctx, need, want, events, 0);
+  ++e->waits;
+  if (ret < 0) {
+    return got ? (long)got : ret;
+  }
+  for (long i = 0; i < ret; ++i) {
+    Complete_aio(e, &events[i], &out[got++]);
+  }
+  return (long)got;
+}
+
+#endif // C_AIO_IMPLEMENTATION
@@ -0,0 +1,334 @@
+#ifndef C_CLOCK_HEADER
+#define C_CLOCK_HEADER
+
+// === clock.h: cycle-counter clock calibrated against CLOCK_MONOTONIC_RAW ===
+//
+// Contents:
+//   * clock                        (jump: Init_clock)
+//   * counters                     (jump: Ticks_clock)
+//
+// Usage:
+//   clock.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/clock.h" // use as header file
+//
+//   #define C_CLOCK_IMPLEMENTATION
+//   #include "c/clock.h" // use as implementation file
+//
+//   Nanosecond timestamps for per-event tracing, read from the CPU's counter
+//   instead of the kernel: rdtsc on x86, cntvct_el0 on arm64, rdtime on
+//   riscv. Init_clock measures the counter against CLOCK_MONOTONIC_RAW (or
+//   takes cntfrq_el0 on arm64) and Now_clock converts with one multiply and
+//   a shift: ns = base_ns + ((ticks - base_ticks) * mult >> 32).
+//
+//     Clock_clock clock;
+//     Init_clock(&clock);
+//     unsigned long long t0 = Now_clock(&clock);
+//
+//   About once a second of ticks Now_clock re-anchors on CLOCK_MONOTONIC_RAW:
+//   `mult` is recomputed over the whole time since calibration, so the rate
+//   gets more exact as the process runs, and the returned time doesn't go
+//   backwards across a re-anchor. The exception is a resync: when the counter
+//   ran more than RESYNC_NS_clock ahead of the kernel, the time steps back to
+//   CLOCK_MONOTONIC_RAW. Readers on other threads go through a sequence
+//   counter.
+//
+//   An x86 TSC that isn't invariant (no CPUID invariant-TSC bit and not the
+//   kernel's clocksource), an architecture without a readable counter, or a
+//   counter that keeps disagreeing with the kernel at re-anchors (jumps of
+//   more than RESYNC_NS_clock, RESYNCS_clock times) make the clock fall back
+//   to clock_gettime64_linux(CLOCK_MONOTONIC_RAW).
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "clock.h depends on linux.h, include it first"
+#endif
+
+#define CALIBRATE_NS_clock 20000000ULL // first calibration window
+#define RESYNC_NS_clock    1000000LL   // anchor error that restarts calibration
+#define RESYNCS_clock      3           // restarts before falling back
+
+#define SOURCE_SYSCALL_clock 0
+#define SOURCE_TSC_clock     1
+#define SOURCE_CNTVCT_clock  2
+#define SOURCE_RDTIME_clock  3
+
+typedef struct {
+  unsigned int seq;               // odd while re-anchoring
+  int source;
+  unsigned long long base_ticks;
+  unsigned long long base_ns;     // CLOCK_MONOTONIC_RAW
+  unsigned long long mult;        // ns per tick, 32.32 fixed point
+  unsigned long long limit;       // ticks after the base before re-anchoring
+  unsigned long long first_ticks; // start of the calibration baseline
+  unsigned long long first_ns;
+  unsigned long long frequency;   // ticks per second
+  unsigned long anchors;
+  unsigned long resyncs;
+} Clock_clock;
+
+//
+// Clock
+//
+long Init_clock(Clock_clock *c);
+void Anchor_clock(Clock_clock *c, unsigned int seq);
+unsigned long long ToNs_clock(Clock_clock *c, unsigned long long ticks);
+const char *SourceName_clock(int source);
+
+//
+// Counters
+//
+
+// The raw counter: cheapest, may be reordered with surrounding code.
+static inline unsigned long long Ticks_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int lo, hi;
+  __asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+  unsigned long long ticks;
+  __asm__ volatile ("mrs %0, cntvct_el0" : "=r" (ticks));
+  return ticks;
+#elif defined(__riscv) && __riscv_xlen == 64
+  unsigned long long ticks;
+  __asm__ volatile ("rdtime %0" : "=r" (ticks));
+  return ticks;
+#elif defined(__riscv)
+  unsigned int lo, hi, again;
+  do {
+    __asm__ volatile ("rdtimeh %0\n rdtime %1\n rdtimeh %2" : "=r" (hi), "=r" (lo), "=r" (again));
+  } while (hi != again);
+  return ((unsigned long long)hi << 32) | lo;
+#else
+  return 0;
+#endif
+}
+
+// The counter once every earlier instruction has executed, for measuring
+// the end of a timed region.
+static inline unsigned long long TicksOrdered_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned int lo, hi, cpu;
+  __asm__ volatile ("rdtscp" : "=a" (lo), "=d" (hi), "=c" (cpu));
+  return ((unsigned long long)hi << 32) | lo;
+#elif defined(__aarch64__)
+  unsigned long long ticks;
+  __asm__ volatile ("isb\n mrs %0, cntvct_el0" : "=r" (ticks) : : "memory");
+  return ticks;
+#else
+  return Ticks_clock();
+#endif
+}
+
+static inline unsigned long long Raw_clock(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_RAW_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+// Nanoseconds on CLOCK_MONOTONIC_RAW's timeline.
+static inline unsigned long long Now_clock(Clock_clock *c) {
+  for (;;) {
+    unsigned int seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    unsigned long long ticks = Ticks_clock();
+    int source = __atomic_load_n(&c->source, __ATOMIC_RELAXED);
+    unsigned long long delta = ticks - __atomic_load_n(&c->base_ticks, __ATOMIC_RELAXED);
+    unsigned long long ns = __atomic_load_n(&c->base_ns, __ATOMIC_RELAXED) + ((delta * __atomic_load_n(&c->mult, __ATOMIC_RELAXED)) >> 32);
+    unsigned long long limit = __atomic_load_n(&c->limit, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ((seq & 1) || __atomic_load_n(&c->seq, __ATOMIC_RELAXED) != seq) {
+      continue;
+    }
+    if (source == SOURCE_SYSCALL_clock) {
+      return Raw_clock();
+    }
+    if (delta < limit) {
+      return ns;
+    }
+    Anchor_clock(c, seq);
+  }
+}
+
+#endif // C_CLOCK_HEADER
+#ifdef C_CLOCK_IMPLEMENTATION
+
+// floor(n * 2^32 / d) by long division: 32-bit targets have no 64-bit
+// divide instruction and we don't link libgcc.
+static unsigned long long Fraction_clock(unsigned long long n, unsigned long long d) {
+  unsigned long long q = 0, r = 0;
+  for (int i = 63 + 32; i >= 0; --i) {
+    r = (r << 1) | (i >= 32 ? (n >> (i - 32)) & 1 : 0);
+    q <<= 1;
+    if (r >= d) {
+      r -= d;
+      q |= 1;
+    }
+  }
+  return q;
+}
+
+// (delta * mult) >> 32 without overflowing the intermediate product.
+static unsigned long long Scale_clock(unsigned long long delta, unsigned long long mult) {
+  unsigned long long dh = delta >> 32, dl = delta & 0xffffffffULL;
+  unsigned long long mh = mult >> 32, ml = mult & 0xffffffffULL;
+  return dh * mult + dl * mh + ((dl * ml) >> 32);
+}
+
+// A (ticks, ns) pair read as close together as we can: the midpoint of the
+// tightest of a few counter reads around the clock_gettime.
+static void Sample_clock(unsigned long long *ticks, unsigned long long *ns) {
+  unsigned long long best = ~0ULL;
+  for (int i = 0; i < 5; ++i) {
+    unsigned long long t0 = TicksOrdered_clock();
+    unsigned long long raw = Raw_clock();
+    unsigned long long t1 = TicksOrdered_clock();
+    if (t1 - t0 < best) {
+      best = t1 - t0;
+      *ticks = t0 + (best >> 1);
+      *ns = raw;
+    }
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static int InvariantTsc_clock(void) {
+  unsigned int a, b, c, d;
+  __asm__ volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0x80000000U), "c" (0));
+  if (a >= 0x80000007U) {
+    __asm__ volatile ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (0x80000007U), "c" (0));
+    if (d & (1U << 8)) {
+      return 1;
+    }
+  }
+  // Hypervisors often hide the bit; the kernel picking the TSC as its own
+  // clocksource vouches for it as well.
+  char name[16] = {0};
+  long fd = openat_linux(AT_FDCWD_linux, "/sys/devices/system/clocksource/clocksource0/current_clocksource", O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  long size = read_linux((unsigned int)fd, name, sizeof(name) - 1);
+  close_linux((unsigned int)fd);
+  return size >= 3 && name[0] == 't' && name[1] == 's' && name[2] == 'c' && (size == 3 || name[3] == '\n');
+}
+#endif
+
+//
+// Clock
+//
+
+// Picks the counter and calibrates it (CALIBRATE_NS_clock of sleep, except
+// on arm64 where the frequency is architectural).
+long Init_clock(Clock_clock *c) {
+  c->seq = 0;
+  c->source = SOURCE_SYSCALL_clock;
+  c->anchors = 0;
+  c->resyncs = 0;
+  c->mult = 1ULL << 32;
+  c->limit = 0;
+  c->frequency = 1000000000ULL;
+  int source = SOURCE_SYSCALL_clock;
+#if defined(__x86_64__) || defined(__i386__)
+  source = InvariantTsc_clock() ? SOURCE_TSC_clock : SOURCE_SYSCALL_clock;
+#elif defined(__aarch64__)
+  source = SOURCE_CNTVCT_clock;
+#elif defined(__riscv)
+  source = SOURCE_RDTIME_clock;
+#endif
+  c->base_ns = c->first_ns = Raw_clock();
+  if (source == SOURCE_SYSCALL_clock) {
+    return 0;
+  }
+  Sample_clock(&c->first_ticks, &c->first_ns);
+  unsigned long long frequency = 0;
+#if defined(__aarch64__)
+  __asm__ volatile ("mrs %0, cntfrq_el0" : "=r" (frequency));
+#endif
+  if (frequency) {
+    c->mult = Fraction_clock(1000000000ULL, frequency);
+    c->base_ticks = c->first_ticks;
+    c->base_ns = c->first_ns;
+  } else {
+    __kernel_timespec_linux sleep = {0, (long long)CALIBRATE_NS_clock};
+    clock_nanosleep_time64_linux(CLOCK_MONOTONIC_linux, 0, &sleep, 0);
+    Sample_clock(&c->base_ticks, &c->base_ns);
+    if (c->base_ticks <= c->first_ticks) { // not ticking, or trapping to a stub
+      return 0;
+    }
+    c->mult = Fraction_clock(c->base_ns - c->first_ns, c->base_ticks - c->first_ticks);
+  }
+  if (!c->mult) {
+    return 0;
+  }
+  // A second of ticks keeps delta * mult within 64 bits: mult * frequency
+  // is 10^9 << 32.
+  c->frequency = Fraction_clock(1000000000ULL, c->mult);
+  c->limit = c->frequency;
+  c->source = source;
+  return 0;
+}
+
+// Re-anchors on CLOCK_MONOTONIC_RAW; called by Now_clock once `limit` ticks
+// have passed. `seq` is the even sequence the caller read: whoever moves it
+// first does the work, the others retry with the new anchor.
+void Anchor_clock(Clock_clock *c, unsigned int seq) {
+  if (!__atomic_compare_exchange_n(&c->seq, &seq, seq + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return;
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE); // the odd seq before the stores
+  unsigned long long ticks, ns;
+  Sample_clock(&ticks, &ns);
+  unsigned long long predicted = c->base_ns + Scale_clock(ticks - c->base_ticks, c->mult);
+  long long error = (long long)(ns - predicted);
+  if (error > RESYNC_NS_clock || error < -RESYNC_NS_clock || ticks < c->base_ticks) {
+    // Stopped, jumped or drifting counter: restart the baseline from here.
+    if (++c->resyncs > RESYNCS_clock) {
+      __atomic_store_n(&c->source, SOURCE_SYSCALL_clock, __ATOMIC_RELAXED);
+    }
+    c->first_ticks = ticks;
+    c->first_ns = ns;
+  } else if (ticks - c->first_ticks > c->frequency) {
+    c->mult = Fraction_clock(ns - c->first_ns, ticks - c->first_ticks);
+    c->frequency = Fraction_clock(1000000000ULL, c->mult);
+    c->limit = c->frequency;
+  }
+  c->base_ticks = ticks;
+  c->base_ns = ns > predicted || error < -RESYNC_NS_clock ? ns : predicted; // never backwards, unless resynced
+  ++c->anchors;
+  __atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Converts a counter value read earlier (with Ticks_clock, for tracing
+// without the conversion on the hot path) using the current anchor.
+unsigned long long ToNs_clock(Clock_clock *c, unsigned long long ticks) {
+  for (;;) {
+    unsigned int seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    unsigned long long base_ticks = __atomic_load_n(&c->base_ticks, __ATOMIC_RELAXED);
+    unsigned long long base_ns = __atomic_load_n(&c->base_ns, __ATOMIC_RELAXED);
+    unsigned long long mult = __atomic_load_n(&c->mult, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if ((seq & 1) || __atomic_load_n(&c->seq, __ATOMIC_RELAXED) != seq) {
+      continue;
+    }
+    return ticks >= base_ticks ? base_ns + Scale_clock(ticks - base_ticks, mult) : base_ns - Scale_clock(base_ticks - ticks, mult);
+  }
+}
+
+const char *SourceName_clock(int source) {
+  switch (source) {
+  case SOURCE_TSC_clock: return "invariant tsc";
+  case SOURCE_CNTVCT_clock: return "cntvct_el0";
+  case SOURCE_RDTIME_clock: return "rdtime";
+  default: return "clock_gettime syscall";
+  }
+}
+
+#endif // C_CLOCK_IMPLEMENTATION
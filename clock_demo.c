@@ -0,0 +1,160 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o clock_demo clock_demo.c -e main && ./clock_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_CLOCK_IMPLEMENTATION
+#include "clock.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+void SleepUs(unsigned long us) {
+  __kernel_timespec_linux ts = {0, (long long)us * 1000};
+  nanosleep_linux(&ts, 0);
+}
+
+Clock_clock clock;
+
+//
+// Accuracy: the clock against CLOCK_MONOTONIC_RAW read in between, over a
+// few seconds of re-anchoring; never backwards
+//
+void Accuracy_demo(void) {
+  Print(STDOUT_FILENO_linux, "source: ");
+  Print(STDOUT_FILENO_linux, SourceName_clock(clock.source));
+  Print(STDOUT_FILENO_linux, ", ");
+  PrintU64(STDOUT_FILENO_linux, clock.frequency / 1000);
+  Print(STDOUT_FILENO_linux, " kHz after calibration\n");
+
+  unsigned long long last = 0;
+  for (int i = 0; i < 10000000; ++i) {
+    unsigned long long now = Now_clock(&clock);
+    Assert(now >= last);
+    last = now;
+  }
+
+  Print(STDOUT_FILENO_linux, "error against CLOCK_MONOTONIC_RAW (ns):\nafter    max |error|   mean |error|\n");
+  unsigned long long start = Raw_clock();
+  unsigned long long marks[4] = {100000000ULL, 1000000000ULL, 3000000000ULL, 6000000000ULL};
+  for (int m = 0; m < 4; ++m) {
+    unsigned long long worst = 0, total = 0, samples = 0;
+    while (Raw_clock() - start < marks[m]) {
+      SleepUs(1000);
+      unsigned long long before = Now_clock(&clock);
+      unsigned long long raw = Raw_clock();
+      unsigned long long after = Now_clock(&clock);
+      Assert(after >= before);
+      unsigned long long mid = before + (after - before) / 2;
+      unsigned long long error = mid > raw ? mid - raw : raw - mid;
+      worst = error > worst ? error : worst;
+      total += error;
+      ++samples;
+    }
+    PrintU64(STDOUT_FILENO_linux, marks[m] / 100000000ULL);
+    Print(STDOUT_FILENO_linux, "00 ms\t ");
+    PrintU64(STDOUT_FILENO_linux, worst);
+    Print(STDOUT_FILENO_linux, "\t\t");
+    PrintU64(STDOUT_FILENO_linux, samples ? total / samples : 0);
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+  Print(STDOUT_FILENO_linux, "re-anchors: ");
+  PrintU64(STDOUT_FILENO_linux, clock.anchors);
+  Print(STDOUT_FILENO_linux, ", resyncs: ");
+  PrintU64(STDOUT_FILENO_linux, clock.resyncs);
+  Print(STDOUT_FILENO_linux, ", refined frequency ");
+  PrintU64(STDOUT_FILENO_linux, clock.frequency);
+  Print(STDOUT_FILENO_linux, " Hz\n");
+
+  // Ticks taken on the hot path and converted afterwards agree with Now_clock
+  unsigned long long ticks = Ticks_clock();
+  unsigned long long now = Now_clock(&clock);
+  unsigned long long converted = ToNs_clock(&clock, ticks);
+  Assert(converted <= now && now - converted < 1000000);
+}
+
+//
+// Cost per timestamp
+//
+#define CALLS 10000000
+
+void Cost_demo(void) {
+  Print(STDOUT_FILENO_linux, "\nns per call:\n");
+  unsigned long long sink = 0;
+  for (int kind = 0; kind < 4; ++kind) {
+    int calls = kind == 3 ? CALLS / 20 : CALLS;
+    unsigned long long t0 = Raw_clock();
+    for (int i = 0; i < calls; ++i) {
+      switch (kind) {
+      case 0: sink += Ticks_clock(); break;
+      case 1: sink += TicksOrdered_clock(); break;
+      case 2: sink += Now_clock(&clock); break;
+      default: sink += Raw_clock(); break;
+      }
+    }
+    unsigned long long elapsed = Raw_clock() - t0;
+    const char *names[4] = {"Ticks_clock (raw counter)       ", "TicksOrdered_clock              ", "Now_clock (counter -> ns)       ", "clock_gettime syscall (linux.h) "};
+    Print(STDOUT_FILENO_linux, names[kind]);
+    PrintU64(STDOUT_FILENO_linux, elapsed / (unsigned long long)calls);
+    Print(STDOUT_FILENO_linux, ".");
+    PrintU64(STDOUT_FILENO_linux, elapsed * 10 / (unsigned long long)calls % 10);
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+  Assert(sink != 1);
+
+  // The fallback path, as taken without an invariant counter
+  Clock_clock fallback = clock;
+  fallback.source = SOURCE_SYSCALL_clock;
+  unsigned long long a = Now_clock(&fallback), b = Raw_clock();
+  Assert(b >= a && b - a < 10000000);
+  Print(STDOUT_FILENO_linux, "syscall fallback: ok\n");
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Assert(Init_clock(&clock) == 0);
+  Accuracy_demo();
+  Cost_demo();
+  exit_linux(0);
+  return 0;
+}
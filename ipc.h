@@ -0,0 +1,502 @@
+#ifndef C_IPC_HEADER
+#define C_IPC_HEADER
+
+// === ipc.h: cross-process shared-memory rings over memfd & futex ============
+//
+// Contents:
+//   * ring setup & teardown        (jump: Format_ipc)
+//   * descriptor passing           (jump: SendFd_ipc)
+//   * sending & receiving          (jump: TrySend_ipc)
+//
+// Usage:
+//   ipc.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/ipc.h" // use as header file
+//
+//   #define C_IPC_IMPLEMENTATION
+//   #include "c/ipc.h" // use as implementation file
+//
+//   One process creates the ring (a sealed memfd), hands the descriptor to its
+//   peers over a Unix socket with SendFd_ipc and each peer maps it with
+//   Attach_ipc. Format_ipc/Open_ipc lay a ring out in memory shared some
+//   other way (SysV shm, MAP_SHARED inherited across fork).
+//
+//   Messages are copied into fixed-size slots; the fast path is a few atomics
+//   and no syscall, a shared futex is only touched when the ring is empty or
+//   full and someone is actually sleeping on it.
+//
+//   SPSC_ipc rings allow one producer and one consumer; MPMC_ipc rings (with a
+//   per-slot sequence number) allow any number of each, across processes.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "ipc.h depends on linux.h, include it first"
+#endif
+
+#define CACHE_LINE_ipc 64
+#define MAGIC_ipc      0x31435049U // "IPC1"
+
+enum { SPSC_ipc, MPMC_ipc };
+
+// Lives at the start of the shared mapping; every counter the producers and
+// consumers hammer sits on its own cache line.
+typedef struct {
+  unsigned int magic;
+  unsigned int kind;
+  unsigned int capacity; // slots, power of two
+  unsigned int slot_size;
+  unsigned int stride;   // bytes per slot, header included
+  unsigned int closed;
+  char pad0[CACHE_LINE_ipc - 6 * sizeof(unsigned int)];
+  unsigned int head;     // next slot to consume
+  char pad1[CACHE_LINE_ipc - sizeof(unsigned int)];
+  unsigned int tail;     // next slot to produce
+  char pad2[CACHE_LINE_ipc - sizeof(unsigned int)];
+  unsigned int data_seq; // futex word, bumped when messages arrive and a reader sleeps
+  unsigned int readers;  // set by readers about to sleep on data_seq, cleared by the waker
+  char pad3[CACHE_LINE_ipc - 2 * sizeof(unsigned int)];
+  unsigned int space_seq; // futex word, bumped when slots free up and a writer sleeps
+  unsigned int writers;   // same for writers and space_seq
+  char pad4[CACHE_LINE_ipc - 2 * sizeof(unsigned int)];
+} Shared_ipc;
+
+typedef struct {
+  unsigned int seq; // MPMC only: slot turn, see TrySend_ipc
+  unsigned int len;
+} Slot_ipc;
+
+// A process-local view of a ring; the cached counters spare SPSC sides from
+// reading the other side's cache line on every message.
+typedef struct {
+  Shared_ipc *shm;
+  char *slots;
+  unsigned long map_size;
+  int fd;
+  unsigned int mask;
+  unsigned int cached_head; // producer's last view of head
+  unsigned int cached_tail; // consumer's last view of tail
+  unsigned int spin;        // polls before sleeping on the futex
+} Ring_ipc;
+
+//
+// Ring setup & teardown
+//
+unsigned long Size_ipc(unsigned int capacity, unsigned int slot_size);
+long Format_ipc(Ring_ipc *r, void *mem, unsigned long size, int kind, unsigned int capacity, unsigned int slot_size);
+long Open_ipc(Ring_ipc *r, void *mem, unsigned long size);
+long Create_ipc(Ring_ipc *r, int kind, unsigned int capacity, unsigned int slot_size);
+long Attach_ipc(Ring_ipc *r, int fd);
+void Shutdown_ipc(Ring_ipc *r);
+void Close_ipc(Ring_ipc *r);
+//
+// Descriptor passing
+//
+long SendFd_ipc(int sock, int fd);
+long RecvFd_ipc(int sock);
+//
+// Sending & receiving
+//
+long TrySend_ipc(Ring_ipc *r, const void *msg, unsigned int len);
+long TryRecv_ipc(Ring_ipc *r, void *buf, unsigned int cap);
+long Send_ipc(Ring_ipc *r, const void *msg, unsigned int len);
+long Recv_ipc(Ring_ipc *r, void *buf, unsigned int cap);
+
+static inline void Relax_ipc(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ volatile("yield" ::: "memory");
+#else
+  __asm__ volatile("" ::: "memory");
+#endif
+}
+
+static inline Slot_ipc *At_ipc(const Ring_ipc *r, unsigned int pos) {
+  return (Slot_ipc *)(r->slots + (unsigned long)(pos & r->mask) * r->shm->stride);
+}
+
+#endif // C_IPC_HEADER
+#ifdef C_IPC_IMPLEMENTATION
+
+//
+// Ring setup & teardown
+//
+// Spinning only helps when the peer can run meanwhile on another CPU.
+static int CanSpin_ipc(void) {
+  unsigned long mask[16] = {0};
+  long ret = sched_getaffinity_linux(0, sizeof(mask), mask);
+  unsigned int cpus = 0;
+  for (long i = 0; i < ret / (long)sizeof(unsigned long); ++i) {
+    for (unsigned long m = mask[i]; m; m &= m - 1) {
+      ++cpus;
+    }
+  }
+  return cpus > 1;
+}
+
+static void View_ipc(Ring_ipc *r, void *mem, unsigned long size, int fd) {
+  r->shm = (Shared_ipc *)mem;
+  r->slots = (char *)mem + sizeof(Shared_ipc);
+  r->map_size = size;
+  r->fd = fd;
+  r->mask = 0;
+  r->cached_head = 0;
+  r->cached_tail = 0;
+  r->spin = CanSpin_ipc() ? 100 : 0;
+}
+
+static unsigned int Capacity_ipc(unsigned int capacity) {
+  unsigned int count = 1;
+  while (count < capacity) {
+    count <<= 1;
+  }
+  return count;
+}
+
+static unsigned int Stride_ipc(unsigned int slot_size) {
+  return (sizeof(Slot_ipc) + slot_size + 7) & ~7U;
+}
+
+// Bytes of shared memory needed by a ring, see Format_ipc.
+unsigned long Size_ipc(unsigned int capacity, unsigned int slot_size) {
+  return sizeof(Shared_ipc) + (unsigned long)Capacity_ipc(capacity) * Stride_ipc(slot_size);
+}
+
+// Lays a ring out in `mem`, any memory shared between the peers (SysV shm,
+// MAP_SHARED mappings inherited across fork...). `capacity` is rounded up to a
+// power of two; messages are at most `slot_size` bytes. The caller owns `mem`.
+long Format_ipc(Ring_ipc *r, void *mem, unsigned long size, int kind, unsigned int capacity, unsigned int slot_size) {
+  if ((kind != SPSC_ipc && kind != MPMC_ipc) || !capacity || capacity > (1U << 30) || size < Size_ipc(capacity, slot_size)) {
+    return -EINVAL_linux;
+  }
+  View_ipc(r, mem, size, -1);
+  Shared_ipc *shm = r->shm;
+  for (unsigned long i = 0; i < sizeof(Shared_ipc); ++i) {
+    ((char *)shm)[i] = 0;
+  }
+  shm->kind = kind;
+  shm->capacity = Capacity_ipc(capacity);
+  shm->slot_size = slot_size;
+  shm->stride = Stride_ipc(slot_size);
+  r->mask = shm->capacity - 1;
+  if (kind == MPMC_ipc) {
+    for (unsigned int i = 0; i < shm->capacity; ++i) {
+      At_ipc(r, i)->seq = i;
+    }
+  }
+  __atomic_store_n(&shm->magic, MAGIC_ipc, __ATOMIC_RELEASE);
+  return 0;
+}
+
+// Opens a view of a ring another peer laid out in `mem` with Format_ipc.
+long Open_ipc(Ring_ipc *r, void *mem, unsigned long size) {
+  if (size < sizeof(Shared_ipc)) {
+    return -EINVAL_linux;
+  }
+  View_ipc(r, mem, size, -1);
+  Shared_ipc *shm = r->shm;
+  unsigned int capacity = shm->capacity;
+  if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != MAGIC_ipc || !capacity || (capacity & (capacity - 1)) ||
+      shm->stride < sizeof(Slot_ipc) + shm->slot_size || sizeof(Shared_ipc) + (unsigned long)capacity * shm->stride > size) {
+    return -EINVAL_linux;
+  }
+  r->mask = capacity - 1;
+  return 0;
+}
+
+// Creates a ring in a fresh memfd, to be shared with SendFd_ipc.
+long Create_ipc(Ring_ipc *r, int kind, unsigned int capacity, unsigned int slot_size) {
+  if (!capacity || capacity > (1U << 30)) {
+    return -EINVAL_linux;
+  }
+  unsigned long size = Size_ipc(capacity, slot_size);
+  long fd = memfd_create_linux("ipc ring", MFD_CLOEXEC_linux | MFD_ALLOW_SEALING_linux);
+  if (fd < 0) {
+    return fd;
+  }
+  long ret = ftruncate64_linux((unsigned int)fd, size);
+  if (ret >= 0) {
+    // Peers can't shrink the file under our mapping (SIGBUS) or grow it.
+    ret = fcntl64_linux((unsigned int)fd, F_ADD_SEALS_linux, F_SEAL_SHRINK_linux | F_SEAL_GROW_linux);
+  }
+  if (ret >= 0) {
+    ret = mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux, (int)fd, 0);
+  }
+  if (ret >= 0 || ret < -4095) {
+    void *mem = (void *)ret;
+    ret = Format_ipc(r, mem, size, kind, capacity, slot_size);
+    if (ret < 0) {
+      munmap_linux(mem, size);
+    }
+  }
+  if (ret < 0) {
+    close_linux((unsigned int)fd);
+    return ret;
+  }
+  r->fd = (int)fd;
+  return 0;
+}
+
+// Maps a ring created by another process; takes ownership of `fd`.
+long Attach_ipc(Ring_ipc *r, int fd) {
+  long long size = 0;
+  long ret = llseek_linux((unsigned int)fd, 0, &size, SEEK_END_linux);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = mmap_linux(0, (unsigned long)size, PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux, fd, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  void *mem = (void *)ret;
+  ret = Open_ipc(r, mem, (unsigned long)size);
+  if (ret < 0) {
+    munmap_linux(mem, (unsigned long)size);
+    return ret;
+  }
+  r->fd = fd;
+  return 0;
+}
+
+static void Wake_ipc(unsigned int *seq) {
+  __atomic_fetch_add(seq, 1, __ATOMIC_RELEASE);
+  if (futex_wake_linux(seq, FUTEX_BITSET_MATCH_ANY, 0x7fffffff, FUTEX2_SIZE_U32) == -ENOSYS_linux) {
+    futex_time64_linux(seq, FUTEX_WAKE, 0x7fffffff, 0, 0, 0); // kernels before futex2 (6.7)
+  }
+}
+
+// Marks the ring closed and wakes every sleeper: senders get -EPIPE, receivers
+// get -EPIPE once the ring is drained.
+void Shutdown_ipc(Ring_ipc *r) {
+  __atomic_store_n(&r->shm->closed, 1, __ATOMIC_SEQ_CST);
+  Wake_ipc(&r->shm->data_seq);
+  Wake_ipc(&r->shm->space_seq);
+}
+
+// Unmaps and closes rings from Create_ipc/Attach_ipc; a no-op for Format_ipc/Open_ipc views.
+void Close_ipc(Ring_ipc *r) {
+  if (r->fd >= 0) {
+    munmap_linux(r->shm, r->map_size);
+    close_linux((unsigned int)r->fd);
+  }
+}
+
+//
+// Descriptor passing
+//
+long SendFd_ipc(int sock, int fd) {
+  unsigned long control[CMSG_SPACE_linux(sizeof(int)) / sizeof(unsigned long)] = {0};
+  char byte = 0;
+  iovec_linux iov = {&byte, 1};
+  user_msghdr_linux msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr_linux *cmsg = CMSG_FIRSTHDR_linux(&msg);
+  cmsg->cmsg_level = SOL_SOCKET_linux;
+  cmsg->cmsg_type = SCM_RIGHTS_linux;
+  cmsg->cmsg_len = CMSG_LEN_linux(sizeof(int));
+  *(int *)CMSG_DATA_linux(cmsg) = fd;
+  return sendmsg_linux(sock, &msg, MSG_NOSIGNAL_linux);
+}
+
+// Returns the received descriptor (close-on-exec) or -errno.
+long RecvFd_ipc(int sock) {
+  unsigned long control[CMSG_SPACE_linux(sizeof(int)) / sizeof(unsigned long)];
+  char byte;
+  iovec_linux iov = {&byte, 1};
+  user_msghdr_linux msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  long ret = recvmsg_linux(sock, &msg, MSG_CMSG_CLOEXEC_linux);
+  if (ret < 0) {
+    return ret;
+  }
+  cmsghdr_linux *cmsg = CMSG_FIRSTHDR_linux(&msg);
+  if (ret == 0 || !cmsg || cmsg->cmsg_level != SOL_SOCKET_linux || cmsg->cmsg_type != SCM_RIGHTS_linux) {
+    return -EBADMSG_linux;
+  }
+  return *(int *)CMSG_DATA_linux(cmsg);
+}
+
+//
+// Sending & receiving
+//
+
+// Pairs with the sleeper's store to `waiters` in Sleep_ipc: either the
+// sleeper sees the new counter or we see the sleeper and bump its futex word.
+static void Notify_ipc(unsigned int *seq, unsigned int *waiters) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(waiters, __ATOMIC_RELAXED) && __atomic_exchange_n(waiters, 0, __ATOMIC_RELAXED)) {
+    Wake_ipc(seq); // one wake per sleep episode, not one per message
+  }
+}
+
+typedef unsigned long __attribute__((may_alias)) Word_ipc;
+
+// Slots are 8-byte aligned, so copy words whenever the caller's buffer is too.
+static void Copy_ipc(char *dst, const char *src, unsigned int len) {
+  unsigned int i = 0;
+  if (!(((unsigned long)dst | (unsigned long)src) & (sizeof(Word_ipc) - 1))) {
+    for (; i + sizeof(Word_ipc) <= len; i += sizeof(Word_ipc)) {
+      *(Word_ipc *)(dst + i) = *(const Word_ipc *)(src + i);
+    }
+  }
+  for (; i < len; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+// Returns 0, -EAGAIN when the ring is full, -EMSGSIZE or -EPIPE once shut down.
+long TrySend_ipc(Ring_ipc *r, const void *msg, unsigned int len) {
+  Shared_ipc *shm = r->shm;
+  if (len > shm->slot_size) {
+    return -EMSGSIZE_linux;
+  }
+  if (__atomic_load_n(&shm->closed, __ATOMIC_RELAXED)) {
+    return -EPIPE_linux;
+  }
+  Slot_ipc *slot;
+  unsigned int pos;
+  if (shm->kind == SPSC_ipc) {
+    pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+    if (pos - r->cached_head > r->mask) {
+      r->cached_head = __atomic_load_n(&shm->head, __ATOMIC_ACQUIRE);
+      if (pos - r->cached_head > r->mask) {
+        return -EAGAIN_linux;
+      }
+    }
+    slot = At_ipc(r, pos);
+    slot->len = len;
+    Copy_ipc((char *)(slot + 1), (const char *)msg, len);
+    __atomic_store_n(&shm->tail, pos + 1, __ATOMIC_RELEASE);
+  } else {
+    // Vyukov's bounded queue: a slot is free for position `pos` when its seq
+    // equals pos and holds a message for `pos` when its seq equals pos + 1.
+    pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+    for (;;) {
+      slot = At_ipc(r, pos);
+      int diff = (int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+      if (diff == 0) {
+        if (__atomic_compare_exchange_n(&shm->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return -EAGAIN_linux;
+      } else {
+        pos = __atomic_load_n(&shm->tail, __ATOMIC_RELAXED);
+      }
+    }
+    slot->len = len;
+    Copy_ipc((char *)(slot + 1), (const char *)msg, len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  }
+  Notify_ipc(&shm->data_seq, &shm->readers);
+  return 0;
+}
+
+// Returns the message length (only the first `cap` bytes are copied), -EAGAIN
+// when the ring is empty or -EPIPE when it is empty and shut down.
+long TryRecv_ipc(Ring_ipc *r, void *buf, unsigned int cap) {
+  Shared_ipc *shm = r->shm;
+  Slot_ipc *slot;
+  unsigned int pos;
+  unsigned int len;
+  if (shm->kind == SPSC_ipc) {
+    pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+    if (pos == r->cached_tail) {
+      r->cached_tail = __atomic_load_n(&shm->tail, __ATOMIC_ACQUIRE);
+      if (pos == r->cached_tail) {
+        return __atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE) ? -EPIPE_linux : -EAGAIN_linux;
+      }
+    }
+    slot = At_ipc(r, pos);
+    len = slot->len;
+    Copy_ipc((char *)buf, (const char *)(slot + 1), len < cap ? len : cap);
+    __atomic_store_n(&shm->head, pos + 1, __ATOMIC_RELEASE);
+  } else {
+    pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+    for (;;) {
+      slot = At_ipc(r, pos);
+      int diff = (int)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+      if (diff == 0) {
+        if (__atomic_compare_exchange_n(&shm->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return __atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE) ? -EPIPE_linux : -EAGAIN_linux;
+      } else {
+        pos = __atomic_load_n(&shm->head, __ATOMIC_RELAXED);
+      }
+    }
+    len = slot->len;
+    Copy_ipc((char *)buf, (const char *)(slot + 1), len < cap ? len : cap);
+    __atomic_store_n(&slot->seq, pos + r->mask + 1, __ATOMIC_RELEASE);
+  }
+  Notify_ipc(&shm->space_seq, &shm->writers);
+  return len;
+}
+
+// Sleeps on a shared (non-private) futex so peers in other processes can wake us.
+static long Sleep_ipc(Ring_ipc *r, unsigned int *seq, unsigned int *waiters, int sending, const void *msg, void *buf, unsigned int len) {
+  unsigned int observed = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+  __atomic_store_n(waiters, 1, __ATOMIC_SEQ_CST);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  long ret = sending ? TrySend_ipc(r, msg, len) : TryRecv_ipc(r, buf, len);
+  if (ret == -EAGAIN_linux) {
+    long err = futex_wait_linux(seq, observed, FUTEX_BITSET_MATCH_ANY, FUTEX2_SIZE_U32, 0, 0);
+    if (err == -ENOSYS_linux) {
+      futex_time64_linux(seq, FUTEX_WAIT, observed, 0, 0, 0); // kernels before futex2 (6.7)
+    }
+  }
+  return ret;
+}
+
+// Like TrySend_ipc but spins, then sleeps, while the ring is full.
+long Send_ipc(Ring_ipc *r, const void *msg, unsigned int len) {
+  for (;;) {
+    long ret = TrySend_ipc(r, msg, len);
+    for (unsigned int i = 0; ret == -EAGAIN_linux && i < r->spin; ++i) {
+      Relax_ipc();
+      ret = TrySend_ipc(r, msg, len);
+    }
+    if (ret != -EAGAIN_linux) {
+      return ret;
+    }
+    ret = Sleep_ipc(r, &r->shm->space_seq, &r->shm->writers, 1, msg, 0, len);
+    if (ret != -EAGAIN_linux) {
+      return ret;
+    }
+  }
+}
+
+// Like TryRecv_ipc but spins, then sleeps, while the ring is empty.
+long Recv_ipc(Ring_ipc *r, void *buf, unsigned int cap) {
+  for (;;) {
+    long ret = TryRecv_ipc(r, buf, cap);
+    for (unsigned int i = 0; ret == -EAGAIN_linux && i < r->spin; ++i) {
+      Relax_ipc();
+      ret = TryRecv_ipc(r, buf, cap);
+    }
+    if (ret != -EAGAIN_linux) {
+      return ret;
+    }
+    ret = Sleep_ipc(r, &r->shm->data_seq, &r->shm->readers, 0, 0, buf, cap);
+    if (ret != -EAGAIN_linux) {
+      return ret;
+    }
+  }
+}
+
+#endif // C_IPC_IMPLEMENTATION
@@ -0,0 +1,575 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o ipc_demo ipc_demo.c -e main && ./ipc_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_IPC_IMPLEMENTATION
+#include "ipc.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void ReadAll(int fd, void *buf, unsigned long len) {
+  for (unsigned long done = 0; done < len;) {
+    long n = read_linux(fd, (char *)buf + done, len - done);
+    Assert(n > 0);
+    done += n;
+  }
+}
+
+//
+// Correctness: fd passing, SPSC ordering, MPMC across processes
+//
+#define MPMC_PRODUCERS 2
+#define MPMC_CONSUMERS 2
+#define MPMC_COUNT     200000
+
+void Spsc_demo(void) {
+  int sv[2];
+  Assert(socketpair_linux(AF_UNIX_linux, SOCK_STREAM_linux | SOCK_CLOEXEC_linux, 0, sv) == 0);
+  long pid = fork_linux();
+  if (pid == 0) {
+    close_linux(sv[0]);
+    Ring_ipc ring;
+    long fd = RecvFd_ipc(sv[1]);
+    Assert(fd >= 0);
+    Assert(Attach_ipc(&ring, (int)fd) == 0);
+    for (unsigned int i = 0; i < 100000; ++i) {
+      unsigned int msg[4] = {i, i * 3, i ^ 0x5a5a5a5a, 0};
+      Assert(Send_ipc(&ring, msg, (i & 3) * sizeof(unsigned int) + 4) == 0);
+    }
+    Shutdown_ipc(&ring);
+    Close_ipc(&ring);
+    exit_linux(0);
+  }
+  close_linux(sv[1]);
+  Ring_ipc ring;
+  Assert(Create_ipc(&ring, SPSC_ipc, 64, 16) == 0);
+  Assert(SendFd_ipc(sv[0], ring.fd) == 1);
+  unsigned int i = 0;
+  for (;; ++i) {
+    unsigned int msg[4];
+    long len = Recv_ipc(&ring, msg, sizeof(msg));
+    if (len == -EPIPE_linux) {
+      break;
+    }
+    Assert(len == (long)((i & 3) * sizeof(unsigned int) + 4) && msg[0] == i);
+    Assert(len < 8 || msg[1] == i * 3);
+    Assert(len < 12 || msg[2] == (i ^ 0x5a5a5a5a));
+  }
+  Assert(i == 100000);
+  Assert(TrySend_ipc(&ring, &i, sizeof(i)) == -EPIPE_linux);
+  Assert(TrySend_ipc(&ring, &i, 17) == -EMSGSIZE_linux);
+  wait4_linux((int)pid, 0, 0, 0);
+  Close_ipc(&ring);
+  close_linux(sv[0]);
+  Print(STDOUT_FILENO_linux, "spsc ring over passed memfd: ok\n");
+}
+
+void Mpmc_demo(void) {
+  Ring_ipc ring;
+  Assert(Create_ipc(&ring, MPMC_ipc, 256, sizeof(unsigned long long)) == 0);
+  int sums[2];
+  Assert(pipe2_linux(sums, O_CLOEXEC_linux) == 0);
+  long pids[MPMC_PRODUCERS + MPMC_CONSUMERS];
+  for (int p = 0; p < MPMC_PRODUCERS + MPMC_CONSUMERS; ++p) {
+    pids[p] = fork_linux();
+    if (pids[p] == 0) {
+      if (p < MPMC_PRODUCERS) {
+        for (unsigned long long v = 1; v <= MPMC_COUNT; ++v) {
+          Assert(Send_ipc(&ring, &v, sizeof(v)) == 0);
+        }
+      } else {
+        unsigned long long sum = 0;
+        unsigned long long v;
+        while (Recv_ipc(&ring, &v, sizeof(v)) == sizeof(v)) {
+          sum += v;
+        }
+        write_linux(sums[1], &sum, sizeof(sum));
+      }
+      exit_linux(0);
+    }
+  }
+  for (int p = 0; p < MPMC_PRODUCERS; ++p) {
+    wait4_linux((int)pids[p], 0, 0, 0);
+  }
+  Shutdown_ipc(&ring); // consumers drain what is left, then see -EPIPE
+  unsigned long long total = 0;
+  for (int p = 0; p < MPMC_CONSUMERS; ++p) {
+    unsigned long long sum;
+    ReadAll(sums[0], &sum, sizeof(sum));
+    total += sum;
+    wait4_linux((int)pids[MPMC_PRODUCERS + p], 0, 0, 0);
+  }
+  Assert(total == MPMC_PRODUCERS * (unsigned long long)MPMC_COUNT * (MPMC_COUNT + 1) / 2);
+  close_linux(sums[0]);
+  close_linux(sums[1]);
+  Close_ipc(&ring);
+  Print(STDOUT_FILENO_linux, "mpmc ring, 2 producer + 2 consumer processes: ok\n");
+}
+
+//
+// Benchmark suite: round trip & streaming for each IPC primitive from 8 B to
+// 1 MiB, with the two processes pinned same-core, same-socket or cross-socket
+//
+#define MAX_MSG    (1 << 20)
+#define LANE_BYTES (64 << 10) // like a pipe buffer, at least 8 slots
+
+enum { CH_RING, CH_SHM, CH_MSG, CH_MQ, CH_PIPE, CH_SOCKET, CH_EVENTFD, CH_COUNT };
+const char *channelNames[CH_COUNT] = {"memfd ring    ", "sysv shm+futex", "sysv msg      ", "posix mq      ", "pipe2         ", "socketpair    ", "eventfd+shm   "};
+
+typedef struct {
+  long mtype; // msgsnd_linux header, payloads live right behind it for every channel
+  char mtext[MAX_MSG];
+} MsgBuf;
+
+// eventfd carries no payload: messages go through the slots of a
+// MAP_SHARED mapping, `ready` counts filled slots and `free` drained ones.
+typedef struct {
+  char *slots;
+  int ready;
+  int free;
+  unsigned long long credit; // slots this side may fill (sender) or drain (receiver)
+  unsigned int pos;
+} EventLane;
+
+// Two one-way lanes: 0 parent -> child, 1 child -> parent.
+typedef struct {
+  int kind;
+  unsigned int size;
+  unsigned int slots; // per lane, for the shared-memory channels
+  Ring_ipc ring[2];
+  void *mem;
+  unsigned long mem_size;
+  int mq[2];
+  int msq[2];
+  int fds[2][2]; // pipe2 or socketpair: [lane][0] read end, [lane][1] write end
+  EventLane ev[2];
+} Channel;
+
+long ReadNumber(const char *path) {
+  int fd = open_linux(path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  char buf[32];
+  long n = read_linux(fd, buf, sizeof(buf) - 1);
+  close_linux(fd);
+  if (n <= 0 || buf[0] < '0' || buf[0] > '9') {
+    return -1;
+  }
+  long value = 0;
+  for (long i = 0; i < n && buf[i] >= '0' && buf[i] <= '9'; ++i) {
+    value = value * 10 + (buf[i] - '0');
+  }
+  return value;
+}
+
+void WriteAll(int fd, const void *buf, unsigned long len) {
+  for (unsigned long done = 0; done < len;) {
+    long n = write_linux(fd, (const char *)buf + done, len - done);
+    Assert(n > 0);
+    done += n;
+  }
+}
+
+typedef unsigned long __attribute__((may_alias)) Word;
+
+void CopyBytes(char *dst, const char *src, unsigned long len) {
+  unsigned long i = 0;
+  if (!(((unsigned long)dst | (unsigned long)src) & (sizeof(Word) - 1))) {
+    for (; i + sizeof(Word) <= len; i += sizeof(Word)) {
+      *(Word *)(dst + i) = *(const Word *)(src + i);
+    }
+  }
+  for (; i < len; ++i) {
+    dst[i] = src[i];
+  }
+}
+
+// Returns 0, or -errno when the primitive can't carry `size`-byte messages.
+long OpenChannel(Channel *ch, int kind, unsigned int size) {
+  ch->kind = kind;
+  ch->size = size;
+  ch->slots = size * 8 > LANE_BYTES ? 8 : LANE_BYTES / size;
+  if (kind == CH_SHM) {
+    unsigned long laneSize = Size_ipc(ch->slots, size);
+    ch->mem_size = 2 * laneSize;
+    long id = shmget_linux(IPC_PRIVATE_linux, ch->mem_size, IPC_CREAT_linux | 0600);
+    Assert(id >= 0);
+    long addr = shmat_linux((int)id, 0, 0);
+    shmctl_linux((int)id, IPC_RMID_linux, 0); // destroyed once both processes detach
+    Assert(addr >= 0 || addr < -4095);
+    ch->mem = (void *)addr;
+    for (int i = 0; i < 2; ++i) {
+      Assert(Format_ipc(&ch->ring[i], (char *)ch->mem + i * laneSize, laneSize, SPSC_ipc, ch->slots, size) == 0);
+    }
+  } else if (kind == CH_MSG) {
+    if ((long)size > ReadNumber("/proc/sys/kernel/msgmax")) {
+      return -EMSGSIZE_linux;
+    }
+    for (int i = 0; i < 2; ++i) {
+      ch->msq[i] = (int)msgget_linux(IPC_PRIVATE_linux, IPC_CREAT_linux | 0600);
+      Assert(ch->msq[i] >= 0);
+    }
+  } else if (kind == CH_MQ) {
+    const char *names[2] = {"ipc_demo_0", "ipc_demo_1"};
+    mq_attr_linux attr = {0};
+    attr.mq_maxmsg = 10; // default /proc/sys/fs/mqueue/msg_max
+    attr.mq_msgsize = size;
+    for (int i = 0; i < 2; ++i) {
+      mq_unlink_linux(names[i]);
+      long q = mq_open_linux(names[i], O_RDWR_linux | O_CREAT_linux | O_EXCL_linux | O_CLOEXEC_linux, 0600, &attr);
+      if (q < 0) {
+        if (i) {
+          close_linux(ch->mq[0]);
+        }
+        return q; // size above /proc/sys/fs/mqueue/msgsize_max
+      }
+      ch->mq[i] = (int)q;
+      mq_unlink_linux(names[i]); // the descriptors keep the queues alive
+    }
+  } else if (kind == CH_PIPE) {
+    for (int i = 0; i < 2; ++i) {
+      Assert(pipe2_linux(ch->fds[i], O_CLOEXEC_linux) == 0);
+    }
+  } else if (kind == CH_SOCKET) {
+    int sv[2];
+    Assert(socketpair_linux(AF_UNIX_linux, SOCK_STREAM_linux | SOCK_CLOEXEC_linux, 0, sv) == 0);
+    ch->fds[0][0] = sv[1];
+    ch->fds[0][1] = sv[0];
+    ch->fds[1][0] = sv[0];
+    ch->fds[1][1] = sv[1];
+  } else if (kind == CH_EVENTFD) {
+    ch->mem_size = 2UL * ch->slots * size;
+    long addr = mmap_linux(0, ch->mem_size, PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux | MAP_ANONYMOUS_linux, -1, 0);
+    Assert(addr >= 0 || addr < -4095);
+    ch->mem = (void *)addr;
+    for (int i = 0; i < 2; ++i) {
+      ch->ev[i].slots = (char *)ch->mem + (unsigned long)i * ch->slots * size;
+      ch->ev[i].ready = (int)eventfd2_linux(0, EFD_CLOEXEC_linux);
+      ch->ev[i].free = (int)eventfd2_linux(0, EFD_CLOEXEC_linux);
+      Assert(ch->ev[i].ready >= 0 && ch->ev[i].free >= 0);
+    }
+  }
+  return 0;
+}
+
+// After fork: memfd rings are created by the parent and passed over `sock`;
+// every other channel was inherited. Sets up this side's lane state.
+void ConnectChannel(Channel *ch, int isChild, int sock) {
+  if (ch->kind == CH_RING) {
+    for (int i = 0; i < 2; ++i) {
+      if (isChild) {
+        long fd = RecvFd_ipc(sock);
+        Assert(fd >= 0);
+        Assert(Attach_ipc(&ch->ring[i], (int)fd) == 0);
+      } else {
+        Assert(Create_ipc(&ch->ring[i], SPSC_ipc, ch->slots, ch->size) == 0);
+        Assert(SendFd_ipc(sock, ch->ring[i].fd) == 1);
+      }
+    }
+  } else if (ch->kind == CH_EVENTFD) {
+    int sendLane = isChild ? 1 : 0;
+    ch->ev[sendLane].credit = ch->slots;
+    ch->ev[1 - sendLane].credit = 0;
+  }
+}
+
+void CloseChannel(Channel *ch, int isChild) {
+  for (int i = 0; i < 2; ++i) {
+    if (ch->kind == CH_RING) {
+      Close_ipc(&ch->ring[i]);
+    } else if (ch->kind == CH_MQ) {
+      close_linux(ch->mq[i]);
+    } else if (ch->kind == CH_MSG && !isChild) {
+      msgctl_linux(ch->msq[i], IPC_RMID_linux, 0);
+    } else if (ch->kind == CH_PIPE || (ch->kind == CH_SOCKET && i == 0)) {
+      close_linux(ch->fds[i][0]);
+      close_linux(ch->fds[i][1]);
+    } else if (ch->kind == CH_EVENTFD) {
+      close_linux(ch->ev[i].ready);
+      close_linux(ch->ev[i].free);
+    }
+  }
+  if (ch->kind == CH_SHM) {
+    shmdt_linux(ch->mem);
+  } else if (ch->kind == CH_EVENTFD) {
+    munmap_linux(ch->mem, ch->mem_size);
+  }
+}
+
+void ChannelSend(Channel *ch, int lane, MsgBuf *m) {
+  unsigned int size = ch->size;
+  if (ch->kind == CH_RING || ch->kind == CH_SHM) {
+    Assert(Send_ipc(&ch->ring[lane], m->mtext, size) == 0);
+  } else if (ch->kind == CH_MSG) {
+    m->mtype = 1;
+    Assert(msgsnd_linux(ch->msq[lane], m, size, 0) == 0);
+  } else if (ch->kind == CH_MQ) {
+    Assert(mq_timedsend_time64_linux(ch->mq[lane], m->mtext, size, 0, 0) == 0);
+  } else if (ch->kind == CH_PIPE || ch->kind == CH_SOCKET) {
+    WriteAll(ch->fds[lane][1], m->mtext, size);
+  } else {
+    EventLane *ev = &ch->ev[lane];
+    if (!ev->credit) {
+      Assert(read_linux(ev->free, &ev->credit, sizeof(ev->credit)) == sizeof(ev->credit));
+    }
+    CopyBytes(ev->slots + (unsigned long)(ev->pos++ % ch->slots) * size, m->mtext, size);
+    ev->credit--;
+    unsigned long long one = 1;
+    Assert(write_linux(ev->ready, &one, sizeof(one)) == sizeof(one));
+  }
+}
+
+void ChannelRecv(Channel *ch, int lane, MsgBuf *m) {
+  unsigned int size = ch->size;
+  if (ch->kind == CH_RING || ch->kind == CH_SHM) {
+    Assert(Recv_ipc(&ch->ring[lane], m->mtext, size) == (long)size);
+  } else if (ch->kind == CH_MSG) {
+    Assert(msgrcv_linux(ch->msq[lane], m, size, 0, 0) == (long)size);
+  } else if (ch->kind == CH_MQ) {
+    Assert(mq_timedreceive_time64_linux(ch->mq[lane], m->mtext, size, 0, 0) == (long)size);
+  } else if (ch->kind == CH_PIPE || ch->kind == CH_SOCKET) {
+    ReadAll(ch->fds[lane][0], m->mtext, size);
+  } else {
+    EventLane *ev = &ch->ev[lane];
+    if (!ev->credit) {
+      Assert(read_linux(ev->ready, &ev->credit, sizeof(ev->credit)) == sizeof(ev->credit));
+    }
+    CopyBytes(m->mtext, ev->slots + (unsigned long)(ev->pos++ % ch->slots) * size, size);
+    ev->credit--;
+    unsigned long long one = 1;
+    Assert(write_linux(ev->free, &one, sizeof(one)) == sizeof(one));
+  }
+}
+
+void Pin(int cpu) {
+  unsigned long mask[16] = {0};
+  mask[cpu / (8 * sizeof(unsigned long))] |= 1UL << (cpu % (8 * sizeof(unsigned long)));
+  Assert(sched_setaffinity_linux(0, sizeof(mask), mask) == 0);
+}
+
+static MsgBuf message;
+
+// Runs `count` messages parent -> child (streaming) or parent -> child -> parent
+// (round trips) with the processes pinned to `cpus`; returns the elapsed
+// nanoseconds, or 0 when the channel can't carry `size`-byte messages.
+unsigned long long RunChannel(int kind, unsigned int size, int roundTrip, unsigned int count, const int *cpus) {
+  Channel ch = {0};
+  if (OpenChannel(&ch, kind, size) < 0) {
+    return 0;
+  }
+  int sv[2];
+  Assert(socketpair_linux(AF_UNIX_linux, SOCK_STREAM_linux | SOCK_CLOEXEC_linux, 0, sv) == 0);
+  long pid = fork_linux();
+  if (pid == 0) {
+    close_linux(sv[0]);
+    Pin(cpus[1]);
+    ConnectChannel(&ch, true, sv[1]);
+    for (unsigned int i = 0; i < count; ++i) {
+      ChannelRecv(&ch, 0, &message);
+      if (roundTrip) {
+        ChannelSend(&ch, 1, &message);
+      }
+    }
+    if (!roundTrip) {
+      ChannelSend(&ch, 1, &message); // streaming done
+    }
+    CloseChannel(&ch, true);
+    exit_linux(0);
+  }
+  close_linux(sv[1]);
+  Pin(cpus[0]);
+  ConnectChannel(&ch, false, sv[0]);
+  unsigned long long start = Now_ns();
+  for (unsigned int i = 0; i < count; ++i) {
+    message.mtext[0] = (char)i;
+    ChannelSend(&ch, 0, &message);
+    if (roundTrip) {
+      ChannelRecv(&ch, 1, &message);
+      Assert(message.mtext[0] == (char)i);
+    }
+  }
+  if (!roundTrip) {
+    ChannelRecv(&ch, 1, &message);
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  wait4_linux((int)pid, 0, 0, 0);
+  CloseChannel(&ch, false);
+  close_linux(sv[0]);
+  return elapsed;
+}
+
+void PrintCell(const char *text, unsigned long width) {
+  for (unsigned long n = Size_chars(text); n < width; ++n) {
+    Print(STDOUT_FILENO_linux, " ");
+  }
+  Print(STDOUT_FILENO_linux, text);
+}
+
+void PrintNumberCell(unsigned long long value, unsigned long width) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  PrintCell(buf + i, width);
+}
+
+// CPU pairs for each placement, found from sysfs topology; -1 when absent.
+enum { SAME_CORE, SAME_SOCKET, CROSS_SOCKET, PLACEMENT_COUNT };
+const char *placementNames[PLACEMENT_COUNT] = {"same core", "same socket", "cross socket"};
+
+void FindPlacements(int pairs[PLACEMENT_COUNT][2]) {
+  unsigned long mask[16] = {0};
+  Assert(sched_getaffinity_linux(0, sizeof(mask), mask) > 0);
+  int cpus[64];
+  long package[64];
+  long core[64];
+  int n = 0;
+  for (int cpu = 0; cpu < (int)(8 * sizeof(mask)) && n < 64; ++cpu) {
+    if (!(mask[cpu / (8 * sizeof(unsigned long))] & (1UL << (cpu % (8 * sizeof(unsigned long)))))) {
+      continue;
+    }
+    char path[96] = "/sys/devices/system/cpu/cpu";
+    char *p = path + Size_chars(path);
+    char digits[8];
+    int d = 0;
+    for (int v = cpu; d == 0 || v; v /= 10) {
+      digits[d++] = (char)('0' + v % 10);
+    }
+    while (d) {
+      *p++ = digits[--d];
+    }
+    CopyBytes(p, "/topology/physical_package_id", 30);
+    package[n] = ReadNumber(path);
+    CopyBytes(p, "/topology/core_id", 18);
+    core[n] = ReadNumber(path);
+    cpus[n++] = cpu;
+  }
+  for (int k = 0; k < PLACEMENT_COUNT; ++k) {
+    pairs[k][0] = pairs[k][1] = -1;
+  }
+  pairs[SAME_CORE][0] = pairs[SAME_CORE][1] = cpus[0];
+  for (int i = 0; i < n; ++i) {
+    for (int j = i + 1; j < n; ++j) {
+      if (package[i] == package[j] && core[i] != core[j] && pairs[SAME_SOCKET][0] < 0) {
+        pairs[SAME_SOCKET][0] = cpus[i];
+        pairs[SAME_SOCKET][1] = cpus[j];
+      }
+      if (package[i] != package[j] && pairs[CROSS_SOCKET][0] < 0) {
+        pairs[CROSS_SOCKET][0] = cpus[i];
+        pairs[CROSS_SOCKET][1] = cpus[j];
+      }
+    }
+  }
+}
+
+void Suite_demo(void) {
+  unsigned int sizes[] = {8, 64, 512, 4 << 10, 64 << 10, 1 << 20};
+  const char *sizeNames[] = {"8 B", "64 B", "512 B", "4 KiB", "64 KiB", "1 MiB"};
+  enum { SIZE_COUNT = sizeof(sizes) / sizeof(sizes[0]) };
+  unsigned long original[16] = {0};
+  Assert(sched_getaffinity_linux(0, sizeof(original), original) > 0);
+  int pairs[PLACEMENT_COUNT][2];
+  FindPlacements(pairs);
+
+  for (int p = 0; p < PLACEMENT_COUNT; ++p) {
+    Print(STDOUT_FILENO_linux, "\n");
+    Print(STDOUT_FILENO_linux, placementNames[p]);
+    if (pairs[p][0] < 0) {
+      Print(STDOUT_FILENO_linux, ": no such CPU pair in our affinity mask, skipped\n");
+      continue;
+    }
+    Print(STDOUT_FILENO_linux, ": cpu ");
+    PrintU64(STDOUT_FILENO_linux, pairs[p][0]);
+    Print(STDOUT_FILENO_linux, " <-> cpu ");
+    PrintU64(STDOUT_FILENO_linux, pairs[p][1]);
+    Print(STDOUT_FILENO_linux, "\n");
+    for (int roundTrip = true; roundTrip >= false; --roundTrip) {
+      Print(STDOUT_FILENO_linux, roundTrip ? "round trip (ns)" : "streaming (MB/s)");
+      for (int s = 0; s < SIZE_COUNT; ++s) {
+        PrintCell(sizeNames[s], s ? 9 : 8);
+      }
+      Print(STDOUT_FILENO_linux, "\n");
+      for (int kind = 0; kind < CH_COUNT; ++kind) {
+        Print(STDOUT_FILENO_linux, channelNames[kind]);
+        Print(STDOUT_FILENO_linux, "  ");
+        for (int s = 0; s < SIZE_COUNT; ++s) {
+          // ~256 MiB or 100k messages streamed, a quarter of that for round trips
+          unsigned int count = (256U << 20) / sizes[s];
+          count = count > 100000 ? 100000 : count;
+          count = roundTrip ? count / 4 : count;
+          unsigned long long elapsed = RunChannel(kind, sizes[s], roundTrip, count, pairs[p]);
+          if (!elapsed) {
+            PrintCell("n/a", s ? 9 : 8);
+          } else if (roundTrip) {
+            PrintNumberCell(elapsed / count, s ? 9 : 8);
+          } else {
+            PrintNumberCell((unsigned long long)count * sizes[s] * 1000 / elapsed, s ? 9 : 8);
+          }
+        }
+        Print(STDOUT_FILENO_linux, "\n");
+      }
+    }
+  }
+  sched_setaffinity_linux(0, sizeof(original), original);
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Spsc_demo();
+  Mpmc_demo();
+  Suite_demo();
+  exit_linux(0);
+  return 0;
+}
@@ -1838,6 +1838,45 @@
 
 #define UFFD_USER_MODE_ONLY_linux     1
 
+#define UFFD_API_linux                        0xAAULL
+#define UFFD_EVENT_PAGEFAULT_linux            0x12
+#define UFFD_EVENT_FORK_linux                 0x13
+#define UFFD_EVENT_REMAP_linux                0x14
+#define UFFD_EVENT_REMOVE_linux               0x15
+#define UFFD_EVENT_UNMAP_linux                0x16
+#define UFFD_PAGEFAULT_FLAG_WRITE_linux       (1 << 0)
+#define UFFD_PAGEFAULT_FLAG_WP_linux          (1 << 1)
+#define UFFD_PAGEFAULT_FLAG_MINOR_linux       (1 << 2)
+#define UFFD_FEATURE_PAGEFAULT_FLAG_WP_linux  (1 << 0)
+#define UFFD_FEATURE_EVENT_FORK_linux         (1 << 1)
+#define UFFD_FEATURE_EVENT_REMAP_linux        (1 << 2)
+#define UFFD_FEATURE_EVENT_REMOVE_linux       (1 << 3)
+#define UFFD_FEATURE_MISSING_HUGETLBFS_linux  (1 << 4)
+#define UFFD_FEATURE_MISSING_SHMEM_linux      (1 << 5)
+#define UFFD_FEATURE_EVENT_UNMAP_linux        (1 << 6)
+#define UFFD_FEATURE_SIGBUS_linux             (1 << 7)
+#define UFFD_FEATURE_THREAD_ID_linux          (1 << 8)
+#define UFFD_FEATURE_MINOR_HUGETLBFS_linux    (1 << 9)
+#define UFFD_FEATURE_MINOR_SHMEM_linux        (1 << 10)
+#define UFFD_FEATURE_EXACT_ADDRESS_linux      (1 << 11)
+#define UFFD_FEATURE_WP_HUGETLBFS_SHMEM_linux (1 << 12)
+#define UFFD_FEATURE_WP_UNPOPULATED_linux     (1 << 13)
+#define UFFD_FEATURE_POISON_linux             (1 << 14)
+#define UFFD_FEATURE_WP_ASYNC_linux           (1 << 15)
+#define UFFD_FEATURE_MOVE_linux               (1 << 16)
+#define UFFDIO_REGISTER_MODE_MISSING_linux    (1 << 0)
+#define UFFDIO_REGISTER_MODE_WP_linux         (1 << 1)
+#define UFFDIO_REGISTER_MODE_MINOR_linux      (1 << 2)
+#define UFFDIO_COPY_MODE_DONTWAKE_linux       (1 << 0)
+#define UFFDIO_COPY_MODE_WP_linux             (1 << 1)
+#define UFFDIO_ZEROPAGE_MODE_DONTWAKE_linux   (1 << 0)
+#define UFFDIO_WRITEPROTECT_MODE_WP_linux     (1 << 0)
+#define UFFDIO_WRITEPROTECT_MODE_DONTWAKE_linux (1 << 1)
+#define UFFDIO_CONTINUE_MODE_DONTWAKE_linux   (1 << 0)
+#define UFFDIO_CONTINUE_MODE_WP_linux         (1 << 1)
+#define UFFDIO_MOVE_MODE_DONTWAKE_linux       (1 << 0)
+#define UFFDIO_MOVE_MODE_ALLOW_SRC_HOLES_linux (1 << 1)
+
 #define MEMBARRIER_CMD_QUERY_linux                                0
 #define MEMBARRIER_CMD_GLOBAL_linux                               (1 << 0)
 #define MEMBARRIER_CMD_GLOBAL_EXPEDITED_linux                     (1 << 1)
@@ -1912,6 +1951,14 @@
 #define AT_NO_AUTOMOUNT_linux       0x800
 #define AT_EMPTY_PATH_linux         0x1000
 
+// Auxiliary vector entries (/proc/self/auxv, after envp on the entry stack)
+#define AT_NULL_linux               0
+#define AT_PAGESZ_linux             6
+#define AT_HWCAP_linux              16
+#define AT_RANDOM_linux             25
+#define AT_HWCAP2_linux             26
+#define AT_SYSINFO_EHDR_linux       33
+
 #define RESOLVE_NO_XDEV_linux       0x01
 #define RESOLVE_NO_MAGICLINKS_linux 0x02
 #define RESOLVE_NO_SYMLINKS_linux   0x04
@@ -2319,16 +2366,16 @@
 #define NS_GET_ID_linux               _IOR_linux(0xb7, 13, sizeof(unsigned long long))
 
 #define UFFDIO_linux            0xAA
-#define UFFDIO_API_linux        _IOWR_linux(UFFDIO_linux, 0x3F, sizeof(struct uffdio_api_linux))
-#define UFFDIO_REGISTER_linux    _IOWR_linux(UFFDIO_linux, 0x00, sizeof(struct uffdio_register_linux))
-#define UFFDIO_UNREGISTER_linux  _IOR_linux(UFFDIO_linux, 0x01, sizeof(struct uffdio_range_linux))
-#define UFFDIO_WAKE_linux        _IOR_linux(UFFDIO_linux, 0x02, sizeof(struct uffdio_range_linux))
-#define UFFDIO_COPY_linux        _IOWR_linux(UFFDIO_linux, 0x03, sizeof(struct uffdio_copy_linux))
-#define UFFDIO_ZEROPAGE_linux    _IOWR_linux(UFFDIO_linux, 0x04, sizeof(struct uffdio_zeropage_linux))
-#define UFFDIO_MOVE_linux        _IOWR_linux(UFFDIO_linux, 0x05, sizeof(struct uffdio_move_linux))
-#define UFFDIO_WRITEPROTECT_linux _IOWR_linux(UFFDIO_linux, 0x06, sizeof(struct uffdio_writeprotect_linux))
-#define UFFDIO_CONTINUE_linux    _IOWR_linux(UFFDIO_linux, 0x07, sizeof(struct uffdio_continue_linux))
-#define UFFDIO_POISON_linux      _IOWR_linux(UFFDIO_linux, 0x08, sizeof(struct uffdio_poison_linux))
+#define UFFDIO_API_linux        _IOWR_linux(UFFDIO_linux, 0x3F, sizeof(uffdio_api_linux))
+#define UFFDIO_REGISTER_linux    _IOWR_linux(UFFDIO_linux, 0x00, sizeof(uffdio_register_linux))
+#define UFFDIO_UNREGISTER_linux  _IOR_linux(UFFDIO_linux, 0x01, sizeof(uffdio_range_linux))
+#define UFFDIO_WAKE_linux        _IOR_linux(UFFDIO_linux, 0x02, sizeof(uffdio_range_linux))
+#define UFFDIO_COPY_linux        _IOWR_linux(UFFDIO_linux, 0x03, sizeof(uffdio_copy_linux))
+#define UFFDIO_ZEROPAGE_linux    _IOWR_linux(UFFDIO_linux, 0x04, sizeof(uffdio_zeropage_linux))
+#define UFFDIO_MOVE_linux        _IOWR_linux(UFFDIO_linux, 0x05, sizeof(uffdio_move_linux))
+#define UFFDIO_WRITEPROTECT_linux _IOWR_linux(UFFDIO_linux, 0x06, sizeof(uffdio_writeprotect_linux))
+#define UFFDIO_CONTINUE_linux    _IOWR_linux(UFFDIO_linux, 0x07, sizeof(uffdio_continue_linux))
+#define UFFDIO_POISON_linux      _IOWR_linux(UFFDIO_linux, 0x08, sizeof(uffdio_poison_linux))
 
 #define RNDGETENTCNT_linux      _IOR_linux('R', 0x00, sizeof(int))
 #define RNDADDTOENTCNT_linux    _IOW_linux('R', 0x01, sizeof(int))
@@ -2349,7 +2396,7 @@
 #define PIDFD_GET_TIME_FOR_CHILDREN_NAMESPACE_linux _IO_linux(PIDFS_IOCTL_MAGIC_linux, 8)
 #define PIDFD_GET_USER_NAMESPACE_linux              _IO_linux(PIDFS_IOCTL_MAGIC_linux, 9)
 #define PIDFD_GET_UTS_NAMESPACE_linux               _IO_linux(PIDFS_IOCTL_MAGIC_linux, 10)
-#define PIDFD_GET_INFO_linux                        _IOWR_linux(PIDFS_IOCTL_MAGIC_linux, 11, sizeof(struct pidfd_info_linux))
+#define PIDFD_GET_INFO_linux                        _IOWR_linux(PIDFS_IOCTL_MAGIC_linux, 11, sizeof(pidfd_info_linux))
 
 #define SIOCADDRT_linux       0x890B
 #define SIOCDELRT_linux       0x890C
@@ -2867,6 +2914,16 @@ enum {
 
 #define FANOTIFY_METADATA_VERSION_linux 3
 
+#define FAN_EVENT_INFO_TYPE_FID_linux           1
+#define FAN_EVENT_INFO_TYPE_DFID_NAME_linux     2
+#define FAN_EVENT_INFO_TYPE_DFID_linux          3
+#define FAN_EVENT_INFO_TYPE_PIDFD_linux         4
+#define FAN_EVENT_INFO_TYPE_ERROR_linux         5
+#define FAN_EVENT_INFO_TYPE_RANGE_linux         6
+#define FAN_EVENT_INFO_TYPE_MNT_linux           7
+#define FAN_EVENT_INFO_TYPE_OLD_DFID_NAME_linux 10
+#define FAN_EVENT_INFO_TYPE_NEW_DFID_NAME_linux 12
+
 #define PIPE_BUF_linux              4096
 #define O_NOTIFICATION_PIPE_linux   O_EXCL_linux
 
@@ -3166,6 +3223,11 @@ enum {
 #define CMSG_FIRSTHDR_linux(mhdr) \
   ((mhdr)->msg_controllen >= sizeof(cmsghdr_linux) ? \
    (cmsghdr_linux *)(mhdr)->msg_control : (cmsghdr_linux *)0)
+#define CMSG_NXTHDR_linux(mhdr, cmsg) \
+  ((cmsg)->cmsg_len < sizeof(cmsghdr_linux) || \
+   (unsigned char *)(cmsg) + CMSG_ALIGN_linux((cmsg)->cmsg_len) + sizeof(cmsghdr_linux) > \
+   (unsigned char *)(mhdr)->msg_control + (mhdr)->msg_controllen ? \
+   (cmsghdr_linux *)0 : (cmsghdr_linux *)((unsigned char *)(cmsg) + CMSG_ALIGN_linux((cmsg)->cmsg_len)))
 #define CMSG_DATA_linux(cmsg)         ((unsigned char *)(cmsg) + CMSG_ALIGN_linux(sizeof(cmsghdr_linux)))
 #define CMSG_SPACE_linux(len)         (CMSG_ALIGN_linux(sizeof(cmsghdr_linux)) + CMSG_ALIGN_linux(len))
 #define CMSG_LEN_linux(len)           (CMSG_ALIGN_linux(sizeof(cmsghdr_linux)) + (len))
@@ -3201,9 +3263,26 @@ enum {
 #define SO_SNDTIMEO_linux             SO_SNDTIMEO_OLD_linux
 #define SO_RCVTIMEO_OLD_linux         20
 #define SO_SNDTIMEO_OLD_linux         21
+#define SO_ZEROCOPY_linux             60
+
+#define IP_RECVERR_linux              11
+#define IPV6_RECVERR_linux            25
+
+#define SO_EE_ORIGIN_NONE_linux       0
+#define SO_EE_ORIGIN_LOCAL_linux      1
+#define SO_EE_ORIGIN_ICMP_linux       2
+#define SO_EE_ORIGIN_ICMP6_linux      3
+#define SO_EE_ORIGIN_TXSTATUS_linux   4
+#define SO_EE_ORIGIN_ZEROCOPY_linux   5
+#define SO_EE_ORIGIN_TXTIME_linux     6
+
+#define SO_EE_CODE_ZEROCOPY_COPIED_linux 1
 
 #define SOMAXCONN_linux               4096
 
+#define INADDR_ANY_linux              0x00000000U
+#define INADDR_LOOPBACK_linux         0x7f000001U
+
 #define IOCB_CMD_PREAD_linux          0
 #define IOCB_CMD_PWRITE_linux         1
 #define IOCB_CMD_FSYNC_linux          2
@@ -3327,6 +3406,49 @@ enum {
 #define IORING_UNREGISTER_PERSONALITY_linux   10
 #define IORING_REGISTER_RESTRICTIONS_linux    11
 #define IORING_REGISTER_ENABLE_RINGS_linux    12
+#define IORING_REGISTER_FILES2_linux          13
+#define IORING_REGISTER_FILES_UPDATE2_linux   14
+#define IORING_REGISTER_BUFFERS2_linux        15
+#define IORING_REGISTER_BUFFERS_UPDATE_linux  16
+#define IORING_REGISTER_IOWQ_AFF_linux        17
+#define IORING_UNREGISTER_IOWQ_AFF_linux      18
+#define IORING_REGISTER_IOWQ_MAX_WORKERS_linux 19
+#define IORING_REGISTER_RING_FDS_linux        20
+#define IORING_UNREGISTER_RING_FDS_linux      21
+#define IORING_REGISTER_PBUF_RING_linux       22
+#define IORING_UNREGISTER_PBUF_RING_linux     23
+#define IORING_REGISTER_SYNC_CANCEL_linux     24
+#define IORING_REGISTER_FILE_ALLOC_RANGE_linux 25
+#define IORING_REGISTER_PBUF_STATUS_linux     26
+
+#define IORING_RSRC_REGISTER_SPARSE_linux     (1U << 0)
+#define IORING_REGISTER_FILES_SKIP_linux      (-2)
+
+#define IOU_PBUF_RING_MMAP_linux              1
+#define IOU_PBUF_RING_INC_linux               2
+
+#define IORING_FEAT_SINGLE_MMAP_linux         (1U << 0)
+#define IORING_FEAT_NODROP_linux              (1U << 1)
+#define IORING_FEAT_SUBMIT_STABLE_linux       (1U << 2)
+#define IORING_FEAT_RW_CUR_POS_linux          (1U << 3)
+#define IORING_FEAT_CUR_PERSONALITY_linux     (1U << 4)
+#define IORING_FEAT_FAST_POLL_linux           (1U << 5)
+#define IORING_FEAT_POLL_32BITS_linux         (1U << 6)
+#define IORING_FEAT_SQPOLL_NONFIXED_linux     (1U << 7)
+#define IORING_FEAT_EXT_ARG_linux             (1U << 8)
+#define IORING_FEAT_NATIVE_WORKERS_linux      (1U << 9)
+#define IORING_FEAT_RSRC_TAGS_linux           (1U << 10)
+#define IORING_FEAT_CQE_SKIP_linux            (1U << 11)
+#define IORING_FEAT_LINKED_FILE_linux         (1U << 12)
+#define IORING_FEAT_REG_REG_RING_linux        (1U << 13)
+#define IORING_FEAT_RECVSEND_BUNDLE_linux     (1U << 14)
+#define IORING_FEAT_MIN_TIMEOUT_linux         (1U << 15)
+
+#define IORING_SQ_NEED_WAKEUP_linux           (1U << 0)
+#define IORING_SQ_CQ_OVERFLOW_linux           (1U << 1)
+#define IORING_SQ_TASKRUN_linux               (1U << 2)
+
+#define IORING_CQ_EVENTFD_DISABLED_linux      (1U << 0)
 
 #define IORING_OFF_SQ_RING_linux       0ULL
 #define IORING_OFF_CQ_RING_linux       0x8000000ULL
@@ -3337,6 +3459,31 @@ enum {
 #define IORING_CQE_F_MORE_linux          (1U << 1)
 #define IORING_CQE_F_SOCK_NONEMPTY_linux (1U << 2)
 #define IORING_CQE_F_NOTIF_linux         (1U << 3)
+#define IORING_CQE_F_BUF_MORE_linux      (1U << 4)
+
+#define IORING_CQE_BUFFER_SHIFT_linux    16
+
+#define IORING_ACCEPT_MULTISHOT_linux    (1U << 0)
+#define IORING_ACCEPT_DONTWAIT_linux     (1U << 1)
+#define IORING_ACCEPT_POLL_FIRST_linux   (1U << 2)
+
+#define IORING_RECVSEND_POLL_FIRST_linux (1U << 0)
+#define IORING_RECV_MULTISHOT_linux      (1U << 1)
+#define IORING_RECVSEND_FIXED_BUF_linux  (1U << 2)
+#define IORING_SEND_ZC_REPORT_USAGE_linux (1U << 3)
+#define IORING_RECVSEND_BUNDLE_linux     (1U << 4)
+
+#define IORING_NOTIF_USAGE_ZC_COPIED_linux (1U << 31)
+
+#define IORING_FILE_INDEX_ALLOC_linux      (~0U)
+
+#define IORING_TIMEOUT_ABS_linux           (1U << 0)
+#define IORING_TIMEOUT_UPDATE_linux        (1U << 1)
+#define IORING_TIMEOUT_BOOTTIME_linux      (1U << 2)
+#define IORING_TIMEOUT_REALTIME_linux      (1U << 3)
+#define IORING_LINK_TIMEOUT_UPDATE_linux   (1U << 4)
+#define IORING_TIMEOUT_ETIME_SUCCESS_linux (1U << 5)
+#define IORING_TIMEOUT_MULTISHOT_linux     (1U << 6)
 
 #define SOCKET_URING_OP_SIOCINQ_linux         0
 #define SOCKET_URING_OP_SIOCOUTQ_linux        1
@@ -3473,6 +3620,56 @@ enum {
 #define SECCOMP_RET_TRACE_linux        0x7ff00000U
 #define SECCOMP_RET_LOG_linux          0x7ffc0000U
 #define SECCOMP_RET_ALLOW_linux        0x7fff0000U
+#define SECCOMP_RET_ACTION_FULL_linux  0xffff0000U
+#define SECCOMP_RET_DATA_linux         0x0000ffffU
+
+// Classic BPF, as used by seccomp filters (sock_filter_linux programs)
+#define BPF_LD_linux   0x00
+#define BPF_LDX_linux  0x01
+#define BPF_ST_linux   0x02
+#define BPF_STX_linux  0x03
+#define BPF_ALU_linux  0x04
+#define BPF_JMP_linux  0x05
+#define BPF_RET_linux  0x06
+#define BPF_MISC_linux 0x07
+#define BPF_W_linux    0x00
+#define BPF_H_linux    0x08
+#define BPF_B_linux    0x10
+#define BPF_IMM_linux  0x00
+#define BPF_ABS_linux  0x20
+#define BPF_IND_linux  0x40
+#define BPF_MEM_linux  0x60
+#define BPF_LEN_linux  0x80
+#define BPF_MSH_linux  0xa0
+#define BPF_ADD_linux  0x00
+#define BPF_SUB_linux  0x10
+#define BPF_MUL_linux  0x20
+#define BPF_DIV_linux  0x30
+#define BPF_OR_linux   0x40
+#define BPF_AND_linux  0x50
+#define BPF_LSH_linux  0x60
+#define BPF_RSH_linux  0x70
+#define BPF_NEG_linux  0x80
+#define BPF_JA_linux   0x00
+#define BPF_JEQ_linux  0x10
+#define BPF_JGT_linux  0x20
+#define BPF_JGE_linux  0x30
+#define BPF_JSET_linux 0x40
+#define BPF_K_linux    0x00
+#define BPF_X_linux    0x08
+#define BPF_A_linux    0x10
+#define BPF_MAXINSNS_linux 4096
+#define BPF_STMT_linux(code, k) {(unsigned short)(code), 0, 0, (k)}
+#define BPF_JUMP_linux(code, k, jt, jf) {(unsigned short)(code), (jt), (jf), (k)}
+
+// seccomp_data_linux.arch values
+#define AUDIT_ARCH_X86_64_linux  0xc000003eU
+#define AUDIT_ARCH_I386_linux    0x40000003U
+#define AUDIT_ARCH_AARCH64_linux 0xc00000b7U
+#define AUDIT_ARCH_ARM_linux     0x40000028U
+#define AUDIT_ARCH_RISCV64_linux 0xc00000f3U
+#define AUDIT_ARCH_RISCV32_linux 0x400000f3U
+#define AUDIT_ARCH_linux BY_ARCH_linux(AUDIT_ARCH_X86_64_linux, AUDIT_ARCH_AARCH64_linux, AUDIT_ARCH_RISCV64_linux, AUDIT_ARCH_I386_linux, AUDIT_ARCH_ARM_linux, AUDIT_ARCH_RISCV32_linux)
 
 #define LSM_ID_CAPABILITY_linux       100
 #define LSM_ID_SELINUX_linux          101
@@ -3601,6 +3798,14 @@ enum {
 #define PIDFD_SIGNAL_THREAD_GROUP_linux  (1UL << 1)
 #define PIDFD_SIGNAL_PROCESS_GROUP_linux (1UL << 2)
 
+#define PIDFD_INFO_PID_linux             (1UL << 0)
+#define PIDFD_INFO_CREDS_linux           (1UL << 1)
+#define PIDFD_INFO_CGROUPID_linux        (1UL << 2)
+#define PIDFD_INFO_EXIT_linux            (1UL << 3)
+#define PIDFD_INFO_COREDUMP_linux        (1UL << 4)
+#define PIDFD_INFO_SUPPORTED_MASK_linux  (1UL << 5)
+#define PIDFD_INFO_COREDUMP_SIGNAL_linux (1UL << 6)
+
 #define PTRACE_TRACEME_linux          0
 #define PTRACE_PEEKTEXT_linux         1
 #define PTRACE_PEEKDATA_linux         2
@@ -3618,6 +3823,24 @@ enum {
 #define PTRACE_GETEVENTMSG_linux      0x4201
 #define PTRACE_GETSIGINFO_linux       0x4202
 #define PTRACE_SETSIGINFO_linux       0x4203
+#define PTRACE_SEIZE_linux            0x4206
+#define PTRACE_INTERRUPT_linux        0x4207
+#define PTRACE_LISTEN_linux           0x4208
+#define PTRACE_GET_SYSCALL_INFO_linux 0x420e
+
+#define PTRACE_EVENT_FORK_linux       1
+#define PTRACE_EVENT_VFORK_linux      2
+#define PTRACE_EVENT_CLONE_linux      3
+#define PTRACE_EVENT_EXEC_linux       4
+#define PTRACE_EVENT_VFORK_DONE_linux 5
+#define PTRACE_EVENT_EXIT_linux       6
+#define PTRACE_EVENT_SECCOMP_linux    7
+#define PTRACE_EVENT_STOP_linux       128
+
+#define PTRACE_SYSCALL_INFO_NONE_linux    0
+#define PTRACE_SYSCALL_INFO_ENTRY_linux   1
+#define PTRACE_SYSCALL_INFO_EXIT_linux    2
+#define PTRACE_SYSCALL_INFO_SECCOMP_linux 3
 
 #define PTRACE_O_TRACESYSGOOD_linux    1
 #define PTRACE_O_TRACEFORK_linux       (1 << 1)
@@ -4265,11 +4488,26 @@ typedef struct {
   unsigned long long supported_mask;
 } pidfd_info_linux;
 
+// Returned by the vDSO getrandom when called with opaque_len == ~0UL.
+typedef struct {
+  unsigned int size_of_opaque_state;
+  unsigned int mmap_prot;
+  unsigned int mmap_flags;
+  unsigned int reserved[13];
+} vgetrandom_opaque_params_linux;
+
 typedef struct {
   unsigned short sa_family;
   char sa_data[14];
 } sockaddr_linux;
 
+typedef struct {
+  unsigned short sin_family;
+  unsigned short sin_port;
+  unsigned int sin_addr;
+  unsigned char __pad[8];
+} sockaddr_in_linux;
+
 typedef struct {
   unsigned short ss_family;
   char __ss_padding[128 - sizeof(unsigned short) - sizeof(unsigned long)];
@@ -5143,7 +5381,7 @@ typedef struct {
 typedef struct {
   void *msg_name;
   int msg_namelen;
-  struct iovec_linux *msg_iov;
+  iovec_linux *msg_iov;
   unsigned long msg_iovlen;
   void *msg_control;
   unsigned long msg_controllen;
@@ -5161,6 +5399,16 @@ typedef struct {
   int cmsg_type;
 } cmsghdr_linux;
 
+typedef struct {
+  unsigned int ee_errno;
+  unsigned char ee_origin;
+  unsigned char ee_type;
+  unsigned char ee_code;
+  unsigned char ee_pad;
+  unsigned int ee_info;
+  unsigned int ee_data;
+} sock_extended_err_linux;
+
 typedef struct {
   int l_onoff;
   int l_linger;
@@ -5344,6 +5592,70 @@ typedef struct {
   unsigned long long ts;
 } io_uring_getevents_arg_linux;
 
+typedef struct {
+  unsigned int nr;
+  unsigned int flags;
+  unsigned long long resv2;
+  unsigned long long data;
+  unsigned long long tags;
+} io_uring_rsrc_register_linux;
+
+typedef struct {
+  unsigned int offset;
+  unsigned int resv;
+  unsigned long long data;
+} io_uring_rsrc_update_linux;
+
+typedef struct {
+  unsigned int offset;
+  unsigned int resv;
+  unsigned long long data;
+  unsigned long long tags;
+  unsigned int nr;
+  unsigned int resv2;
+} io_uring_rsrc_update2_linux;
+
+typedef struct {
+  unsigned int off;
+  unsigned int len;
+  unsigned long long resv;
+} io_uring_file_index_range_linux;
+
+typedef struct {
+  unsigned long long addr;
+  unsigned int len;
+  unsigned short bid;
+  unsigned short resv;
+} io_uring_buf_linux;
+
+typedef struct {
+  union {
+    struct {
+      unsigned long long resv1;
+      unsigned int resv2;
+      unsigned short resv3;
+      unsigned short tail;
+    };
+    io_uring_buf_linux bufs[0];
+  };
+} io_uring_buf_ring_linux;
+
+_Static_assert(sizeof(io_uring_buf_ring_linux) == 16, "");
+
+typedef struct {
+  unsigned long long ring_addr;
+  unsigned int ring_entries;
+  unsigned short bgid;
+  unsigned short flags;
+  unsigned long long resv[3];
+} io_uring_buf_reg_linux;
+
+typedef struct {
+  unsigned int buf_group;
+  unsigned int head;
+  unsigned int resv[8];
+} io_uring_buf_status_linux;
+
 typedef struct {
   unsigned int modes;
   long offset;
@@ -5408,6 +5720,30 @@ typedef struct {
   unsigned long long args[6];
 } seccomp_data_linux;
 
+typedef struct {
+  unsigned char op; // PTRACE_SYSCALL_INFO_*_linux
+  unsigned char reserved;
+  unsigned short flags;
+  unsigned int arch; // AUDIT_ARCH_*_linux
+  unsigned long long instruction_pointer;
+  unsigned long long stack_pointer;
+  union {
+    struct {
+      unsigned long long nr;
+      unsigned long long args[6];
+    } entry;
+    struct {
+      long long rval;
+      unsigned char is_error;
+    } exit;
+    struct {
+      unsigned long long nr;
+      unsigned long long args[6];
+      unsigned int ret_data;
+    } seccomp;
+  };
+} ptrace_syscall_info_linux;
+
 typedef struct {
   unsigned short seccomp_notif;
   unsigned short seccomp_notif_resp;
@@ -0,0 +1,182 @@
+#ifndef C_MIRROR_HEADER
+#define C_MIRROR_HEADER
+
+// === mirror.h: double-mapped ("magic") ring buffers over memfd ==============
+//
+// Contents:
+//   * setup & teardown             (jump: Init_mirror)
+//   * producer side                (jump: Space_mirror)
+//   * consumer side                (jump: Data_mirror)
+//   * fd integration               (jump: Fill_mirror)
+//
+// Usage:
+//   mirror.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/mirror.h" // use as header file
+//
+//   #define C_MIRROR_IMPLEMENTATION
+//   #include "c/mirror.h" // use as implementation file
+//
+//   The backing memfd is mapped twice, back to back, so byte i and byte
+//   i + size are the same memory. Both the free space and the buffered data
+//   are therefore always contiguous: a record that wraps around the end can be
+//   parsed in place, and one read_linux/write_linux (or a single iovec for
+//   readv_linux/writev_linux) fills or drains the buffer, no memmove needed.
+//
+//   Buffer_mirror is single-producer single-consumer and not thread-safe;
+//   share it between threads only with external synchronization.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "mirror.h depends on linux.h, include it first"
+#endif
+
+// Sizes are rounded to this, a multiple of every page size Linux uses
+// (4 KiB, 16 KiB, 64 KiB), so both views land on page boundaries.
+#define GRANULE_mirror (64UL << 10)
+
+typedef struct {
+  char *base;         // 2 * size bytes of address space, both halves the same pages
+  unsigned long size;
+  unsigned long head; // consumer offset, always < size
+  unsigned long tail; // producer offset, head <= tail <= head + size
+} Buffer_mirror;
+
+//
+// Setup & teardown
+//
+long Init_mirror(Buffer_mirror *b, unsigned long size);
+void Free_mirror(Buffer_mirror *b);
+//
+// Fd integration
+//
+long Fill_mirror(Buffer_mirror *b, int fd);
+long Drain_mirror(Buffer_mirror *b, int fd);
+
+//
+// Producer side
+//
+static inline unsigned long Used_mirror(const Buffer_mirror *b) {
+  return b->tail - b->head;
+}
+
+// Contiguous free space: write up to `iov->iov_len` bytes at `iov->iov_base`,
+// then Commit_mirror them. Fits straight into readv_linux/preadv/io_uring.
+static inline unsigned long Space_mirror(const Buffer_mirror *b, iovec_linux *iov) {
+  iov->iov_base = b->base + b->tail;
+  iov->iov_len = b->size - (b->tail - b->head);
+  return iov->iov_len;
+}
+
+// The compiler doesn't know both views alias: the barrier keeps it from moving
+// stores made through one view past loads made through the other.
+static inline void Commit_mirror(Buffer_mirror *b, unsigned long n) {
+  __asm__ volatile("" ::: "memory");
+  b->tail += n;
+}
+
+//
+// Consumer side
+//
+
+// Contiguous buffered data, wrap-around included.
+static inline unsigned long Data_mirror(const Buffer_mirror *b, iovec_linux *iov) {
+  iov->iov_base = b->base + b->head;
+  iov->iov_len = b->tail - b->head;
+  return iov->iov_len;
+}
+
+static inline void Consume_mirror(Buffer_mirror *b, unsigned long n) {
+  __asm__ volatile("" ::: "memory");
+  b->head += n;
+  if (b->head >= b->size) { // keep offsets inside the first view
+    b->head -= b->size;
+    b->tail -= b->size;
+  }
+}
+
+#endif // C_MIRROR_HEADER
+#ifdef C_MIRROR_IMPLEMENTATION
+
+//
+// Setup & teardown
+//
+
+// `size` is rounded up to GRANULE_mirror.
+long Init_mirror(Buffer_mirror *b, unsigned long size) {
+  size = (size + GRANULE_mirror - 1) & ~(GRANULE_mirror - 1);
+  if (!size || size * 2 < size) {
+    return -EINVAL_linux;
+  }
+  long fd = memfd_create_linux("mirror", MFD_CLOEXEC_linux);
+  if (fd < 0) {
+    return fd;
+  }
+  long ret = ftruncate64_linux((unsigned int)fd, size);
+  long base = -1;
+  if (ret >= 0) {
+    // Reserve both halves first so the fixed mappings can't clobber anything.
+    base = mmap_linux(0, 2 * size, PROT_NONE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+    ret = base;
+  }
+  for (int i = 0; i < 2 && (ret >= 0 || ret < -4095); ++i) {
+    ret = mmap_linux((char *)base + i * size, size, PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux | MAP_FIXED_linux, (int)fd, 0);
+  }
+  close_linux((unsigned int)fd); // the mappings keep the pages alive
+  if (ret < 0 && ret > -4096) {
+    if (base >= 0 || base < -4095) {
+      munmap_linux((void *)base, 2 * size);
+    }
+    return ret;
+  }
+  b->base = (char *)base;
+  b->size = size;
+  b->head = 0;
+  b->tail = 0;
+  return 0;
+}
+
+void Free_mirror(Buffer_mirror *b) {
+  munmap_linux(b->base, 2 * b->size);
+}
+
+//
+// Fd integration
+//
+
+// One read_linux into the free space; returns bytes read, 0 at EOF, -EAGAIN
+// (non-blocking fd) or -ENOBUFS when the buffer is full.
+long Fill_mirror(Buffer_mirror *b, int fd) {
+  iovec_linux iov;
+  if (!Space_mirror(b, &iov)) {
+    return -ENOBUFS_linux;
+  }
+  long n = read_linux(fd, iov.iov_base, iov.iov_len);
+  if (n > 0) {
+    Commit_mirror(b, (unsigned long)n);
+  }
+  return n;
+}
+
+// One write_linux of the buffered data; returns bytes written.
+long Drain_mirror(Buffer_mirror *b, int fd) {
+  iovec_linux iov;
+  if (!Data_mirror(b, &iov)) {
+    return 0;
+  }
+  long n = write_linux(fd, iov.iov_base, iov.iov_len);
+  if (n > 0) {
+    Consume_mirror(b, (unsigned long)n);
+  }
+  return n;
+}
+
+#endif // C_MIRROR_IMPLEMENTATION
@@ -0,0 +1,402 @@
+#ifndef C_NUMA_HEADER
+#define C_NUMA_HEADER
+
+// === numa.h: NUMA topology, node-local arenas, interleaving, migration ======
+//
+// Contents:
+//   * topology                     (jump: Load_numa)
+//   * node-local arenas            (jump: InitArena_numa)
+//   * interleaved allocations      (jump: AllocInterleaved_numa)
+//   * migration                    (jump: MigrateHere_numa)
+//
+// Usage:
+//   numa.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/numa.h" // use as header file
+//
+//   #define C_NUMA_IMPLEMENTATION
+//   #include "c/numa.h" // use as implementation file
+//
+//   Load_numa reads /sys/devices/system/node once (openat_linux and
+//   getdents64_linux, no path formatting): which nodes exist, their CPUs,
+//   memory and the distance matrix. On kernels built without NUMA the
+//   directory is missing and the whole machine is reported as node 0.
+//
+//   Placement goes through mbind_linux on fresh mappings, before any page is
+//   touched, so the first fault already lands on the right node. When the
+//   kernel has no NUMA support (-ENOSYS) memory is simply not placed.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers; functions returning pointers return 0 on failure.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "numa.h depends on linux.h, include it first"
+#endif
+
+#define MAX_NODES_numa 64
+#define MAX_CPUS_numa  1024
+#define WORD_BITS_numa (8 * sizeof(unsigned long))
+
+// Arrays are indexed by node id; ids can be sparse, check `nodes` first.
+typedef struct {
+  unsigned long nodes[MAX_NODES_numa / WORD_BITS_numa]; // present nodes, a valid mbind_linux nodemask
+  int count;
+  unsigned long cpus[MAX_NODES_numa][MAX_CPUS_numa / WORD_BITS_numa];
+  unsigned long long memory[MAX_NODES_numa]; // bytes, 0 for CPU-only nodes
+  unsigned char distance[MAX_NODES_numa][MAX_NODES_numa]; // 10 is local
+} Topology_numa;
+
+typedef struct {
+  char *base;
+  unsigned long size;
+  unsigned long used;
+  int node;
+} Arena_numa;
+
+//
+// Topology
+//
+long Load_numa(Topology_numa *t);
+int NodeOfCpu_numa(const Topology_numa *t, int cpu);
+long CurrentNode_numa(void);
+//
+// Node-local arenas
+//
+long InitArena_numa(Arena_numa *a, unsigned long size, int node, int strict);
+void FreeArena_numa(Arena_numa *a);
+//
+// Interleaved allocations
+//
+void *AllocInterleaved_numa(const Topology_numa *t, unsigned long size);
+void FreeInterleaved_numa(void *p, unsigned long size);
+//
+// Migration
+//
+long MigrateHere_numa(void *addr, unsigned long len);
+long NodeOf_numa(const void *addr);
+
+static inline int HasNode_numa(const Topology_numa *t, int node) {
+  return node >= 0 && node < MAX_NODES_numa && (t->nodes[node / WORD_BITS_numa] >> (node % WORD_BITS_numa)) & 1;
+}
+
+static inline int HasCpu_numa(const Topology_numa *t, int node, int cpu) {
+  return cpu >= 0 && cpu < MAX_CPUS_numa && (t->cpus[node][cpu / WORD_BITS_numa] >> (cpu % WORD_BITS_numa)) & 1;
+}
+
+// Bump allocation; `align` must be a power of two. Returns 0 when full.
+static inline void *AllocArena_numa(Arena_numa *a, unsigned long size, unsigned long align) {
+  unsigned long at = (a->used + align - 1) & ~(align - 1);
+  if (at > a->size || size > a->size - at) {
+    return 0;
+  }
+  a->used = at + size;
+  return a->base + at;
+}
+
+static inline void ResetArena_numa(Arena_numa *a) {
+  a->used = 0;
+}
+
+#endif // C_NUMA_HEADER
+#ifdef C_NUMA_IMPLEMENTATION
+
+//
+// Topology
+//
+
+// Reads a small sysfs file relative to `dfd`, NUL-terminated.
+static long ReadAt_numa(int dfd, const char *path, char *buf, unsigned long cap) {
+  long fd = openat_linux(dfd, path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  long n = read_linux((unsigned int)fd, buf, cap - 1);
+  close_linux((unsigned int)fd);
+  buf[n > 0 ? n : 0] = 0;
+  return n;
+}
+
+static const char *Number_numa(const char *s, unsigned long long *value) {
+  *value = 0;
+  while (*s >= '0' && *s <= '9') {
+    *value = *value * 10 + (unsigned long long)(*s++ - '0');
+  }
+  return s;
+}
+
+// Parses a sysfs list such as "0-3,8,10-11" into a bitmask of `bits` bits.
+static void List_numa(const char *s, unsigned long *mask, unsigned long bits) {
+  while (*s >= '0' && *s <= '9') {
+    unsigned long long first;
+    unsigned long long last;
+    s = Number_numa(s, &first);
+    last = first;
+    if (*s == '-') {
+      s = Number_numa(s + 1, &last);
+    }
+    for (unsigned long long i = first; i <= last && i < bits; ++i) {
+      mask[i / WORD_BITS_numa] |= 1UL << (i % WORD_BITS_numa);
+    }
+    if (*s == ',') {
+      ++s;
+    }
+  }
+}
+
+static void Node_numa(Topology_numa *t, int dfd, int node, const char *name) {
+  char path[32];
+  char buf[4096];
+  unsigned long n = 0;
+  while (name[n]) {
+    path[n] = name[n];
+    ++n;
+  }
+  const char *files[3] = {"/cpulist", "/meminfo", "/distance"};
+  for (int f = 0; f < 3; ++f) {
+    unsigned long i = 0;
+    do {
+      path[n + i] = files[f][i];
+    } while (files[f][i++]);
+    if (ReadAt_numa(dfd, path, buf, sizeof(buf)) <= 0) {
+      continue;
+    }
+    if (f == 0) {
+      List_numa(buf, t->cpus[node], MAX_CPUS_numa);
+    } else if (f == 1) {
+      // "Node 0 MemTotal:        6158152 kB"
+      const char *s = buf;
+      while (*s && *s != ':') {
+        ++s;
+      }
+      while (*s == ':' || *s == ' ') {
+        ++s;
+      }
+      unsigned long long kb;
+      Number_numa(s, &kb);
+      t->memory[node] = kb << 10;
+    } else {
+      // One column per present node, in ascending id order: stored raw here
+      // and spread over node ids once every node is known.
+      const char *s = buf;
+      for (int col = 0; col < MAX_NODES_numa && *s >= '0' && *s <= '9'; ++col) {
+        unsigned long long d;
+        s = Number_numa(s, &d);
+        t->distance[node][col] = (unsigned char)d;
+        while (*s == ' ') {
+          ++s;
+        }
+      }
+    }
+  }
+}
+
+// Fills `t` from sysfs; a machine without NUMA sysfs is one node 0 owning
+// every CPU in our affinity mask.
+long Load_numa(Topology_numa *t) {
+  char *bytes = (char *)t;
+  for (unsigned long i = 0; i < sizeof(*t); ++i) {
+    bytes[i] = 0;
+  }
+  long dfd = openat_linux(AT_FDCWD_linux, "/sys/devices/system/node", O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (dfd < 0) {
+    long ret = sched_getaffinity_linux(0, sizeof(t->cpus[0]), t->cpus[0]);
+    if (ret < 0) {
+      return ret;
+    }
+    t->nodes[0] = 1;
+    t->count = 1;
+    t->distance[0][0] = 10;
+    return 0;
+  }
+  union {
+    linux_dirent64_linux d;
+    char bytes[2048];
+  } buf;
+  long n;
+  while ((n = getdents64_linux((unsigned int)dfd, &buf.d, sizeof(buf))) > 0) {
+    for (long at = 0; at < n;) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(buf.bytes + at);
+      at += d->d_reclen;
+      const char *name = d->d_name;
+      if (name[0] != 'n' || name[1] != 'o' || name[2] != 'd' || name[3] != 'e' || name[4] < '0' || name[4] > '9') {
+        continue;
+      }
+      unsigned long long id;
+      if (*Number_numa(name + 4, &id) || id >= MAX_NODES_numa) {
+        continue;
+      }
+      t->nodes[id / WORD_BITS_numa] |= 1UL << (id % WORD_BITS_numa);
+      t->count++;
+      Node_numa(t, (int)dfd, (int)id, name);
+    }
+  }
+  close_linux((unsigned int)dfd);
+  if (n < 0) {
+    return n;
+  }
+  for (int from = 0; from < MAX_NODES_numa; ++from) {
+    if (!HasNode_numa(t, from)) {
+      continue;
+    }
+    unsigned char raw[MAX_NODES_numa];
+    for (int col = 0; col < MAX_NODES_numa; ++col) {
+      raw[col] = t->distance[from][col];
+      t->distance[from][col] = 0;
+    }
+    for (int to = 0, col = 0; to < MAX_NODES_numa; ++to) {
+      if (HasNode_numa(t, to)) {
+        t->distance[from][to] = raw[col++];
+      }
+    }
+  }
+  return 0;
+}
+
+// Returns the node owning `cpu`, or -1.
+int NodeOfCpu_numa(const Topology_numa *t, int cpu) {
+  for (int node = 0; node < MAX_NODES_numa; ++node) {
+    if (HasNode_numa(t, node) && HasCpu_numa(t, node, cpu)) {
+      return node;
+    }
+  }
+  return -1;
+}
+
+// The node of the CPU we're running on right now.
+long CurrentNode_numa(void) {
+  unsigned int cpu;
+  unsigned int node;
+  long ret = getcpu_linux(&cpu, &node, 0);
+  return ret < 0 ? ret : (long)node;
+}
+
+// mbind_linux wants the mask size in bits plus one (it drops the last bit).
+static long Bind_numa(void *addr, unsigned long len, int mode, const unsigned long *mask) {
+  long ret = mbind_linux(addr, len, (unsigned long)mode, mask, MAX_NODES_numa + 1, 0);
+  return ret == -ENOSYS_linux ? 0 : ret;
+}
+
+static void *Map_numa(unsigned long size) {
+  long ret = mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  return ret < 0 && ret > -4096 ? 0 : (void *)ret;
+}
+
+//
+// Node-local arenas
+//
+
+// Maps `size` bytes whose pages come from `node`: only from it when `strict`
+// (MPOL_BIND, allocation fails once the node is full), otherwise preferably
+// (MPOL_PREFERRED, falls back to the nearest node).
+long InitArena_numa(Arena_numa *a, unsigned long size, int node, int strict) {
+  if (node < 0 || node >= MAX_NODES_numa) {
+    return -EINVAL_linux;
+  }
+  a->base = (char *)Map_numa(size);
+  if (!a->base) {
+    return -ENOMEM_linux;
+  }
+  unsigned long mask[MAX_NODES_numa / WORD_BITS_numa] = {0};
+  mask[node / WORD_BITS_numa] = 1UL << (node % WORD_BITS_numa);
+  long ret = Bind_numa(a->base, size, strict ? MPOL_BIND_linux : MPOL_PREFERRED_linux, mask);
+  if (ret < 0) {
+    munmap_linux(a->base, size);
+    return ret;
+  }
+  a->size = size;
+  a->used = 0;
+  a->node = node;
+  return 0;
+}
+
+void FreeArena_numa(Arena_numa *a) {
+  munmap_linux(a->base, a->size);
+  a->base = 0;
+}
+
+//
+// Interleaved allocations
+//
+
+// Spreads pages round-robin over every node with memory, so a table read by
+// all sockets costs the average distance instead of hammering one node.
+void *AllocInterleaved_numa(const Topology_numa *t, unsigned long size) {
+  unsigned long mask[MAX_NODES_numa / WORD_BITS_numa] = {0};
+  for (int node = 0; node < MAX_NODES_numa; ++node) {
+    if (HasNode_numa(t, node) && t->memory[node]) {
+      mask[node / WORD_BITS_numa] |= 1UL << (node % WORD_BITS_numa);
+    }
+  }
+  void *p = Map_numa(size);
+  if (p && Bind_numa(p, size, MPOL_INTERLEAVE_linux, mask) < 0) {
+    munmap_linux(p, size);
+    return 0;
+  }
+  return p;
+}
+
+void FreeInterleaved_numa(void *p, unsigned long size) {
+  munmap_linux(p, size);
+}
+
+//
+// Migration
+//
+
+// move_pages_linux works on pages; stepping 4 KiB covers every page size,
+// larger pages are merely listed several times.
+#define STEP_numa  4096UL
+#define BATCH_numa 256
+
+// Moves the resident pages of [addr, addr + len) to the node we're running
+// on. Returns how many 4 KiB steps now sit there; untouched pages don't count
+// (they'll fault in locally anyway).
+long MigrateHere_numa(void *addr, unsigned long len) {
+  long node = CurrentNode_numa();
+  if (node < 0) {
+    return node;
+  }
+  const void *pages[BATCH_numa];
+  int nodes[BATCH_numa];
+  int status[BATCH_numa];
+  char *at = (char *)((unsigned long)addr & ~(STEP_numa - 1));
+  char *end = (char *)addr + len;
+  long here = 0;
+  while (at < end) {
+    int n = 0;
+    for (; n < BATCH_numa && at < end; ++n, at += STEP_numa) {
+      pages[n] = at;
+      nodes[n] = (int)node;
+    }
+    long ret = move_pages_linux(0, (unsigned long)n, pages, nodes, status, MPOL_MF_MOVE_linux);
+    if (ret == -ENOSYS_linux) {
+      return (len + STEP_numa - 1) / STEP_numa; // one node: everything is local
+    }
+    if (ret < 0) {
+      return ret;
+    }
+    for (int i = 0; i < n; ++i) {
+      here += status[i] == (int)node;
+    }
+  }
+  return here;
+}
+
+// The node holding the page at `addr`, -ENOENT when it isn't resident.
+long NodeOf_numa(const void *addr) {
+  const void *page = (const void *)((unsigned long)addr & ~(STEP_numa - 1));
+  int status;
+  long ret = move_pages_linux(0, 1, &page, 0, &status, 0);
+  if (ret == -ENOSYS_linux) {
+    return 0;
+  }
+  return ret < 0 ? ret : status;
+}
+
+#endif // C_NUMA_IMPLEMENTATION
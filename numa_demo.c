@@ -0,0 +1,252 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o numa_demo numa_demo.c -e main && ./numa_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_NUMA_IMPLEMENTATION
+#include "numa.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long Xorshift(unsigned long long *state) {
+  unsigned long long x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+//
+// Topology as sysfs reports it
+//
+void Topology_demo(const Topology_numa *t) {
+  Print(STDOUT_FILENO_linux, "nodes: ");
+  PrintU64(STDOUT_FILENO_linux, t->count);
+  Print(STDOUT_FILENO_linux, "\n");
+  for (int node = 0; node < MAX_NODES_numa; ++node) {
+    if (!HasNode_numa(t, node)) {
+      continue;
+    }
+    Print(STDOUT_FILENO_linux, "  node ");
+    PrintU64(STDOUT_FILENO_linux, node);
+    Print(STDOUT_FILENO_linux, ": ");
+    PrintU64(STDOUT_FILENO_linux, t->memory[node] >> 20);
+    Print(STDOUT_FILENO_linux, " MiB, cpus");
+    for (int cpu = 0; cpu < MAX_CPUS_numa; ++cpu) {
+      if (HasCpu_numa(t, node, cpu)) {
+        Print(STDOUT_FILENO_linux, " ");
+        PrintU64(STDOUT_FILENO_linux, cpu);
+      }
+    }
+    Print(STDOUT_FILENO_linux, ", distances");
+    for (int to = 0; to < MAX_NODES_numa; ++to) {
+      if (HasNode_numa(t, to)) {
+        Print(STDOUT_FILENO_linux, " ");
+        PrintU64(STDOUT_FILENO_linux, t->distance[node][to]);
+      }
+    }
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+  long node = CurrentNode_numa();
+  Assert(node >= 0 && HasNode_numa(t, (int)node));
+  Assert(t->distance[node][node] == 10 || t->distance[node][node] == 0);
+}
+
+int FirstCpu(const Topology_numa *t, int node) {
+  for (int cpu = 0; cpu < MAX_CPUS_numa; ++cpu) {
+    if (HasCpu_numa(t, node, cpu)) {
+      return cpu;
+    }
+  }
+  return -1;
+}
+
+void Pin(int cpu) {
+  unsigned long mask[MAX_CPUS_numa / WORD_BITS_numa] = {0};
+  mask[cpu / WORD_BITS_numa] = 1UL << (cpu % WORD_BITS_numa);
+  Assert(sched_setaffinity_linux(0, sizeof(mask), mask) == 0);
+}
+
+//
+// Arena pages land on their node; migration pulls pages to the current node
+//
+void Placement_demo(const Topology_numa *t) {
+  long here = CurrentNode_numa();
+  int far = (int)here;
+  for (int node = 0; node < MAX_NODES_numa; ++node) {
+    if (HasNode_numa(t, node) && node != here && t->memory[node]) {
+      far = node;
+    }
+  }
+  Arena_numa a;
+  Assert(InitArena_numa(&a, 16UL << 20, far, true) == 0);
+  char *p = (char *)AllocArena_numa(&a, 8UL << 20, 4096);
+  Assert(p != NULL && AllocArena_numa(&a, 16UL << 20, 1) == NULL);
+  for (unsigned long i = 0; i < (8UL << 20); i += 4096) {
+    p[i] = 1;
+  }
+  Assert(NodeOf_numa(p) == far);
+  Assert(MigrateHere_numa(p, 8UL << 20) == (long)((8UL << 20) / 4096));
+  Assert(NodeOf_numa(p + (4UL << 20)) == here);
+  FreeArena_numa(&a);
+
+  char *shared = (char *)AllocInterleaved_numa(t, 4UL << 20);
+  Assert(shared != NULL);
+  for (unsigned long i = 0; i < (4UL << 20); i += 4096) {
+    shared[i] = 1;
+  }
+  FreeInterleaved_numa(shared, 4UL << 20);
+  Print(STDOUT_FILENO_linux, far != here ? "arena on remote node, migrated back: ok\n" : "arena, migration (single node): ok\n");
+}
+
+//
+// Bandwidth and latency for every (CPU node, memory node) pair, plus interleaved
+//
+#define BW_BYTES   (256UL << 20)
+#define CHASE_SIZE (64UL << 20)
+#define CHASE_HOPS (4UL << 20)
+
+// Streams reads over the buffer, returns MB/s.
+unsigned long long Bandwidth(char *buf) {
+  unsigned long long *words = (unsigned long long *)buf;
+  unsigned long count = BW_BYTES / sizeof(unsigned long long);
+  for (unsigned long i = 0; i < count; ++i) {
+    words[i] = i;
+  }
+  unsigned long long start = Now_ns();
+  unsigned long long sum = 0;
+  for (int pass = 0; pass < 4; ++pass) {
+    for (unsigned long i = 0; i < count; i += 4) {
+      sum += words[i] + words[i + 1] + words[i + 2] + words[i + 3];
+    }
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(sum == 4 * ((unsigned long long)count * (count - 1) / 2));
+  return 4 * BW_BYTES * 1000 / elapsed;
+}
+
+// Random pointer chase, one cache line per hop, returns ns per load.
+unsigned long long Latency(char *buf) {
+  unsigned long lines = CHASE_SIZE / 64;
+  unsigned long *order = (unsigned long *)(buf + CHASE_SIZE); // scratch after the chase area
+  for (unsigned long i = 0; i < lines; ++i) {
+    order[i] = i;
+  }
+  unsigned long long seed = 88172645463325252ULL;
+  for (unsigned long i = lines - 1; i > 0; --i) {
+    unsigned long j = (unsigned long)(Xorshift(&seed) % (i + 1));
+    unsigned long swap = order[i];
+    order[i] = order[j];
+    order[j] = swap;
+  }
+  for (unsigned long i = 0; i < lines; ++i) {
+    *(char **)(buf + order[i] * 64) = buf + order[(i + 1) % lines] * 64;
+  }
+  char *at = buf + order[0] * 64;
+  unsigned long long start = Now_ns();
+  for (unsigned long i = 0; i < CHASE_HOPS; ++i) {
+    at = *(char **)at;
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(at != NULL);
+  return elapsed / CHASE_HOPS;
+}
+
+void Measure(char *buf, const char *label, int cpuNode, int memNode) {
+  Print(STDOUT_FILENO_linux, "  cpu node ");
+  PrintU64(STDOUT_FILENO_linux, cpuNode);
+  Print(STDOUT_FILENO_linux, label);
+  if (memNode >= 0) {
+    PrintU64(STDOUT_FILENO_linux, memNode);
+  }
+  Print(STDOUT_FILENO_linux, ": ");
+  PrintU64(STDOUT_FILENO_linux, Bandwidth(buf));
+  Print(STDOUT_FILENO_linux, " MB/s, ");
+  PrintU64(STDOUT_FILENO_linux, Latency(buf));
+  Print(STDOUT_FILENO_linux, " ns/load\n");
+}
+
+void Bench_demo(const Topology_numa *t) {
+  unsigned long original[MAX_CPUS_numa / WORD_BITS_numa] = {0};
+  Assert(sched_getaffinity_linux(0, sizeof(original), original) > 0);
+  Print(STDOUT_FILENO_linux, "cross-node bandwidth (sequential reads) and latency (pointer chase):\n");
+  for (int cpuNode = 0; cpuNode < MAX_NODES_numa; ++cpuNode) {
+    int cpu = HasNode_numa(t, cpuNode) ? FirstCpu(t, cpuNode) : -1;
+    if (cpu < 0) {
+      continue;
+    }
+    Pin(cpu);
+    for (int memNode = 0; memNode < MAX_NODES_numa; ++memNode) {
+      if (!HasNode_numa(t, memNode) || !t->memory[memNode]) {
+        continue;
+      }
+      Arena_numa a;
+      Assert(InitArena_numa(&a, BW_BYTES, memNode, true) == 0);
+      Measure(a.base, memNode == cpuNode ? ", local memory node " : ", remote memory node ", cpuNode, memNode);
+      FreeArena_numa(&a);
+    }
+    char *shared = (char *)AllocInterleaved_numa(t, BW_BYTES);
+    Assert(shared != NULL);
+    Measure(shared, ", interleaved memory", cpuNode, -1);
+    FreeInterleaved_numa(shared, BW_BYTES);
+  }
+  sched_setaffinity_linux(0, sizeof(original), original);
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  static Topology_numa t;
+  Assert(Load_numa(&t) == 0 && t.count >= 1);
+  Topology_demo(&t);
+  Placement_demo(&t);
+  Bench_demo(&t);
+  exit_linux(0);
+  return 0;
+}
@@ -0,0 +1,478 @@
+#ifndef C_PROC_HEADER
+#define C_PROC_HEADER
+
+// === proc.h: vfork-style process spawning & pidfd supervision ==============
+//
+// Contents:
+//   * spawn                        (jump: Spawn_proc)
+//   * supervisor                   (jump: Init_proc)
+//
+// Usage:
+//   proc.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/proc.h" // use as header file
+//
+//   #define C_PROC_IMPLEMENTATION
+//   #include "c/proc.h" // use as implementation file
+//
+//   fork copies the parent's page tables, so its cost grows with the
+//   parent's RSS. Spawn_proc uses clone3_linux(CLONE_VM | CLONE_VFORK |
+//   CLONE_PIDFD) instead: the child borrows our memory on a small stack
+//   carved from the caller's frame, runs its fd actions, resets its signal
+//   mask and process group, and execs; we sleep until then. The cost no
+//   longer depends on how big we are.
+//
+//     Action_proc actions[] = {{ACTION_DUP_proc, pipe[1], 1, 0},
+//                              {ACTION_CLOSE_RANGE_proc, 3, ~0, 0}};
+//     Attr_proc attr = {actions, 2, SETPGID_proc, 0, 0};
+//     int pidfd = (int)Spawn_proc("/bin/echo", argv, envp, &attr, 0);
+//     long status = Wait_proc(pidfd); // exit code, or 128 + signal
+//
+//   Handlers are reset in the child before it runs any of our code
+//   (CLONE_CLEAR_SIGHAND, or by hand before 5.5), and we block every signal
+//   around the clone, so no handler of ours ever runs on the borrowed stack.
+//   An exec failure is written back through the shared memory: Spawn_proc
+//   reaps the child and returns the exec's -errno.
+//
+//   The supervisor watches children through their pidfds in one epoll set:
+//   a pidfd turns readable when its process exits, so there's no SIGCHLD
+//   handler and no wait loop, and signals sent through a pidfd can't hit a
+//   recycled pid. Poll_proc reaps each exited child with waitid(P_PIDFD),
+//   keeping its rusage, and with INFO_proc asks PIDFD_GET_INFO (6.15+) for
+//   its exit code, credentials and cgroup without reading /proc. Kill_proc
+//   follows SIGKILL with process_mrelease, which frees the victim's memory
+//   right away instead of when its exit path gets around to it.
+//
+//     Init_proc(&s, 0);
+//     Watch_proc(&s, pidfd, job);
+//     int n = (int)Poll_proc(&s, exits, 64, -1); // exits[i].user == job
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "proc.h depends on linux.h, include it first"
+#endif
+
+#define STACK_proc (16UL << 10) // child stack, on the caller's stack
+
+#define ACTION_DUP_proc         1 // dup3(fd, newfd), fd == newfd clears FD_CLOEXEC
+#define ACTION_CLOSE_proc       2 // close(fd)
+#define ACTION_CLOSE_RANGE_proc 3 // close_range(fd, newfd, flags)
+
+#define SETPGID_proc 1 // setpgid(0, pgid): 0 for a group of its own
+#define SETMASK_proc 2 // signal mask `mask` instead of the caller's
+
+typedef struct {
+  int kind;
+  int fd;
+  int newfd;          // dup target, or last fd of a range
+  unsigned int flags; // CLOSE_RANGE_*
+} Action_proc;
+
+typedef struct {
+  const Action_proc *actions;
+  int action_count;
+  int flags;          // SETPGID_proc | SETMASK_proc
+  int pgid;
+  unsigned long long mask;
+} Attr_proc;
+
+#define EVENTS_proc 256 // exits handled per Poll_proc call at most
+#define INFO_proc   1   // Init_proc flag: fill Exit_proc.info
+
+typedef struct {
+  int pid;
+  int status; // exit code, or 128 + signal; -1 if unknown
+  void *user;
+  unsigned long long user_ns; // from waitid's rusage: children only
+  unsigned long long system_ns;
+  long max_rss_kb;
+  int has_info;               // PIDFD_GET_INFO answered
+  pidfd_info_linux info;
+} Exit_proc;
+
+typedef struct {
+  int epoll;
+  int flags;
+  int watched;
+  unsigned int slots;
+  void **users; // by pidfd
+} Supervisor_proc;
+
+//
+// Spawn
+//
+long Spawn_proc(const char *path, const char *const *argv, const char *const *envp, const Attr_proc *attr, int *pid);
+long Wait_proc(int pidfd);
+//
+// Supervisor
+//
+long Init_proc(Supervisor_proc *s, int flags);
+long Watch_proc(Supervisor_proc *s, int pidfd, void *user);
+long Adopt_proc(Supervisor_proc *s, int pid, void *user);
+long Kill_proc(int pidfd, int sig);
+long Poll_proc(Supervisor_proc *s, Exit_proc *exits, int max, int timeout_ms);
+void Free_proc(Supervisor_proc *s);
+
+#endif // C_PROC_HEADER
+#ifdef C_PROC_IMPLEMENTATION
+
+typedef struct {
+  const char *path;
+  const char *const *argv;
+  const char *const *envp;
+  const Attr_proc *attr;
+  unsigned long long mask; // the caller's, restored unless SETMASK_proc
+  int reset_handlers;      // no CLONE_CLEAR_SIGHAND
+  long error;              // written by the child if it can't exec
+} Child_proc;
+
+static int Run_proc(void *arg) {
+  Child_proc *c = (Child_proc *)arg;
+  const Attr_proc *attr = c->attr;
+  long ret = 0;
+  if (c->reset_handlers) {
+    for (int sig = 1; sig <= 64; ++sig) {
+      sigaction_t_linux act;
+      if (rt_sigaction_linux(sig, 0, &act) == 0 && act.sa_handler_linux != SIG_DFL_linux && act.sa_handler_linux != SIG_IGN_linux) {
+        act.sa_handler_linux = SIG_DFL_linux;
+        rt_sigaction_linux(sig, &act, 0);
+      }
+    }
+  }
+  for (int i = 0; attr && i < attr->action_count && ret >= 0; ++i) {
+    const Action_proc *a = &attr->actions[i];
+    switch (a->kind) {
+    case ACTION_DUP_proc:
+      ret = a->fd == a->newfd ? fcntl64_linux((unsigned int)a->fd, F_SETFD_linux, 0) : dup3_linux((unsigned int)a->fd, (unsigned int)a->newfd, 0);
+      break;
+    case ACTION_CLOSE_proc:
+      ret = close_linux((unsigned int)a->fd);
+      break;
+    case ACTION_CLOSE_RANGE_proc:
+      ret = close_range_linux((unsigned int)a->fd, (unsigned int)a->newfd, a->flags);
+      break;
+    default:
+      ret = -EINVAL_linux;
+    }
+  }
+  if (ret >= 0 && attr && (attr->flags & SETPGID_proc)) {
+    ret = setpgid_linux(0, attr->pgid);
+  }
+  if (ret >= 0) {
+    unsigned long long mask = attr && (attr->flags & SETMASK_proc) ? attr->mask : c->mask;
+    rt_sigprocmask_linux(SIG_SETMASK_linux, &mask, 0);
+    ret = execve_linux(c->path, c->argv, c->envp);
+  }
+  c->error = ret < 0 ? ret : -EINVAL_linux;
+  return 127;
+}
+
+// clone3_linux with a trampoline, like thread.h's: the new stack starts with
+// {entry, arg}; the child pops them, calls entry(arg) and exits with its
+// result. Only the parent returns, with the child's pid or -errno.
+static long Clone3_proc(clone_args_linux *args) {
+#if defined(__x86_64__)
+  register long rax __asm__("rax") = NR_clone3_linux;
+  register long rdi __asm__("rdi") = (long)args;
+  register long rsi __asm__("rsi") = sizeof(*args);
+  __asm__ volatile (
+    "syscall\n"
+    "test %%rax, %%rax\n"
+    "jnz 1f\n"
+    "xor %%ebp, %%ebp\n"
+    "pop %%rax\n"
+    "pop %%rdi\n"
+    "and $-16, %%rsp\n"
+    "call *%%rax\n"
+    "mov %%eax, %%edi\n"
+    "mov $60, %%eax\n"
+    "syscall\n"
+    "hlt\n"
+    "1:\n"
+    : "+r" (rax)
+    : "r" (rdi), "r" (rsi)
+    : "rcx", "r11", "memory", "cc"
+  );
+  return rax;
+#elif defined(__aarch64__)
+  register long x8 __asm__("x8") = NR_clone3_linux;
+  register long x0 __asm__("x0") = (long)args;
+  register long x1 __asm__("x1") = sizeof(*args);
+  __asm__ volatile (
+    "svc #0\n"
+    "cbnz x0, 1f\n"
+    "mov x29, #0\n"
+    "ldp x9, x0, [sp], #16\n"
+    "blr x9\n"
+    "mov x8, #93\n"
+    "svc #0\n"
+    "1:\n"
+    : "+r" (x0)
+    : "r" (x8), "r" (x1)
+    : "x9", "x30", "memory", "cc"
+  );
+  return x0;
+#elif defined(__riscv)
+  register long a7 __asm__("a7") = NR_clone3_linux;
+  register long a0 __asm__("a0") = (long)args;
+  register long a1 __asm__("a1") = sizeof(*args);
+  __asm__ volatile (
+    "ecall\n"
+    "bnez a0, 1f\n"
+#if __riscv_xlen == 64
+    "ld t0, 0(sp)\n"
+    "ld a0, 8(sp)\n"
+#else
+    "lw t0, 0(sp)\n"
+    "lw a0, 4(sp)\n"
+#endif
+    "addi sp, sp, 16\n"
+    "jalr t0\n"
+    "li a7, 93\n"
+    "ecall\n"
+    "1:\n"
+    : "+r" (a0)
+    : "r" (a7), "r" (a1)
+    : "t0", "ra", "memory"
+  );
+  return a0;
+#elif defined(__i386__)
+  register long eax __asm__("eax") = NR_clone3_linux;
+  register long ebx __asm__("ebx") = (long)args;
+  register long ecx __asm__("ecx") = sizeof(*args);
+  __asm__ volatile (
+    "int $0x80\n"
+    "test %%eax, %%eax\n"
+    "jnz 1f\n"
+    "xor %%ebp, %%ebp\n"
+    "mov (%%esp), %%eax\n"
+    "mov 4(%%esp), %%ecx\n"
+    "and $-16, %%esp\n"
+    "sub $12, %%esp\n"
+    "push %%ecx\n"
+    "call *%%eax\n"
+    "mov %%eax, %%ebx\n"
+    "mov $1, %%eax\n"
+    "int $0x80\n"
+    "hlt\n"
+    "1:\n"
+    : "+r" (eax)
+    : "r" (ebx), "r" (ecx)
+    : "edx", "memory", "cc"
+  );
+  return eax;
+#elif defined(__arm__)
+  register long r7 __asm__("r7") = NR_clone3_linux;
+  register long r0 __asm__("r0") = (long)args;
+  register long r1 __asm__("r1") = sizeof(*args);
+  __asm__ volatile (
+    "svc #0\n"
+    "cmp r0, #0\n"
+    "bne 1f\n"
+    "ldr r3, [sp]\n"
+    "ldr r0, [sp, #4]\n"
+    "add sp, sp, #16\n"
+    "blx r3\n"
+    "mov r7, #1\n"
+    "svc #0\n"
+    "1:\n"
+    : "+r" (r0)
+    : "r" (r7), "r" (r1)
+    : "r3", "lr", "memory", "cc"
+  );
+  return r0;
+#endif
+}
+
+//
+// Spawn
+//
+
+// Runs `path` with `attr` (0 for none) applied in the child; returns a pidfd
+// once the child has exec'd, and its pid in `pid` if not 0.
+long Spawn_proc(const char *path, const char *const *argv, const char *const *envp, const Attr_proc *attr, int *pid) {
+  char stack[STACK_proc] __attribute__((aligned(16)));
+  Child_proc c = {path, argv, envp, attr, 0, 0, 0};
+  void **sp = (void **)(stack + sizeof(stack) - 16);
+  sp[0] = (void *)Run_proc;
+  sp[1] = &c;
+  int pidfd = -1;
+  clone_args_linux args = {0};
+  args.flags = CLONE_VM_linux | CLONE_VFORK_linux | CLONE_PIDFD_linux | CLONE_CLEAR_SIGHAND_linux;
+  args.pidfd = (unsigned long)&pidfd;
+  args.exit_signal = SIGCHLD_linux;
+  args.stack = (unsigned long)stack;
+  args.stack_size = (unsigned long)((char *)sp - stack);
+
+  unsigned long long all = ~0ULL;
+  rt_sigprocmask_linux(SIG_SETMASK_linux, &all, &c.mask);
+  long ret = Clone3_proc(&args);
+  if (ret == -EINVAL_linux) { // before 5.5: no CLONE_CLEAR_SIGHAND
+    args.flags &= ~(unsigned long long)CLONE_CLEAR_SIGHAND_linux;
+    c.reset_handlers = 1;
+    ret = Clone3_proc(&args);
+  }
+  rt_sigprocmask_linux(SIG_SETMASK_linux, &c.mask, 0);
+  if (ret < 0) {
+    return ret;
+  }
+  if (c.error) {
+    siginfo_t_linux info;
+    waitid_linux(P_PIDFD_linux, pidfd, &info, WEXITED_linux, 0);
+    close_linux((unsigned int)pidfd);
+    return c.error;
+  }
+  if (pid) {
+    *pid = (int)ret;
+  }
+  return pidfd;
+}
+
+// Reaps the child; returns its exit code, or 128 + the signal that killed it.
+// The pidfd stays open.
+long Wait_proc(int pidfd) {
+  siginfo_t_linux info;
+  long ret;
+  do {
+    ret = waitid_linux(P_PIDFD_linux, pidfd, &info, WEXITED_linux, 0);
+  } while (ret == -EINTR_linux);
+  if (ret < 0) {
+    return ret;
+  }
+  return info.si_code == CLD_EXITED_linux ? info.si_status_linux : 128 + info.si_status_linux;
+}
+
+//
+// Supervisor
+//
+
+// Sets up the epoll set and a user pointer slot per possible descriptor.
+long Init_proc(Supervisor_proc *s, int flags) {
+  rlimit64_linux limit;
+  long ret = prlimit64_linux(0, RLIMIT_NOFILE_linux, 0, &limit);
+  if (ret < 0) {
+    return ret;
+  }
+  s->slots = limit.rlim_cur < (1U << 20) ? (unsigned int)limit.rlim_cur : 1U << 20;
+  ret = mmap_linux(0, s->slots * sizeof(void *), PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  s->users = (void **)ret;
+  ret = epoll_create1_linux(EPOLL_CLOEXEC_linux);
+  if (ret < 0) {
+    munmap_linux(s->users, s->slots * sizeof(void *));
+    return ret;
+  }
+  s->epoll = (int)ret;
+  s->flags = flags;
+  s->watched = 0;
+  return 0;
+}
+
+// Watches a child's pidfd, which the supervisor closes once it's reaped.
+long Watch_proc(Supervisor_proc *s, int pidfd, void *user) {
+  if (pidfd < 0 || (unsigned int)pidfd >= s->slots) {
+    return -EMFILE_linux;
+  }
+  epoll_event_linux event = {EPOLLIN_linux, (unsigned long long)pidfd};
+  long ret = epoll_ctl_linux(s->epoll, EPOLL_CTL_ADD_linux, pidfd, &event);
+  if (ret < 0) {
+    return ret;
+  }
+  s->users[pidfd] = user;
+  ++s->watched;
+  return 0;
+}
+
+// Watches any process by pid; returns its new pidfd. For processes that
+// aren't our children only PIDFD_GET_INFO knows the exit status.
+long Adopt_proc(Supervisor_proc *s, int pid, void *user) {
+  long pidfd = pidfd_open_linux(pid, 0);
+  if (pidfd < 0) {
+    return pidfd;
+  }
+  long ret = Watch_proc(s, (int)pidfd, user);
+  if (ret < 0) {
+    close_linux((unsigned int)pidfd);
+    return ret;
+  }
+  return pidfd;
+}
+
+// Signals through the pidfd; after SIGKILL also reclaims the memory of the
+// dying process from this thread.
+long Kill_proc(int pidfd, int sig) {
+  long ret = pidfd_send_signal_linux(pidfd, sig, 0, 0);
+  if (ret == 0 && sig == SIGKILL_linux) {
+    process_mrelease_linux(pidfd, 0); // best effort: ENOSYS before 5.15
+  }
+  return ret;
+}
+
+// Waits up to `timeout_ms` (-1: forever) for exits and reaps them into
+// `exits`; returns how many.
+long Poll_proc(Supervisor_proc *s, Exit_proc *exits, int max, int timeout_ms) {
+  epoll_event_linux events[EVENTS_proc];
+  long n = epoll_wait_linux(s->epoll, events, max < EVENTS_proc ? max : EVENTS_proc, timeout_ms);
+  if (n < 0) {
+    return n == -EINTR_linux ? 0 : n;
+  }
+  int count = 0;
+  for (int i = 0; i < n; ++i) {
+    int pidfd = (int)events[i].data;
+    siginfo_t_linux info;
+    rusage_linux usage;
+    info.si_pid_linux = 0;
+    long ret = waitid_linux(P_PIDFD_linux, pidfd, &info, WEXITED_linux | WNOHANG_linux, &usage);
+    if (ret == 0 && info.si_pid_linux == 0) {
+      continue; // not an exit after all
+    }
+    Exit_proc *e = &exits[count++];
+    e->user = s->users[pidfd];
+    e->status = -1;
+    e->pid = 0;
+    e->user_ns = e->system_ns = 0;
+    e->max_rss_kb = 0;
+    if (ret == 0) {
+      e->pid = info.si_pid_linux;
+      e->status = info.si_code == CLD_EXITED_linux ? info.si_status_linux : 128 + info.si_status_linux;
+      e->user_ns = (unsigned long long)usage.ru_utime.tv_sec * 1000000000ULL + (unsigned long long)usage.ru_utime.tv_usec * 1000;
+      e->system_ns = (unsigned long long)usage.ru_stime.tv_sec * 1000000000ULL + (unsigned long long)usage.ru_stime.tv_usec * 1000;
+      e->max_rss_kb = usage.ru_maxrss;
+    }
+    e->has_info = 0;
+    if ((s->flags & INFO_proc) || ret < 0) { // not our child: only pidfs saw the exit
+      e->info.mask = PIDFD_INFO_EXIT_linux | PIDFD_INFO_CGROUPID_linux;
+      if (ioctl_linux((unsigned int)pidfd, PIDFD_GET_INFO_linux, (unsigned long)&e->info) == 0) {
+        e->has_info = 1;
+        e->pid = e->pid ? e->pid : (int)e->info.pid;
+        if (e->status < 0 && (e->info.mask & PIDFD_INFO_EXIT_linux)) {
+          int code = e->info.exit_code;
+          e->status = (code & 0x7f) ? 128 + (code & 0x7f) : (code >> 8) & 0xff;
+        }
+      }
+    }
+    // A copy of the pidfd inherited by a fork would keep it in the set.
+    epoll_ctl_linux(s->epoll, EPOLL_CTL_DEL_linux, pidfd, 0);
+    close_linux((unsigned int)pidfd);
+    --s->watched;
+  }
+  return count;
+}
+
+// Closes the epoll set; pidfds still watched stay open.
+void Free_proc(Supervisor_proc *s) {
+  close_linux((unsigned int)s->epoll);
+  munmap_linux(s->users, s->slots * sizeof(void *));
+}
+
+#endif // C_PROC_IMPLEMENTATION
@@ -0,0 +1,333 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o proc_demo proc_demo.c -e main && ./proc_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_PROC_IMPLEMENTATION
+#include "proc.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+const char *envp[] = {"PATH=/bin:/usr/bin", NULL};
+
+//
+// fd actions, signal mask and process group reach the child, exec failures
+// come back as -errno
+//
+void Spawn_demo(void) {
+  int pipe[2];
+  Assert(pipe2_linux(pipe, O_CLOEXEC_linux) == 0);
+  Action_proc actions[] = {
+    {ACTION_DUP_proc, pipe[1], 1, 0},
+    {ACTION_CLOSE_RANGE_proc, 3, ~0, 0},
+  };
+  Attr_proc attr = {actions, 2, 0, 0, 0};
+  const char *echo[] = {"echo", "spawned", NULL};
+  int pid;
+  long pidfd = Spawn_proc("/bin/echo", echo, envp, &attr, &pid);
+  Assert(pidfd >= 0 && pid > 0);
+  close_linux(pipe[1]);
+  char out[32];
+  long size = 0, ret;
+  while ((ret = read_linux(pipe[0], out + size, sizeof(out) - (unsigned long)size)) > 0) {
+    size += ret;
+  }
+  Assert(size == 8 && out[0] == 's' && out[7] == '\n');
+  Assert(Wait_proc((int)pidfd) == 0);
+  close_linux((unsigned int)pidfd);
+  close_linux(pipe[0]);
+
+  // SIGTERM blocked here but not in the child, which leads its own group
+  unsigned long long term = 1ULL << (SIGTERM_linux - 1), old;
+  rt_sigprocmask_linux(SIG_BLOCK_linux, &term, &old);
+  Attr_proc fresh = {NULL, 0, SETPGID_proc | SETMASK_proc, 0, 0};
+  const char *sleep[] = {"sleep", "10", NULL};
+  pidfd = Spawn_proc("/bin/sleep", sleep, envp, &fresh, &pid);
+  Assert(pidfd >= 0);
+  Assert(getpgid_linux(pid) == pid);
+  Assert(pidfd_send_signal_linux((int)pidfd, SIGTERM_linux, NULL, 0) == 0);
+  Assert(Wait_proc((int)pidfd) == 128 + SIGTERM_linux);
+  close_linux((unsigned int)pidfd);
+  rt_sigprocmask_linux(SIG_SETMASK_linux, &old, NULL);
+
+  Assert(Spawn_proc("/nonexistent", echo, envp, NULL, NULL) == -ENOENT_linux);
+  Assert(wait4_linux(-1, NULL, WNOHANG_linux, NULL) == -ECHILD_linux); // reaped
+  Print(STDOUT_FILENO_linux, "fd actions, signal mask, process group, exec errors: ok\n");
+}
+
+//
+// Spawn rate against fork + exec as the parent's RSS grows (4 KiB pages, the
+// page tables fork has to copy)
+//
+#define SPAWNS 200
+
+const char *truth[] = {"true", NULL};
+
+unsigned long long ForkExec(void) {
+  unsigned long long t0 = Now_ns();
+  for (int i = 0; i < SPAWNS; ++i) {
+    long pid = fork_linux();
+    Assert(pid >= 0);
+    if (pid == 0) {
+      execve_linux("/bin/true", truth, envp);
+      exit_linux(127);
+    }
+    int status;
+    Assert(wait4_linux((int)pid, &status, 0, NULL) == pid && status == 0);
+  }
+  return Now_ns() - t0;
+}
+
+unsigned long long Spawn(void) {
+  unsigned long long t0 = Now_ns();
+  for (int i = 0; i < SPAWNS; ++i) {
+    long pidfd = Spawn_proc("/bin/true", truth, envp, NULL, NULL);
+    Assert(pidfd >= 0);
+    Assert(Wait_proc((int)pidfd) == 0);
+    close_linux((unsigned int)pidfd);
+  }
+  return Now_ns() - t0;
+}
+
+void Bench_demo(void) {
+#if defined(__LP64__)
+  unsigned long sizes[4] = {0, 256UL << 20, 1UL << 30, 3UL << 30}; // 10 GB wants a bigger machine than CI's
+#else
+  unsigned long sizes[4] = {0, 64UL << 20, 256UL << 20, 1UL << 30};
+#endif
+  Print(STDOUT_FILENO_linux, "\nspawns/s of /bin/true, spawn + wait:\nparent RSS     fork+exec   clone3 vfork\n");
+  for (int s = 0; s < 4; ++s) {
+    char *rss = 0;
+    if (sizes[s]) {
+      long ret = mmap_linux(0, sizes[s], PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+      Assert(ret > 0 || ret < -4095);
+      rss = (char *)ret;
+      madvise_linux(rss, sizes[s], MADV_NOHUGEPAGE_linux);
+      for (unsigned long i = 0; i < sizes[s]; i += 4096) {
+        rss[i] = 1;
+      }
+    }
+    PrintU64(STDOUT_FILENO_linux, sizes[s] >> 20);
+    Print(STDOUT_FILENO_linux, " MiB\t");
+    PrintU64(STDOUT_FILENO_linux, SPAWNS * 1000000000ULL / ForkExec());
+    Print(STDOUT_FILENO_linux, "\t\t");
+    PrintU64(STDOUT_FILENO_linux, SPAWNS * 1000000000ULL / Spawn());
+    Print(STDOUT_FILENO_linux, "\n");
+    if (rss) {
+      munmap_linux(rss, sizes[s]);
+    }
+  }
+}
+
+//
+// The supervisor reaps children and adopted processes with their exit
+// status, stats and pidfs info, and kills through pidfds
+//
+const char *names[4] = {"true", "exit 7", "killed", "adopted"};
+
+long ForkPidfd(int *pidfd) {
+  clone_args_linux args = {0};
+  args.flags = CLONE_PIDFD_linux;
+  args.pidfd = (unsigned long)pidfd;
+  args.exit_signal = SIGCHLD_linux;
+  return clone3_linux(&args);
+}
+
+void Supervisor_demo(void) {
+  Supervisor_proc s;
+  Assert(Init_proc(&s, INFO_proc) == 0);
+  const char *truth[] = {"true", NULL};
+  const char *seven[] = {"sh", "-c", "exit 7", NULL};
+  const char *sleep[] = {"sleep", "10", NULL};
+  long pidfd = Spawn_proc("/bin/true", truth, envp, NULL, NULL);
+  Assert(pidfd >= 0 && Watch_proc(&s, (int)pidfd, (void *)names[0]) == 0);
+  pidfd = Spawn_proc("/bin/sh", seven, envp, NULL, NULL);
+  Assert(pidfd >= 0 && Watch_proc(&s, (int)pidfd, (void *)names[1]) == 0);
+  pidfd = Spawn_proc("/bin/sleep", sleep, envp, NULL, NULL);
+  Assert(pidfd >= 0 && Watch_proc(&s, (int)pidfd, (void *)names[2]) == 0);
+  Assert(Kill_proc((int)pidfd, SIGKILL_linux) == 0);
+  long pid = fork_linux();
+  Assert(pid >= 0);
+  if (pid == 0) {
+    exit_linux(3);
+  }
+  Assert(Adopt_proc(&s, (int)pid, (void *)names[3]) >= 0);
+
+  int expected[4] = {0, 7, 128 + SIGKILL_linux, 3};
+  int seen = 0;
+  while (s.watched) {
+    Exit_proc exits[4];
+    long n = Poll_proc(&s, exits, 4, -1);
+    Assert(n >= 0);
+    for (int i = 0; i < n; ++i) {
+      int which = 0;
+      while (names[which] != exits[i].user) {
+        ++which;
+      }
+      Assert(exits[i].status == expected[which] && exits[i].pid > 0);
+      Assert(!exits[i].has_info || (exits[i].info.mask & PIDFD_INFO_EXIT_linux));
+      seen |= 1 << which;
+    }
+  }
+  Assert(seen == 15);
+  Free_proc(&s);
+  Print(STDOUT_FILENO_linux, "supervisor exits, kills and adopted processes: ok\n");
+}
+
+//
+// Event handling cost with 50k short-lived children, 1000 alive at most
+//
+#define CHILDREN 50000
+#define ALIVE    1000
+
+enum { REAP_EPOLL, REAP_EPOLL_INFO, REAP_WAIT4, REAP_COUNT };
+const char *reapNames[REAP_COUNT] = {"pidfd + epoll + waitid      ", "pidfd + epoll + PIDFD_GET_INFO", "wait4(-1) loop, pids only    "};
+
+void Reap(int mode, unsigned long long *reap_ns, unsigned long long *total_ns) {
+  Supervisor_proc s;
+  Assert(Init_proc(&s, mode == REAP_EPOLL_INFO ? INFO_proc : 0) == 0);
+  int spawned = 0, reaped = 0, alive = 0;
+  unsigned long long t0 = Now_ns(), reaping = 0;
+  while (reaped < CHILDREN) {
+    for (; alive < ALIVE && spawned < CHILDREN; ++alive, ++spawned) {
+      int pidfd = -1;
+      long pid = mode == REAP_WAIT4 ? fork_linux() : ForkPidfd(&pidfd);
+      Assert(pid >= 0);
+      if (pid == 0) {
+        exit_linux(spawned & 0x7f);
+      }
+      if (mode != REAP_WAIT4) {
+        Assert(Watch_proc(&s, pidfd, (void *)(long)(spawned & 0x7f)) == 0);
+      }
+    }
+    unsigned long long t1 = Now_ns();
+    if (mode == REAP_WAIT4) {
+      int status;
+      rusage_linux usage;
+      long pid = wait4_linux(-1, &status, 0, &usage);
+      Assert(pid > 0);
+      do {
+        --alive;
+        ++reaped;
+      } while ((pid = wait4_linux(-1, &status, WNOHANG_linux, &usage)) > 0);
+    } else {
+      Exit_proc exits[EVENTS_proc];
+      long n = Poll_proc(&s, exits, EVENTS_proc, -1);
+      for (int i = 0; i < n; ++i) {
+        Assert(exits[i].status == (int)(long)exits[i].user);
+      }
+      alive -= (int)n;
+      reaped += (int)n;
+    }
+    reaping += Now_ns() - t1;
+  }
+  *total_ns = Now_ns() - t0;
+  *reap_ns = reaping;
+  Free_proc(&s);
+}
+
+void Reap_demo(void) {
+  Print(STDOUT_FILENO_linux, "\n50000 short-lived children, 1000 alive at most:\n                                reaping ns/exit   children/s overall\n");
+  for (int mode = 0; mode < REAP_COUNT; ++mode) {
+    unsigned long long reap, total;
+    Reap(mode, &reap, &total);
+    Print(STDOUT_FILENO_linux, reapNames[mode]);
+    Print(STDOUT_FILENO_linux, "  ");
+    PrintU64(STDOUT_FILENO_linux, reap / CHILDREN);
+    Print(STDOUT_FILENO_linux, "\t\t  ");
+    PrintU64(STDOUT_FILENO_linux, CHILDREN * 1000000000ULL / total);
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+
+  // Killing a child holding 1 GiB: kill to reaped, with and without
+  // process_mrelease in Kill_proc
+  for (int release = 0; release < 2; ++release) {
+    int pipe[2];
+    Assert(pipe2_linux(pipe, 0) == 0);
+    int pidfd = -1;
+    long pid = ForkPidfd(&pidfd);
+    Assert(pid >= 0);
+    if (pid == 0) {
+      unsigned long size = 1UL << 30;
+      long ret = mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_POPULATE_linux, -1, 0);
+      Assert(ret > 0 || ret < -4095);
+      write_linux(pipe[1], "r", 1);
+      for (;;) {
+        pause_linux();
+      }
+    }
+    char ready;
+    Assert(read_linux(pipe[0], &ready, 1) == 1);
+    Supervisor_proc s;
+    Assert(Init_proc(&s, 0) == 0);
+    Assert(Watch_proc(&s, pidfd, NULL) == 0);
+    unsigned long long t0 = Now_ns();
+    Assert((release ? Kill_proc(pidfd, SIGKILL_linux) : pidfd_send_signal_linux(pidfd, SIGKILL_linux, NULL, 0)) == 0);
+    Exit_proc exit;
+    while (Poll_proc(&s, &exit, 1, -1) != 1) {
+    }
+    Print(STDOUT_FILENO_linux, release ? "SIGKILL + process_mrelease, 1 GiB child: reaped after " : "SIGKILL, 1 GiB child: reaped after ");
+    PrintU64(STDOUT_FILENO_linux, (Now_ns() - t0) / 1000);
+    Print(STDOUT_FILENO_linux, " us\n");
+    Free_proc(&s);
+    close_linux(pipe[0]);
+    close_linux(pipe[1]);
+  }
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Spawn_demo();
+  Supervisor_demo();
+  Bench_demo();
+  Reap_demo();
+  exit_linux(0);
+  return 0;
+}
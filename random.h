@@ -0,0 +1,444 @@
+#ifndef C_RANDOM_HEADER
+#define C_RANDOM_HEADER
+
+// === random.h: fork-safe ChaCha20 generator with vDSO getrandom ==============
+//
+// Contents:
+//   * generator                    (jump: Init_random)
+//   * per-thread states            (jump: NewState_random)
+//   * chacha20                     (jump: Block_random)
+//
+// Usage:
+//   random.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/random.h" // use as header file
+//
+//   #define C_RANDOM_IMPLEMENTATION
+//   #include "c/random.h" // use as implementation file
+//
+//   Cryptographic random bytes (keys, nonces, session ids) without a
+//   getrandom syscall per request. Init_random sets up one generator for the
+//   process, each thread takes its own state with NewState_random and fills
+//   buffers with Fill_random:
+//
+//     Generator_random g;
+//     Init_random(&g, 64); // room for 64 thread states
+//     State_random *s = NewState_random(&g);
+//     unsigned char key[32];
+//     Fill_random(&g, s, key, sizeof(key));
+//
+//   When the kernel exports getrandom in the vDSO (x86_64 since 6.11, later
+//   arm64 and others), Fill_random calls it: the kernel's own ChaCha20, in
+//   userspace, reseeded whenever the kernel's pool changes. Otherwise, or
+//   with `use_vdso` cleared, states run ChaCha20 with fast key erasure: each
+//   refill computes BLOCKS_random blocks, the last 32 bytes become the next
+//   key and handed-out bytes are wiped, so a later memory disclosure can't
+//   recover earlier output. A state reseeds from getrandom_linux once per
+//   RESEED_random bytes of output, not per call.
+//
+//   States live in pages marked MADV_WIPEONFORK and MADV_DONTDUMP: a forked
+//   child finds them zeroed and reseeds before its first byte, so parent and
+//   child never share a stream, and keys stay out of core dumps. Before the
+//   kernel's pool is ready (GRND_NONBLOCK fails early in boot) or without
+//   getrandom, a state seeds from AT_RANDOM, the pid and the time, and tries
+//   getrandom again at its next refill.
+//
+//   A state belongs to one thread; the generator is shared and read-only
+//   after Init_random.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "random.h depends on linux.h, include it first"
+#endif
+
+#define BLOCKS_random 16            // ChaCha20 blocks per refill
+#define BUFFER_random (BLOCKS_random * 64)
+#define RESEED_random (1ULL << 20)  // output bytes between getrandom reseeds
+
+#define SEEDED_random 1             // from getrandom
+#define WEAK_random   2             // from AT_RANDOM, pid and time
+
+typedef struct {
+  unsigned char buffer[BUFFER_random]; // keystream, handed out from the end
+  unsigned int key[8];
+  unsigned int available;              // bytes left in buffer
+  unsigned int seeded;                 // 0 in a fresh or forked-and-wiped state
+  unsigned long long since_seed;       // bytes generated since the last reseed
+  unsigned long long reseeds;
+} __attribute__((aligned(64))) State_random;
+
+typedef long (*Vgetrandom_random)(void *buf, unsigned long len, unsigned int flags, void *state, unsigned long state_len);
+
+typedef struct {
+  State_random *states;           // MADV_WIPEONFORK | MADV_DONTDUMP
+  unsigned long states_size;
+  char *vdso_states;              // mapped as the vDSO asked
+  unsigned long vdso_size;
+  Vgetrandom_random vgetrandom;   // 0 without vDSO getrandom
+  unsigned int vdso_state_size;
+  unsigned int vdso_per_page;
+  int use_vdso;
+  unsigned int capacity;
+  unsigned int count;             // states handed out
+  unsigned long page;
+  unsigned char at_random[16];    // AT_RANDOM, zero when /proc is missing
+} Generator_random;
+
+//
+// Generator
+//
+long Init_random(Generator_random *g, unsigned int capacity);
+void Free_random(Generator_random *g);
+
+//
+// Per-thread states
+//
+State_random *NewState_random(Generator_random *g);
+long Fill_random(Generator_random *g, State_random *s, void *buf, unsigned long len);
+long Refill_random(Generator_random *g, State_random *s);
+
+typedef unsigned long long __attribute__((may_alias, aligned(1))) Unaligned_random;
+
+static inline unsigned long long U64_random(Generator_random *g, State_random *s) {
+  unsigned long long value = 0;
+  if (!g->use_vdso && s->available >= sizeof(value)) {
+    s->available -= sizeof(value);
+    Unaligned_random *at = (Unaligned_random *)(s->buffer + s->available);
+    value = *at;
+    *at = 0;
+    return value;
+  }
+  Fill_random(g, s, &value, sizeof(value));
+  return value;
+}
+
+//
+// ChaCha20
+//
+void Block_random(const unsigned int in[16], unsigned int out[16]);
+
+#endif // C_RANDOM_HEADER
+
+#ifdef C_RANDOM_IMPLEMENTATION
+
+// Clears key material in a way the compiler can't drop as a dead store.
+static void Wipe_random(void *p, unsigned long len) {
+  for (unsigned long i = 0; i < len; ++i) {
+    ((volatile unsigned char *)p)[i] = 0;
+  }
+}
+
+#define Rotl_random(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define Quarter_random(a, b, c, d)                      \
+  a += b; d ^= a; d = Rotl_random(d, 16);               \
+  c += d; b ^= c; b = Rotl_random(b, 12);               \
+  a += b; d ^= a; d = Rotl_random(d, 8);                \
+  c += d; b ^= c; b = Rotl_random(b, 7)
+
+// One 64-byte block: `in` is the constants, key, counter and nonce words.
+// Output words are little-endian like every architecture linux.h targets.
+void Block_random(const unsigned int in[16], unsigned int out[16]) {
+  unsigned int x0 = in[0], x1 = in[1], x2 = in[2], x3 = in[3];
+  unsigned int x4 = in[4], x5 = in[5], x6 = in[6], x7 = in[7];
+  unsigned int x8 = in[8], x9 = in[9], x10 = in[10], x11 = in[11];
+  unsigned int x12 = in[12], x13 = in[13], x14 = in[14], x15 = in[15];
+  for (int i = 0; i < 10; ++i) {
+    Quarter_random(x0, x4, x8, x12);
+    Quarter_random(x1, x5, x9, x13);
+    Quarter_random(x2, x6, x10, x14);
+    Quarter_random(x3, x7, x11, x15);
+    Quarter_random(x0, x5, x10, x15);
+    Quarter_random(x1, x6, x11, x12);
+    Quarter_random(x2, x7, x8, x13);
+    Quarter_random(x3, x4, x9, x14);
+  }
+  out[0] = x0 + in[0]; out[1] = x1 + in[1]; out[2] = x2 + in[2]; out[3] = x3 + in[3];
+  out[4] = x4 + in[4]; out[5] = x5 + in[5]; out[6] = x6 + in[6]; out[7] = x7 + in[7];
+  out[8] = x8 + in[8]; out[9] = x9 + in[9]; out[10] = x10 + in[10]; out[11] = x11 + in[11];
+  out[12] = x12 + in[12]; out[13] = x13 + in[13]; out[14] = x14 + in[14]; out[15] = x15 + in[15];
+}
+
+// Reads the entries of the auxiliary vector random.h needs; main(void)
+// can't see the entry stack, /proc/self/auxv has the same words.
+static void Auxv_random(Generator_random *g, unsigned long *vdso) {
+  unsigned long auxv[128];
+  long fd = openat_linux(AT_FDCWD_linux, "/proc/self/auxv", O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return;
+  }
+  long got = 0;
+  for (long ret; got < (long)sizeof(auxv); got += ret) {
+    ret = read_linux((unsigned int)fd, (char *)auxv + got, sizeof(auxv) - (unsigned long)got);
+    if (ret <= 0) {
+      break;
+    }
+  }
+  close_linux((unsigned int)fd);
+  for (long i = 0; i + 1 < got / (long)sizeof(unsigned long) && auxv[i] != AT_NULL_linux; i += 2) {
+    if (auxv[i] == AT_PAGESZ_linux) {
+      g->page = auxv[i + 1];
+    } else if (auxv[i] == AT_SYSINFO_EHDR_linux) {
+      *vdso = auxv[i + 1];
+    } else if (auxv[i] == AT_RANDOM_linux && auxv[i + 1]) {
+      for (int b = 0; b < 16; ++b) {
+        g->at_random[b] = ((const unsigned char *)auxv[i + 1])[b];
+      }
+    }
+  }
+}
+
+#if defined(__LP64__)
+typedef struct {
+  unsigned char ident[16];
+  unsigned short type, machine;
+  unsigned int version;
+  unsigned long entry, phoff, shoff;
+  unsigned int flags;
+  unsigned short ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+} ElfHeader_random;
+
+typedef struct {
+  unsigned int type, flags;
+  unsigned long offset, vaddr, paddr, filesz, memsz, align;
+} ElfProgram_random;
+
+typedef struct {
+  long tag;
+  unsigned long value;
+} ElfDynamic_random;
+
+typedef struct {
+  unsigned int name;
+  unsigned char info, other;
+  unsigned short shndx;
+  unsigned long value, size;
+} ElfSymbol_random;
+
+#define PT_LOAD_random    1
+#define PT_DYNAMIC_random 2
+#define DT_HASH_random    4
+#define DT_STRTAB_random  5
+#define DT_SYMTAB_random  6
+
+static int Equal_random(const char *a, const char *b) {
+  while (*a && *a == *b) {
+    ++a, ++b;
+  }
+  return *a == *b;
+}
+
+// Finds getrandom in the vDSO image through its DT_HASH symbol count; the
+// kernel links every vDSO with both hash styles.
+static Vgetrandom_random Lookup_random(unsigned long base) {
+  const ElfHeader_random *header = (const ElfHeader_random *)base;
+  const ElfProgram_random *programs = (const ElfProgram_random *)(base + header->phoff);
+  unsigned long bias = 0, dynamic = 0;
+  int loaded = 0;
+  for (int i = 0; i < header->phnum; ++i) {
+    if (programs[i].type == PT_LOAD_random && !loaded) {
+      bias = base + programs[i].offset - programs[i].vaddr;
+      loaded = 1;
+    } else if (programs[i].type == PT_DYNAMIC_random) {
+      dynamic = programs[i].vaddr;
+    }
+  }
+  if (!loaded || !dynamic) {
+    return 0;
+  }
+  const unsigned int *hash = 0;
+  const char *strings = 0;
+  const ElfSymbol_random *symbols = 0;
+  for (const ElfDynamic_random *d = (const ElfDynamic_random *)(bias + dynamic); d->tag; ++d) {
+    if (d->tag == DT_HASH_random) {
+      hash = (const unsigned int *)(bias + d->value);
+    } else if (d->tag == DT_STRTAB_random) {
+      strings = (const char *)(bias + d->value);
+    } else if (d->tag == DT_SYMTAB_random) {
+      symbols = (const ElfSymbol_random *)(bias + d->value);
+    }
+  }
+  if (!hash || !strings || !symbols) {
+    return 0;
+  }
+  for (unsigned int i = 0; i < hash[1]; ++i) {
+    const char *name = strings + symbols[i].name;
+    if (symbols[i].shndx && (Equal_random(name, "__vdso_getrandom") || Equal_random(name, "__kernel_getrandom"))) {
+      return (Vgetrandom_random)(bias + symbols[i].value);
+    }
+  }
+  return 0;
+}
+#endif
+
+// Sets up vDSO getrandom: the vDSO reports how big each opaque state is and
+// how to map them (MAP_DROPPABLE, which also wipes on fork); a state must
+// not straddle a page.
+static void Vdso_random(Generator_random *g, unsigned long vdso) {
+#if defined(__LP64__)
+  if (!vdso) {
+    return;
+  }
+  Vgetrandom_random vgetrandom = Lookup_random(vdso);
+  vgetrandom_opaque_params_linux params;
+  if (!vgetrandom || vgetrandom(0, 0, 0, &params, ~0UL) != 0 || !params.size_of_opaque_state || params.size_of_opaque_state > g->page) {
+    return;
+  }
+  unsigned int per_page = (unsigned int)(g->page / params.size_of_opaque_state);
+  unsigned long size = (g->capacity + per_page - 1) / per_page * g->page;
+  long ret = mmap_linux(0, size, params.mmap_prot, params.mmap_flags, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return;
+  }
+  g->vdso_states = (char *)ret;
+  g->vdso_size = size;
+  g->vdso_state_size = params.size_of_opaque_state;
+  g->vdso_per_page = per_page;
+  g->vgetrandom = vgetrandom;
+  g->use_vdso = 1;
+#else
+  (void)g, (void)vdso;
+#endif
+}
+
+long Init_random(Generator_random *g, unsigned int capacity) {
+  g->vdso_states = 0;
+  g->vdso_size = 0;
+  g->vgetrandom = 0;
+  g->vdso_state_size = 0;
+  g->vdso_per_page = 0;
+  g->use_vdso = 0;
+  g->capacity = capacity;
+  g->count = 0;
+  g->page = 4096;
+  for (int i = 0; i < 16; ++i) {
+    g->at_random[i] = 0;
+  }
+  unsigned long vdso = 0;
+  Auxv_random(g, &vdso);
+
+  g->states_size = ((unsigned long)capacity * sizeof(State_random) + g->page - 1) & ~(g->page - 1);
+  long ret = mmap_linux(0, g->states_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  g->states = (State_random *)ret;
+  // Without WIPEONFORK (before 4.14) a child would replay the parent's stream.
+  if ((ret = madvise_linux(g->states, g->states_size, MADV_WIPEONFORK_linux)) < 0 ||
+      (ret = madvise_linux(g->states, g->states_size, MADV_DONTDUMP_linux)) < 0) {
+    munmap_linux(g->states, g->states_size);
+    return ret;
+  }
+  Vdso_random(g, vdso);
+  return 0;
+}
+
+void Free_random(Generator_random *g) {
+  munmap_linux(g->states, g->states_size);
+  if (g->vdso_states) {
+    munmap_linux(g->vdso_states, g->vdso_size);
+  }
+}
+
+// A zeroed state that seeds on first use; 0 once `capacity` are taken.
+State_random *NewState_random(Generator_random *g) {
+  unsigned int index = __atomic_fetch_add(&g->count, 1, __ATOMIC_RELAXED);
+  return index < g->capacity ? g->states + index : 0;
+}
+
+// Mixes fresh key material into the key. The new key only takes effect
+// through the next refill, so the seed is never output directly.
+static void Seed_random(Generator_random *g, State_random *s) {
+  unsigned int seed[8];
+  if (getrandom_linux((char *)seed, sizeof(seed), GRND_NONBLOCK_linux) == (long)sizeof(seed)) {
+    s->seeded = SEEDED_random;
+  } else {
+    __kernel_timespec_linux ts;
+    clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+    seed[0] = seed[1] = seed[2] = seed[3] = 0;
+    for (int b = 0; b < 16; ++b) {
+      seed[b >> 2] |= (unsigned int)g->at_random[b] << (8 * (b & 3));
+    }
+    seed[4] = (unsigned int)getpid_linux();
+    seed[5] = (unsigned int)(s - g->states);
+    seed[6] = (unsigned int)ts.tv_nsec;
+    seed[7] = (unsigned int)ts.tv_sec;
+    s->seeded = WEAK_random;
+  }
+  for (int i = 0; i < 8; ++i) {
+    s->key[i] ^= seed[i];
+  }
+  Wipe_random(seed, sizeof(seed));
+  s->since_seed = 0;
+  ++s->reseeds;
+}
+
+// Computes BLOCKS_random blocks with the current key, keeps the last 32
+// bytes as the next key and erases them from the buffer.
+long Refill_random(Generator_random *g, State_random *s) {
+  if (s->seeded != SEEDED_random || s->since_seed >= RESEED_random) {
+    Seed_random(g, s);
+  }
+  unsigned int in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+  for (int i = 0; i < 8; ++i) {
+    in[4 + i] = s->key[i];
+  }
+  unsigned int *out = (unsigned int *)s->buffer;
+  for (unsigned int b = 0; b < BLOCKS_random; ++b) {
+    in[12] = b;
+    Block_random(in, out + 16 * b);
+  }
+  unsigned int *next = out + (BUFFER_random - sizeof(s->key)) / sizeof(*out);
+  for (int i = 0; i < 8; ++i) {
+    s->key[i] = next[i];
+  }
+  Wipe_random(in, sizeof(in));
+  Wipe_random(next, sizeof(s->key));
+  s->available = BUFFER_random - sizeof(s->key);
+  s->since_seed += BUFFER_random;
+  return 0;
+}
+
+typedef unsigned long __attribute__((may_alias)) Word_random;
+
+long Fill_random(Generator_random *g, State_random *s, void *buf, unsigned long len) {
+  if (g->use_vdso) {
+    unsigned int index = (unsigned int)(s - g->states);
+    char *state = g->vdso_states + index / g->vdso_per_page * g->page + index % g->vdso_per_page * g->vdso_state_size;
+    return g->vgetrandom(buf, len, 0, state, g->vdso_state_size);
+  }
+  char *dst = (char *)buf;
+  for (unsigned long done = 0; done < len;) {
+    if (!s->available) {
+      long ret = Refill_random(g, s);
+      if (ret < 0) {
+        return ret;
+      }
+    }
+    unsigned long n = len - done < s->available ? len - done : s->available;
+    s->available -= (unsigned int)n;
+    char *src = (char *)s->buffer + s->available;
+    unsigned long i = 0;
+    if (!(((unsigned long)(dst + done) | (unsigned long)src) & (sizeof(Word_random) - 1))) {
+      for (; i + sizeof(Word_random) <= n; i += sizeof(Word_random)) {
+        *(Word_random *)(dst + done + i) = *(Word_random *)(src + i);
+        *(Word_random *)(src + i) = 0;
+      }
+    }
+    for (; i < n; ++i) {
+      dst[done + i] = src[i];
+      src[i] = 0;
+    }
+    done += n;
+  }
+  return (long)len;
+}
+
+#endif // C_RANDOM_IMPLEMENTATION
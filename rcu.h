@@ -0,0 +1,406 @@
+#ifndef C_RCU_HEADER
+#define C_RCU_HEADER
+
+// === rcu.h: userspace RCU & hazard pointers with membarrier fences ==========
+//
+// Contents:
+//   * domain & readers             (jump: Init_rcu)
+//   * read side                    (jump: ReadLock_rcu)
+//   * grace periods                (jump: Synchronize_rcu)
+//   * deferred frees               (jump: Defer_rcu)
+//   * hazard pointers              (jump: Protect_rcu)
+//
+// Usage:
+//   rcu.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/rcu.h" // use as header file
+//
+//   #define C_RCU_IMPLEMENTATION
+//   #include "c/rcu.h" // use as implementation file
+//
+//   Read-mostly data without atomics on the read path. Each reader thread
+//   registers a Reader_rcu once; a read-side critical section is then two
+//   plain stores to that thread's own cache line, with only compiler
+//   barriers: no fence, no read-modify-write, no shared cache line.
+//
+//   The fences the readers skip are issued by writers on their behalf:
+//   membarrier_linux(MEMBARRIER_CMD_PRIVATE_EXPEDITED) runs a full barrier on
+//   every CPU currently running one of our threads, so a grace period costs
+//   the writer two rounds of IPIs plus waiting for the readers. Kernels without
+//   it (before 4.14) fall back to readers fencing themselves.
+//
+//     ReadLock_rcu(&domain, &reader);
+//     Config *c = (Config *)Dereference_rcu((void **)&current);
+//     ... use c ...
+//     ReadUnlock_rcu(&domain, &reader);
+//
+//     Assign_rcu((void **)&current, fresh);     // writer
+//     Defer_rcu(&domain, &old->head, FreeConfig); // freed after a grace period
+//
+//   Defer_rcu batches frees so one grace period pays for BATCH_rcu of them.
+//   Hazard pointers (Protect_rcu, Retire_rcu) protect single nodes of linked
+//   structures for longer than a read section should last, with the same
+//   asymmetric fences: a plain store on the reader, membarrier on the scan.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "rcu.h depends on linux.h, include it first"
+#endif
+
+#define HAZARDS_rcu 2  // hazard pointer slots per reader
+#define BATCH_rcu   64 // deferred or retired nodes per grace period / scan
+
+// Embed in objects freed through Defer_rcu or Retire_rcu. Hazard pointers
+// hold node addresses, so nodes retired with Retire_rcu put it first.
+typedef struct Head_rcu {
+  struct Head_rcu *next;
+  void (*free)(struct Head_rcu *head);
+} Head_rcu;
+
+// One per reader thread, on its own cache line: nothing else writes to it.
+typedef struct Reader_rcu {
+  unsigned long epoch; // 0 outside read sections, else the domain epoch at entry
+  unsigned long nest;
+  void *hazards[HAZARDS_rcu];
+  struct Reader_rcu *next;
+  Head_rcu *retired;
+  unsigned long retired_count;
+} __attribute__((aligned(64))) Reader_rcu;
+
+typedef struct {
+  unsigned long epoch; // odd, advances by 2 per grace period
+  int fences;          // no membarrier: readers fence themselves
+  unsigned int lock;   // futex mutex for writers, registration and deferred frees
+  Reader_rcu *readers;
+  Head_rcu *deferred;
+  unsigned long deferred_count;
+  Head_rcu *orphans;   // retired nodes of unregistered readers
+  unsigned long grace_periods;
+} Domain_rcu;
+
+//
+// Domain & readers
+//
+long Init_rcu(Domain_rcu *d);
+void Register_rcu(Domain_rcu *d, Reader_rcu *r);
+void Unregister_rcu(Domain_rcu *d, Reader_rcu *r);
+//
+// Grace periods
+//
+void Synchronize_rcu(Domain_rcu *d);
+//
+// Deferred frees
+//
+void Defer_rcu(Domain_rcu *d, Head_rcu *head, void (*free)(Head_rcu *head));
+void Barrier_rcu(Domain_rcu *d);
+//
+// Hazard pointers
+//
+void Retire_rcu(Domain_rcu *d, Reader_rcu *r, Head_rcu *head, void (*free)(Head_rcu *head));
+unsigned long Scan_rcu(Domain_rcu *d, Reader_rcu *r);
+
+//
+// Read side
+//
+
+// Enters a read-side critical section; sections nest.
+static inline void ReadLock_rcu(Domain_rcu *d, Reader_rcu *r) {
+  if (r->nest++ == 0) {
+    __atomic_store_n(&r->epoch, __atomic_load_n(&d->epoch, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    if (d->fences) {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } else {
+      __atomic_signal_fence(__ATOMIC_SEQ_CST); // the writer's membarrier is our fence
+    }
+  }
+}
+
+static inline void ReadUnlock_rcu(Domain_rcu *d, Reader_rcu *r) {
+  if (--r->nest == 0) {
+    if (d->fences) {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } else {
+      __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    }
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELAXED);
+  }
+}
+
+// Loads an RCU-protected pointer. Relaxed is enough: loads through it are
+// address-dependent, which every architecture we support orders.
+static inline void *Dereference_rcu(void **p) {
+  return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+// Publishes `v`: its initialization is visible before the pointer is.
+static inline void Assign_rcu(void **p, void *v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+//
+// Hazard pointers
+//
+
+// Loads `*src` into hazard `slot` and returns it once the slot is known to
+// cover it; the node can't be freed until Clear_rcu (or another Protect_rcu
+// on the slot). The recheck closes the window between load and publish.
+static inline void *Protect_rcu(Domain_rcu *d, Reader_rcu *r, int slot, void **src) {
+  void *p = __atomic_load_n(src, __ATOMIC_RELAXED);
+  for (;;) {
+    __atomic_store_n(&r->hazards[slot], p, __ATOMIC_RELAXED);
+    if (d->fences) {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    } else {
+      __atomic_signal_fence(__ATOMIC_SEQ_CST); // Scan_rcu's membarrier is our fence
+    }
+    void *again = __atomic_load_n(src, __ATOMIC_RELAXED);
+    if (again == p) {
+      return p;
+    }
+    p = again;
+  }
+}
+
+static inline void Clear_rcu(Reader_rcu *r, int slot) {
+  __atomic_store_n(&r->hazards[slot], 0, __ATOMIC_RELEASE);
+}
+
+#endif // C_RCU_HEADER
+#ifdef C_RCU_IMPLEMENTATION
+
+// Three-state futex mutex: 0 free, 1 locked, 2 locked with waiters.
+static void Lock_rcu(Domain_rcu *d) {
+  unsigned int state = 0;
+  if (__atomic_compare_exchange_n(&d->lock, &state, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    return;
+  }
+  if (state != 2) {
+    state = __atomic_exchange_n(&d->lock, 2, __ATOMIC_ACQUIRE);
+  }
+  while (state != 0) {
+    futex_time64_linux(&d->lock, FUTEX_WAIT | FUTEX_PRIVATE_FLAG, 2, 0, 0, 0);
+    state = __atomic_exchange_n(&d->lock, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+static void Unlock_rcu(Domain_rcu *d) {
+  if (__atomic_exchange_n(&d->lock, 0, __ATOMIC_RELEASE) == 2) {
+    futex_time64_linux(&d->lock, FUTEX_WAKE | FUTEX_PRIVATE_FLAG, 1, 0, 0, 0);
+  }
+}
+
+// The asymmetric half of every reader-side compiler barrier.
+static void Fence_rcu(Domain_rcu *d) {
+  if (d->fences || membarrier_linux(MEMBARRIER_CMD_PRIVATE_EXPEDITED_linux, 0, 0) < 0) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  }
+}
+
+//
+// Domain & readers
+//
+
+// Registers the process for expedited membarriers; when that isn't
+// available, the domain falls back to fencing readers.
+long Init_rcu(Domain_rcu *d) {
+  d->epoch = 1;
+  d->lock = 0;
+  d->readers = 0;
+  d->deferred = 0;
+  d->deferred_count = 0;
+  d->orphans = 0;
+  d->grace_periods = 0;
+  long ret = membarrier_linux(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED_linux, 0, 0);
+  d->fences = ret < 0;
+  return 0;
+}
+
+// Call from the reader thread before its first read section.
+void Register_rcu(Domain_rcu *d, Reader_rcu *r) {
+  r->epoch = 0;
+  r->nest = 0;
+  for (int i = 0; i < HAZARDS_rcu; ++i) {
+    r->hazards[i] = 0;
+  }
+  r->retired = 0;
+  r->retired_count = 0;
+  Lock_rcu(d);
+  r->next = d->readers;
+  __atomic_store_n(&d->readers, r, __ATOMIC_RELEASE);
+  Unlock_rcu(d);
+}
+
+// Call outside any read section; retired nodes still hazarded elsewhere are
+// handed to the domain.
+void Unregister_rcu(Domain_rcu *d, Reader_rcu *r) {
+  Scan_rcu(d, r);
+  Lock_rcu(d);
+  for (Reader_rcu **at = &d->readers; *at; at = &(*at)->next) {
+    if (*at == r) {
+      *at = r->next;
+      break;
+    }
+  }
+  while (r->retired) {
+    Head_rcu *h = r->retired;
+    r->retired = h->next;
+    h->next = d->orphans;
+    d->orphans = h;
+  }
+  Unlock_rcu(d);
+}
+
+//
+// Grace periods
+//
+
+static void Wait_rcu(Domain_rcu *d) {
+  // After this barrier every reader either sees the pointer we replaced
+  // before calling, or has its section entry visible to the scan below.
+  Fence_rcu(d);
+  unsigned long target = d->epoch + 2;
+  __atomic_store_n(&d->epoch, target, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (Reader_rcu *r = d->readers; r; r = r->next) {
+    // Readers still in a section entered before the bump hold an older epoch.
+    for (int spins = 0;; ++spins) {
+      unsigned long epoch = __atomic_load_n(&r->epoch, __ATOMIC_RELAXED);
+      if (!epoch || (long)(epoch - target) >= 0) {
+        break;
+      }
+      if (spins > 100) {
+        sched_yield_linux(); // it may be preempted on our CPU
+      } else {
+        __atomic_signal_fence(__ATOMIC_SEQ_CST);
+      }
+    }
+  }
+  // The readers' loads inside their sections complete before we free.
+  Fence_rcu(d);
+  d->grace_periods++;
+}
+
+// Returns once every read section that was running when it was called has
+// ended. Must not be called from inside a read section.
+void Synchronize_rcu(Domain_rcu *d) {
+  Lock_rcu(d);
+  Wait_rcu(d);
+  Unlock_rcu(d);
+}
+
+//
+// Deferred frees
+//
+
+static void Run_rcu(Head_rcu *h) {
+  while (h) {
+    Head_rcu *next = h->next;
+    h->free(h);
+    h = next;
+  }
+}
+
+// Queues `free(head)` for after a grace period; every BATCH_rcu calls, one
+// grace period runs for the whole batch (in the calling thread).
+void Defer_rcu(Domain_rcu *d, Head_rcu *head, void (*free)(Head_rcu *head)) {
+  head->free = free;
+  Lock_rcu(d);
+  head->next = d->deferred;
+  d->deferred = head;
+  Head_rcu *batch = 0;
+  if (++d->deferred_count >= BATCH_rcu) {
+    batch = d->deferred;
+    d->deferred = 0;
+    d->deferred_count = 0;
+    Wait_rcu(d);
+  }
+  Unlock_rcu(d);
+  Run_rcu(batch);
+}
+
+// Waits a grace period and runs every queued free.
+void Barrier_rcu(Domain_rcu *d) {
+  Lock_rcu(d);
+  Head_rcu *batch = d->deferred;
+  d->deferred = 0;
+  d->deferred_count = 0;
+  Wait_rcu(d);
+  Unlock_rcu(d);
+  Run_rcu(batch);
+}
+
+//
+// Hazard pointers
+//
+
+// Queues a node unlinked from its structure; it's freed by a later scan
+// once no hazard pointer covers it.
+void Retire_rcu(Domain_rcu *d, Reader_rcu *r, Head_rcu *head, void (*free)(Head_rcu *head)) {
+  head->free = free;
+  head->next = r->retired;
+  r->retired = head;
+  if (++r->retired_count >= BATCH_rcu) {
+    Scan_rcu(d, r);
+  }
+}
+
+static int Hazarded_rcu(const Domain_rcu *d, const void *p) {
+  for (const Reader_rcu *o = d->readers; o; o = o->next) {
+    for (int i = 0; i < HAZARDS_rcu; ++i) {
+      if (__atomic_load_n(&o->hazards[i], __ATOMIC_RELAXED) == p) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+// Frees the retired nodes (ours and orphans) no hazard pointer covers;
+// returns how many were freed.
+unsigned long Scan_rcu(Domain_rcu *d, Reader_rcu *r) {
+  Lock_rcu(d);
+  Head_rcu *candidates = r->retired;
+  Head_rcu *orphans = d->orphans;
+  r->retired = 0;
+  r->retired_count = 0;
+  d->orphans = 0;
+  // Readers' hazard stores made before our unlinking are visible now, and
+  // readers publishing later reload the pointer and see it gone.
+  Fence_rcu(d);
+  Head_rcu *freed = 0;
+  unsigned long count = 0;
+  for (int list = 0; list < 2; ++list) {
+    Head_rcu *h = list ? orphans : candidates;
+    while (h) {
+      Head_rcu *next = h->next;
+      if (Hazarded_rcu(d, h)) {
+        if (list) {
+          h->next = d->orphans;
+          d->orphans = h;
+        } else {
+          h->next = r->retired;
+          r->retired = h;
+          r->retired_count++;
+        }
+      } else {
+        h->next = freed;
+        freed = h;
+        count++;
+      }
+      h = next;
+    }
+  }
+  Unlock_rcu(d);
+  Run_rcu(freed);
+  return count;
+}
+
+#endif // C_RCU_IMPLEMENTATION
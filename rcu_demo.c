@@ -0,0 +1,263 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o rcu_demo rcu_demo.c -e main && ./rcu_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_THREAD_IMPLEMENTATION
+#include "thread.h"
+#define C_RCU_IMPLEMENTATION
+#include "rcu.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_group_linux(1); // exit_linux would only end the failing thread
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void SleepUs(unsigned long us) {
+  __kernel_timespec_linux ts = {0, (long long)us * 1000};
+  nanosleep_linux(&ts, 0);
+}
+
+//
+// A routing table snapshot: readers check it's consistent and not freed
+//
+#define POISON 0xdeadUL
+#define POOL   (1 << 16)
+
+typedef struct {
+  Head_rcu head; // first, for hazard pointers
+  unsigned long version;
+  unsigned long routes[7]; // version * 8 + i
+  unsigned long refs;      // only used by the refcount benchmark
+} Table;
+
+Table *pool;
+unsigned long poolNext;
+unsigned long freed;
+
+Table *NewTable(unsigned long version) {
+  unsigned long i = __atomic_fetch_add(&poolNext, 1, __ATOMIC_RELAXED);
+  Assert(i < POOL);
+  Table *t = &pool[i];
+  t->version = version;
+  for (int r = 0; r < 7; ++r) {
+    t->routes[r] = version * 8 + (unsigned long)r;
+  }
+  t->refs = 0;
+  return t;
+}
+
+// Poisons instead of unmapping, so a reader that was wrongly let through
+// fails its check instead of crashing somewhere unrelated.
+void FreeTable(Head_rcu *head) {
+  Table *t = (Table *)head;
+  t->version = POISON;
+  for (int r = 0; r < 7; ++r) {
+    t->routes[r] = POISON;
+  }
+  __atomic_fetch_add(&freed, 1, __ATOMIC_RELAXED);
+}
+
+unsigned long CheckTable(const Table *t) {
+  unsigned long v = t->version;
+  Assert(v != POISON);
+  for (int r = 0; r < 7; ++r) {
+    Assert(t->routes[r] == v * 8 + (unsigned long)r);
+  }
+  return v;
+}
+
+Domain_rcu domain;
+Table *current;
+int stop;
+
+enum { MODE_RCU, MODE_HAZARD, MODE_REFCOUNT, MODE_NONE, MODE_COUNT };
+const char *modeNames[MODE_COUNT] = {"rcu read section  ", "hazard pointer    ", "atomic refcount   ", "unprotected load  "};
+
+typedef struct {
+  Reader_rcu reader;
+  Thread_thread thread;
+  int mode;
+  int check;
+  unsigned long long reads;
+} __attribute__((aligned(64))) Worker;
+
+int Reader(void *arg) {
+  Worker *w = (Worker *)arg;
+  Register_rcu(&domain, &w->reader);
+  unsigned long long reads = 0;
+  unsigned long sink = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    for (int i = 0; i < 256; ++i) {
+      Table *t;
+      switch (w->mode) {
+      case MODE_RCU:
+        ReadLock_rcu(&domain, &w->reader);
+        t = (Table *)Dereference_rcu((void **)&current);
+        sink += w->check ? CheckTable(t) : t->routes[i & 3];
+        ReadUnlock_rcu(&domain, &w->reader);
+        break;
+      case MODE_HAZARD:
+        t = (Table *)Protect_rcu(&domain, &w->reader, 0, (void **)&current);
+        sink += w->check ? CheckTable(t) : t->routes[i & 3];
+        Clear_rcu(&w->reader, 0);
+        break;
+      case MODE_REFCOUNT: // what a shared_ptr-style read path does
+        t = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+        __atomic_fetch_add(&t->refs, 1, __ATOMIC_ACQUIRE);
+        sink += t->routes[i & 3];
+        __atomic_fetch_sub(&t->refs, 1, __ATOMIC_RELEASE);
+        break;
+      default:
+        t = __atomic_load_n(&current, __ATOMIC_RELAXED);
+        sink += t->routes[i & 3];
+        break;
+      }
+    }
+    reads += 256;
+  }
+  Unregister_rcu(&domain, &w->reader);
+  w->reads = reads;
+  return (int)(sink & 1);
+}
+
+// Runs `readers` reader threads in `mode` for `ms` while this thread
+// publishes a new table every `updateUs` microseconds; returns total reads.
+unsigned long long Run(Worker *workers, int readers, int mode, int check, unsigned long ms, unsigned long updateUs, unsigned long *updates) {
+  Assign_rcu((void **)&current, NewTable(0));
+  stop = 0;
+  for (int i = 0; i < readers; ++i) {
+    workers[i].mode = mode;
+    workers[i].check = check;
+    Assert(Spawn_thread(&workers[i].thread, Reader, &workers[i], 0) == 0);
+  }
+  Reader_rcu writer;
+  Register_rcu(&domain, &writer);
+  unsigned long n = 0;
+  unsigned long long deadline = Now_ns() + ms * 1000000ULL;
+  while (Now_ns() < deadline) {
+    SleepUs(updateUs);
+    Table *old = current;
+    Assign_rcu((void **)&current, NewTable(++n));
+    if (mode == MODE_RCU) {
+      Defer_rcu(&domain, &old->head, FreeTable);
+    } else if (mode == MODE_HAZARD) {
+      Retire_rcu(&domain, &writer, &old->head, FreeTable);
+    }
+  }
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+  unsigned long long reads = 0;
+  for (int i = 0; i < readers; ++i) {
+    Join_thread(&workers[i].thread);
+    reads += workers[i].reads;
+  }
+  Unregister_rcu(&domain, &writer);
+  Barrier_rcu(&domain);
+  Scan_rcu(&domain, &writer);
+  *updates = n;
+  return reads;
+}
+
+//
+// Frees never overtake readers: thousands of updates under checking readers
+//
+void Safety_demo(Worker *workers) {
+  for (int mode = MODE_RCU; mode <= MODE_HAZARD; ++mode) {
+    unsigned long updates;
+    unsigned long before = freed;
+    unsigned long long reads = Run(workers, 4, mode, true, 300, 20, &updates);
+    Assert(reads > 0 && updates > BATCH_rcu);
+    Assert(freed - before == updates); // every replaced table, and only those
+    CheckTable(current);
+  }
+  Print(STDOUT_FILENO_linux, domain.fences ? "membarrier unavailable, readers fence themselves\n" : "membarrier private expedited: readers run fence-free\n");
+  Print(STDOUT_FILENO_linux, "rcu deferred frees and hazard pointer retires under readers: ok\n");
+}
+
+//
+// Read scalability: reads/s per protection scheme as readers are added
+//
+void Bench_demo(Worker *workers) {
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+  Assert(sched_getaffinity_linux(0, sizeof(mask), mask) > 0);
+  int cpus = 0;
+  for (int i = 0; i < 1024; ++i) {
+    cpus += (int)((mask[i / (8 * sizeof(unsigned long))] >> (i % (8 * sizeof(unsigned long)))) & 1);
+  }
+  int counts[4] = {1, 2, cpus > 4 ? cpus / 2 : 4, cpus > 8 ? cpus : 8};
+  Print(STDOUT_FILENO_linux, "\nreads/s (millions), a writer publishing a new table every 1 ms:\nreaders            ");
+  for (int c = 0; c < 4; ++c) {
+    PrintU64(STDOUT_FILENO_linux, counts[c]);
+    Print(STDOUT_FILENO_linux, c < 3 ? "\t" : "\n");
+  }
+  for (int mode = 0; mode < MODE_COUNT; ++mode) {
+    Print(STDOUT_FILENO_linux, modeNames[mode]);
+    for (int c = 0; c < 4; ++c) {
+      unsigned long updates;
+      poolNext = 0;
+      unsigned long long reads = Run(workers, counts[c], mode, false, 500, 1000, &updates);
+      PrintU64(STDOUT_FILENO_linux, reads * 2 / 1000000); // over 500 ms
+      Print(STDOUT_FILENO_linux, c < 3 ? "\t" : "\n");
+    }
+  }
+  Print(STDOUT_FILENO_linux, "grace periods run: ");
+  PrintU64(STDOUT_FILENO_linux, domain.grace_periods);
+  Print(STDOUT_FILENO_linux, "\n");
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  long ret = mmap_linux(0, POOL * sizeof(Table), PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  Assert(ret > 0 || ret < -4095);
+  pool = (Table *)ret;
+  Assert(Init_rcu(&domain) == 0);
+  static Worker workers[1024];
+  Safety_demo(workers);
+  Bench_demo(workers);
+  exit_linux(0);
+  return 0;
+}
@@ -0,0 +1,317 @@
+#ifndef C_RT_HEADER
+#define C_RT_HEADER
+
+// === rt.h: low-latency thread profiles & wakeup jitter measurement ==========
+//
+// Contents:
+//   * profiles                     (jump: Apply_rt)
+//   * jitter                       (jump: MeasureJitter_rt)
+//
+// Usage:
+//   rt.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/rt.h" // use as header file
+//
+//   #define C_RT_IMPLEMENTATION
+//   #include "c/rt.h" // use as implementation file
+//
+//   Apply_rt configures the calling thread in one call, in this order:
+//     1. mlockall_linux(MCL_CURRENT | MCL_FUTURE | MCL_ONFAULT)
+//     2. prefault `stack_bytes` below the stack pointer and the `heap` range,
+//        so they're faulted (and locked) now, not on the hot path
+//     3. prctl_linux(PR_SET_TIMERSLACK, 1): timers fire when asked, not up to
+//        50 us later so the kernel can batch wakeups
+//     4. pin to `cpu` (CPU_ISOLATED_rt picks the first isolcpus= CPU we may use)
+//     5. SCHED_FIFO via sched_setscheduler_linux, or SCHED_DEADLINE via
+//        sched_setattr_linux
+//   Every step is attempted even when an earlier one fails; the report says
+//   which were applied and why the others weren't. Typical failures: EPERM
+//   without CAP_SYS_NICE / RLIMIT_RTPRIO, ENOMEM past RLIMIT_MEMLOCK, and
+//   SCHED_DEADLINE refusing pinned threads (it needs the whole root domain,
+//   use an exclusive cpuset instead of a pin).
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "rt.h depends on linux.h, include it first"
+#endif
+
+#define CPU_NONE_rt     -1 // leave the affinity alone
+#define CPU_ISOLATED_rt -2
+
+enum {
+  STEP_MLOCK_rt,
+  STEP_STACK_rt,
+  STEP_HEAP_rt,
+  STEP_TIMERSLACK_rt,
+  STEP_AFFINITY_rt,
+  STEP_SCHEDULER_rt,
+  STEP_COUNT_rt,
+};
+
+typedef struct {
+  int policy;   // SCHED_FIFO_linux, SCHED_DEADLINE_linux, or SCHED_NORMAL_linux to keep ours
+  int priority; // SCHED_FIFO: 1..99
+  unsigned long long runtime_ns; // SCHED_DEADLINE: runtime <= deadline <= period
+  unsigned long long deadline_ns;
+  unsigned long long period_ns;
+  int cpu;      // CPU_NONE_rt, CPU_ISOLATED_rt or a CPU number
+  int lock_memory;
+  int no_timer_slack;
+  unsigned long stack_bytes;
+  void *heap;
+  unsigned long heap_bytes;
+} Profile_rt;
+
+typedef struct {
+  unsigned int requested; // 1 << STEP_*_rt
+  unsigned int applied;
+  long errors[STEP_COUNT_rt]; // -errno of each failed step
+  int cpu; // where we got pinned, -1 if not
+} Report_rt;
+
+// Wakeup latency histogram: bucket i counts latencies in [2^i, 2^(i+1)) ns.
+#define BUCKETS_rt 32
+
+typedef struct {
+  unsigned long long samples;
+  unsigned long long total_ns;
+  unsigned long long min_ns;
+  unsigned long long max_ns;
+  unsigned int buckets[BUCKETS_rt];
+} Jitter_rt;
+
+//
+// Profiles
+//
+long Apply_rt(const Profile_rt *p, Report_rt *r);
+const char *StepName_rt(int step);
+long IsolatedCpu_rt(void);
+//
+// Jitter
+//
+long MeasureJitter_rt(Jitter_rt *j, unsigned long long period_ns, unsigned long count);
+unsigned long long Percentile_rt(const Jitter_rt *j, unsigned int permille);
+
+#endif // C_RT_HEADER
+#ifdef C_RT_IMPLEMENTATION
+
+//
+// Profiles
+//
+
+const char *StepName_rt(int step) {
+  static const char *names[STEP_COUNT_rt] = {"mlockall", "stack prefault", "heap prefault", "timer slack", "affinity", "scheduler"};
+  return step >= 0 && step < STEP_COUNT_rt ? names[step] : "?";
+}
+
+static int Allowed_rt(int cpu) {
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+  if (cpu < 0 || cpu >= 1024 || sched_getaffinity_linux(0, sizeof(mask), mask) < 0) {
+    return 0;
+  }
+  return (mask[cpu / (8 * sizeof(unsigned long))] >> (cpu % (8 * sizeof(unsigned long)))) & 1;
+}
+
+// The first CPU isolated from the scheduler (isolcpus=) that our affinity mask
+// allows, -ENOENT when there is none.
+long IsolatedCpu_rt(void) {
+  char buf[512];
+  long fd = openat_linux(AT_FDCWD_linux, "/sys/devices/system/cpu/isolated", O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  long n = read_linux((unsigned int)fd, buf, sizeof(buf) - 1);
+  close_linux((unsigned int)fd);
+  buf[n > 0 ? n : 0] = 0;
+  for (const char *s = buf; *s >= '0' && *s <= '9';) {
+    long lo = 0;
+    long hi;
+    while (*s >= '0' && *s <= '9') {
+      lo = lo * 10 + (*s++ - '0');
+    }
+    hi = lo;
+    if (*s == '-') {
+      hi = 0;
+      for (++s; *s >= '0' && *s <= '9'; ++s) {
+        hi = hi * 10 + (*s - '0');
+      }
+    }
+    for (long cpu = lo; cpu <= hi; ++cpu) {
+      if (Allowed_rt((int)cpu)) {
+        return cpu;
+      }
+    }
+    if (*s == ',') {
+      ++s;
+    }
+  }
+  return -ENOENT_linux;
+}
+
+// Touches `bytes` of stack below our frame; noinline so the frame really is
+// below the caller's.
+__attribute__((noinline)) static void PrefaultStack_rt(unsigned long bytes) {
+  volatile char *p = (volatile char *)__builtin_alloca(bytes);
+  for (unsigned long i = 0; i < bytes; i += 4096) {
+    p[i] = 0;
+  }
+  p[bytes - 1] = 0;
+}
+
+static long PrefaultHeap_rt(void *heap, unsigned long bytes) {
+  unsigned long start = (unsigned long)heap & ~4095UL;
+  unsigned long end = ((unsigned long)heap + bytes + 4095) & ~4095UL;
+  long ret = madvise_linux((void *)start, end - start, MADV_POPULATE_WRITE_linux);
+  if (ret != -EINVAL_linux) { // before 5.14: touch it ourselves
+    return ret;
+  }
+  for (volatile char *p = (volatile char *)heap; p < (volatile char *)heap + bytes; p += 4096) {
+    *p = *p;
+  }
+  return 0;
+}
+
+static void Step_rt(Report_rt *r, int step, long ret) {
+  r->requested |= 1U << step;
+  if (ret < 0) {
+    r->errors[step] = ret;
+  } else {
+    r->applied |= 1U << step;
+  }
+}
+
+// Applies `p` to the calling thread. Returns 0 when every requested step
+// was applied, otherwise the error of the first one that wasn't; `r` has
+// the details.
+long Apply_rt(const Profile_rt *p, Report_rt *r) {
+  for (int i = 0; i < STEP_COUNT_rt; ++i) {
+    r->errors[i] = 0;
+  }
+  r->requested = 0;
+  r->applied = 0;
+  r->cpu = -1;
+  // Lock first: with MCL_ONFAULT the prefaulted pages below stay resident.
+  if (p->lock_memory) {
+    long ret = mlockall_linux(MCL_CURRENT_linux | MCL_FUTURE_linux | MCL_ONFAULT_linux);
+    if (ret == -EINVAL_linux) { // before 4.4 there's no MCL_ONFAULT
+      ret = mlockall_linux(MCL_CURRENT_linux | MCL_FUTURE_linux);
+    }
+    Step_rt(r, STEP_MLOCK_rt, ret);
+  }
+  if (p->stack_bytes) {
+    PrefaultStack_rt(p->stack_bytes);
+    Step_rt(r, STEP_STACK_rt, 0);
+  }
+  if (p->heap && p->heap_bytes) {
+    Step_rt(r, STEP_HEAP_rt, PrefaultHeap_rt(p->heap, p->heap_bytes));
+  }
+  if (p->no_timer_slack) {
+    Step_rt(r, STEP_TIMERSLACK_rt, prctl_linux(PR_SET_TIMERSLACK_linux, 1, 0, 0, 0)); // 0 would mean "default"
+  }
+  if (p->cpu != CPU_NONE_rt) {
+    long cpu = p->cpu == CPU_ISOLATED_rt ? IsolatedCpu_rt() : p->cpu;
+    long ret = cpu;
+    if (cpu >= 0 && cpu < 1024) {
+      unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+      mask[cpu / (8 * sizeof(unsigned long))] = 1UL << (cpu % (8 * sizeof(unsigned long)));
+      ret = sched_setaffinity_linux(0, sizeof(mask), mask);
+    } else if (cpu >= 0) {
+      ret = -EINVAL_linux;
+    }
+    r->cpu = ret < 0 ? -1 : (int)cpu;
+    Step_rt(r, STEP_AFFINITY_rt, ret);
+  }
+  if (p->policy == SCHED_FIFO_linux) {
+    sched_param_linux param = {p->priority};
+    Step_rt(r, STEP_SCHEDULER_rt, sched_setscheduler_linux(0, SCHED_FIFO_linux, &param));
+  } else if (p->policy == SCHED_DEADLINE_linux) {
+    sched_attr_linux attr = {0};
+    attr.size = sizeof(attr);
+    attr.sched_policy = SCHED_DEADLINE_linux;
+    attr.sched_runtime = p->runtime_ns;
+    attr.sched_deadline = p->deadline_ns;
+    attr.sched_period = p->period_ns;
+    Step_rt(r, STEP_SCHEDULER_rt, sched_setattr_linux(0, &attr, 0));
+  } else if (p->policy != SCHED_NORMAL_linux) {
+    Step_rt(r, STEP_SCHEDULER_rt, -EINVAL_linux);
+  }
+  for (int i = 0; i < STEP_COUNT_rt; ++i) {
+    if (r->errors[i]) {
+      return r->errors[i];
+    }
+  }
+  return 0;
+}
+
+//
+// Jitter
+//
+
+// Sleeps until `count` absolute deadlines `period_ns` apart on
+// CLOCK_MONOTONIC and records how late each wakeup was. Absolute deadlines
+// keep the schedule from drifting by the latency itself.
+long MeasureJitter_rt(Jitter_rt *j, unsigned long long period_ns, unsigned long count) {
+  j->samples = 0;
+  j->total_ns = 0;
+  j->min_ns = ~0ULL;
+  j->max_ns = 0;
+  for (int i = 0; i < BUCKETS_rt; ++i) {
+    j->buckets[i] = 0;
+  }
+  __kernel_timespec_linux next;
+  long ret = clock_gettime64_linux(CLOCK_MONOTONIC_linux, &next);
+  if (ret < 0) {
+    return ret;
+  }
+  for (unsigned long i = 0; i < count; ++i) {
+    next.tv_nsec += (long long)period_ns;
+    while (next.tv_nsec >= 1000000000) { // no 64-bit division on 32-bit targets
+      next.tv_nsec -= 1000000000;
+      next.tv_sec++;
+    }
+    ret = clock_nanosleep_time64_linux(CLOCK_MONOTONIC_linux, TIMER_ABSTIME_linux, &next, 0);
+    if (ret == -EINTR_linux) {
+      continue;
+    }
+    if (ret < 0) {
+      return ret;
+    }
+    __kernel_timespec_linux now;
+    clock_gettime64_linux(CLOCK_MONOTONIC_linux, &now);
+    long long late = (now.tv_sec - next.tv_sec) * 1000000000LL + (now.tv_nsec - next.tv_nsec);
+    unsigned long long ns = late > 0 ? (unsigned long long)late : 0;
+    int bucket = 0;
+    while (bucket < BUCKETS_rt - 1 && (ns >> (bucket + 1))) {
+      ++bucket;
+    }
+    j->buckets[bucket]++;
+    j->samples++;
+    j->total_ns += ns;
+    j->min_ns = ns < j->min_ns ? ns : j->min_ns;
+    j->max_ns = ns > j->max_ns ? ns : j->max_ns;
+  }
+  return (long)j->samples;
+}
+
+// Upper bound of the bucket holding the given percentile (999 = p99.9).
+unsigned long long Percentile_rt(const Jitter_rt *j, unsigned int permille) {
+  unsigned long long seen = 0;
+  for (int i = 0; i < BUCKETS_rt; ++i) {
+    seen += j->buckets[i];
+    if (seen * 1000 >= j->samples * permille) {
+      unsigned long long bound = (2ULL << i) - 1;
+      return bound < j->max_ns ? bound : j->max_ns;
+    }
+  }
+  return j->max_ns;
+}
+
+#endif // C_RT_IMPLEMENTATION
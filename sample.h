@@ -0,0 +1,571 @@
+#ifndef C_SAMPLE_HEADER
+#define C_SAMPLE_HEADER
+
+// === sample.h: remote stack & memory sampler over process_vm_readv =========
+//
+// Contents:
+//   * sampler                      (jump: Init_sample)
+//   * snapshots                    (jump: Decode_sample)
+//
+// Usage:
+//   sample.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/sample.h" // use as header file
+//
+//   #define C_SAMPLE_IMPLEMENTATION
+//   #include "c/sample.h" // use as implementation file
+//
+//   Signal-based profilers interrupt the target, and ptrace stops it. The
+//   sampler does neither: it reads another process's memory from outside
+//   with process_vm_readv_linux, which takes many scattered ranges in one
+//   call. Each sample gathers the top of every thread's stack and the data
+//   regions registered with Watch_sample, such as a request-state table,
+//   into one buffer with a single batched iovec_linux read, then appends
+//   one compact snapshot record to a file for offline analysis.
+//
+//     static Sampler_sample s;
+//     Init_sample(&s, pid, 16 << 10, 4 << 20); // 16 KiB per stack
+//     Watch_sample(&s, table_address, table_bytes, 1);
+//     for (;;) {
+//       Sample_sample(&s, fd);
+//       nanosleep_linux(&interval, 0);
+//     }
+//
+//   Stack pointers come from /proc/<pid>/task/<tid>/syscall, which gives
+//   the stack and instruction pointers of a thread blocked in the kernel
+//   without stopping it; /proc/<pid>/task/<tid>/stat no longer reports
+//   them (kstkesp reads 0 since 4.x), and PTRACE_GETREGSET needs a stopped
+//   tracee. The files stay open and are re-read with one pread each per
+//   sample. A thread running in userspace reports "running": it is read
+//   from its last known stack pointer, or the main thread from the stat
+//   startstack. The stack mapping around each pointer comes from
+//   /proc/<pid>/maps when Threads_sample rescans, which Sample_sample does
+//   itself when a thread exits or leaves its stack; call Threads_sample to
+//   pick up new threads.
+//
+//   A record is a Header_sample, one Entry_sample per stack or region, then
+//   the bytes read for each entry, each padded to 8 bytes. Entries whose
+//   bytes match the previous record's are flagged UNCHANGED_sample and
+//   carry no bytes: a mostly idle process costs little more than its
+//   entries. Reading needs the same permission as ptrace attach, but
+//   nothing is stopped.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "sample.h depends on linux.h, include it first"
+#endif
+
+#define THREADS_sample 256     // threads sampled at most
+#define REGIONS_sample 64      // watched data regions at most
+#define TEXT_sample    65536   // /proc read buffer
+#define REDZONE_sample 128     // bytes below the stack pointer (x86-64 red zone)
+#define MAGIC_sample   0x4c504d53U // "SMPL"
+
+#define RUNNING_sample   1 // thread was running: stack read from its last known pointer
+#define UNCHANGED_sample 2 // same bytes as the entry in the previous record
+#define FAULT_sample     4 // the read stopped short: length is what was read
+#define GONE_sample      8 // thread exited since the last rescan
+#define REGION_sample    16 // a watched data region, not a stack
+
+typedef struct {
+  unsigned int magic; // MAGIC_sample
+  unsigned int size;  // the whole record, this header included
+  unsigned long long time_ns; // CLOCK_MONOTONIC
+  int pid;
+  unsigned short entries;
+  unsigned short reserved;
+} Header_sample;
+
+typedef struct {
+  unsigned long long address; // of the bytes read in the target
+  unsigned int length;        // bytes read
+  unsigned int flags;         // RUNNING_sample | UNCHANGED_sample | ...
+  int id;                     // tid, or the region's id
+  int nr;                     // syscall the thread is blocked in, -1 if none
+  unsigned long long sp;
+  unsigned long long pc;
+} Entry_sample;
+
+typedef struct {
+  int tid;
+  int fd;                    // /proc/<pid>/task/<tid>/syscall
+  int seen;
+  int nr;
+  unsigned long long sp, pc;
+  unsigned long long stack_lo, stack_hi; // mapping holding sp, 0 if unknown
+} Thread_sample;
+
+typedef struct {
+  unsigned long long address;
+  unsigned long long size;
+  int id;
+} Region_sample;
+
+typedef struct {
+  int pid;
+  int stale; // rescan before the next sample
+  unsigned long depth;    // stack bytes read per thread
+  unsigned long capacity; // bytes read per sample at most
+  unsigned long long start_stack; // main thread, from stat
+  Thread_sample threads[THREADS_sample];
+  unsigned int thread_count;
+  Region_sample regions[REGIONS_sample];
+  unsigned int region_count;
+  Entry_sample entries[THREADS_sample + REGIONS_sample];
+  Entry_sample previous[THREADS_sample + REGIONS_sample];
+  unsigned int offsets[THREADS_sample + REGIONS_sample]; // of each previous entry's bytes
+  unsigned int entry_count, previous_count;
+  iovec_linux local[THREADS_sample + REGIONS_sample];
+  iovec_linux remote[THREADS_sample + REGIONS_sample];
+  iovec_linux out[THREADS_sample + REGIONS_sample + 2];
+  unsigned char *buffers[2]; // this sample's bytes and the previous one's
+  unsigned int current;
+  char *text;
+  unsigned long long samples;
+  unsigned long long reads;   // process_vm_readv calls
+  unsigned long long written; // record bytes
+  unsigned long long unchanged;
+} Sampler_sample;
+
+//
+// Sampler
+//
+long Init_sample(Sampler_sample *s, int pid, unsigned long depth, unsigned long capacity);
+long Watch_sample(Sampler_sample *s, unsigned long long address, unsigned long long size, int id);
+long Threads_sample(Sampler_sample *s);
+long Sample_sample(Sampler_sample *s, int fd);
+void Free_sample(Sampler_sample *s);
+//
+// Snapshots
+//
+long Decode_sample(const void *data, unsigned long size, const Header_sample **header, const Entry_sample **entries, const unsigned char **bytes);
+
+#endif // C_SAMPLE_HEADER
+#ifdef C_SAMPLE_IMPLEMENTATION
+
+static char *Append_sample(char *p, const char *s) {
+  while (*s) {
+    *p++ = *s++;
+  }
+  *p = 0;
+  return p;
+}
+
+static char *AppendNumber_sample(char *p, unsigned int value) {
+  char digits[12];
+  int n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  while (n) {
+    *p++ = digits[--n];
+  }
+  *p = 0;
+  return p;
+}
+
+// Parses a decimal or 0x-prefixed hex number, returns the end.
+static const char *Number_sample(const char *s, unsigned long long *value) {
+  *value = 0;
+  if (s[0] == '0' && s[1] == 'x') {
+    for (s += 2;; ++s) {
+      unsigned int d = *s >= '0' && *s <= '9' ? (unsigned int)(*s - '0') : *s >= 'a' && *s <= 'f' ? (unsigned int)(*s - 'a' + 10) : 16;
+      if (d == 16) {
+        return s;
+      }
+      *value = *value << 4 | d;
+    }
+  }
+  while (*s >= '0' && *s <= '9') {
+    *value = *value * 10 + (unsigned int)(*s++ - '0');
+  }
+  return s;
+}
+
+static unsigned long long Now_sample(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static char *Proc_sample(const Sampler_sample *s, char *path, int tid) {
+  char *end = AppendNumber_sample(Append_sample(path, "/proc/"), (unsigned int)s->pid);
+  if (tid) {
+    end = AppendNumber_sample(Append_sample(end, "/task/"), (unsigned int)tid);
+  }
+  return end;
+}
+
+long Init_sample(Sampler_sample *s, int pid, unsigned long depth, unsigned long capacity) {
+  s->pid = pid;
+  s->depth = depth;
+  s->capacity = capacity & ~7UL; // entries start 8-byte aligned
+  s->thread_count = s->region_count = s->entry_count = s->previous_count = 0;
+  s->current = 0;
+  s->samples = s->reads = s->written = s->unchanged = 0;
+  long ret = mmap_linux(0, 2 * s->capacity + TEXT_sample, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  s->buffers[0] = (unsigned char *)ret;
+  s->buffers[1] = s->buffers[0] + s->capacity;
+  s->text = (char *)(s->buffers[1] + s->capacity);
+  s->stale = 1;
+  return Threads_sample(s);
+}
+
+long Watch_sample(Sampler_sample *s, unsigned long long address, unsigned long long size, int id) {
+  if (s->region_count == REGIONS_sample) {
+    return -ENOSPC_linux;
+  }
+  s->regions[s->region_count++] = (Region_sample){address, size, id};
+  return 0;
+}
+
+// Refreshes a thread's pointers from its syscall file: "nr args... sp pc",
+// "-1 sp pc" when blocked outside a syscall, or "running".
+static long Pointers_sample(Sampler_sample *s, Thread_sample *t) {
+  char *text = s->text;
+  long got = pread64_linux((unsigned int)t->fd, text, 255, 0);
+  if (got <= 0) {
+    return got < 0 ? got : -ESRCH_linux;
+  }
+  text[got] = 0;
+  if (text[0] == 'r') {
+    t->nr = -1;
+    return RUNNING_sample;
+  }
+  unsigned long long value, last[2] = {0, 0};
+  const char *p = text;
+  int negative = *p == '-';
+  p = Number_sample(p + negative, &value);
+  t->nr = negative ? -1 : (int)value;
+  while (*p == ' ') {
+    p = Number_sample(p + 1, &value);
+    last[0] = last[1];
+    last[1] = value;
+  }
+  t->sp = last[0];
+  t->pc = last[1];
+  return 0;
+}
+
+// Reads a /proc file into s->text in chunks, calling line() on each line.
+static long Lines_sample(Sampler_sample *s, const char *path, void (*line)(Sampler_sample *, const char *)) {
+  long fd = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  unsigned long kept = 0;
+  for (;;) {
+    long got = read_linux((unsigned int)fd, s->text + kept, TEXT_sample - 1 - kept);
+    if (got <= 0) {
+      break;
+    }
+    unsigned long end = kept + (unsigned long)got, start = 0;
+    for (unsigned long i = 0; i < end; ++i) {
+      if (s->text[i] == '\n') {
+        s->text[i] = 0;
+        line(s, s->text + start);
+        start = i + 1;
+      }
+    }
+    kept = end - start;
+    for (unsigned long i = 0; i < kept; ++i) {
+      s->text[i] = s->text[start + i];
+    }
+    if (kept == TEXT_sample - 1) {
+      kept = 0; // a line longer than the buffer: drop it
+    }
+  }
+  close_linux((unsigned int)fd);
+  return 0;
+}
+
+// "lo-hi perms ...": the mapping each thread's stack pointer falls in.
+static void Map_sample(Sampler_sample *s, const char *line) {
+  unsigned long long lo = 0, hi = 0;
+  const char *p = line;
+  for (; *p && *p != '-'; ++p) {
+    lo = lo << 4 | (unsigned long long)(*p <= '9' ? *p - '0' : *p - 'a' + 10);
+  }
+  for (p += *p == '-'; *p && *p != ' '; ++p) {
+    hi = hi << 4 | (unsigned long long)(*p <= '9' ? *p - '0' : *p - 'a' + 10);
+  }
+  for (unsigned int i = 0; i < s->thread_count; ++i) {
+    Thread_sample *t = &s->threads[i];
+    unsigned long long sp = t->sp ? t->sp : t->tid == s->pid ? s->start_stack : 0;
+    if (sp >= lo && sp < hi) {
+      t->stack_lo = lo;
+      t->stack_hi = hi;
+    }
+  }
+}
+
+// Field 28 of stat, startstack, after the parenthesized comm.
+static long StartStack_sample(Sampler_sample *s) {
+  char path[64];
+  Append_sample(Proc_sample(s, path, 0), "/stat");
+  long fd = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  long got = read_linux((unsigned int)fd, s->text, TEXT_sample - 1);
+  close_linux((unsigned int)fd);
+  if (got <= 0) {
+    return got < 0 ? got : -ESRCH_linux;
+  }
+  s->text[got] = 0;
+  const char *p = s->text + got;
+  while (p > s->text && *p != ')') {
+    --p;
+  }
+  for (int field = 2; *p && field < 28; ++p) {
+    field += *p == ' ';
+  }
+  Number_sample(p, &s->start_stack);
+  return 0;
+}
+
+long Threads_sample(Sampler_sample *s) {
+  char path[64];
+  char *end = Append_sample(Proc_sample(s, path, 0), "/task");
+  long dir = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (dir < 0) {
+    return dir;
+  }
+  for (unsigned int i = 0; i < s->thread_count; ++i) {
+    s->threads[i].seen = 0;
+  }
+  for (;;) {
+    long got = getdents64_linux((unsigned int)dir, (linux_dirent64_linux *)s->text, TEXT_sample);
+    if (got <= 0) {
+      break;
+    }
+    for (long at = 0; at < got;) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(s->text + at);
+      at += d->d_reclen;
+      unsigned long long tid;
+      if (*Number_sample(d->d_name, &tid) || !tid) {
+        continue; // "." and ".."
+      }
+      unsigned int i = 0;
+      while (i < s->thread_count && s->threads[i].tid != (int)tid) {
+        ++i;
+      }
+      if (i == s->thread_count) {
+        if (i == THREADS_sample) {
+          continue;
+        }
+        Append_sample(AppendNumber_sample(Append_sample(end, "/"), (unsigned int)tid), "/syscall");
+        long fd = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+        *end = 0;
+        if (fd < 0) {
+          continue;
+        }
+        s->threads[i] = (Thread_sample){(int)tid, (int)fd, 0, -1, 0, 0, 0, 0};
+        ++s->thread_count;
+      }
+      s->threads[i].seen = 1;
+    }
+  }
+  close_linux((unsigned int)dir);
+
+  // Drop the threads that exited, keeping the order of the rest
+  unsigned int kept = 0;
+  for (unsigned int i = 0; i < s->thread_count; ++i) {
+    if (s->threads[i].seen && Pointers_sample(s, &s->threads[i]) >= 0) {
+      s->threads[i].stack_lo = s->threads[i].stack_hi = 0;
+      s->threads[kept++] = s->threads[i];
+    } else {
+      close_linux((unsigned int)s->threads[i].fd);
+    }
+  }
+  s->thread_count = kept;
+  if (!kept) {
+    return -ESRCH_linux;
+  }
+  StartStack_sample(s);
+  Append_sample(Proc_sample(s, path, 0), "/maps");
+  long ret = Lines_sample(s, path, Map_sample);
+  if (ret < 0) {
+    return ret;
+  }
+  s->stale = 0;
+  return kept;
+}
+
+// One process_vm_readv for the whole batch in the usual case. A range that
+// faults ends the call there: record how much of it arrived and go on
+// with the next one.
+static long Gather_sample(Sampler_sample *s, const unsigned int *which, unsigned int count) {
+  unsigned int i = 0;
+  while (i < count) {
+    long got = process_vm_readv_linux(s->pid, s->local + i, count - i, s->remote + i, count - i, 0);
+    ++s->reads;
+    if (got < 0 && got != -EFAULT_linux) {
+      return got;
+    }
+    unsigned long left = got < 0 ? 0 : (unsigned long)got;
+    while (i < count && left >= s->local[i].iov_len) {
+      left -= s->local[i].iov_len;
+      ++i;
+    }
+    if (i < count) {
+      Entry_sample *e = &s->entries[which[i]];
+      e->length = (unsigned int)left;
+      e->flags |= FAULT_sample;
+      ++i;
+    }
+  }
+  return 0;
+}
+
+static int Same_sample(const unsigned char *a, const unsigned char *b, unsigned long len) {
+  for (unsigned long i = 0; i < len; ++i) {
+    if (a[i] != b[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+long Sample_sample(Sampler_sample *s, int fd) {
+  if (s->stale) {
+    long ret = Threads_sample(s);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  unsigned char *buffer = s->buffers[s->current];
+  unsigned long used = 0;
+  unsigned int n = 0, iovs = 0;
+  unsigned int which[THREADS_sample + REGIONS_sample];
+  unsigned int offsets[THREADS_sample + REGIONS_sample];
+  unsigned long long now = Now_sample();
+
+  for (unsigned int i = 0; i < s->thread_count; ++i) {
+    Thread_sample *t = &s->threads[i];
+    Entry_sample *e = &s->entries[n];
+    long state = Pointers_sample(s, t);
+    *e = (Entry_sample){0, 0, 0, t->tid, t->nr, t->sp, t->pc};
+    offsets[n++] = (unsigned int)used;
+    if (state < 0) {
+      e->flags = GONE_sample;
+      s->stale = 1;
+      continue;
+    }
+    e->flags = (unsigned int)state;
+    unsigned long long sp = t->sp ? t->sp : t->tid == s->pid ? s->start_stack : 0;
+    if (!t->stack_hi || sp < t->stack_lo || sp >= t->stack_hi) {
+      s->stale |= t->sp != 0; // the pointer moved to another mapping
+      continue;
+    }
+    unsigned long long from = sp - REDZONE_sample > t->stack_lo ? sp - REDZONE_sample : t->stack_lo;
+    unsigned long long to = from + s->depth < t->stack_hi ? from + s->depth : t->stack_hi;
+    unsigned long long length = to - from;
+    if (length > s->capacity - used) {
+      length = s->capacity - used;
+    }
+    e->address = from;
+    e->length = (unsigned int)length;
+    used += (unsigned long)(length + 7) & ~7UL;
+  }
+  for (unsigned int i = 0; i < s->region_count; ++i) {
+    Region_sample *r = &s->regions[i];
+    Entry_sample *e = &s->entries[n];
+    unsigned long long length = r->size < s->capacity - used ? r->size : s->capacity - used;
+    *e = (Entry_sample){r->address, (unsigned int)length, REGION_sample, r->id, -1, 0, 0};
+    offsets[n++] = (unsigned int)used;
+    used += (unsigned long)(length + 7) & ~7UL;
+  }
+  for (unsigned int i = 0; i < n; ++i) {
+    if (s->entries[i].length) {
+      s->local[iovs] = (iovec_linux){buffer + offsets[i], s->entries[i].length};
+      s->remote[iovs] = (iovec_linux){(void *)(unsigned long)s->entries[i].address, s->entries[i].length};
+      which[iovs++] = i;
+    }
+  }
+  long ret = Gather_sample(s, which, iovs);
+  if (ret < 0) {
+    return ret;
+  }
+
+  // Record: header, entries, then the bytes that changed
+  Header_sample header = {MAGIC_sample, 0, now, s->pid, (unsigned short)n, 0};
+  unsigned int outs = 0;
+  unsigned long size = sizeof(header) + n * sizeof(Entry_sample);
+  s->out[outs++] = (iovec_linux){&header, sizeof(header)};
+  s->out[outs++] = (iovec_linux){s->entries, n * sizeof(Entry_sample)};
+  const unsigned char *before = s->buffers[!s->current];
+  for (unsigned int i = 0; i < n; ++i) {
+    Entry_sample *e = &s->entries[i];
+    const Entry_sample *p = i < s->previous_count ? &s->previous[i] : 0;
+    if (!e->length) {
+      continue;
+    }
+    if (p && p->id == e->id && p->address == e->address && p->length == e->length &&
+        Same_sample(buffer + offsets[i], before + s->offsets[i], e->length)) {
+      e->flags |= UNCHANGED_sample;
+      ++s->unchanged;
+      continue;
+    }
+    unsigned long padded = (e->length + 7UL) & ~7UL;
+    for (unsigned long k = offsets[i] + e->length; k < offsets[i] + padded; ++k) {
+      buffer[k] = 0;
+    }
+    s->out[outs++] = (iovec_linux){buffer + offsets[i], padded};
+    size += padded;
+  }
+  header.size = (unsigned int)size;
+  ret = writev_linux((unsigned long)fd, s->out, outs);
+  if (ret < 0) {
+    return ret;
+  }
+
+  for (unsigned int i = 0; i < n; ++i) {
+    s->previous[i] = s->entries[i];
+    s->previous[i].flags &= ~UNCHANGED_sample;
+    s->offsets[i] = offsets[i];
+  }
+  s->previous_count = n;
+  s->entry_count = n;
+  s->current ^= 1;
+  ++s->samples;
+  s->written += (unsigned long long)ret;
+  return ret;
+}
+
+void Free_sample(Sampler_sample *s) {
+  for (unsigned int i = 0; i < s->thread_count; ++i) {
+    close_linux((unsigned int)s->threads[i].fd);
+  }
+  s->thread_count = 0;
+  munmap_linux(s->buffers[0], 2 * s->capacity + TEXT_sample);
+}
+
+//
+// Snapshots
+//
+long Decode_sample(const void *data, unsigned long size, const Header_sample **header, const Entry_sample **entries, const unsigned char **bytes) {
+  const Header_sample *h = (const Header_sample *)data;
+  if (size < sizeof(*h) || h->magic != MAGIC_sample || h->size > size ||
+      h->size < sizeof(*h) + h->entries * sizeof(Entry_sample)) {
+    return -EINVAL_linux;
+  }
+  *header = h;
+  *entries = (const Entry_sample *)(h + 1);
+  *bytes = (const unsigned char *)(*entries + h->entries);
+  return h->size;
+}
+
+#endif // C_SAMPLE_IMPLEMENTATION
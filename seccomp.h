@@ -0,0 +1,299 @@
+#ifndef C_SECCOMP_HEADER
+#define C_SECCOMP_HEADER
+
+// === seccomp.h: seccomp filter compiler with binary-search dispatch =========
+//
+// Contents:
+//   * compiler                     (jump: Compile_seccomp)
+//   * install                      (jump: Install_seccomp)
+//   * interpreter                  (jump: Run_seccomp)
+//
+// Usage:
+//   seccomp.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/seccomp.h" // use as header file
+//
+//   #define C_SECCOMP_IMPLEMENTATION
+//   #include "c/seccomp.h" // use as implementation file
+//
+//   A hand-written filter is a chain of one compare per syscall: allowing
+//   150 syscalls costs up to 150 BPF instructions on every syscall, and the
+//   ones at the end of the list or missing from it pay them all.
+//   Compile_seccomp takes each architecture's rules, a syscall number and
+//   its action, and emits a program that checks the architecture, then
+//   binary-searches the syscall number: consecutive numbers with the same
+//   action merge into one range, and a lookup costs a compare per level,
+//   about log2 of the number of ranges.
+//
+//     Rule_seccomp rules[] = {{NR_read_linux, SECCOMP_RET_ALLOW_linux},
+//                             {NR_write_linux, SECCOMP_RET_ALLOW_linux},
+//                             {NR_openat_linux, SECCOMP_RET_ERRNO_linux | EACCES_linux}};
+//     Arch_seccomp arch = {AUDIT_ARCH_linux, rules, 3, SECCOMP_RET_KILL_PROCESS_linux};
+//     sock_filter_linux filter[BPF_MAXINSNS_linux];
+//     long len = Compile_seccomp(&arch, 1, SECCOMP_RET_KILL_PROCESS_linux, 0, filter, BPF_MAXINSNS_linux);
+//     Install_seccomp(filter, (unsigned int)len, SECCOMP_FILTER_FLAG_TSYNC_linux);
+//
+//   Each architecture has a fallback for syscalls without a rule, and calls
+//   from an architecture without rules (i386 on x86_64, say) get the
+//   mismatch action. On x86_64 the x32 numbers, with bit 30 set, sort
+//   above every rule and fall back. LINEAR_seccomp emits the usual chain
+//   instead, in rule order, for comparison.
+//
+//   Since 5.11 the kernel caches, per syscall number, filters that always
+//   return ALLOW, and skips running them for those numbers: the tree pays
+//   off for everything else (errno, trap, trace and log rules, denied
+//   syscalls) and on older kernels. Install_seccomp sets
+//   PR_SET_NO_NEW_PRIVS first, which seccomp requires without
+//   CAP_SYS_ADMIN; with SECCOMP_FILTER_FLAG_TSYNC it installs the filter on
+//   every thread of the process, and returns the id of a thread that
+//   couldn't be synchronized.
+//
+//   Run_seccomp interprets a program on a seccomp_data_linux, to check a
+//   filter against its rules before installing it, or count the
+//   instructions a syscall costs.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "seccomp.h depends on linux.h, include it first"
+#endif
+
+#define RULES_seccomp 1024 // rules per architecture
+#define ARCHES_seccomp 8   // architectures per filter
+
+#define LINEAR_seccomp 1 // Compile_seccomp flag: one compare per rule, in rule order
+
+typedef struct {
+  unsigned int nr;     // NR_*_linux of the architecture
+  unsigned int action; // SECCOMP_RET_*_linux, with its data (errno, trace message)
+} Rule_seccomp;
+
+typedef struct {
+  unsigned int arch;     // AUDIT_ARCH_*_linux
+  Rule_seccomp *rules;   // sorted in place unless LINEAR_seccomp
+  unsigned int count;
+  unsigned int fallback; // action for syscalls without a rule
+} Arch_seccomp;
+
+//
+// Compiler
+//
+long Compile_seccomp(Arch_seccomp *arches, unsigned int count, unsigned int mismatch, int flags, sock_filter_linux *out, unsigned int max);
+//
+// Install
+//
+long Install_seccomp(const sock_filter_linux *filter, unsigned int len, unsigned int flags);
+//
+// Interpreter
+//
+unsigned int Run_seccomp(const sock_filter_linux *filter, unsigned int len, const seccomp_data_linux *data, unsigned int *steps);
+
+#endif // C_SECCOMP_HEADER
+#ifdef C_SECCOMP_IMPLEMENTATION
+
+#define LD_NR_seccomp ((sock_filter_linux)BPF_STMT_linux(BPF_LD_linux | BPF_W_linux | BPF_ABS_linux, __builtin_offsetof(seccomp_data_linux, nr)))
+#define LD_ARCH_seccomp ((sock_filter_linux)BPF_STMT_linux(BPF_LD_linux | BPF_W_linux | BPF_ABS_linux, __builtin_offsetof(seccomp_data_linux, arch)))
+#define RET_seccomp(action) ((sock_filter_linux)BPF_STMT_linux(BPF_RET_linux | BPF_K_linux, (action)))
+#define JA_seccomp(offset) ((sock_filter_linux)BPF_STMT_linux(BPF_JMP_linux | BPF_JA_linux | BPF_K_linux, (offset)))
+
+// Insertion sort by number: rule lists are short and often nearly sorted.
+static void Sort_seccomp(Rule_seccomp *rules, unsigned int count) {
+  for (unsigned int i = 1; i < count; ++i) {
+    Rule_seccomp rule = rules[i];
+    unsigned int at = i;
+    while (at && rules[at - 1].nr > rule.nr) {
+      rules[at] = rules[at - 1];
+      --at;
+    }
+    rules[at] = rule;
+  }
+}
+
+// Instructions of the subtree over ranges [lo, hi): a range is a return,
+// a split is a JGE over the left subtree, or JGE + JA when the left is too
+// far for an 8-bit jump.
+static unsigned int Size_seccomp(unsigned int lo, unsigned int hi) {
+  if (hi - lo == 1) {
+    return 1;
+  }
+  unsigned int mid = lo + (hi - lo) / 2;
+  unsigned int left = Size_seccomp(lo, mid);
+  return 1 + (left > 255) + left + Size_seccomp(mid, hi);
+}
+
+static unsigned int Tree_seccomp(const unsigned int *starts, const unsigned int *actions, unsigned int lo, unsigned int hi, sock_filter_linux *out) {
+  if (hi - lo == 1) {
+    out[0] = RET_seccomp(actions[lo]);
+    return 1;
+  }
+  unsigned int mid = lo + (hi - lo) / 2, n = 0;
+  unsigned int left = Size_seccomp(lo, mid);
+  if (left > 255) {
+    out[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JGE_linux | BPF_K_linux, starts[mid], 0, 1);
+    out[n++] = JA_seccomp(left);
+  } else {
+    out[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JGE_linux | BPF_K_linux, starts[mid], (unsigned char)left, 0);
+  }
+  n += Tree_seccomp(starts, actions, lo, mid, out + n);
+  n += Tree_seccomp(starts, actions, mid, hi, out + n);
+  return n;
+}
+
+// Appends range [start, ...) of action, merging it into the last range
+// when the actions match, or replacing the last range when it's empty.
+static unsigned int Add_seccomp(unsigned int *starts, unsigned int *actions, unsigned int n, unsigned int start, unsigned int action) {
+  if (n && starts[n - 1] == start) {
+    --n;
+  }
+  if (n && actions[n - 1] == action) {
+    return n;
+  }
+  starts[n] = start;
+  actions[n] = action;
+  return n + 1;
+}
+
+// The number line cut into ranges [starts[i], starts[i + 1]) of one action.
+static long Ranges_seccomp(const Arch_seccomp *a, unsigned int *starts, unsigned int *actions) {
+  unsigned int n = Add_seccomp(starts, actions, 0, 0, a->fallback), next = 0;
+  for (unsigned int i = 0; i < a->count; ++i) {
+    const Rule_seccomp *r = &a->rules[i];
+    if (i && r->nr == a->rules[i - 1].nr) {
+      if (r->action != a->rules[i - 1].action) {
+        return -EINVAL_linux;
+      }
+      continue;
+    }
+    if (r->nr > next) {
+      n = Add_seccomp(starts, actions, n, next, a->fallback);
+    }
+    n = Add_seccomp(starts, actions, n, r->nr, r->action);
+    next = r->nr + 1;
+  }
+  if (next) {
+    n = Add_seccomp(starts, actions, n, next, a->fallback);
+  }
+  return n;
+}
+
+static long Linear_seccomp(const Arch_seccomp *a, sock_filter_linux *out, unsigned int max) {
+  if (2 * a->count + 2 > max) {
+    return -E2BIG_linux;
+  }
+  unsigned int n = 0;
+  out[n++] = LD_NR_seccomp;
+  for (unsigned int i = 0; i < a->count; ++i) {
+    out[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JEQ_linux | BPF_K_linux, a->rules[i].nr, 0, 1);
+    out[n++] = RET_seccomp(a->rules[i].action);
+  }
+  out[n++] = RET_seccomp(a->fallback);
+  return n;
+}
+
+long Compile_seccomp(Arch_seccomp *arches, unsigned int count, unsigned int mismatch, int flags, sock_filter_linux *out, unsigned int max) {
+  if (!count || count > ARCHES_seccomp) {
+    return -EINVAL_linux;
+  }
+  if (max > BPF_MAXINSNS_linux) {
+    max = BPF_MAXINSNS_linux;
+  }
+  // Dispatch on the architecture: JEQ + JA to its program for each
+  unsigned int n = 0;
+  if (2 * count + 2 > max) {
+    return -E2BIG_linux;
+  }
+  out[n++] = LD_ARCH_seccomp;
+  for (unsigned int i = 0; i < count; ++i) {
+    out[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JEQ_linux | BPF_K_linux, arches[i].arch, 0, 1);
+    out[n++] = JA_seccomp(0);
+  }
+  out[n++] = RET_seccomp(mismatch);
+
+  unsigned int starts[2 * RULES_seccomp + 1], actions[2 * RULES_seccomp + 1];
+  for (unsigned int i = 0; i < count; ++i) {
+    Arch_seccomp *a = &arches[i];
+    if (a->count > RULES_seccomp) {
+      return -EINVAL_linux;
+    }
+    out[2 + 2 * i].k = n - (3 + 2 * i);
+    if (flags & LINEAR_seccomp) {
+      long len = Linear_seccomp(a, out + n, max - n);
+      if (len < 0) {
+        return len;
+      }
+      n += (unsigned int)len;
+      continue;
+    }
+    Sort_seccomp(a->rules, a->count);
+    long ranges = Ranges_seccomp(a, starts, actions);
+    if (ranges < 0) {
+      return ranges;
+    }
+    if (1 + Size_seccomp(0, (unsigned int)ranges) > max - n) {
+      return -E2BIG_linux;
+    }
+    out[n++] = LD_NR_seccomp;
+    n += Tree_seccomp(starts, actions, 0, (unsigned int)ranges, out + n);
+  }
+  return n;
+}
+
+long Install_seccomp(const sock_filter_linux *filter, unsigned int len, unsigned int flags) {
+  if (!len || len > BPF_MAXINSNS_linux) {
+    return -EINVAL_linux;
+  }
+  long ret = prctl_linux(PR_SET_NO_NEW_PRIVS_linux, 1, 0, 0, 0);
+  if (ret < 0) {
+    return ret;
+  }
+  sock_fprog_linux prog = {(unsigned short)len, (sock_filter_linux *)filter};
+  return seccomp_linux(SECCOMP_SET_MODE_FILTER_linux, flags, &prog);
+}
+
+// The subset of classic BPF a seccomp filter uses: loads of the 32-bit
+// words of seccomp_data_linux, K jumps and returns.
+unsigned int Run_seccomp(const sock_filter_linux *filter, unsigned int len, const seccomp_data_linux *data, unsigned int *steps) {
+  unsigned int a = 0, pc = 0, taken = 0;
+  while (pc < len) {
+    const sock_filter_linux *f = &filter[pc++];
+    ++taken;
+    switch (f->code) {
+    case BPF_LD_linux | BPF_W_linux | BPF_ABS_linux:
+      if (f->k % 4 || f->k >= sizeof(*data)) {
+        pc = len;
+        break;
+      }
+      a = ((const unsigned int *)data)[f->k / 4];
+      break;
+    case BPF_JMP_linux | BPF_JA_linux | BPF_K_linux: pc += f->k; break;
+    case BPF_JMP_linux | BPF_JEQ_linux | BPF_K_linux: pc += a == f->k ? f->jt : f->jf; break;
+    case BPF_JMP_linux | BPF_JGT_linux | BPF_K_linux: pc += a > f->k ? f->jt : f->jf; break;
+    case BPF_JMP_linux | BPF_JGE_linux | BPF_K_linux: pc += a >= f->k ? f->jt : f->jf; break;
+    case BPF_JMP_linux | BPF_JSET_linux | BPF_K_linux: pc += a & f->k ? f->jt : f->jf; break;
+    case BPF_RET_linux | BPF_K_linux:
+      if (steps) {
+        *steps = taken;
+      }
+      return f->k;
+    case BPF_RET_linux | BPF_A_linux:
+      if (steps) {
+        *steps = taken;
+      }
+      return a;
+    default: pc = len; break;
+    }
+  }
+  if (steps) {
+    *steps = taken;
+  }
+  return SECCOMP_RET_KILL_PROCESS_linux; // what the kernel's checker would have refused
+}
+
+#endif // C_SECCOMP_IMPLEMENTATION
@@ -0,0 +1,242 @@
+#ifndef C_THREAD_HEADER
+#define C_THREAD_HEADER
+
+// === thread.h: raw clone threads without libc ===============================
+//
+// Contents:
+//   * threads                      (jump: Spawn_thread)
+//
+// Usage:
+//   thread.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/thread.h" // use as header file
+//
+//   #define C_THREAD_IMPLEMENTATION
+//   #include "c/thread.h" // use as implementation file
+//
+//   Spawn_thread maps a stack (with a guard page below it) and clones a thread
+//   sharing our memory, files and signal handlers. The child never returns
+//   into C code with the parent's frame: a per-architecture trampoline pops
+//   the entry point off the new stack, calls it and exits the thread.
+//   Join_thread sleeps on the thread id the kernel clears at exit
+//   (CLONE_CHILD_CLEARTID), then unmaps the stack.
+//
+//   Threads don't get a TLS area of their own: they inherit the thread
+//   pointer of their creator, which is fine for code that doesn't use
+//   __thread variables.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "thread.h depends on linux.h, include it first"
+#endif
+
+#define STACK_thread (256UL << 10)
+
+typedef struct {
+  int tid;    // futex word: 0 once the thread has exited
+  int result; // what `fn` returned
+  int (*fn)(void *arg);
+  void *arg;
+  char *stack; // mapping, guard page included
+  unsigned long stack_size;
+} Thread_thread;
+
+//
+// Threads
+//
+long Spawn_thread(Thread_thread *t, int (*fn)(void *arg), void *arg, unsigned long stack_size);
+long Join_thread(Thread_thread *t);
+
+#endif // C_THREAD_HEADER
+#ifdef C_THREAD_IMPLEMENTATION
+
+static int Entry_thread(void *arg) {
+  Thread_thread *t = (Thread_thread *)arg;
+  t->result = t->fn(t->arg);
+  return t->result;
+}
+
+// clone_linux with a trampoline: the new stack starts with {entry, arg}; the
+// child pops them, calls entry(arg) and exits with its result. Only the
+// parent returns, with the child's tid or -errno.
+static long Clone_thread(unsigned long flags, void **sp, int *tid) {
+#if defined(__x86_64__)
+  register long rax __asm__("rax") = NR_clone_linux;
+  register long rdi __asm__("rdi") = (long)flags;
+  register long rsi __asm__("rsi") = (long)sp;
+  register long rdx __asm__("rdx") = (long)tid;
+  register long r10 __asm__("r10") = (long)tid;
+  register long r8 __asm__("r8") = 0;
+  __asm__ volatile (
+    "syscall\n"
+    "test %%rax, %%rax\n"
+    "jnz 1f\n"
+    "xor %%ebp, %%ebp\n"
+    "pop %%rax\n"
+    "pop %%rdi\n"
+    "and $-16, %%rsp\n"
+    "call *%%rax\n"
+    "mov %%eax, %%edi\n"
+    "mov $60, %%eax\n" // exit, not exit_group
+    "syscall\n"
+    "hlt\n"
+    "1:\n"
+    : "+r" (rax)
+    : "r" (rdi), "r" (rsi), "r" (rdx), "r" (r10), "r" (r8)
+    : "rcx", "r11", "memory", "cc"
+  );
+  return rax;
+#elif defined(__aarch64__)
+  register long x8 __asm__("x8") = NR_clone_linux;
+  register long x0 __asm__("x0") = (long)flags;
+  register long x1 __asm__("x1") = (long)sp;
+  register long x2 __asm__("x2") = (long)tid;
+  register long x3 __asm__("x3") = 0;
+  register long x4 __asm__("x4") = (long)tid;
+  __asm__ volatile (
+    "svc #0\n"
+    "cbnz x0, 1f\n"
+    "mov x29, #0\n"
+    "ldp x9, x0, [sp], #16\n"
+    "blr x9\n"
+    "mov x8, #93\n"
+    "svc #0\n"
+    "1:\n"
+    : "+r" (x0)
+    : "r" (x8), "r" (x1), "r" (x2), "r" (x3), "r" (x4)
+    : "x9", "x30", "memory", "cc"
+  );
+  return x0;
+#elif defined(__riscv)
+  register long a7 __asm__("a7") = NR_clone_linux;
+  register long a0 __asm__("a0") = (long)flags;
+  register long a1 __asm__("a1") = (long)sp;
+  register long a2 __asm__("a2") = (long)tid;
+  register long a3 __asm__("a3") = 0;
+  register long a4 __asm__("a4") = (long)tid;
+  __asm__ volatile (
+    "ecall\n"
+    "bnez a0, 1f\n"
+#if __riscv_xlen == 64
+    "ld t0, 0(sp)\n"
+    "ld a0, 8(sp)\n"
+#else
+    "lw t0, 0(sp)\n"
+    "lw a0, 4(sp)\n"
+#endif
+    "addi sp, sp, 16\n"
+    "jalr t0\n"
+    "li a7, 93\n"
+    "ecall\n"
+    "1:\n"
+    : "+r" (a0)
+    : "r" (a7), "r" (a1), "r" (a2), "r" (a3), "r" (a4)
+    : "t0", "ra", "memory"
+  );
+  return a0;
+#elif defined(__i386__)
+  register long eax __asm__("eax") = NR_clone_linux;
+  register long ebx __asm__("ebx") = (long)flags;
+  register long ecx __asm__("ecx") = (long)sp;
+  register long edx __asm__("edx") = (long)tid;
+  register long esi __asm__("esi") = 0;
+  register long edi __asm__("edi") = (long)tid;
+  __asm__ volatile (
+    "int $0x80\n"
+    "test %%eax, %%eax\n"
+    "jnz 1f\n"
+    "xor %%ebp, %%ebp\n"
+    "mov (%%esp), %%eax\n"
+    "mov 4(%%esp), %%ecx\n"
+    "and $-16, %%esp\n"
+    "sub $12, %%esp\n"
+    "push %%ecx\n"
+    "call *%%eax\n"
+    "mov %%eax, %%ebx\n"
+    "mov $1, %%eax\n"
+    "int $0x80\n"
+    "hlt\n"
+    "1:\n"
+    : "+r" (eax)
+    : "r" (ebx), "r" (ecx), "r" (edx), "r" (esi), "r" (edi)
+    : "memory", "cc"
+  );
+  return eax;
+#elif defined(__arm__)
+  register long r7 __asm__("r7") = NR_clone_linux;
+  register long r0 __asm__("r0") = (long)flags;
+  register long r1 __asm__("r1") = (long)sp;
+  register long r2 __asm__("r2") = (long)tid;
+  register long r3 __asm__("r3") = 0;
+  register long r4 __asm__("r4") = (long)tid;
+  __asm__ volatile (
+    "svc #0\n"
+    "cmp r0, #0\n"
+    "bne 1f\n"
+    "ldr r3, [sp]\n"
+    "ldr r0, [sp, #4]\n"
+    "add sp, sp, #16\n"
+    "blx r3\n"
+    "mov r7, #1\n"
+    "svc #0\n"
+    "1:\n"
+    : "+r" (r0)
+    : "r" (r7), "r" (r1), "r" (r2), "r" (r3), "r" (r4)
+    : "lr", "memory", "cc"
+  );
+  return r0;
+#endif
+}
+
+//
+// Threads
+//
+
+// Starts `fn(arg)` on a new thread with a `stack_size` stack (0 for
+// STACK_thread). `t` must stay valid until Join_thread.
+long Spawn_thread(Thread_thread *t, int (*fn)(void *arg), void *arg, unsigned long stack_size) {
+  stack_size = ((stack_size ? stack_size : STACK_thread) + 4095) & ~4095UL;
+  unsigned long size = stack_size + 4096; // a guard page catches overflows
+  long ret = mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_STACK_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  t->stack = (char *)ret;
+  t->stack_size = size;
+  t->fn = fn;
+  t->arg = arg;
+  t->result = 0;
+  mprotect_linux(t->stack, 4096, PROT_NONE_linux);
+  void **sp = (void **)(t->stack + size - 16);
+  sp[0] = (void *)Entry_thread;
+  sp[1] = t;
+  unsigned long flags = CLONE_VM_linux | CLONE_FS_linux | CLONE_FILES_linux | CLONE_SIGHAND_linux | CLONE_THREAD_linux |
+                        CLONE_SYSVSEM_linux | CLONE_PARENT_SETTID_linux | CLONE_CHILD_CLEARTID_linux;
+  ret = Clone_thread(flags, sp, &t->tid);
+  if (ret < 0) {
+    munmap_linux(t->stack, size);
+    return ret;
+  }
+  return 0;
+}
+
+// Waits for the thread to exit and frees its stack; returns its result.
+long Join_thread(Thread_thread *t) {
+  int tid;
+  // The kernel's wake at exit is not FUTEX_PRIVATE, so neither is the wait.
+  while ((tid = __atomic_load_n(&t->tid, __ATOMIC_ACQUIRE)) != 0) {
+    futex_time64_linux((unsigned int *)&t->tid, FUTEX_WAIT, (unsigned int)tid, 0, 0, 0);
+  }
+  munmap_linux(t->stack, t->stack_size);
+  return t->result;
+}
+
+#endif // C_THREAD_IMPLEMENTATION
@@ -0,0 +1,81 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o thread_demo thread_demo.c -e main && ./thread_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_THREAD_IMPLEMENTATION
+#include "thread.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_group_linux(1); // exit_linux would only end the failing thread
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+//
+// Threads share memory, return results, and their stacks are reclaimed
+//
+#define THREADS    8
+#define INCREMENTS 100000
+
+unsigned long counter;
+
+int Work(void *arg) {
+  int id = (int)(long)arg;
+  char deep[64 << 10]; // touches most of a default stack
+  for (unsigned long i = 0; i < sizeof(deep); i += 4096) {
+    ((volatile char *)deep)[i] = (char)id;
+  }
+  for (int i = 0; i < INCREMENTS; ++i) {
+    __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED);
+  }
+  return id * 10 + deep[4096]; // id * 11 if the stack writes stuck
+}
+
+void Threads_demo(void) {
+  Thread_thread threads[THREADS];
+  for (int round = 0; round < 100; ++round) { // stacks must not leak
+    for (long i = 0; i < THREADS; ++i) {
+      Assert(Spawn_thread(&threads[i], Work, (void *)i, 0) == 0);
+    }
+    for (int i = 0; i < THREADS; ++i) {
+      Assert(Join_thread(&threads[i]) == i * 11);
+      Assert(threads[i].tid == 0);
+    }
+  }
+  Assert(counter == 100UL * THREADS * INCREMENTS);
+  Print(STDOUT_FILENO_linux, "spawn, shared memory, results, join: ok\n");
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Threads_demo();
+  exit_linux(0);
+  return 0;
+}
@@ -0,0 +1,375 @@
+#ifndef C_TOPO_HEADER
+#define C_TOPO_HEADER
+
+// === topo.h: CPU topology discovery & thread placement plans ================
+//
+// Contents:
+//   * topology                     (jump: Load_topo)
+//   * placement plans              (jump: Build_topo)
+//   * pinning                      (jump: Apply_topo)
+//
+// Usage:
+//   topo.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/topo.h" // use as header file
+//
+//   #define C_TOPO_IMPLEMENTATION
+//   #include "c/topo.h" // use as implementation file
+//
+//   Load_topo only reports the CPUs in our sched_getaffinity_linux mask, so
+//   cgroup cpusets and taskset limits are respected by every plan built from
+//   it. For each CPU it records the package, the physical core (SMT threads
+//   share it), the NUMA node and the L2/L3 groups from
+//   /sys/devices/system/cpu/cpuN/{topology,cache}.
+//
+//   A plan is an ordered list of CPUs: worker i runs on cpus[i % count].
+//     PLAN_CORES_topo    one thread per physical core, SMT siblings left idle
+//     PLAN_COMPACT_topo  fill a core's threads, then its L3, then its package
+//     PLAN_SCATTER_topo  round-robin over packages, SMT siblings last
+//   Restricting a plan to a node keeps workers next to their memory or NIC
+//   (see NicNode_topo).
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "topo.h depends on linux.h, include it first"
+#endif
+
+#define MAX_CPUS_topo  1024
+#define WORD_BITS_topo (8 * sizeof(unsigned long))
+
+enum {
+  PLAN_CORES_topo,
+  PLAN_COMPACT_topo,
+  PLAN_SCATTER_topo,
+};
+
+// Groups are named after their lowest CPU number, so they're unique machine-wide.
+typedef struct {
+  short cpu;
+  short package;
+  short core; // first CPU of the physical core
+  short smt;  // 0 for the core's first thread in our affinity mask, 1 for the next...
+  short node; // -1 when unknown
+  short l2;   // first CPU sharing our L2, -1 when unknown
+  short l3;
+} Cpu_topo;
+
+typedef struct {
+  int count; // CPUs we may run on
+  Cpu_topo cpus[MAX_CPUS_topo]; // ascending CPU numbers
+  int packages;
+  int cores;
+  unsigned long l2_size; // bytes, per L2 group
+  unsigned long l3_size;
+} Topology_topo;
+
+typedef struct {
+  int count;
+  short cpus[MAX_CPUS_topo];
+} Plan_topo;
+
+//
+// Topology
+//
+long Load_topo(Topology_topo *t);
+long NicNode_topo(const char *ifname);
+//
+// Placement plans
+//
+long Build_topo(const Topology_topo *t, int kind, int node, Plan_topo *plan);
+//
+// Pinning
+//
+long Pin_topo(int tid, int cpu);
+long Apply_topo(const Plan_topo *plan, int slot, int tid);
+
+#endif // C_TOPO_HEADER
+#ifdef C_TOPO_IMPLEMENTATION
+
+//
+// Topology
+//
+
+// Appends `s` to the path being built at `p`, returns the new end.
+static char *Append_topo(char *p, const char *s) {
+  while (*s) {
+    *p++ = *s++;
+  }
+  *p = 0;
+  return p;
+}
+
+static char *AppendNumber_topo(char *p, unsigned int value) {
+  char digits[12];
+  int n = 0;
+  do {
+    digits[n++] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  while (n) {
+    *p++ = digits[--n];
+  }
+  *p = 0;
+  return p;
+}
+
+static const char *Number_topo(const char *s, long *value) {
+  *value = 0;
+  while (*s >= '0' && *s <= '9') {
+    *value = *value * 10 + (*s++ - '0');
+  }
+  return s;
+}
+
+static long ReadAt_topo(int dfd, const char *path, char *buf, unsigned long cap) {
+  long fd = openat_linux(dfd, path, O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  long n = read_linux((unsigned int)fd, buf, cap - 1);
+  close_linux((unsigned int)fd);
+  buf[n > 0 ? n : 0] = 0;
+  return n;
+}
+
+// A single number ("3"), or a size ("2048K", "32M"); -1 when unreadable.
+static long ReadNumberAt_topo(int dfd, const char *path) {
+  char buf[32];
+  if (ReadAt_topo(dfd, path, buf, sizeof(buf)) <= 0 || buf[0] < '0' || buf[0] > '9') {
+    return -1;
+  }
+  long value;
+  const char *s = Number_topo(buf, &value);
+  return *s == 'K' ? value << 10 : *s == 'M' ? value << 20 : value;
+}
+
+// A CPU list ("0-3,8"): its first CPU, and our rank in it when `cpu` is listed,
+// counting only the CPUs in `mask` (our affinity mask) when it is given.
+static long ReadListAt_topo(int dfd, const char *path, int cpu, short *rank, const unsigned long *mask) {
+  char buf[512];
+  if (ReadAt_topo(dfd, path, buf, sizeof(buf)) <= 0 || buf[0] < '0' || buf[0] > '9') {
+    return -1;
+  }
+  long first = -1;
+  short below = 0;
+  for (const char *s = buf; *s >= '0' && *s <= '9';) {
+    long lo;
+    long hi;
+    s = Number_topo(s, &lo);
+    hi = lo;
+    if (*s == '-') {
+      s = Number_topo(s + 1, &hi);
+    }
+    first = first < 0 ? lo : first;
+    for (long i = lo; i <= hi && i < cpu; ++i) {
+      below += !mask || (mask[i / WORD_BITS_topo] >> (i % WORD_BITS_topo)) & 1;
+    }
+    if (*s == ',') {
+      ++s;
+    }
+  }
+  if (rank) {
+    *rank = below;
+  }
+  return first;
+}
+
+// cpuN/nodeM is a symlink to the CPU's node; its name is all we need.
+static long Node_topo(int dfd, const char *dir) {
+  long fd = openat_linux(dfd, dir, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  union {
+    linux_dirent64_linux d;
+    char bytes[1024];
+  } buf;
+  long node = -1;
+  long n;
+  while (node < 0 && (n = getdents64_linux((unsigned int)fd, &buf.d, sizeof(buf))) > 0) {
+    for (long at = 0; at < n; ) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(buf.bytes + at);
+      at += d->d_reclen;
+      const char *name = d->d_name;
+      if (name[0] == 'n' && name[1] == 'o' && name[2] == 'd' && name[3] == 'e' && name[4] >= '0' && name[4] <= '9') {
+        Number_topo(name + 4, &node);
+        break;
+      }
+    }
+  }
+  close_linux((unsigned int)fd);
+  return node;
+}
+
+static void Caches_topo(Topology_topo *t, int dfd, Cpu_topo *c, char *path, char *end) {
+  c->l2 = -1;
+  c->l3 = -1;
+  for (unsigned int index = 0; index < 16; ++index) {
+    char *dir = AppendNumber_topo(Append_topo(end, "/cache/index"), index);
+    Append_topo(dir, "/level");
+    long level = ReadNumberAt_topo(dfd, path);
+    if (level < 0) {
+      break;
+    }
+    if (level != 2 && level != 3) {
+      continue;
+    }
+    char type[16];
+    Append_topo(dir, "/type");
+    if (ReadAt_topo(dfd, path, type, sizeof(type)) <= 0 || type[0] == 'I') {
+      continue; // instruction caches don't matter for placement
+    }
+    Append_topo(dir, "/shared_cpu_list");
+    short group = (short)ReadListAt_topo(dfd, path, c->cpu, 0, 0);
+    Append_topo(dir, "/size");
+    long size = ReadNumberAt_topo(dfd, path);
+    if (level == 2) {
+      c->l2 = group;
+      t->l2_size = size > 0 ? (unsigned long)size : t->l2_size;
+    } else {
+      c->l3 = group;
+      t->l3_size = size > 0 ? (unsigned long)size : t->l3_size;
+    }
+  }
+}
+
+// Fills `t` with the CPUs in our affinity mask.
+long Load_topo(Topology_topo *t) {
+  unsigned long mask[MAX_CPUS_topo / WORD_BITS_topo] = {0};
+  long ret = sched_getaffinity_linux(0, sizeof(mask), mask);
+  if (ret < 0) {
+    return ret;
+  }
+  long dfd = openat_linux(AT_FDCWD_linux, "/sys/devices/system/cpu", O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (dfd < 0) {
+    return dfd;
+  }
+  t->count = 0;
+  t->packages = 0;
+  t->cores = 0;
+  t->l2_size = 0;
+  t->l3_size = 0;
+  for (int cpu = 0; cpu < MAX_CPUS_topo; ++cpu) {
+    if (!((mask[cpu / WORD_BITS_topo] >> (cpu % WORD_BITS_topo)) & 1)) {
+      continue;
+    }
+    Cpu_topo *c = &t->cpus[t->count++];
+    char path[96];
+    char *end = AppendNumber_topo(Append_topo(path, "cpu"), (unsigned int)cpu);
+    c->cpu = (short)cpu;
+    c->node = (short)Node_topo((int)dfd, path);
+    Append_topo(end, "/topology/physical_package_id");
+    long package = ReadNumberAt_topo((int)dfd, path);
+    c->package = (short)(package < 0 ? 0 : package);
+    Append_topo(end, "/topology/core_cpus_list");
+    long core = ReadListAt_topo((int)dfd, path, cpu, &c->smt, mask);
+    if (core < 0) { // kernels before 5.7
+      Append_topo(end, "/topology/thread_siblings_list");
+      core = ReadListAt_topo((int)dfd, path, cpu, &c->smt, mask);
+    }
+    if (core < 0) {
+      core = cpu;
+      c->smt = 0;
+    }
+    c->core = (short)core;
+    Caches_topo(t, (int)dfd, c, path, end);
+  }
+  close_linux((unsigned int)dfd);
+  for (int i = 0; i < t->count; ++i) {
+    int newPackage = 1;
+    for (int j = 0; j < i; ++j) {
+      newPackage &= t->cpus[j].package != t->cpus[i].package;
+    }
+    t->packages += newPackage;
+    t->cores += t->cpus[i].smt == 0;
+  }
+  return 0;
+}
+
+// The NUMA node a network interface hangs off, -1 when the kernel doesn't
+// know (virtual devices, single-node machines).
+long NicNode_topo(const char *ifname) {
+  char path[96];
+  Append_topo(Append_topo(Append_topo(path, "/sys/class/net/"), ifname), "/device/numa_node");
+  return ReadNumberAt_topo(AT_FDCWD_linux, path);
+}
+
+//
+// Placement plans
+//
+
+// Sort key of a CPU for each plan, smallest first.
+static unsigned long long Key_topo(const Cpu_topo *c, int kind, int rank) {
+  unsigned long long l3 = (unsigned long long)(c->l3 + 1);
+  if (kind == PLAN_SCATTER_topo) {
+    return (unsigned long long)c->smt << 48 | (unsigned long long)rank << 24 | (unsigned long long)c->package;
+  }
+  return (unsigned long long)c->package << 48 | l3 << 32 | (unsigned long long)c->core << 16 | (unsigned long long)c->smt;
+}
+
+// Builds a plan of `kind` over the CPUs of `node` (-1 for all of them).
+// Returns the number of CPUs in the plan.
+long Build_topo(const Topology_topo *t, int kind, int node, Plan_topo *plan) {
+  if (kind < PLAN_CORES_topo || kind > PLAN_SCATTER_topo) {
+    return -EINVAL_linux;
+  }
+  unsigned long long keys[MAX_CPUS_topo];
+  plan->count = 0;
+  for (int i = 0; i < t->count; ++i) {
+    const Cpu_topo *c = &t->cpus[i];
+    if ((node >= 0 && c->node != node) || (kind == PLAN_CORES_topo && c->smt)) {
+      continue;
+    }
+    // Scatter ranks a CPU among the same-SMT CPUs of its package that sort
+    // before it compactly, so package 0 core 0, package 1 core 0, ...
+    int rank = 0;
+    if (kind == PLAN_SCATTER_topo) {
+      unsigned long long own = Key_topo(c, PLAN_COMPACT_topo, 0);
+      for (int j = 0; j < t->count; ++j) {
+        const Cpu_topo *o = &t->cpus[j];
+        rank += o->package == c->package && o->smt == c->smt && (node < 0 || o->node == node) && Key_topo(o, PLAN_COMPACT_topo, 0) < own;
+      }
+    }
+    unsigned long long key = Key_topo(c, kind, rank);
+    int at = plan->count++;
+    for (; at > 0 && keys[at - 1] > key; --at) {
+      keys[at] = keys[at - 1];
+      plan->cpus[at] = plan->cpus[at - 1];
+    }
+    keys[at] = key;
+    plan->cpus[at] = c->cpu;
+  }
+  return plan->count;
+}
+
+//
+// Pinning
+//
+
+// Restricts thread `tid` (0 for the caller) to `cpu`.
+long Pin_topo(int tid, int cpu) {
+  unsigned long mask[MAX_CPUS_topo / WORD_BITS_topo] = {0};
+  if (cpu < 0 || cpu >= MAX_CPUS_topo) {
+    return -EINVAL_linux;
+  }
+  mask[cpu / WORD_BITS_topo] = 1UL << (cpu % WORD_BITS_topo);
+  return sched_setaffinity_linux(tid, sizeof(mask), mask);
+}
+
+// Pins thread `tid` (0 for the caller) as worker `slot` of the plan.
+long Apply_topo(const Plan_topo *plan, int slot, int tid) {
+  if (plan->count <= 0 || slot < 0) {
+    return -EINVAL_linux;
+  }
+  return Pin_topo(tid, plan->cpus[slot % plan->count]);
+}
+
+#endif // C_TOPO_IMPLEMENTATION
@@ -0,0 +1,243 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o topo_demo topo_demo.c -e main && ./topo_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_TOPO_IMPLEMENTATION
+#include "topo.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+const char *planNames[3] = {"one per core", "compact     ", "scatter     "};
+
+void PrintPlan(const Plan_topo *plan) {
+  for (int i = 0; i < plan->count && i < 16; ++i) {
+    Print(STDOUT_FILENO_linux, " ");
+    PrintU64(STDOUT_FILENO_linux, plan->cpus[i]);
+  }
+  Print(STDOUT_FILENO_linux, plan->count > 16 ? " ...\n" : "\n");
+}
+
+//
+// Topology and the three plans over it
+//
+void Topology_demo(const Topology_topo *t) {
+  Print(STDOUT_FILENO_linux, "cpus ");
+  PrintU64(STDOUT_FILENO_linux, t->count);
+  Print(STDOUT_FILENO_linux, ", physical cores ");
+  PrintU64(STDOUT_FILENO_linux, t->cores);
+  Print(STDOUT_FILENO_linux, ", packages ");
+  PrintU64(STDOUT_FILENO_linux, t->packages);
+  Print(STDOUT_FILENO_linux, ", L2 ");
+  PrintU64(STDOUT_FILENO_linux, t->l2_size >> 10);
+  Print(STDOUT_FILENO_linux, " KiB, L3 ");
+  PrintU64(STDOUT_FILENO_linux, t->l3_size >> 10);
+  Print(STDOUT_FILENO_linux, " KiB\n");
+  Assert(t->count >= 1 && t->cores >= 1 && t->cores <= t->count && t->packages >= 1);
+
+  for (int kind = PLAN_CORES_topo; kind <= PLAN_SCATTER_topo; ++kind) {
+    Plan_topo plan;
+    Assert(Build_topo(t, kind, -1, &plan) == (kind == PLAN_CORES_topo ? t->cores : t->count));
+    Print(STDOUT_FILENO_linux, planNames[kind]);
+    Print(STDOUT_FILENO_linux, ":");
+    PrintPlan(&plan);
+    for (int i = 0; i < plan.count; ++i) {
+      for (int j = i + 1; j < plan.count; ++j) {
+        Assert(plan.cpus[i] != plan.cpus[j]);
+      }
+    }
+  }
+  Plan_topo local;
+  if (t->cpus[0].node >= 0) { // restricted to a node, every CPU in it
+    Assert(Build_topo(t, PLAN_COMPACT_topo, t->cpus[0].node, &local) >= 1);
+  }
+  long nic = NicNode_topo("eth0");
+  Print(STDOUT_FILENO_linux, "eth0 NUMA node: ");
+  if (nic < 0) {
+    Print(STDOUT_FILENO_linux, "unknown\n");
+  } else {
+    PrintU64(STDOUT_FILENO_linux, nic);
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+}
+
+//
+// Effect of each plan on a memory-bound and a latency-bound kernel
+//
+#define STREAM_BYTES (32UL << 20)
+#define STREAM_PASSES 8
+#define PINGS 20000
+
+typedef struct {
+  volatile int go;
+  volatile int ready;
+  char pad0[56];
+  volatile unsigned long ping; // worker 0 writes odd values, worker 1 even
+  char pad1[56];
+} Shared;
+
+Shared *shared;
+
+void WaitGo(void) {
+  __atomic_fetch_add(&shared->ready, 1, __ATOMIC_SEQ_CST);
+  while (!shared->go) {
+    sched_yield_linux();
+  }
+}
+
+// Each worker streams over its own buffer; SMT siblings and workers sharing
+// an L3 or a memory controller compete for bandwidth.
+void StreamWorker(void) {
+  long ret = mmap_linux(0, STREAM_BYTES, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  Assert(ret > 0 || ret < -4095);
+  unsigned long long *words = (unsigned long long *)ret;
+  unsigned long count = STREAM_BYTES / sizeof(unsigned long long);
+  for (unsigned long i = 0; i < count; ++i) {
+    words[i] = i;
+  }
+  WaitGo();
+  unsigned long long sum = 0;
+  for (int pass = 0; pass < STREAM_PASSES; ++pass) {
+    for (unsigned long i = 0; i < count; i += 4) {
+      sum += words[i] + words[i + 1] + words[i + 2] + words[i + 3];
+    }
+  }
+  Assert(sum == STREAM_PASSES * ((unsigned long long)count * (count - 1) / 2));
+}
+
+// Cache-line ping-pong between the first two workers of the plan: SMT
+// siblings share L1, cores share L3, packages go over the interconnect.
+void PingWorker(int id, int spin) {
+  WaitGo();
+  for (unsigned long i = 0; i < PINGS; ++i) {
+    unsigned long want = 2 * i + (unsigned long)id;
+    for (int n = 0; shared->ping != want; ++n) {
+      if (n > spin) { // both ends may share one CPU
+        sched_yield_linux();
+        n = 0;
+      }
+    }
+    shared->ping = want + 1;
+  }
+}
+
+// Runs `workers` processes pinned by `plan`, returns the time from go to the
+// last exit.
+unsigned long long RunPlan(const Plan_topo *plan, int workers, int ping) {
+  shared->go = 0;
+  shared->ready = 0;
+  shared->ping = 0;
+  int spin = plan->count > 1 ? 1 << 20 : 100;
+  int pids[MAX_CPUS_topo];
+  for (int w = 0; w < workers; ++w) {
+    long pid = fork_linux();
+    Assert(pid >= 0);
+    if (pid == 0) {
+      Assert(Apply_topo(plan, w, 0) == 0);
+      if (ping) {
+        PingWorker(w, spin);
+      } else {
+        StreamWorker();
+      }
+      exit_linux(0);
+    }
+    pids[w] = (int)pid;
+  }
+  while (shared->ready != workers) {
+    sched_yield_linux();
+  }
+  unsigned long long start = Now_ns();
+  shared->go = 1;
+  for (int w = 0; w < workers; ++w) {
+    int status;
+    Assert(wait4_linux(pids[w], &status, 0, 0) == pids[w] && status == 0);
+  }
+  return Now_ns() - start;
+}
+
+void Bench_demo(const Topology_topo *t) {
+  long ret = mmap_linux(0, sizeof(Shared), PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux | MAP_ANONYMOUS_linux, -1, 0);
+  Assert(ret > 0 || ret < -4095);
+  shared = (Shared *)ret;
+  // As many workers as physical cores: the one-per-core plan gets a core each,
+  // compact doubles them up on SMT siblings, scatter spreads packages first.
+  int workers = t->cores < 64 ? t->cores : 64;
+  workers = workers < 2 ? 2 : workers;
+  Print(STDOUT_FILENO_linux, "\nmemory-bound (");
+  PrintU64(STDOUT_FILENO_linux, workers);
+  Print(STDOUT_FILENO_linux, " workers streaming 32 MiB each) and latency-bound (ping-pong of workers 0 and 1):\n");
+  for (int kind = PLAN_CORES_topo; kind <= PLAN_SCATTER_topo; ++kind) {
+    Plan_topo plan;
+    Build_topo(t, kind, -1, &plan);
+    unsigned long long stream = RunPlan(&plan, workers, false);
+    unsigned long long ping = RunPlan(&plan, 2, true);
+    Print(STDOUT_FILENO_linux, planNames[kind]);
+    Print(STDOUT_FILENO_linux, ": ");
+    PrintU64(STDOUT_FILENO_linux, (unsigned long long)workers * STREAM_PASSES * STREAM_BYTES * 1000 / stream);
+    Print(STDOUT_FILENO_linux, " MB/s aggregate, ");
+    PrintU64(STDOUT_FILENO_linux, ping / PINGS);
+    Print(STDOUT_FILENO_linux, " ns round trip (cpu ");
+    PrintU64(STDOUT_FILENO_linux, plan.cpus[0]);
+    Print(STDOUT_FILENO_linux, " <-> cpu ");
+    PrintU64(STDOUT_FILENO_linux, plan.cpus[1 % plan.count]);
+    Print(STDOUT_FILENO_linux, ")\n");
+  }
+  munmap_linux(shared, sizeof(Shared));
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  static Topology_topo t;
+  Assert(Load_topo(&t) == 0);
+  Topology_demo(&t);
+  Bench_demo(&t);
+  exit_linux(0);
+  return 0;
+}
@@ -0,0 +1,1121 @@
+#ifndef C_TRACE_HEADER
+#define C_TRACE_HEADER
+
+// === trace.h: seccomp-filtered syscall profiler ==============================
+//
+// Contents:
+//   * profiler                     (jump: Run_trace)
+//   * names                        (jump: Name_trace)
+//   * report                       (jump: Report_trace)
+//
+// Usage:
+//   trace.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/trace.h" // use as header file
+//
+//   #define C_TRACE_IMPLEMENTATION
+//   #include "c/trace.h" // use as implementation file
+//
+//   strace stops the target twice per syscall, at entry and at exit, and
+//   each stop is two context switches through the tracer: a syscall-heavy
+//   program runs many times slower. Run_trace forks the target under
+//   ptrace_linux but installs a seccomp filter in the child before the
+//   exec, returning SECCOMP_RET_TRACE for the selected syscalls and ALLOW
+//   for the rest, so everything else runs at full speed. A selected syscall
+//   stops once at PTRACE_EVENT_SECCOMP, where the call is counted and timed,
+//   and is resumed with PTRACE_SYSCALL to stop again at its exit for the
+//   result; the thread then runs with PTRACE_CONT until its next selected
+//   syscall. Forks, vforks and threads are followed and inherit the filter.
+//
+//     static Profile_trace p; // counters for every syscall number: keep off the stack
+//     Select_trace(&p, NR_openat_linux);
+//     Select_trace(&p, NR_read_linux);
+//     long code = Run_trace(&p, "/bin/sh", argv, envp); // exit code, or 128 + signal
+//     Report_trace(&p, STDERR_FILENO_linux);
+//
+//   Selecting nothing traces every syscall, at two stops each like strace;
+//   FULL_trace stops at every entry and exit with PTRACE_SYSCALL instead,
+//   for comparison. Time per call runs from the seccomp stop to the exit
+//   stop, so like strace -c it includes one trip through the tracer.
+//
+//   Syscall numbers are named from the linux.h NR_*_linux table for the
+//   architecture that made the call, read from PTRACE_GET_SYSCALL_INFO
+//   (5.3+): a 64-bit profiler also names the syscalls of i386 or arm32
+//   targets, which are counted apart. The filter sets PR_SET_NO_NEW_PRIVS in
+//   the target, which ptrace already implies for set-user-ID programs.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "trace.h depends on linux.h, include it first"
+#endif
+
+#define NRS_trace     1024 // counted syscall numbers; higher ones share the last slot
+#define ERRORS_trace  1024 // distinct (syscall, errno) pairs
+#define THREADS_trace 4096 // traced threads alive at once
+
+#define FULL_trace 1 // Profile_trace.flags: stop at every entry and exit, like strace
+
+typedef struct {
+  unsigned long long calls;
+  unsigned long long errors;
+  unsigned long long ns; // seccomp stop to exit stop
+} Counter_trace;
+
+typedef struct {
+  unsigned int key; // (abi * NRS_trace + slot) << 12 | errno, 0 if free
+  unsigned long long count;
+} Error_trace;
+
+typedef struct {
+  int tid;           // 0 if free
+  int abi;           // 0 native, 1 foreign; -1 between syscalls
+  unsigned int slot; // counter of the syscall in progress
+  unsigned long long entered_ns;
+} Thread_trace;
+
+typedef struct {
+  int flags;                              // FULL_trace
+  unsigned int selected[NRS_trace / 32];  // native syscalls to stop at, none means all
+  unsigned int foreign_arch;              // AUDIT_ARCH_* of foreign-ABI calls seen, or 0
+  Counter_trace counters[2][NRS_trace];   // native, then foreign ABI
+  Error_trace errors[ERRORS_trace];
+  Thread_trace threads[THREADS_trace];
+  sock_filter_linux filter[2 * NRS_trace + 8];
+  unsigned long long stops;               // ptrace stops taken
+  unsigned int untracked;                 // threads started with the table full, run but not counted
+  unsigned long long elapsed_ns;          // fork to the last traced exit
+  int pid;
+  int status;                             // wait status of the target
+} Profile_trace;
+
+//
+// Profiler
+//
+long Select_trace(Profile_trace *p, unsigned long nr);
+long Run_trace(Profile_trace *p, const char *path, const char *const *argv, const char *const *envp);
+//
+// Names
+//
+const char *Name_trace(unsigned int arch, unsigned long nr);
+long Lookup_trace(unsigned int arch, const char *name);
+const char *Errno_trace(unsigned int err);
+//
+// Report
+//
+long Report_trace(const Profile_trace *p, int fd);
+
+#endif // C_TRACE_HEADER
+#ifdef C_TRACE_IMPLEMENTATION
+
+typedef struct {
+  const char *name;
+  int nr[6]; // x86_64, arm64, riscv64, x86_32, arm32, riscv32; -1 if missing
+} Syscall_trace;
+
+// The linux.h NR_*_linux table with every architecture's column, as an
+// X-macro: the same rows build syscalls_trace[] and, below it, a compile-time
+// check that the target's column agrees with NR_*_linux.
+#define SYSCALLS_trace(X) \
+  X(fork, 57, -1, -1, 2, 2, -1)                               \
+  X(vfork, 58, -1, -1, 190, 190, -1)                          \
+  X(clone, 56, 220, 220, 120, 120, 220)                       \
+  X(clone3, 435, 435, 435, 435, 435, 435)                     \
+  X(execve, 59, 221, 221, 11, 11, 221)                        \
+  X(execveat, 322, 281, 281, 358, 387, 281)                   \
+  X(exit, 60, 93, 93, 1, 1, 93)                               \
+  X(exit_group, 231, 94, 94, 252, 248, 94)                    \
+  X(wait4, 61, 260, 260, 114, 114, -1)                        \
+  X(waitid, 247, 95, 95, 284, 280, 95)                        \
+  X(waitpid, -1, -1, -1, 7, -1, -1)                           \
+  X(getpid, 39, 172, 172, 20, 20, 172)                        \
+  X(getppid, 110, 173, 173, 64, 64, 173)                      \
+  X(gettid, 186, 178, 178, 224, 224, 178)                     \
+  X(getpgid, 121, 155, 155, 132, 132, 155)                    \
+  X(setpgid, 109, 154, 154, 57, 57, 154)                      \
+  X(getpgrp, 111, -1, -1, 65, 65, -1)                         \
+  X(getsid, 124, 156, 156, 147, 147, 156)                     \
+  X(setsid, 112, 157, 157, 66, 66, 157)                       \
+  X(set_tid_address, 218, 96, 96, 258, 256, 96)               \
+  X(prctl, 157, 167, 167, 172, 172, 167)                      \
+  X(personality, 135, 92, 92, 136, 136, 92)                   \
+  X(sched_setscheduler, 144, 119, 119, 156, 156, 119)         \
+  X(sched_getscheduler, 145, 120, 120, 157, 157, 120)         \
+  X(sched_setparam, 142, 118, 118, 154, 154, 118)             \
+  X(sched_getparam, 143, 121, 121, 155, 155, 121)             \
+  X(sched_setattr, 314, 274, 274, 351, 380, 274)              \
+  X(sched_getattr, 315, 275, 275, 352, 381, 275)              \
+  X(sched_yield, 24, 124, 124, 158, 158, 124)                 \
+  X(sched_get_priority_max, 146, 125, 125, 159, 159, 125)     \
+  X(sched_get_priority_min, 147, 126, 126, 160, 160, 126)     \
+  X(sched_rr_get_interval, 148, 127, 127, 161, 161, -1)       \
+  X(sched_rr_get_interval_time64, -1, 423, -1, 423, 423, 423) \
+  X(sched_setaffinity, 203, 122, 122, 241, 241, 122)          \
+  X(sched_getaffinity, 204, 123, 123, 242, 242, 123)          \
+  X(nice, -1, -1, -1, 34, 34, -1)                             \
+  X(setpriority, 141, 140, 140, 97, 97, 140)                  \
+  X(getpriority, 140, 141, 141, 96, 96, 141)                  \
+  X(brk, 12, 214, 214, 45, 45, 214)                           \
+  X(mmap, 9, 222, 222, 90, -1, -1)                            \
+  X(mmap2, -1, 222, -1, 192, 192, 222)                        \
+  X(munmap, 11, 215, 215, 91, 91, 215)                        \
+  X(mremap, 25, 216, 216, 163, 163, 216)                      \
+  X(remap_file_pages, 216, 234, 234, 257, 253, 234)           \
+  X(mprotect, 10, 226, 226, 125, 125, 226)                    \
+  X(pkey_mprotect, 329, 288, 288, 380, 394, 288)              \
+  X(madvise, 28, 233, 233, 219, 220, 233)                     \
+  X(process_madvise, 440, 440, 440, 440, 440, 440)            \
+  X(mlock, 149, 228, 228, 150, 150, 228)                      \
+  X(mlock2, 325, 284, 284, 376, 390, 284)                     \
+  X(munlock, 150, 229, 229, 151, 151, 229)                    \
+  X(mlockall, 151, 230, 230, 152, 152, 230)                   \
+  X(munlockall, 152, 231, 231, 153, 153, 231)                 \
+  X(mincore, 27, 232, 232, 218, 219, 232)                     \
+  X(msync, 26, 227, 227, 144, 144, 227)                       \
+  X(mseal, 462, 462, 462, 462, 462, 462)                      \
+  X(mbind, 237, 235, 235, 274, 319, 235)                      \
+  X(set_mempolicy, 238, 237, 237, 276, 321, 237)              \
+  X(get_mempolicy, 239, 236, 236, 275, 320, 236)              \
+  X(set_mempolicy_home_node, 450, 450, 450, 450, 450, 450)    \
+  X(migrate_pages, 256, 238, 238, 294, 400, 238)              \
+  X(move_pages, 279, 239, 239, 317, 344, 239)                 \
+  X(memfd_create, 319, 279, 279, 356, 385, 279)               \
+  X(memfd_secret, 447, 447, 447, 447, -1, 447)                \
+  X(pkey_alloc, 330, 289, 289, 381, 395, 289)                 \
+  X(pkey_free, 331, 290, 290, 382, 396, 290)                  \
+  X(map_shadow_stack, 453, 453, 453, 453, 453, 453)           \
+  X(userfaultfd, 323, 282, 282, 374, 388, 282)                \
+  X(process_mrelease, 448, 448, 448, 448, 448, 448)           \
+  X(membarrier, 324, 283, 283, 375, 389, 283)                 \
+  X(open, 2, -1, -1, 5, 5, -1)                                \
+  X(openat, 257, 56, 56, 295, 322, 56)                        \
+  X(openat2, 437, 437, 437, 437, 437, 437)                    \
+  X(creat, 85, -1, -1, 8, 8, -1)                              \
+  X(close, 3, 57, 57, 6, 6, 57)                               \
+  X(close_range, 436, 436, 436, 436, 436, 436)                \
+  X(open_by_handle_at, 304, 265, 265, 342, 371, 265)          \
+  X(name_to_handle_at, 303, 264, 264, 341, 370, 264)          \
+  X(read, 0, 63, 63, 3, 3, 63)                                \
+  X(write, 1, 64, 64, 4, 4, 64)                               \
+  X(readv, 19, 65, 65, 145, 145, 65)                          \
+  X(writev, 20, 66, 66, 146, 146, 66)                         \
+  X(pread64, 17, 67, 67, 180, 180, 67)                        \
+  X(pwrite64, 18, 68, 68, 181, 181, 68)                       \
+  X(preadv, 295, 69, 69, 333, 361, 69)                        \
+  X(pwritev, 296, 70, 70, 334, 362, 70)                       \
+  X(preadv2, 327, 286, 286, 378, 392, 286)                    \
+  X(pwritev2, 328, 287, 287, 379, 393, 287)                   \
+  X(lseek, 8, 62, 62, 19, 19, -1)                             \
+  X(llseek, -1, 62, -1, -1, -1, 62)                           \
+  X(_llseek, -1, -1, -1, 140, 140, -1)                        \
+  X(truncate, 76, 45, 45, 92, 92, -1)                         \
+  X(truncate64, -1, 45, -1, 193, 193, 45)                     \
+  X(ftruncate, 77, 46, 46, 93, 93, -1)                        \
+  X(ftruncate64, -1, 46, -1, 194, 194, 46)                    \
+  X(sendfile, 40, 71, 71, 187, 187, -1)                       \
+  X(sendfile64, -1, 71, -1, 239, 239, 71)                     \
+  X(splice, 275, 76, 76, 313, 340, 76)                        \
+  X(tee, 276, 77, 77, 315, 342, 77)                           \
+  X(vmsplice, 278, 75, 75, 316, 343, 75)                      \
+  X(copy_file_range, 326, 285, 285, 377, 391, 285)            \
+  X(fadvise64, 221, 223, 223, 250, -1, -1)                    \
+  X(fadvise64_64, -1, 223, -1, 272, -1, 223)                  \
+  X(arm_fadvise64_64, -1, -1, -1, -1, 270, -1)                \
+  X(readahead, 187, 213, 213, 225, 225, 213)                  \
+  X(fallocate, 285, 47, 47, 324, 352, 47)                     \
+  X(sync, 162, 81, 81, 36, 36, 81)                            \
+  X(syncfs, 306, 267, 267, 344, 373, 267)                     \
+  X(fsync, 74, 82, 82, 118, 118, 82)                          \
+  X(fdatasync, 75, 83, 83, 148, 148, 83)                      \
+  X(sync_file_range, 277, 84, 84, 314, -1, 84)                \
+  X(arm_sync_file_range, -1, -1, -1, -1, 341, -1)             \
+  X(dup, 32, 23, 23, 41, 41, 23)                              \
+  X(dup2, 33, -1, -1, 63, 63, -1)                             \
+  X(dup3, 292, 24, 24, 330, 358, 24)                          \
+  X(fcntl, 72, 25, 25, 55, 55, -1)                            \
+  X(fcntl64, -1, 25, -1, 221, 221, 25)                        \
+  X(ioctl, 16, 29, 29, 54, 54, 29)                            \
+  X(select, 23, -1, -1, 82, -1, -1)                           \
+  X(_newselect, -1, -1, -1, 142, 142, -1)                     \
+  X(pselect6, 270, 72, 72, 308, 335, -1)                      \
+  X(pselect6_time64, -1, 413, -1, 413, 413, 413)              \
+  X(poll, 7, -1, -1, 168, 168, -1)                            \
+  X(ppoll, 271, 73, 73, 309, 336, -1)                         \
+  X(ppoll_time64, -1, 414, -1, 414, 414, 414)                 \
+  X(epoll_create, 213, -1, -1, 254, 250, -1)                  \
+  X(epoll_create1, 291, 20, 20, 329, 357, 20)                 \
+  X(epoll_ctl, 233, 21, 21, 255, 251, 21)                     \
+  X(epoll_wait, 232, -1, -1, 256, 252, -1)                    \
+  X(epoll_pwait, 281, 22, 22, 319, 346, 22)                   \
+  X(epoll_pwait2, 441, 441, 441, 441, 441, 441)               \
+  X(epoll_ctl_old, 214, -1, -1, -1, -1, -1)                   \
+  X(epoll_wait_old, 215, -1, -1, -1, -1, -1)                  \
+  X(stat, 4, -1, -1, 106, 106, -1)                            \
+  X(fstat, 5, 80, 80, 108, 108, -1)                           \
+  X(lstat, 6, -1, -1, 107, 107, -1)                           \
+  X(stat64, -1, -1, -1, 195, 195, -1)                         \
+  X(fstat64, -1, 80, -1, 197, 197, -1)                        \
+  X(lstat64, -1, -1, -1, 196, 196, -1)                        \
+  X(newfstatat, 262, 79, 79, -1, -1, -1)                      \
+  X(fstatat64, -1, 79, -1, 300, 327, -1)                      \
+  X(statx, 332, 291, 291, 383, 397, 291)                      \
+  X(oldstat, -1, -1, -1, 18, -1, -1)                          \
+  X(oldfstat, -1, -1, -1, 28, -1, -1)                         \
+  X(oldlstat, -1, -1, -1, 84, -1, -1)                         \
+  X(file_getattr, 468, 468, 468, 468, 468, 468)               \
+  X(chmod, 90, -1, -1, 15, 15, -1)                            \
+  X(fchmod, 91, 52, 52, 94, 94, 52)                           \
+  X(fchmodat, 268, 53, 53, 306, 333, 53)                      \
+  X(fchmodat2, 452, 452, 452, 452, 452, 452)                  \
+  X(umask, 95, 166, 166, 60, 60, 166)                         \
+  X(chown, 92, -1, -1, 182, 182, -1)                          \
+  X(fchown, 93, 55, 55, 95, 95, 55)                           \
+  X(lchown, 94, -1, -1, 16, 16, -1)                           \
+  X(chown32, -1, -1, -1, 212, 212, -1)                        \
+  X(fchown32, -1, -1, -1, 207, 207, -1)                       \
+  X(lchown32, -1, -1, -1, 198, 198, -1)                       \
+  X(fchownat, 260, 54, 54, 298, 325, 54)                      \
+  X(file_setattr, 469, 469, 469, 469, 469, 469)               \
+  X(utime, 132, -1, -1, 30, -1, -1)                           \
+  X(utimes, 235, -1, -1, 271, 269, -1)                        \
+  X(futimesat, 261, -1, -1, 299, 326, -1)                     \
+  X(utimensat, 280, 88, 88, 320, 348, -1)                     \
+  X(utimensat_time64, -1, 412, -1, 412, 412, 412)             \
+  X(access, 21, -1, -1, 33, 33, -1)                           \
+  X(faccessat, 269, 48, 48, 307, 334, 48)                     \
+  X(faccessat2, 439, 439, 439, 439, 439, 439)                 \
+  X(setxattr, 188, 5, 5, 226, 226, 5)                         \
+  X(lsetxattr, 189, 6, 6, 227, 227, 6)                        \
+  X(fsetxattr, 190, 7, 7, 228, 228, 7)                        \
+  X(setxattrat, 463, 463, 463, 463, 463, 463)                 \
+  X(getxattr, 191, 8, 8, 229, 229, 8)                         \
+  X(lgetxattr, 192, 9, 9, 230, 230, 9)                        \
+  X(fgetxattr, 193, 10, 10, 231, 231, 10)                     \
+  X(getxattrat, 464, 464, 464, 464, 464, 464)                 \
+  X(listxattr, 194, 11, 11, 232, 232, 11)                     \
+  X(llistxattr, 195, 12, 12, 233, 233, 12)                    \
+  X(flistxattr, 196, 13, 13, 234, 234, 13)                    \
+  X(listxattrat, 465, 465, 465, 465, 465, 465)                \
+  X(removexattr, 197, 14, 14, 235, 235, 14)                   \
+  X(lremovexattr, 198, 15, 15, 236, 236, 15)                  \
+  X(fremovexattr, 199, 16, 16, 237, 237, 16)                  \
+  X(removexattrat, 466, 466, 466, 466, 466, 466)              \
+  X(flock, 73, 32, 32, 143, 143, 32)                          \
+  X(mkdir, 83, -1, -1, 39, 39, -1)                            \
+  X(mkdirat, 258, 34, 34, 296, 323, 34)                       \
+  X(rmdir, 84, -1, -1, 40, 40, -1)                            \
+  X(getdents, 78, -1, -1, 141, 141, -1)                       \
+  X(getdents64, 217, 61, 61, 220, 217, 61)                    \
+  X(readdir, -1, -1, -1, 89, -1, -1)                          \
+  X(getcwd, 79, 17, 17, 183, 183, 17)                         \
+  X(chdir, 80, 49, 49, 12, 12, 49)                            \
+  X(fchdir, 81, 50, 50, 133, 133, 50)                         \
+  X(link, 86, -1, -1, 9, 9, -1)                               \
+  X(linkat, 265, 37, 37, 303, 330, 37)                        \
+  X(unlink, 87, -1, -1, 10, 10, -1)                           \
+  X(unlinkat, 263, 35, 35, 301, 328, 35)                      \
+  X(symlink, 88, -1, -1, 83, 83, -1)                          \
+  X(symlinkat, 266, 36, 36, 304, 331, 36)                     \
+  X(readlink, 89, -1, -1, 85, 85, -1)                         \
+  X(readlinkat, 267, 78, 78, 305, 332, 78)                    \
+  X(rename, 82, -1, -1, 38, 38, -1)                           \
+  X(renameat, 264, 38, -1, 302, 329, -1)                      \
+  X(renameat2, 316, 276, 276, 353, 382, 276)                  \
+  X(mknod, 133, -1, -1, 14, 14, -1)                           \
+  X(mknodat, 259, 33, 33, 297, 324, 33)                       \
+  X(mount, 165, 40, 40, 21, 21, 40)                           \
+  X(umount, -1, -1, -1, 22, -1, -1)                           \
+  X(umount2, 166, 39, 39, 52, 52, 39)                         \
+  X(pivot_root, 155, 41, 41, 217, 218, 41)                    \
+  X(chroot, 161, 51, 51, 61, 61, 51)                          \
+  X(mount_setattr, 442, 442, 442, 442, 442, 442)              \
+  X(move_mount, 429, 429, 429, 429, 429, 429)                 \
+  X(open_tree, 428, 428, 428, 428, 428, 428)                  \
+  X(open_tree_attr, 467, 467, 467, 467, 467, 467)             \
+  X(fsconfig, 431, 431, 431, 431, 431, 431)                   \
+  X(fsmount, 432, 432, 432, 432, 432, 432)                    \
+  X(fsopen, 430, 430, 430, 430, 430, 430)                     \
+  X(fspick, 433, 433, 433, 433, 433, 433)                     \
+  X(statfs, 137, 43, 43, 99, 99, -1)                          \
+  X(fstatfs, 138, 44, 44, 100, 100, -1)                       \
+  X(statfs64, -1, 43, -1, 268, 266, 43)                       \
+  X(fstatfs64, -1, 44, -1, 269, 267, 44)                      \
+  X(ustat, 136, -1, -1, 62, 62, -1)                           \
+  X(statmount, 457, 457, 457, 457, 457, 457)                  \
+  X(listmount, 458, 458, 458, 458, 458, 458)                  \
+  X(quotactl, 179, 60, 60, 131, 131, 60)                      \
+  X(quotactl_fd, 443, 443, 443, 443, 443, 443)                \
+  X(inotify_init, 253, -1, -1, 291, 316, -1)                  \
+  X(inotify_init1, 294, 26, 26, 332, 360, 26)                 \
+  X(inotify_add_watch, 254, 27, 27, 292, 317, 27)             \
+  X(inotify_rm_watch, 255, 28, 28, 293, 318, 28)              \
+  X(fanotify_init, 300, 262, 262, 338, 367, 262)              \
+  X(fanotify_mark, 301, 263, 263, 339, 368, 263)              \
+  X(signal, -1, -1, -1, 48, -1, -1)                           \
+  X(sigaction, -1, -1, -1, 67, 67, -1)                        \
+  X(rt_sigaction, 13, 134, 134, 174, 174, 134)                \
+  X(kill, 62, 129, 129, 37, 37, 129)                          \
+  X(tkill, 200, 130, 130, 238, 238, 130)                      \
+  X(tgkill, 234, 131, 131, 270, 268, 131)                     \
+  X(rt_sigqueueinfo, 129, 138, 138, 178, 178, 138)            \
+  X(rt_tgsigqueueinfo, 297, 240, 240, 335, 363, 240)          \
+  X(sigprocmask, -1, -1, -1, 126, 126, -1)                    \
+  X(rt_sigprocmask, 14, 135, 135, 175, 175, 135)              \
+  X(sgetmask, -1, -1, -1, 68, -1, -1)                         \
+  X(ssetmask, -1, -1, -1, 69, -1, -1)                         \
+  X(sigpending, -1, -1, -1, 73, 73, -1)                       \
+  X(rt_sigpending, 127, 136, 136, 176, 176, 136)              \
+  X(sigsuspend, -1, -1, -1, 72, 72, -1)                       \
+  X(rt_sigsuspend, 130, 133, 133, 179, 179, 133)              \
+  X(pause, 34, -1, -1, 29, 29, -1)                            \
+  X(rt_sigtimedwait, 128, 137, 137, 177, 177, -1)             \
+  X(rt_sigtimedwait_time64, -1, 421, -1, 421, 421, 421)       \
+  X(sigaltstack, 131, 132, 132, 186, 186, 132)                \
+  X(sigreturn, -1, -1, -1, 119, 119, -1)                      \
+  X(rt_sigreturn, 15, 139, 139, 173, 173, 139)                \
+  X(signalfd, 282, -1, -1, 321, 349, -1)                      \
+  X(signalfd4, 289, 74, 74, 327, 355, 74)                     \
+  X(pipe, 22, -1, -1, 42, 42, -1)                             \
+  X(pipe2, 293, 59, 59, 331, 359, 59)                         \
+  X(shmget, 29, 194, 194, 395, 307, 194)                      \
+  X(shmat, 30, 196, 196, 397, 305, 196)                       \
+  X(shmdt, 67, 197, 197, 398, 306, 197)                       \
+  X(shmctl, 31, 195, 195, 396, 308, 195)                      \
+  X(msgget, 68, 186, 186, 399, 303, 186)                      \
+  X(msgsnd, 69, 189, 189, 400, 301, 189)                      \
+  X(msgrcv, 70, 188, 188, 401, 302, 188)                      \
+  X(msgctl, 71, 187, 187, 402, 304, 187)                      \
+  X(semget, 64, 190, 190, 393, 299, 190)                      \
+  X(semop, 65, 193, 193, -1, 298, 193)                        \
+  X(semctl, 66, 191, 191, 394, 300, 191)                      \
+  X(semtimedop, 220, 192, 192, -1, 312, -1)                   \
+  X(semtimedop_time64, -1, 420, -1, 420, 420, 420)            \
+  X(mq_open, 240, 180, 180, 277, 274, 180)                    \
+  X(mq_unlink, 241, 181, 181, 278, 275, 181)                  \
+  X(mq_timedsend, 242, 182, 182, 279, 276, -1)                \
+  X(mq_timedsend_time64, -1, 418, -1, 418, 418, 418)          \
+  X(mq_timedreceive, 243, 183, 183, 280, 277, -1)             \
+  X(mq_timedreceive_time64, -1, 419, -1, 419, 419, 419)       \
+  X(mq_notify, 244, 184, 184, 281, 278, 184)                  \
+  X(mq_getsetattr, 245, 185, 185, 282, 279, 185)              \
+  X(futex, 202, 98, 98, 240, 240, -1)                         \
+  X(futex_time64, -1, 422, -1, 422, 422, 422)                 \
+  X(futex_wait, 455, 455, 455, 455, 455, 455)                 \
+  X(futex_wake, 454, 454, 454, 454, 454, 454)                 \
+  X(futex_waitv, 449, 449, 449, 449, 449, 449)                \
+  X(futex_requeue, 456, 456, 456, 456, 456, 456)              \
+  X(set_robust_list, 273, 99, 99, 311, 338, 99)               \
+  X(get_robust_list, 274, 100, 100, 312, 339, 100)            \
+  X(eventfd, 284, -1, -1, 323, 351, -1)                       \
+  X(eventfd2, 290, 19, 19, 328, 356, 19)                      \
+  X(socket, 41, 198, 198, 359, 281, 198)                      \
+  X(socketpair, 53, 199, 199, 360, 288, 199)                  \
+  X(bind, 49, 200, 200, 361, 282, 200)                        \
+  X(listen, 50, 201, 201, 363, 284, 201)                      \
+  X(accept, 43, 202, 202, -1, 285, 202)                       \
+  X(accept4, 288, 242, 242, 364, 366, 242)                    \
+  X(connect, 42, 203, 203, 362, 283, 203)                     \
+  X(shutdown, 48, 210, 210, 373, 293, 210)                    \
+  X(socketcall, -1, -1, -1, 102, -1, -1)                      \
+  X(send, -1, -1, -1, -1, 289, -1)                            \
+  X(sendto, 44, 206, 206, 369, 290, 206)                      \
+  X(sendmsg, 46, 211, 211, 370, 296, 211)                     \
+  X(sendmmsg, 307, 269, 269, 345, 374, 269)                   \
+  X(recv, -1, -1, -1, -1, 291, -1)                            \
+  X(recvfrom, 45, 207, 207, 371, 292, 207)                    \
+  X(recvmsg, 47, 212, 212, 372, 297, 212)                     \
+  X(recvmmsg, 299, 243, 243, 337, 365, -1)                    \
+  X(recvmmsg_time64, -1, 417, -1, 417, 417, 417)              \
+  X(getsockopt, 55, 209, 209, 365, 295, 209)                  \
+  X(setsockopt, 54, 208, 208, 366, 294, 208)                  \
+  X(getsockname, 51, 204, 204, 367, 286, 204)                 \
+  X(getpeername, 52, 205, 205, 368, 287, 205)                 \
+  X(io_setup, 206, 0, 0, 245, 243, 0)                         \
+  X(io_destroy, 207, 1, 1, 246, 244, 1)                       \
+  X(io_submit, 209, 2, 2, 248, 246, 2)                        \
+  X(io_cancel, 210, 3, 3, 249, 247, 3)                        \
+  X(io_getevents, 208, 4, 4, 247, 245, -1)                    \
+  X(io_pgetevents, 333, 292, 292, 385, 399, -1)               \
+  X(io_pgetevents_time64, -1, 416, -1, 416, 416, 416)         \
+  X(io_uring_setup, 425, 425, 425, 425, 425, 425)             \
+  X(io_uring_enter, 426, 426, 426, 426, 426, 426)             \
+  X(io_uring_register, 427, 427, 427, 427, 427, 427)          \
+  X(time, 201, -1, -1, 13, -1, -1)                            \
+  X(gettimeofday, 96, 169, 169, 78, 78, -1)                   \
+  X(clock_gettime, 228, 113, 113, 265, 263, -1)               \
+  X(clock_gettime64, -1, 403, -1, 403, 403, 403)              \
+  X(clock_getres, 229, 114, 114, 266, 264, -1)                \
+  X(clock_getres_time64, -1, 406, -1, 406, 406, 406)          \
+  X(settimeofday, 164, 170, 170, 79, 79, -1)                  \
+  X(clock_settime, 227, 112, 112, 264, 262, -1)               \
+  X(clock_settime64, -1, 404, -1, 404, 404, 404)              \
+  X(stime, -1, -1, -1, 25, -1, -1)                            \
+  X(adjtimex, 159, 171, 171, 124, 124, -1)                    \
+  X(clock_adjtime, 305, 266, 266, 343, 372, -1)               \
+  X(clock_adjtime64, -1, 405, -1, 405, 405, 405)              \
+  X(nanosleep, 35, 101, 101, 162, 162, -1)                    \
+  X(clock_nanosleep, 230, 115, 115, 267, 265, -1)             \
+  X(clock_nanosleep_time64, -1, 407, -1, 407, 407, 407)       \
+  X(alarm, 37, -1, -1, 27, -1, -1)                            \
+  X(setitimer, 38, 103, 103, 104, 104, 103)                   \
+  X(getitimer, 36, 102, 102, 105, 105, 102)                   \
+  X(timer_create, 222, 107, 107, 259, 257, 107)               \
+  X(timer_settime, 223, 110, 110, 260, 258, -1)               \
+  X(timer_settime64, -1, 409, -1, 409, 409, 409)              \
+  X(timer_gettime, 224, 108, 108, 261, 259, -1)               \
+  X(timer_gettime64, -1, 408, -1, 408, 408, 408)              \
+  X(timer_getoverrun, 225, 109, 109, 262, 260, 109)           \
+  X(timer_delete, 226, 111, 111, 263, 261, 111)               \
+  X(timerfd_create, 283, 85, 85, 322, 350, 85)                \
+  X(timerfd_settime, 286, 86, 86, 325, 353, -1)               \
+  X(timerfd_settime64, -1, 411, -1, 411, 411, 411)            \
+  X(timerfd_gettime, 287, 87, 87, 326, 354, -1)               \
+  X(timerfd_gettime64, -1, 410, -1, 410, 410, 410)            \
+  X(getrandom, 318, 278, 278, 355, 384, 278)                  \
+  X(getuid, 102, 174, 174, 24, 24, 174)                       \
+  X(geteuid, 107, 175, 175, 49, 49, 175)                      \
+  X(setuid, 105, 146, 146, 23, 23, 146)                       \
+  X(setreuid, 113, 145, 145, 70, 70, 145)                     \
+  X(setresuid, 117, 147, 147, 164, 164, 147)                  \
+  X(getresuid, 118, 148, 148, 165, 165, 148)                  \
+  X(setfsuid, 122, 151, 151, 138, 138, 151)                   \
+  X(getuid32, -1, -1, -1, 199, 199, -1)                       \
+  X(geteuid32, -1, -1, -1, 201, 201, -1)                      \
+  X(setuid32, -1, -1, -1, 213, 213, -1)                       \
+  X(setreuid32, -1, -1, -1, 203, 203, -1)                     \
+  X(setresuid32, -1, -1, -1, 208, 208, -1)                    \
+  X(getresuid32, -1, -1, -1, 209, 209, -1)                    \
+  X(setfsuid32, -1, -1, -1, 215, 215, -1)                     \
+  X(getgid, 104, 176, 176, 47, 47, 176)                       \
+  X(getegid, 108, 177, 177, 50, 50, 177)                      \
+  X(setgid, 106, 144, 144, 46, 46, 144)                       \
+  X(setregid, 114, 143, 143, 71, 71, 143)                     \
+  X(setresgid, 119, 149, 149, 170, 170, 149)                  \
+  X(getresgid, 120, 150, 150, 171, 171, 150)                  \
+  X(setfsgid, 123, 152, 152, 139, 139, 152)                   \
+  X(getgid32, -1, -1, -1, 200, 200, -1)                       \
+  X(getegid32, -1, -1, -1, 202, 202, -1)                      \
+  X(setgid32, -1, -1, -1, 214, 214, -1)                       \
+  X(setregid32, -1, -1, -1, 204, 204, -1)                     \
+  X(setresgid32, -1, -1, -1, 210, 210, -1)                    \
+  X(getresgid32, -1, -1, -1, 211, 211, -1)                    \
+  X(setfsgid32, -1, -1, -1, 216, 216, -1)                     \
+  X(getgroups, 115, 158, 158, 80, 80, 158)                    \
+  X(setgroups, 116, 159, 159, 81, 81, 159)                    \
+  X(getgroups32, -1, -1, -1, 205, 205, -1)                    \
+  X(setgroups32, -1, -1, -1, 206, 206, -1)                    \
+  X(capget, 125, 90, 90, 184, 184, 90)                        \
+  X(capset, 126, 91, 91, 185, 185, 91)                        \
+  X(seccomp, 317, 277, 277, 354, 383, 277)                    \
+  X(security, 185, -1, -1, -1, -1, -1)                        \
+  X(lsm_get_self_attr, 459, 459, 459, 459, 459, 459)          \
+  X(lsm_set_self_attr, 460, 460, 460, 460, 460, 460)          \
+  X(lsm_list_modules, 461, 461, 461, 461, 461, 461)           \
+  X(landlock_create_ruleset, 444, 444, 444, 444, 444, 444)    \
+  X(landlock_add_rule, 445, 445, 445, 445, 445, 445)          \
+  X(landlock_restrict_self, 446, 446, 446, 446, 446, 446)     \
+  X(add_key, 248, 217, 217, 286, 309, 217)                    \
+  X(request_key, 249, 218, 218, 287, 310, 218)                \
+  X(keyctl, 250, 219, 219, 288, 311, 219)                     \
+  X(getrlimit, 97, 163, 163, 76, -1, -1)                      \
+  X(setrlimit, 160, 164, 164, 75, 75, -1)                     \
+  X(prlimit64, 302, 261, 261, 340, 369, 261)                  \
+  X(ugetrlimit, -1, -1, -1, 191, 191, -1)                     \
+  X(ulimit, -1, -1, -1, 58, -1, -1)                           \
+  X(getrusage, 98, 165, 165, 77, 77, 165)                     \
+  X(times, 100, 153, 153, 43, 43, 153)                        \
+  X(acct, 163, 89, 89, 51, 51, 89)                            \
+  X(unshare, 272, 97, 97, 310, 337, 97)                       \
+  X(setns, 308, 268, 268, 346, 375, 268)                      \
+  X(listns, 470, 470, 470, 470, 470, 470)                     \
+  X(kcmp, 312, 272, 272, 349, 378, 272)                       \
+  X(pidfd_open, 434, 434, 434, 434, 434, 434)                 \
+  X(pidfd_getfd, 438, 438, 438, 438, 438, 438)                \
+  X(pidfd_send_signal, 424, 424, 424, 424, 424, 424)          \
+  X(process_vm_readv, 310, 270, 270, 347, 376, 270)           \
+  X(process_vm_writev, 311, 271, 271, 348, 377, 271)          \
+  X(ptrace, 101, 117, 117, 26, 26, 117)                       \
+  X(uname, 63, 160, 160, 122, 122, 160)                       \
+  X(olduname, -1, -1, -1, 109, -1, -1)                        \
+  X(oldolduname, -1, -1, -1, 59, -1, -1)                      \
+  X(gethostname, -1, -1, -1, -1, -1, -1)                      \
+  X(sethostname, 170, 161, 161, 74, 74, 161)                  \
+  X(setdomainname, 171, 162, 162, 121, 121, 162)              \
+  X(sysinfo, 99, 179, 179, 116, 116, 179)                     \
+  X(syslog, 103, 116, 116, 103, 103, 116)                     \
+  X(getcpu, 309, 168, 168, 318, 345, 168)                     \
+  X(create_module, 174, -1, -1, 127, -1, -1)                  \
+  X(init_module, 175, 105, 105, 128, 128, 105)                \
+  X(finit_module, 313, 273, 273, 350, 379, 273)               \
+  X(delete_module, 176, 106, 106, 129, 129, 106)              \
+  X(query_module, 178, -1, -1, 167, -1, -1)                   \
+  X(get_kernel_syms, 177, -1, -1, 130, -1, -1)                \
+  X(reboot, 169, 142, 142, 88, 88, 142)                       \
+  X(swapon, 167, 224, 224, 87, 87, 224)                       \
+  X(swapoff, 168, 225, 225, 115, 115, 225)                    \
+  X(kexec_load, 246, 104, 104, 283, 347, 104)                 \
+  X(kexec_file_load, 320, 294, 294, -1, 401, 294)             \
+  X(vhangup, 153, 58, 58, 111, 111, 58)                       \
+  X(perf_event_open, 298, 241, 241, 336, 364, 241)            \
+  X(uprobe, 336, -1, -1, -1, -1, -1)                          \
+  X(uretprobe, 335, -1, -1, -1, -1, -1)                       \
+  X(bpf, 321, 280, 280, 357, 386, 280)                        \
+  X(ioperm, 173, -1, -1, 101, -1, -1)                         \
+  X(iopl, 172, -1, -1, 110, -1, -1)                           \
+  X(ioprio_set, 251, 30, 30, 289, 314, 30)                    \
+  X(ioprio_get, 252, 31, 31, 290, 315, 31)                    \
+  X(cacheflush, -1, -1, -1, -1, 0x0f0002, -1)                 \
+  X(cachestat, 451, 451, 451, 451, 451, 451)                  \
+  X(arch_prctl, 158, -1, -1, 384, -1, -1)                     \
+  X(modify_ldt, 154, -1, -1, 123, -1, -1)                     \
+  X(set_thread_area, 205, -1, -1, 243, -1, -1)                \
+  X(get_thread_area, 211, -1, -1, 244, -1, -1)                \
+  X(vm86, -1, -1, -1, 166, -1, -1)                            \
+  X(vm86old, -1, -1, -1, 113, -1, -1)                         \
+  X(set_tls, -1, -1, -1, -1, 0x0f0005, -1)                    \
+  X(get_tls, -1, -1, -1, -1, 0x0f0006, -1)                    \
+  X(riscv_flush_icache, -1, -1, 259, -1, -1, 259)             \
+  X(riscv_hwprobe, -1, -1, 258, -1, -1, 258)                  \
+  X(rseq, 334, 293, 293, 386, 398, 293)                       \
+  X(restart_syscall, 219, 128, 128, 0, 0, 128)                \
+  X(lookup_dcookie, 212, 18, 18, 253, 249, 18)                \
+  X(mpx, -1, -1, -1, 56, -1, -1)                              \
+  X(pciconfig_read, -1, -1, -1, -1, 272, -1)                  \
+  X(pciconfig_write, -1, -1, -1, -1, 273, -1)                 \
+  X(pciconfig_iobase, -1, -1, -1, -1, 271, -1)                \
+  X(sysfs, 139, -1, -1, 135, 135, -1)                         \
+  X(_sysctl, 156, -1, -1, 149, 149, -1)                       \
+  X(ipc, -1, -1, -1, 117, -1, -1)                             \
+  X(profil, -1, -1, -1, 98, -1, -1)                           \
+  X(prof, -1, -1, -1, 44, -1, -1)                             \
+  X(afs_syscall, 183, -1, -1, 137, -1, -1)                    \
+  X(break, -1, -1, -1, 17, -1, -1)                            \
+  X(ftime, -1, -1, -1, 35, -1, -1)                            \
+  X(gtty, -1, -1, -1, 32, -1, -1)                             \
+  X(idle, -1, -1, -1, 112, -1, -1)                            \
+  X(lock, -1, -1, -1, 53, -1, -1)                             \
+  X(nfsservctl, 180, 42, 42, 169, 169, 42)                    \
+  X(getpmsg, 181, -1, -1, 188, -1, -1)                        \
+  X(putpmsg, 182, -1, -1, 189, -1, -1)                        \
+  X(stty, -1, -1, -1, 31, -1, -1)                             \
+  X(tuxcall, 184, -1, -1, -1, -1, -1)                         \
+  X(vserver, 236, -1, -1, 273, 313, -1)                       \
+  X(bdflush, -1, -1, -1, 134, 134, -1)                        \
+  X(uselib, 134, -1, -1, 86, 86, -1)
+
+#define ROW_trace(name, x86_64, arm64, riscv64, x86_32, arm32, riscv32) {#name, {x86_64, arm64, riscv64, x86_32, arm32, riscv32}},
+static const Syscall_trace syscalls_trace[] = {SYSCALLS_trace(ROW_trace)};
+
+// NR_*_linux is `void` where the target lacks a syscall, which a row spells -1.
+#define PICK_trace(x, n, ...) n
+#define PROBE_trace(...) PICK_trace(__VA_ARGS__, 0, )
+#define PROBE_trace_void ~, 1,
+#define VOID2_trace(x) PROBE_trace(PROBE_trace_##x)
+#define VOID_trace(x) VOID2_trace(x)
+#define IF_trace_0(yes, no) no
+#define IF_trace_1(yes, no) yes
+#define IF2_trace(c) IF_trace_##c
+#define IF_trace(c) IF2_trace(c)
+#define NR_trace(x) IF_trace(VOID_trace(x))(-1, x)
+#define CHECK_trace(name, x86_64, arm64, riscv64, x86_32, arm32, riscv32) \
+  _Static_assert(NR_trace(NR_##name##_linux) == BY_ARCH_linux(x86_64, arm64, riscv64, x86_32, arm32, riscv32), "syscalls_trace: " #name " differs from NR_" #name "_linux");
+SYSCALLS_trace(CHECK_trace)
+
+static const char *const errnos_trace[] = {
+  "", "EPERM", "ENOENT", "ESRCH", "EINTR", "EIO", "ENXIO", "E2BIG", "ENOEXEC", "EBADF", "ECHILD",
+  "EAGAIN", "ENOMEM", "EACCES", "EFAULT", "ENOTBLK", "EBUSY", "EEXIST", "EXDEV", "ENODEV", "ENOTDIR",
+  "EISDIR", "EINVAL", "ENFILE", "EMFILE", "ENOTTY", "ETXTBSY", "EFBIG", "ENOSPC", "ESPIPE", "EROFS",
+  "EMLINK", "EPIPE", "EDOM", "ERANGE", "EDEADLK", "ENAMETOOLONG", "ENOLCK", "ENOSYS", "ENOTEMPTY",
+  "ELOOP", "", "ENOMSG", "EIDRM", "ECHRNG", "EL2NSYNC", "EL3HLT", "EL3RST", "ELNRNG", "EUNATCH",
+  "ENOCSI", "EL2HLT", "EBADE", "EBADR", "EXFULL", "ENOANO", "EBADRQC", "EBADSLT", "", "EBFONT",
+  "ENOSTR", "ENODATA", "ETIME", "ENOSR", "ENONET", "ENOPKG", "EREMOTE", "ENOLINK", "EADV", "ESRMNT",
+  "ECOMM", "EPROTO", "EMULTIHOP", "EDOTDOT", "EBADMSG", "EOVERFLOW", "ENOTUNIQ", "EBADFD", "EREMCHG",
+  "ELIBACC", "ELIBBAD", "ELIBSCN", "ELIBMAX", "ELIBEXEC", "EILSEQ", "ERESTART", "ESTRPIPE", "EUSERS",
+  "ENOTSOCK", "EDESTADDRREQ", "EMSGSIZE", "EPROTOTYPE", "ENOPROTOOPT", "EPROTONOSUPPORT",
+  "ESOCKTNOSUPPORT", "EOPNOTSUPP", "EPFNOSUPPORT", "EAFNOSUPPORT", "EADDRINUSE", "EADDRNOTAVAIL",
+  "ENETDOWN", "ENETUNREACH", "ENETRESET", "ECONNABORTED", "ECONNRESET", "ENOBUFS", "EISCONN",
+  "ENOTCONN", "ESHUTDOWN", "ETOOMANYREFS", "ETIMEDOUT", "ECONNREFUSED", "EHOSTDOWN", "EHOSTUNREACH",
+  "EALREADY", "EINPROGRESS", "ESTALE", "EUCLEAN", "ENOTNAM", "ENAVAIL", "EISNAM", "EREMOTEIO",
+  "EDQUOT", "ENOMEDIUM", "EMEDIUMTYPE", "ECANCELED", "ENOKEY", "EKEYEXPIRED", "EKEYREVOKED",
+  "EKEYREJECTED", "EOWNERDEAD", "ENOTRECOVERABLE", "ERFKILL", "EHWPOISON",
+};
+
+static const char *const arches_trace[6] = {"x86_64", "arm64", "riscv64", "i386", "arm", "riscv32"};
+
+static int Column_trace(unsigned int arch) {
+  switch (arch) {
+  case AUDIT_ARCH_X86_64_linux: return 0;
+  case AUDIT_ARCH_AARCH64_linux: return 1;
+  case AUDIT_ARCH_RISCV64_linux: return 2;
+  case AUDIT_ARCH_I386_linux: return 3;
+  case AUDIT_ARCH_ARM_linux: return 4;
+  case AUDIT_ARCH_RISCV32_linux: return 5;
+  }
+  return -1;
+}
+
+const char *Name_trace(unsigned int arch, unsigned long nr) {
+  int column = Column_trace(arch);
+  if (column < 0) {
+    return 0;
+  }
+  for (unsigned long i = 0; i < sizeof(syscalls_trace) / sizeof(syscalls_trace[0]); ++i) {
+    if (syscalls_trace[i].nr[column] >= 0 && (unsigned long)syscalls_trace[i].nr[column] == nr) {
+      return syscalls_trace[i].name;
+    }
+  }
+  return 0;
+}
+
+long Lookup_trace(unsigned int arch, const char *name) {
+  int column = Column_trace(arch);
+  if (column < 0) {
+    return -EINVAL_linux;
+  }
+  for (unsigned long i = 0; i < sizeof(syscalls_trace) / sizeof(syscalls_trace[0]); ++i) {
+    const char *a = syscalls_trace[i].name, *b = name;
+    while (*a && *a == *b) {
+      ++a;
+      ++b;
+    }
+    if (*a == *b) {
+      return syscalls_trace[i].nr[column] < 0 ? -ENOSYS_linux : syscalls_trace[i].nr[column];
+    }
+  }
+  return -ENOENT_linux;
+}
+
+const char *Errno_trace(unsigned int err) {
+  if (err < sizeof(errnos_trace) / sizeof(errnos_trace[0])) {
+    return errnos_trace[err][0] ? errnos_trace[err] : 0;
+  }
+  // Kernel-internal codes, seen at the exit stop of interrupted calls
+  switch (err) {
+  case 512: return "ERESTARTSYS";
+  case 513: return "ERESTARTNOINTR";
+  case 514: return "ERESTARTNOHAND";
+  case 515: return "ENOIOCTLCMD";
+  case 516: return "ERESTART_RESTARTBLOCK";
+  }
+  return 0;
+}
+
+// a / b without libgcc's 64-bit division on 32-bit targets.
+static unsigned long long Div_trace(unsigned long long a, unsigned long long b) {
+#if __SIZEOF_LONG__ == 8
+  return a / b;
+#else
+  unsigned long long q = 0, r = 0;
+  for (int i = 63; i >= 0; --i) {
+    r = r << 1 | (a >> i & 1);
+    if (r >= b) {
+      r -= b;
+      q |= 1ULL << i;
+    }
+  }
+  return q;
+#endif
+}
+
+static unsigned long long Now_trace(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+long Select_trace(Profile_trace *p, unsigned long nr) {
+  if (nr >= NRS_trace) {
+    return -EINVAL_linux;
+  }
+  p->selected[nr / 32] |= 1U << (nr % 32);
+  return 0;
+}
+
+static int Any_trace(const Profile_trace *p) {
+  for (int i = 0; i < NRS_trace / 32; ++i) {
+    if (p->selected[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Foreign-ABI calls (i386 on x86_64, arm32 on arm64) all trace: their
+// numbers differ from the selection's. Then one compare per selected call.
+static unsigned short Filter_trace(Profile_trace *p) {
+  sock_filter_linux *f = p->filter;
+  unsigned int n = 0;
+  f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_LD_linux | BPF_W_linux | BPF_ABS_linux, __builtin_offsetof(seccomp_data_linux, arch));
+  f[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JEQ_linux | BPF_K_linux, AUDIT_ARCH_linux, 1, 0);
+  f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_RET_linux | BPF_K_linux, SECCOMP_RET_TRACE_linux);
+  if (Any_trace(p)) {
+    f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_LD_linux | BPF_W_linux | BPF_ABS_linux, __builtin_offsetof(seccomp_data_linux, nr));
+    for (unsigned int nr = 0; nr < NRS_trace; ++nr) {
+      if (p->selected[nr / 32] & (1U << (nr % 32))) {
+        f[n++] = (sock_filter_linux)BPF_JUMP_linux(BPF_JMP_linux | BPF_JEQ_linux | BPF_K_linux, nr, 0, 1);
+        f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_RET_linux | BPF_K_linux, SECCOMP_RET_TRACE_linux);
+      }
+    }
+    f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_RET_linux | BPF_K_linux, SECCOMP_RET_ALLOW_linux);
+  } else {
+    f[n++] = (sock_filter_linux)BPF_STMT_linux(BPF_RET_linux | BPF_K_linux, SECCOMP_RET_TRACE_linux);
+  }
+  return (unsigned short)n;
+}
+
+static unsigned int Hash_trace(unsigned int key) {
+  return key * 2654435761U;
+}
+
+// Open addressing with linear probing, like watch.h's tables.
+static Thread_trace *Find_trace(Profile_trace *p, int tid, int insert) {
+  unsigned int i = Hash_trace((unsigned int)tid) & (THREADS_trace - 1);
+  for (int probe = 0; probe < THREADS_trace; ++probe, i = (i + 1) & (THREADS_trace - 1)) {
+    Thread_trace *t = &p->threads[i];
+    if (t->tid == tid) {
+      return t;
+    }
+    if (t->tid == 0) {
+      if (!insert) {
+        return 0;
+      }
+      t->tid = tid;
+      t->abi = -1;
+      return t;
+    }
+  }
+  return 0;
+}
+
+// Backward-shift erase, so lookups never need tombstones.
+static void Forget_trace(Profile_trace *p, Thread_trace *t) {
+  unsigned int i = (unsigned int)(t - p->threads), j = i;
+  for (int step = 1; step < THREADS_trace; ++step) { // a full table has no empty slot to stop at
+    j = (j + 1) & (THREADS_trace - 1);
+    if (p->threads[j].tid == 0) {
+      break;
+    }
+    unsigned int home = Hash_trace((unsigned int)p->threads[j].tid) & (THREADS_trace - 1);
+    if (((j - home) & (THREADS_trace - 1)) >= ((j - i) & (THREADS_trace - 1))) {
+      p->threads[i] = p->threads[j];
+      i = j;
+    }
+  }
+  p->threads[i].tid = 0;
+  p->threads[i].abi = -1;
+}
+
+static void Fail_trace(Profile_trace *p, unsigned int key) {
+  unsigned int i = Hash_trace(key) & (ERRORS_trace - 1);
+  for (int probe = 0; probe < ERRORS_trace; ++probe, i = (i + 1) & (ERRORS_trace - 1)) {
+    if (p->errors[i].key == key || p->errors[i].key == 0) {
+      p->errors[i].key = key;
+      ++p->errors[i].count;
+      return;
+    }
+  }
+}
+
+static void Enter_trace(Profile_trace *p, int any, int tid, const ptrace_syscall_info_linux *info, unsigned long long nr) {
+  int abi = info->arch != AUDIT_ARCH_linux;
+  unsigned int slot = nr < NRS_trace ? (unsigned int)nr : NRS_trace - 1;
+  if (abi) {
+    p->foreign_arch = info->arch;
+  } else if (any && !(p->selected[slot / 32] & (1U << (slot % 32)))) {
+    return; // FULL_trace stops at everything but counts the selection
+  }
+  ++p->counters[abi][slot].calls;
+  Thread_trace *t = Find_trace(p, tid, 1);
+  if (t) {
+    t->abi = abi;
+    t->slot = slot;
+    t->entered_ns = Now_trace();
+  }
+}
+
+static void Exit_trace(Profile_trace *p, int tid, const ptrace_syscall_info_linux *info) {
+  Thread_trace *t = Find_trace(p, tid, 0);
+  if (!t || t->abi < 0) {
+    return;
+  }
+  Counter_trace *c = &p->counters[t->abi][t->slot];
+  c->ns += Now_trace() - t->entered_ns;
+  if (info->exit.is_error) {
+    ++c->errors;
+    Fail_trace(p, ((unsigned int)t->abi * NRS_trace + t->slot) << 12 | ((unsigned int)-info->exit.rval & 0xfff));
+  }
+  t->abi = -1;
+}
+
+long Run_trace(Profile_trace *p, const char *path, const char *const *argv, const char *const *envp) {
+  for (int i = 0; i < NRS_trace; ++i) {
+    p->counters[0][i] = p->counters[1][i] = (Counter_trace){0, 0, 0};
+  }
+  for (int i = 0; i < ERRORS_trace; ++i) {
+    p->errors[i] = (Error_trace){0, 0};
+  }
+  for (int i = 0; i < THREADS_trace; ++i) {
+    p->threads[i] = (Thread_trace){0, -1, 0, 0};
+  }
+  p->foreign_arch = 0;
+  p->stops = 0;
+  p->untracked = 0;
+  p->elapsed_ns = 0;
+  p->status = 0;
+  int any = Any_trace(p), full = p->flags & FULL_trace;
+  sock_fprog_linux prog = {Filter_trace(p), p->filter};
+
+  unsigned long long start = Now_trace();
+  long pid = fork_linux();
+  if (pid < 0) {
+    return pid;
+  }
+  if (pid == 0) {
+    // Stop until the tracer has set its options, or the first selected
+    // syscall would find no one to report to and fail with ENOSYS.
+    ptrace_linux(PTRACE_TRACEME_linux, 0, 0, 0);
+    kill_linux((int)getpid_linux(), SIGSTOP_linux);
+    if (!full && (prctl_linux(PR_SET_NO_NEW_PRIVS_linux, 1, 0, 0, 0) < 0 ||
+                  seccomp_linux(SECCOMP_SET_MODE_FILTER_linux, 0, &prog) < 0)) {
+      exit_group_linux(127);
+    }
+    execve_linux(path, argv, envp);
+    exit_group_linux(127);
+  }
+  p->pid = (int)pid;
+
+  int status = 0;
+  long ret;
+  while ((ret = wait4_linux(p->pid, &status, __WALL_linux, 0)) == -EINTR_linux) {
+  }
+  unsigned long options = PTRACE_O_TRACESYSGOOD_linux | PTRACE_O_TRACESECCOMP_linux | PTRACE_O_EXITKILL_linux |
+                          PTRACE_O_TRACEFORK_linux | PTRACE_O_TRACEVFORK_linux | PTRACE_O_TRACECLONE_linux |
+                          PTRACE_O_TRACEEXEC_linux;
+  if (ret >= 0) {
+    ret = ptrace_linux(PTRACE_SETOPTIONS_linux, p->pid, 0, (void *)options);
+  }
+  if (ret < 0) {
+    kill_linux(p->pid, SIGKILL_linux);
+    wait4_linux(p->pid, &status, __WALL_linux, 0);
+    return ret;
+  }
+  Find_trace(p, p->pid, 1);
+  ptrace_linux(full ? PTRACE_SYSCALL_linux : PTRACE_CONT_linux, p->pid, 0, 0);
+
+  for (;;) {
+    int tid = (int)wait4_linux(-1, &status, __WALL_linux, 0);
+    if (tid == -EINTR_linux) {
+      continue;
+    }
+    if (tid < 0) {
+      break; // ECHILD: every tracee is gone
+    }
+    if ((status & 0x7f) != 0x7f) { // exited or killed
+      Thread_trace *t = Find_trace(p, tid, 0);
+      if (t) {
+        Forget_trace(p, t);
+      }
+      if (tid == p->pid) {
+        p->status = status;
+        p->elapsed_ns = Now_trace() - start;
+      }
+      continue;
+    }
+    ++p->stops;
+    int sig = (status >> 8) & 0xff, event = (status >> 16) & 0xff, deliver = 0;
+    Thread_trace *t = Find_trace(p, tid, 0);
+    ptrace_syscall_info_linux info;
+    if (!t) {
+      // New tasks of a traced fork or clone start with a SIGSTOP of ours.
+      // A task that found the table full lands here on every stop, and its
+      // seccomp, syscall and event stops are SIGTRAPs that would kill it.
+      t = Find_trace(p, tid, 1);
+      deliver = sig == SIGSTOP_linux || (sig & 0x7f) == SIGTRAP_linux ? 0 : sig;
+      p->untracked += !t && sig == SIGSTOP_linux;
+    } else if (sig == SIGTRAP_linux && event == PTRACE_EVENT_SECCOMP_linux) {
+      if (ptrace_linux(PTRACE_GET_SYSCALL_INFO_linux, tid, (void *)sizeof(info), &info) > 0 &&
+          info.op == PTRACE_SYSCALL_INFO_SECCOMP_linux) {
+        Enter_trace(p, any, tid, &info, info.seccomp.nr);
+      }
+    } else if (sig == (SIGTRAP_linux | 0x80)) {
+      if (ptrace_linux(PTRACE_GET_SYSCALL_INFO_linux, tid, (void *)sizeof(info), &info) > 0) {
+        if (info.op == PTRACE_SYSCALL_INFO_ENTRY_linux) {
+          Enter_trace(p, any, tid, &info, info.entry.nr);
+        } else if (info.op == PTRACE_SYSCALL_INFO_EXIT_linux) {
+          Exit_trace(p, tid, &info);
+        }
+      }
+    } else if (!(sig == SIGTRAP_linux && event)) { // fork, clone and exec events pass
+      deliver = sig;
+    }
+    long op = full || (t && t->abi >= 0) ? PTRACE_SYSCALL_linux : PTRACE_CONT_linux;
+    ptrace_linux(op, tid, 0, (void *)(unsigned long)deliver);
+  }
+  if (!p->elapsed_ns) {
+    p->elapsed_ns = Now_trace() - start;
+  }
+  return (p->status & 0x7f) ? 128 + (p->status & 0x7f) : (p->status >> 8) & 0xff;
+}
+
+//
+// Report
+//
+static unsigned int Put_trace(char *line, unsigned int at, const char *text) {
+  while (*text && at < 159) {
+    line[at++] = *text++;
+  }
+  return at;
+}
+
+// value / 10^decimals as a fixed-point number, right-aligned in width.
+static unsigned int Number_trace(char *line, unsigned int at, unsigned long long value, int decimals, unsigned int width) {
+  char digits[32];
+  unsigned int n = 0;
+  do {
+    unsigned long long q = Div_trace(value, 10);
+    digits[n++] = (char)('0' + (value - q * 10));
+    value = q;
+    if ((int)n == decimals) {
+      digits[n++] = '.';
+      if (!value) {
+        digits[n++] = '0';
+      }
+    }
+  } while (value || (int)n <= decimals);
+  while (width > n && at < 159) {
+    line[at++] = ' ';
+    --width;
+  }
+  while (n && at < 159) {
+    line[at++] = digits[--n];
+  }
+  return at;
+}
+
+static unsigned int Label_trace(const Profile_trace *p, char *line, unsigned int at, int abi, unsigned int slot) {
+  unsigned int arch = abi ? p->foreign_arch : AUDIT_ARCH_linux;
+  const char *name = Name_trace(arch, slot);
+  if (slot == NRS_trace - 1) {
+    at = Put_trace(line, at, "other");
+  } else if (name) {
+    at = Put_trace(line, at, name);
+  } else {
+    at = Put_trace(line, at, "syscall_");
+    at = Number_trace(line, at, slot, 0, 0);
+  }
+  if (abi && Column_trace(arch) >= 0) {
+    at = Put_trace(line, at, " (");
+    at = Put_trace(line, at, arches_trace[Column_trace(arch)]);
+    at = Put_trace(line, at, ")");
+  }
+  return at;
+}
+
+long Report_trace(const Profile_trace *p, int fd) {
+  unsigned short rows[2 * NRS_trace];
+  unsigned int count = 0;
+  unsigned long long ns = 0, calls = 0, errors = 0;
+  for (unsigned int i = 0; i < 2 * NRS_trace; ++i) {
+    const Counter_trace *c = &p->counters[i / NRS_trace][i % NRS_trace];
+    if (!c->calls) {
+      continue;
+    }
+    ns += c->ns;
+    calls += c->calls;
+    errors += c->errors;
+    // Insertion sort, most time first
+    unsigned int at = count++;
+    while (at && p->counters[rows[at - 1] / NRS_trace][rows[at - 1] % NRS_trace].ns < c->ns) {
+      rows[at] = rows[at - 1];
+      --at;
+    }
+    rows[at] = (unsigned short)i;
+  }
+
+  long written = 0;
+  char line[160];
+  static const char header[] = "% time     seconds  usecs/call     calls    errors syscall\n"
+                               "------ ----------- ----------- --------- --------- ----------------\n";
+  static const char rule[] = "------ ----------- ----------- --------- --------- ----------------\n";
+  static const char breakdown[] = "\nerrors by syscall          errno                        calls\n";
+  long ret = write_linux(fd, header, sizeof(header) - 1);
+  if (ret < 0) {
+    return ret;
+  }
+  written += ret;
+  for (unsigned int r = 0; r <= count; ++r) {
+    const Counter_trace *c = 0;
+    Counter_trace total = {calls, errors, ns};
+    unsigned int at = 0;
+    if (r == count) {
+      c = &total;
+      ret = write_linux(fd, rule, sizeof(rule) - 1);
+      written += ret > 0 ? ret : 0;
+    } else {
+      c = &p->counters[rows[r] / NRS_trace][rows[r] % NRS_trace];
+    }
+    at = Number_trace(line, at, ns ? Div_trace(c->ns * 10000, ns) : 0, 2, 6);
+    at = Number_trace(line, at, Div_trace(c->ns, 1000), 6, 12);
+    at = Number_trace(line, at, c->calls ? Div_trace(c->ns, 1000 * c->calls) : 0, 0, 12);
+    at = Number_trace(line, at, c->calls, 0, 10);
+    if (c->errors) {
+      at = Number_trace(line, at, c->errors, 0, 10);
+    } else {
+      at = Put_trace(line, at, "          ");
+    }
+    at = Put_trace(line, at, " ");
+    at = r == count ? Put_trace(line, at, "total") : Label_trace(p, line, at, rows[r] / NRS_trace, rows[r] % NRS_trace);
+    line[at++] = '\n';
+    ret = write_linux(fd, line, at);
+    written += ret > 0 ? ret : 0;
+  }
+
+  // Errors by syscall, in the table's order
+  if (errors) {
+    ret = write_linux(fd, breakdown, sizeof(breakdown) - 1);
+    written += ret > 0 ? ret : 0;
+  }
+  for (unsigned int r = 0; r < count && errors; ++r) {
+    for (unsigned int e = 0; e < ERRORS_trace; ++e) {
+      if (!p->errors[e].key || p->errors[e].key >> 12 != rows[r]) {
+        continue;
+      }
+      unsigned int err = p->errors[e].key & 0xfff, at = 0;
+      const char *name = Errno_trace(err);
+      at = Label_trace(p, line, at, rows[r] / NRS_trace, rows[r] % NRS_trace);
+      while (at < 27) {
+        line[at++] = ' ';
+      }
+      if (name) {
+        at = Put_trace(line, at, name);
+      } else {
+        at = Put_trace(line, at, "E");
+        at = Number_trace(line, at, err, 0, 0);
+      }
+      while (at < 52) {
+        line[at++] = ' ';
+      }
+      at = Number_trace(line, at, p->errors[e].count, 0, 10);
+      line[at++] = '\n';
+      ret = write_linux(fd, line, at);
+      written += ret > 0 ? ret : 0;
+    }
+  }
+  if (p->untracked) {
+    unsigned int at = Put_trace(line, 0, "\nthreads not counted (table full): ");
+    at = Number_trace(line, at, p->untracked, 0, 0);
+    line[at++] = '\n';
+    ret = write_linux(fd, line, at);
+    written += ret > 0 ? ret : 0;
+  }
+  return written;
+}
+
+#endif // C_TRACE_IMPLEMENTATION
@@ -0,0 +1,154 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o trace_demo trace_demo.c -e main && ./trace_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_TRACE_IMPLEMENTATION
+#include "trace.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int Equal(const char *a, const char *b) {
+  while (*a && *a == *b) {
+    ++a;
+    ++b;
+  }
+  return *a == *b;
+}
+
+// A shell loop of redirections: each pass opens /dev/null, fails to open a
+// missing file, and dups, writes and closes in between.
+const char *const argv[] = {"/bin/sh", "-c",
+                            "i=0; while [ $i -lt 20000 ]; do echo x > /dev/null; "
+                            "true 2>/dev/null < /nonexistent; i=$((i+1)); done",
+                            NULL};
+const char *const envp[] = {"PATH=/bin:/usr/bin", NULL};
+
+Profile_trace profile;
+
+//
+// Names: numbers map back through the NR_*_linux columns of any architecture
+//
+void Names_demo(void) {
+  Assert(Equal(Name_trace(AUDIT_ARCH_linux, NR_openat_linux), "openat"));
+  Assert(Lookup_trace(AUDIT_ARCH_linux, "close") == NR_close_linux);
+  Assert(Equal(Name_trace(AUDIT_ARCH_I386_linux, 5), "open"));
+  Assert(Equal(Name_trace(AUDIT_ARCH_AARCH64_linux, 56), "openat"));
+  Assert(Lookup_trace(AUDIT_ARCH_AARCH64_linux, "open") == -ENOSYS_linux);
+  Assert(Lookup_trace(AUDIT_ARCH_linux, "no_such_call") == -ENOENT_linux);
+  Assert(Equal(Errno_trace(ENOENT_linux), "ENOENT"));
+  Print(STDOUT_FILENO_linux, "names: openat, close, i386 open, arm64 openat: ok\n\n");
+}
+
+//
+// Profile: counts, time and errors of the selected syscalls
+//
+void Profile_demo(void) {
+  Assert(Select_trace(&profile, NR_openat_linux) == 0);
+  Assert(Select_trace(&profile, NR_close_linux) == 0);
+  Assert(Select_trace(&profile, NR_write_linux) == 0);
+  Assert(Run_trace(&profile, argv[0], argv, envp) == 0);
+  Assert(Report_trace(&profile, STDOUT_FILENO_linux) > 0);
+  const Counter_trace *openat = &profile.counters[0][NR_openat_linux];
+  Assert(openat->calls >= 40000 && openat->errors >= 20000);
+  Assert(profile.counters[0][NR_write_linux].calls >= 20000);
+}
+
+//
+// Slowdown: the same run untraced, with the filter on openat, on
+// every syscall, and stopping at every entry and exit like strace
+//
+void Slowdown_demo(void) {
+  unsigned long long t0 = Now_ns();
+  long pid = fork_linux();
+  Assert(pid >= 0);
+  if (pid == 0) {
+    execve_linux(argv[0], argv, envp);
+    exit_group_linux(127);
+  }
+  int status;
+  Assert(wait4_linux((int)pid, &status, 0, 0) == pid && status == 0);
+  unsigned long long untraced = Now_ns() - t0;
+
+  Print(STDOUT_FILENO_linux, "\nmode                              ms    slowdown   ptrace stops\n");
+  Print(STDOUT_FILENO_linux, "untraced                          ");
+  PrintU64(STDOUT_FILENO_linux, untraced / 1000000);
+  Print(STDOUT_FILENO_linux, "\n");
+  const char *names[3] = {"seccomp, openat                  ", "seccomp, every syscall           ",
+                          "PTRACE_SYSCALL (like strace)     "};
+  for (int mode = 0; mode < 3; ++mode) {
+    for (int i = 0; i < NRS_trace / 32; ++i) {
+      profile.selected[i] = 0;
+    }
+    if (mode == 0) {
+      Select_trace(&profile, NR_openat_linux);
+    }
+    profile.flags = mode == 2 ? FULL_trace : 0;
+    Assert(Run_trace(&profile, argv[0], argv, envp) == 0);
+    Print(STDOUT_FILENO_linux, names[mode]);
+    PrintU64(STDOUT_FILENO_linux, profile.elapsed_ns / 1000000);
+    Print(STDOUT_FILENO_linux, "\t  ");
+    PrintU64(STDOUT_FILENO_linux, profile.elapsed_ns / untraced);
+    Print(STDOUT_FILENO_linux, ".");
+    PrintU64(STDOUT_FILENO_linux, profile.elapsed_ns * 10 / untraced % 10);
+    Print(STDOUT_FILENO_linux, "x\t");
+    PrintU64(STDOUT_FILENO_linux, profile.stops);
+    Print(STDOUT_FILENO_linux, "\n");
+  }
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Names_demo();
+  Profile_demo();
+  Slowdown_demo();
+  exit_linux(0);
+  return 0;
+}
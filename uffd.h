@@ -0,0 +1,481 @@
+#ifndef C_UFFD_HEADER
+#define C_UFFD_HEADER
+
+// === uffd.h: userfaultfd demand paging & write-protect tracking =============
+//
+// Contents:
+//   * manager                      (jump: Init_uffd)
+//   * regions                      (jump: Register_uffd)
+//   * dirty tracking               (jump: Protect_uffd)
+//
+// Usage:
+//   uffd.h is a libc-free header-only library for C & C++, it depends on
+//   linux.h and thread.h
+//
+//   #include "c/linux.h"
+//   #include "c/thread.h"
+//   #include "c/uffd.h" // use as header file
+//
+//   #define C_UFFD_IMPLEMENTATION
+//   #include "c/uffd.h" // use as implementation file
+//
+//   Restores a large memory image lazily: map the region empty, register it
+//   with a fill callback and start touching it right away. A handler thread
+//   reads UFFD_EVENT_PAGEFAULT messages in batches and, per fault, asks the
+//   callback for the whole aligned window around the faulting page (reading
+//   a snapshot file, decompressing, ...), then installs it with one
+//   UFFDIO_COPY that also wakes the faulting thread. Faults that land in a
+//   window already served from the same batch cost nothing more.
+//
+//     long Fill(void *user, unsigned long long offset, void *dst, unsigned long len) {
+//       return pread64_linux(snapshot_fd, dst, len, offset) == (long)len ? 0 : -EIO_linux;
+//     }
+//     Init_uffd(&m);
+//     Register_uffd(&m, base, size, 0, Fill, 0, TRACK_uffd);
+//     Start_uffd(&m);
+//
+//   A callback can return ZERO_uffd for all-zero windows, mapped without a
+//   copy. If it fails, the faulting page is poisoned (SIGBUS on access) where
+//   the kernel supports it, else mapped as zeroes, and `errors` is counted.
+//
+//   With TRACK_uffd the region is also write-protected: the first write to
+//   each page after Protect_uffd traps, the handler marks the page dirty and
+//   lifts the protection. Collect_uffd hands over the pages written since the
+//   last call, re-protecting them first, for incremental snapshots. Pages
+//   loaded by the handler come in protected, so they start clean.
+//
+//   The handler must never fault on a registered region itself, so callbacks
+//   only read from elsewhere.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "uffd.h depends on linux.h, include it first"
+#endif
+#ifndef C_THREAD_HEADER
+  #error "uffd.h depends on thread.h, include it first"
+#endif
+
+#define REGIONS_uffd 16
+#define WINDOW_uffd  (64UL << 10) // default fault-around window
+#define STAGING_uffd (2UL << 20)  // largest window
+#define MESSAGES_uffd 32          // fault messages read per batch
+
+#define TRACK_uffd 1 // Register_uffd flag: write-protect tracking
+#define ZERO_uffd  1 // fill result: the window is all zeroes
+
+// Fills `len` bytes of the region's image at `offset` into `dst`; returns 0,
+// ZERO_uffd, or -errno.
+typedef long (*Fill_uffd)(void *user, unsigned long long offset, void *dst, unsigned long len);
+
+typedef struct {
+  char *base;
+  unsigned long size;
+  unsigned long window; // power of two, page to STAGING_uffd
+  Fill_uffd fill;
+  void *user;
+  int tracking;
+  unsigned long *dirty; // page bitmap when tracking
+} Region_uffd;
+
+typedef struct {
+  int fd;
+  int stop_fd; // eventfd that ends the handler
+  int running;
+  int count;   // published with release, the handler may be running
+  unsigned long long features;
+  unsigned long page;
+  unsigned int page_shift;
+  char *staging;
+  Thread_thread thread;
+  Region_uffd regions[REGIONS_uffd];
+  // updated by the handler thread
+  unsigned long long faults;  // missing-page faults served
+  unsigned long long copies;  // UFFDIO_COPY / ZEROPAGE calls
+  unsigned long long bytes;   // bytes installed
+  unsigned long long wp_faults;
+  unsigned long long errors;  // failed fills
+} Manager_uffd;
+
+//
+// Manager
+//
+long Init_uffd(Manager_uffd *m);
+long Start_uffd(Manager_uffd *m);
+void Free_uffd(Manager_uffd *m);
+//
+// Regions
+//
+long Register_uffd(Manager_uffd *m, void *base, unsigned long size, unsigned long window, Fill_uffd fill, void *user, int flags);
+//
+// Dirty tracking
+//
+long Protect_uffd(Manager_uffd *m, int region);
+long Collect_uffd(Manager_uffd *m, int region, void (*emit)(void *user, unsigned long long offset, const void *data, unsigned long len), void *user);
+
+#endif // C_UFFD_HEADER
+#ifdef C_UFFD_IMPLEMENTATION
+
+#define BITS_uffd (8 * sizeof(unsigned long))
+
+// The page size from AT_PAGESZ in /proc/self/auxv, 4 KiB without /proc.
+static unsigned int PageShift_uffd(void) {
+  unsigned long auxv[128];
+  long fd = openat_linux(AT_FDCWD_linux, "/proc/self/auxv", O_RDONLY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return 12;
+  }
+  long got = 0;
+  for (long ret; got < (long)sizeof(auxv); got += ret) {
+    ret = read_linux((unsigned int)fd, (char *)auxv + got, sizeof(auxv) - (unsigned long)got);
+    if (ret <= 0) {
+      break;
+    }
+  }
+  close_linux((unsigned int)fd);
+  for (long i = 0; i + 1 < got / (long)sizeof(unsigned long) && auxv[i] != AT_NULL_linux; i += 2) {
+    if (auxv[i] == AT_PAGESZ_linux) {
+      for (unsigned int shift = 12; shift < BITS_uffd; ++shift) {
+        if (auxv[i + 1] == 1UL << shift) {
+          return shift;
+        }
+      }
+    }
+  }
+  return 12;
+}
+
+static Region_uffd *Find_uffd(Manager_uffd *m, unsigned long long addr) {
+  int count = __atomic_load_n(&m->count, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < count; ++i) {
+    Region_uffd *r = &m->regions[i];
+    if (addr >= (unsigned long)r->base && addr - (unsigned long)r->base < r->size) {
+      return r;
+    }
+  }
+  return 0;
+}
+
+// Installs the window around `addr` and makes sure the faulting thread wakes;
+// `served` gets the range whose faulting threads are now awake.
+static void Serve_uffd(Manager_uffd *m, Region_uffd *r, unsigned long long addr, unsigned long long served[2]) {
+  unsigned long long base = (unsigned long)r->base;
+  unsigned long long start = base + ((addr - base) & ~(unsigned long long)(r->window - 1));
+  unsigned long long end = start + r->window;
+  if (end > base + r->size) {
+    end = base + r->size;
+  }
+  ++m->faults;
+  long filled = r->fill(r->user, start - base, m->staging, (unsigned long)(end - start));
+  if (filled == ZERO_uffd && r->tracking) { // the zero page can't be installed protected
+    for (unsigned long i = 0; i < end - start; i += sizeof(unsigned long)) {
+      *(unsigned long *)(m->staging + i) = 0;
+    }
+    filled = 0;
+  }
+  int woken = 0;
+  if (filled < 0) {
+    ++m->errors;
+    uffdio_poison_linux p = {{addr, m->page}, 0, 0};
+    if (!(m->features & UFFD_FEATURE_POISON_linux) || ioctl_linux(m->fd, UFFDIO_POISON_linux, (unsigned long)&p) < 0) {
+      if (r->tracking) { // zeroes copied in protected, as for ZERO_uffd above
+        for (unsigned long i = 0; i < m->page; i += sizeof(unsigned long)) {
+          *(unsigned long *)(m->staging + i) = 0;
+        }
+        uffdio_copy_linux c = {addr, (unsigned long)m->staging, m->page, UFFDIO_COPY_MODE_WP_linux, 0};
+        ioctl_linux(m->fd, UFFDIO_COPY_linux, (unsigned long)&c);
+      } else {
+        uffdio_zeropage_linux z = {{addr, m->page}, 0, 0};
+        ioctl_linux(m->fd, UFFDIO_ZEROPAGE_linux, (unsigned long)&z);
+      }
+    }
+    start = end = addr; // skip the copy loop, wake below
+  }
+  for (unsigned long long dst = start; dst < end;) {
+    long long done;
+    long ret;
+    if (filled == ZERO_uffd) {
+      uffdio_zeropage_linux z = {{dst, end - dst}, 0, 0};
+      ret = ioctl_linux(m->fd, UFFDIO_ZEROPAGE_linux, (unsigned long)&z);
+      done = z.zeropage;
+    } else {
+      uffdio_copy_linux c = {dst, (unsigned long)m->staging + (dst - start), end - dst, r->tracking ? UFFDIO_COPY_MODE_WP_linux : 0, 0};
+      ret = ioctl_linux(m->fd, UFFDIO_COPY_linux, (unsigned long)&c);
+      done = c.copy;
+    }
+    ++m->copies;
+    if (ret < 0 && done == 0) {
+      done = ret;
+    }
+    if (done > 0) { // all of it, or up to the first page that was already there
+      woken |= addr >= dst && addr < dst + (unsigned long long)done;
+      m->bytes += (unsigned long long)done;
+      dst += (unsigned long long)done;
+    } else if (done == -EEXIST_linux) {
+      dst += m->page;
+    } else if (done != -EAGAIN_linux) { // EAGAIN: the mapping is changing, retry
+      break;
+    }
+  }
+  if (!woken) {
+    uffdio_range_linux wake = {addr, m->page};
+    ioctl_linux(m->fd, UFFDIO_WAKE_linux, (unsigned long)&wake);
+  }
+  served[0] = woken ? start : addr;
+  served[1] = woken ? end : addr + m->page;
+}
+
+static void Dirty_uffd(Manager_uffd *m, Region_uffd *r, unsigned long long addr) {
+  unsigned long page = (unsigned long)((addr - (unsigned long)r->base) >> m->page_shift);
+  __atomic_fetch_or(&r->dirty[page / BITS_uffd], 1UL << (page % BITS_uffd), __ATOMIC_RELAXED);
+  uffdio_writeprotect_linux w = {{addr, m->page}, 0}; // unprotect and wake
+  ioctl_linux(m->fd, UFFDIO_WRITEPROTECT_linux, (unsigned long)&w);
+  ++m->wp_faults;
+}
+
+static int Handler_uffd(void *arg) {
+  Manager_uffd *m = (Manager_uffd *)arg;
+  uffd_msg_linux msgs[MESSAGES_uffd];
+  unsigned long long served[MESSAGES_uffd][2];
+  for (;;) {
+    pollfd_linux fds[2] = {{m->fd, POLLIN_linux, 0}, {m->stop_fd, POLLIN_linux, 0}};
+    long ret = ppoll_time64_linux(fds, 2, 0, 0);
+    if (ret == -EINTR_linux) {
+      continue;
+    }
+    if (ret < 0 || fds[1].revents) {
+      return (int)(ret < 0 ? ret : 0);
+    }
+    ret = read_linux(m->fd, msgs, sizeof(msgs));
+    if (ret == -EAGAIN_linux) {
+      continue;
+    }
+    if (ret < 0) {
+      return (int)ret;
+    }
+    int count = (int)(ret / (long)sizeof(uffd_msg_linux));
+    int windows = 0;
+    for (int i = 0; i < count; ++i) {
+      if (msgs[i].event != UFFD_EVENT_PAGEFAULT_linux) {
+        continue;
+      }
+      unsigned long long addr = msgs[i].arg.pagefault.address & ~(unsigned long long)(m->page - 1);
+      Region_uffd *r = Find_uffd(m, addr);
+      if (!r) {
+        continue;
+      }
+      if (msgs[i].arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP_linux) {
+        Dirty_uffd(m, r, addr);
+        continue;
+      }
+      int seen = 0;
+      for (int w = 0; w < windows && !seen; ++w) { // woken by that copy already
+        seen = addr >= served[w][0] && addr < served[w][1];
+      }
+      if (!seen) {
+        Serve_uffd(m, r, addr, served[windows++]);
+      }
+    }
+  }
+}
+
+//
+// Manager
+//
+
+// Opens the userfaultfd (user-mode faults only when unprivileged) and
+// negotiates the features this header uses.
+long Init_uffd(Manager_uffd *m) {
+  unsigned char *bytes = (unsigned char *)m;
+  for (unsigned long i = 0; i < sizeof(*m); ++i) {
+    bytes[i] = 0;
+  }
+  int flags = O_CLOEXEC_linux | O_NONBLOCK_linux;
+  long fd = userfaultfd_linux(flags);
+  if (fd == -EPERM_linux) {
+    flags |= UFFD_USER_MODE_ONLY_linux;
+    fd = userfaultfd_linux(flags);
+  }
+  if (fd < 0) {
+    return fd;
+  }
+  // UFFDIO_API works once per descriptor: probe what's supported on a first
+  // one, then ask for it on the one we keep.
+  uffdio_api_linux api = {UFFD_API_linux, 0, 0};
+  long ret = ioctl_linux((unsigned int)fd, UFFDIO_API_linux, (unsigned long)&api);
+  close_linux((unsigned int)fd);
+  if (ret < 0) {
+    return ret;
+  }
+  unsigned long long wanted = api.features & (UFFD_FEATURE_PAGEFAULT_FLAG_WP_linux | UFFD_FEATURE_POISON_linux);
+  fd = userfaultfd_linux(flags);
+  if (fd < 0) {
+    return fd;
+  }
+  m->fd = (int)fd;
+  api.api = UFFD_API_linux;
+  api.features = wanted;
+  ret = ioctl_linux(m->fd, UFFDIO_API_linux, (unsigned long)&api);
+  if (ret < 0) {
+    close_linux(m->fd);
+    return ret;
+  }
+  m->features = wanted;
+  m->page_shift = PageShift_uffd();
+  m->page = 1UL << m->page_shift;
+  ret = eventfd2_linux(0, EFD_CLOEXEC_linux);
+  if (ret < 0) {
+    close_linux(m->fd);
+    return ret;
+  }
+  m->stop_fd = (int)ret;
+  ret = mmap_linux(0, STAGING_uffd, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    close_linux(m->stop_fd);
+    close_linux(m->fd);
+    return ret;
+  }
+  m->staging = (char *)ret;
+  return 0;
+}
+
+// Starts the handler thread; regions may be registered before or after.
+long Start_uffd(Manager_uffd *m) {
+  long ret = Spawn_thread(&m->thread, Handler_uffd, m, 0);
+  if (ret == 0) {
+    m->running = 1;
+  }
+  return ret;
+}
+
+// Stops the handler and closes the descriptor, which unregisters every
+// region: pages never touched read as zeroes from then on.
+void Free_uffd(Manager_uffd *m) {
+  if (m->running) {
+    unsigned long long one = 1;
+    write_linux(m->stop_fd, &one, sizeof(one));
+    Join_thread(&m->thread);
+    m->running = 0;
+  }
+  close_linux(m->stop_fd);
+  close_linux(m->fd);
+  munmap_linux(m->staging, STAGING_uffd);
+  for (int i = 0; i < m->count; ++i) {
+    Region_uffd *r = &m->regions[i];
+    if (r->dirty) {
+      unsigned long pages = r->size >> m->page_shift;
+      munmap_linux(r->dirty, (pages + BITS_uffd - 1) / BITS_uffd * sizeof(unsigned long));
+    }
+  }
+}
+
+//
+// Regions
+//
+
+// Serves missing pages of [base, base + size), an anonymous private mapping,
+// from `fill` in `window`-sized chunks (0 for WINDOW_uffd). Returns the
+// region index.
+long Register_uffd(Manager_uffd *m, void *base, unsigned long size, unsigned long window, Fill_uffd fill, void *user, int flags) {
+  window = window ? window : WINDOW_uffd;
+  if (m->count == REGIONS_uffd) {
+    return -ENOSPC_linux;
+  }
+  if (((unsigned long)base | size) & (m->page - 1) || !size || window < m->page || window > STAGING_uffd || (window & (window - 1))) {
+    return -EINVAL_linux;
+  }
+  if ((flags & TRACK_uffd) && !(m->features & UFFD_FEATURE_PAGEFAULT_FLAG_WP_linux)) {
+    return -EOPNOTSUPP_linux;
+  }
+  Region_uffd *r = &m->regions[m->count];
+  r->base = (char *)base;
+  r->size = size;
+  r->window = window;
+  r->fill = fill;
+  r->user = user;
+  r->tracking = flags & TRACK_uffd;
+  r->dirty = 0;
+  if (r->tracking) {
+    unsigned long pages = size >> m->page_shift;
+    long ret = mmap_linux(0, (pages + BITS_uffd - 1) / BITS_uffd * sizeof(unsigned long), PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+    if (ret < 0 && ret > -4096) {
+      return ret;
+    }
+    r->dirty = (unsigned long *)ret;
+  }
+  uffdio_register_linux reg = {{(unsigned long)base, size}, UFFDIO_REGISTER_MODE_MISSING_linux | (r->tracking ? UFFDIO_REGISTER_MODE_WP_linux : 0), 0};
+  long ret = ioctl_linux(m->fd, UFFDIO_REGISTER_linux, (unsigned long)&reg);
+  if (ret < 0) {
+    if (r->dirty) {
+      munmap_linux(r->dirty, ((size >> m->page_shift) + BITS_uffd - 1) / BITS_uffd * sizeof(unsigned long));
+    }
+    return ret;
+  }
+  __atomic_store_n(&m->count, m->count + 1, __ATOMIC_RELEASE);
+  return m->count - 1;
+}
+
+//
+// Dirty tracking
+//
+
+// Starts a new epoch: write-protects the whole region and forgets earlier
+// writes. Call it with writers paused, a write racing with it may be missed.
+long Protect_uffd(Manager_uffd *m, int region) {
+  Region_uffd *r = &m->regions[region];
+  if (!r->tracking) {
+    return -EINVAL_linux;
+  }
+  uffdio_writeprotect_linux w = {{(unsigned long)r->base, r->size}, UFFDIO_WRITEPROTECT_MODE_WP_linux};
+  long ret = ioctl_linux(m->fd, UFFDIO_WRITEPROTECT_linux, (unsigned long)&w);
+  if (ret < 0) {
+    return ret;
+  }
+  unsigned long words = ((r->size >> m->page_shift) + BITS_uffd - 1) / BITS_uffd;
+  for (unsigned long i = 0; i < words; ++i) {
+    __atomic_store_n(&r->dirty[i], 0, __ATOMIC_RELAXED);
+  }
+  return 0;
+}
+
+// Calls `emit` on each run of pages written since the last Protect_uffd or
+// Collect_uffd and returns the number of pages. Each run is re-protected
+// before it's emitted, so writers may keep going: a write racing with the
+// emit shows up in this call's data and again in the next one.
+long Collect_uffd(Manager_uffd *m, int region, void (*emit)(void *user, unsigned long long offset, const void *data, unsigned long len), void *user) {
+  Region_uffd *r = &m->regions[region];
+  if (!r->tracking) {
+    return -EINVAL_linux;
+  }
+  unsigned long pages = r->size >> m->page_shift;
+  long total = 0;
+  unsigned long run = 0, run_length = 0, bits = 0;
+  for (unsigned long page = 0; page <= pages; ++page) {
+    if (page % BITS_uffd == 0 && page < pages) {
+      bits = __atomic_exchange_n(&r->dirty[page / BITS_uffd], 0, __ATOMIC_RELAXED);
+    }
+    if (page < pages && ((bits >> (page % BITS_uffd)) & 1)) {
+      run = run_length ? run : page;
+      ++run_length;
+      continue;
+    }
+    if (run_length) {
+      unsigned long long offset = (unsigned long long)run << m->page_shift;
+      unsigned long len = run_length << m->page_shift;
+      uffdio_writeprotect_linux w = {{(unsigned long)r->base + offset, len}, UFFDIO_WRITEPROTECT_MODE_WP_linux};
+      ioctl_linux(m->fd, UFFDIO_WRITEPROTECT_linux, (unsigned long)&w);
+      emit(user, offset, r->base + offset, len);
+      total += (long)run_length;
+      run_length = 0;
+    }
+  }
+  return total;
+}
+
+#endif // C_UFFD_IMPLEMENTATION
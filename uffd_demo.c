@@ -0,0 +1,281 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o uffd_demo uffd_demo.c -e main && ./uffd_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_THREAD_IMPLEMENTATION
+#include "thread.h"
+#define C_UFFD_IMPLEMENTATION
+#include "uffd.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_group_linux(1); // exit_linux would only end the failing thread
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long Xorshift(unsigned long long *state) {
+  unsigned long long x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+char *Map(unsigned long size) {
+  long ret = mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  Assert(ret > 0 || ret < -4095);
+  return (char *)ret;
+}
+
+//
+// A snapshot file (a memfd here): words hold their offset scrambled, the
+// last quarter is zero like a heap that was never written
+//
+#if defined(__LP64__)
+#define SNAPSHOT (1UL << 30)
+#else
+#define SNAPSHOT (128UL << 20)
+#endif
+#define WRITTEN   (SNAPSHOT / 4 * 3)
+#define SCRAMBLE  0x9e3779b97f4a7c15ULL
+
+int snapshot;
+
+unsigned long Expected(unsigned long long offset) {
+  return offset < WRITTEN ? (unsigned long)(offset ^ SCRAMBLE) : 0;
+}
+
+void WriteSnapshot(void) {
+  long fd = memfd_create_linux("snapshot", MFD_CLOEXEC_linux);
+  Assert(fd >= 0);
+  snapshot = (int)fd;
+  Assert(ftruncate64_linux(snapshot, SNAPSHOT) == 0);
+  char *chunk = Map(STAGING_uffd);
+  for (unsigned long long at = 0; at < WRITTEN; at += STAGING_uffd) {
+    for (unsigned long i = 0; i < STAGING_uffd; i += sizeof(unsigned long)) {
+      *(unsigned long *)(chunk + i) = Expected(at + i);
+    }
+    Assert(pwrite64_linux(snapshot, chunk, STAGING_uffd, (long long)at) == (long)STAGING_uffd);
+  }
+  munmap_linux(chunk, STAGING_uffd);
+}
+
+long ReadFill(void *user, unsigned long long offset, void *dst, unsigned long len) {
+  (void)user;
+  if (offset >= WRITTEN) {
+    return ZERO_uffd;
+  }
+  for (unsigned long done = 0; done < len;) {
+    long ret = pread64_linux(snapshot, (char *)dst + done, len - done, (long long)(offset + done));
+    if (ret <= 0) {
+      return ret < 0 ? ret : -EIO_linux;
+    }
+    done += (unsigned long)ret;
+  }
+  return 0;
+}
+
+// Reads one word per page, what a restored process touching its state does.
+unsigned long long Touch(const char *base, unsigned long long *rng, unsigned long pages) {
+  unsigned long long t0 = Now_ns();
+  for (unsigned long i = 0; i < pages; ++i) {
+    unsigned long long offset = rng ? (Xorshift(rng) % (SNAPSHOT / 4096)) * 4096 : (unsigned long long)i * 4096;
+    offset += (offset >> 12) % 512 * sizeof(unsigned long);
+    Assert(*(const unsigned long *)(base + offset) == Expected(offset));
+  }
+  return Now_ns() - t0;
+}
+
+#define WORKING_SET (SNAPSHOT / 4096 / 50) // pages touched at startup: 2% of the image, at random
+
+void PrintMs(const char *label, unsigned long long ns) {
+  Print(STDOUT_FILENO_linux, label);
+  PrintU64(STDOUT_FILENO_linux, ns / 1000000);
+  Print(STDOUT_FILENO_linux, ".");
+  PrintU64(STDOUT_FILENO_linux, ns / 100000 % 10);
+  Print(STDOUT_FILENO_linux, " ms");
+}
+
+//
+// Time to first access: eager pread of the whole image against lazy
+// userfaultfd restores with several fault-around windows
+//
+void Restore_demo(void) {
+  Print(STDOUT_FILENO_linux, "snapshot: ");
+  PrintU64(STDOUT_FILENO_linux, SNAPSHOT >> 20);
+  Print(STDOUT_FILENO_linux, " MiB (last quarter zero), startup working set: ");
+  PrintU64(STDOUT_FILENO_linux, WORKING_SET);
+  Print(STDOUT_FILENO_linux, " random pages\n");
+
+  unsigned long long t0 = Now_ns();
+  char *eager = Map(SNAPSHOT);
+  for (unsigned long long at = 0; at < SNAPSHOT; at += STAGING_uffd) {
+    Assert(ReadFill(NULL, at, eager + at, STAGING_uffd) >= 0);
+  }
+  unsigned long long first = Now_ns() - t0;
+  unsigned long long rng = 42;
+  unsigned long long working = Touch(eager, &rng, WORKING_SET);
+  PrintMs("eager load     first access ", first);
+  PrintMs(", working set ", first + working);
+  PrintMs(", every page ", first + working + Touch(eager, NULL, SNAPSHOT / 4096));
+  Print(STDOUT_FILENO_linux, "\n");
+  munmap_linux(eager, SNAPSHOT);
+
+  unsigned long windows[3] = {4096, 64 << 10, 2 << 20};
+  const char *names[3] = {"lazy 4 KiB     ", "lazy 64 KiB    ", "lazy 2 MiB     "};
+  for (int w = 0; w < 3; ++w) {
+    Manager_uffd m;
+    t0 = Now_ns();
+    char *lazy = Map(SNAPSHOT);
+    Assert(Init_uffd(&m) == 0);
+    Assert(Register_uffd(&m, lazy, SNAPSHOT, windows[w], ReadFill, NULL, 0) == 0);
+    Assert(Start_uffd(&m) == 0);
+    Assert(*(volatile unsigned long *)(lazy + 8) == Expected(8));
+    first = Now_ns() - t0;
+    rng = 42;
+    working = Touch(lazy, &rng, WORKING_SET);
+    unsigned long long all = Touch(lazy, NULL, SNAPSHOT / 4096);
+    Free_uffd(&m); // joins the handler, its counters are final
+    Print(STDOUT_FILENO_linux, names[w]);
+    Print(STDOUT_FILENO_linux, "first access ");
+    PrintU64(STDOUT_FILENO_linux, first / 1000);
+    Print(STDOUT_FILENO_linux, " us");
+    PrintMs(", working set ", first + working);
+    PrintMs(", every page ", first + working + all);
+    Print(STDOUT_FILENO_linux, " (");
+    PrintU64(STDOUT_FILENO_linux, m.faults);
+    Print(STDOUT_FILENO_linux, " faults)\n");
+    Assert(m.bytes == SNAPSHOT && m.errors == 0);
+    munmap_linux(lazy, SNAPSHOT);
+  }
+}
+
+//
+// Incremental snapshots: Collect_uffd returns exactly the pages written
+// since the previous one, runs merged
+//
+#define TRACKED (64UL << 20)
+
+unsigned char written[TRACKED / 4096];
+long emitted;
+
+void Emit(void *user, unsigned long long offset, const void *data, unsigned long len) {
+  (void)user;
+  for (unsigned long i = 0; i < len; i += 4096) {
+    unsigned long page = (unsigned long)((offset + i) >> 12);
+    Assert(written[page]);
+    Assert(*(const unsigned long *)((const char *)data + i) == page); // the new contents
+    written[page] = 0;
+    ++emitted;
+  }
+}
+
+void Dirty_demo(void) {
+  Manager_uffd m;
+  Assert(Init_uffd(&m) == 0);
+  if (!(m.features & UFFD_FEATURE_PAGEFAULT_FLAG_WP_linux) || m.page != 4096) {
+    Print(STDOUT_FILENO_linux, "write-protect tracking unavailable, skipped\n");
+    Free_uffd(&m);
+    return;
+  }
+  char *region = Map(TRACKED);
+  int id = (int)Register_uffd(&m, region, TRACKED, 0, ReadFill, NULL, TRACK_uffd);
+  Assert(id == 0);
+  Assert(Start_uffd(&m) == 0);
+  Assert(Touch(region, NULL, TRACKED / 4096) > 0); // loaded pages come in clean
+  Assert(Collect_uffd(&m, id, Emit, NULL) == 0);
+
+  unsigned long long rng = 7;
+  for (int round = 0; round < 3; ++round) {
+    long distinct = 0;
+    unsigned long long t0 = Now_ns();
+    for (int i = 0; i < 5000; ++i) {
+      unsigned long page = (unsigned long)(Xorshift(&rng) % (TRACKED / 4096));
+      page = round == 1 ? page & ~15UL : page; // round 1 writes 16-page runs
+      for (unsigned long p = page; p < page + (round == 1 ? 16 : 1); ++p) {
+        distinct += !written[p];
+        written[p] = 1;
+        *(unsigned long *)(region + p * 4096) = p;
+      }
+    }
+    unsigned long long writes = Now_ns() - t0;
+    emitted = 0;
+    t0 = Now_ns();
+    Assert(Collect_uffd(&m, id, Emit, NULL) == distinct);
+    Assert(emitted == distinct);
+    Print(STDOUT_FILENO_linux, "incremental snapshot ");
+    PrintU64(STDOUT_FILENO_linux, round);
+    Print(STDOUT_FILENO_linux, ": ");
+    PrintU64(STDOUT_FILENO_linux, distinct);
+    Print(STDOUT_FILENO_linux, " dirty pages, ");
+    PrintU64(STDOUT_FILENO_linux, writes / (distinct ? distinct : 1));
+    Print(STDOUT_FILENO_linux, " ns per first write, collected in ");
+    PrintU64(STDOUT_FILENO_linux, (Now_ns() - t0) / 1000);
+    Print(STDOUT_FILENO_linux, " us\n");
+  }
+  Assert(Collect_uffd(&m, id, Emit, NULL) == 0);
+  Free_uffd(&m);
+  munmap_linux(region, TRACKED);
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  WriteSnapshot();
+  Manager_uffd m;
+  long ret = Init_uffd(&m);
+  if (ret < 0) {
+    Print(STDOUT_FILENO_linux, "userfaultfd unavailable (vm.unprivileged_userfaultfd?), errno ");
+    PrintU64(STDOUT_FILENO_linux, (unsigned long long)-ret);
+    Print(STDOUT_FILENO_linux, "\n");
+    exit_linux(0);
+  }
+  Free_uffd(&m);
+  Restore_demo();
+  Dirty_demo();
+  exit_linux(0);
+  return 0;
+}
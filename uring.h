@@ -0,0 +1,1568 @@
+#ifndef C_URING_HEADER
+#define C_URING_HEADER
+
+// === uring.h: io_uring rings, resources, SQE builders & TCP server ===========
+//
+// Contents:
+//   * ring setup & teardown        (jump: Init_uring)
+//   * submission & completion      (jump: GetSqe_uring)
+//   * registered files & buffers   (jump: RegisterFiles_uring)
+//   * provided-buffer rings        (jump: BufRing_uring)
+//   * SQE builders                 (jump: PrepRw_uring)
+//   * TCP server engine            (jump: ServerConfig_uring)
+//   * zero-copy send tracking      (jump: ZcTracker_uring)
+//   * bulk O_DIRECT file I/O       (jump: Bulk_uring)
+//   * small-file batch loader      (jump: Loader_uring)
+//
+// Usage:
+//   uring.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/uring.h" // use as header file
+//
+//   #define C_URING_IMPLEMENTATION
+//   #include "c/uring.h" // use as implementation file
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers. Hot-path helpers (SQE builders, CQE peeking) are
+//   static inline so they compile down to a few loads and stores.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "uring.h depends on linux.h, include it first"
+#endif
+
+typedef struct {
+  unsigned int *head;
+  unsigned int *tail;
+  unsigned int *flags;
+  unsigned int *array;
+  io_uring_sqe_linux *sqes;
+  unsigned int mask;
+  unsigned int entries;
+  unsigned int sqe_tail; // SQEs handed out by GetSqe_uring, published on submit
+  void *ring_ptr;
+  unsigned long ring_size;
+  unsigned long sqes_size;
+} Sq_uring;
+
+typedef struct {
+  unsigned int *head;
+  unsigned int *tail;
+  unsigned int *flags;
+  unsigned int *overflow;
+  io_uring_cqe_linux *cqes;
+  unsigned int mask;
+  unsigned int entries;
+  void *ring_ptr;
+  unsigned long ring_size;
+} Cq_uring;
+
+typedef struct {
+  Sq_uring sq;
+  Cq_uring cq;
+  int fd;
+  unsigned int flags;
+  unsigned int features;
+} Ring_uring;
+
+// A provided-buffer ring (IORING_REGISTER_PBUF_RING) backed by one slab of
+// `entries` buffers of `buf_size` bytes each; buffer id == slot in the slab.
+typedef struct {
+  io_uring_buf_ring_linux *br;
+  char *bufs;
+  unsigned int buf_size;
+  unsigned short entries;
+  unsigned short mask;
+  unsigned short bgid;
+  unsigned short tail; // local tail, published by AdvanceBufRing_uring
+  unsigned long ring_size;
+  unsigned long bufs_size;
+} BufRing_uring;
+
+// Parses in[0, len), appends replies at out + *out_len (up to out_cap bytes) and
+// returns how many input bytes it consumed, or -1 to close the connection.
+// Unconsumed bytes are handed back, with more data appended, on the next call.
+typedef long (*OnData_uring)(void *user, const char *in, unsigned long len, char *out, unsigned long *out_len, unsigned long out_cap);
+
+typedef struct {
+  OnData_uring on_data;
+  void *user;
+  unsigned int addr;           // IPv4 address in host byte order, e.g. INADDR_LOOPBACK_linux
+  unsigned short port;
+  unsigned short max_conns;    // per worker, also the highest fd a worker serves
+  unsigned int ring_entries;
+  unsigned short buf_count;    // provided recv buffers per worker, power of two
+  unsigned int buf_size;
+  unsigned int io_size;        // per-connection input and output buffer size
+  unsigned int send_timeout_ms;
+  unsigned long *enters;       // or 0: io_uring_enter calls are added here, e.g. MAP_SHARED across workers
+} ServerConfig_uring;
+
+typedef struct {
+  char *in;
+  char *out;
+  unsigned int in_len;
+  unsigned int out_len;
+  unsigned int out_inflight;
+  unsigned int gen;
+  unsigned int state;
+} Conn_uring;
+
+typedef struct {
+  Ring_uring ring;
+  BufRing_uring br;
+  const ServerConfig_uring *cfg;
+  Conn_uring *conns;
+  unsigned long conns_size;
+  char *io;
+  unsigned long io_size;
+  int listen_fd;
+  int accept_idle; // multishot accept waiting for a free SQE
+  __kernel_timespec_linux send_timeout;
+} Server_uring;
+
+// Called once the kernel no longer references a zero-copy payload: `res` is the
+// byte count (or -errno) of the send and `copied` is set when the kernel fell
+// back to copying (IORING_SEND_ZC_REPORT_USAGE_linux), e.g. over loopback.
+typedef void (*ZcRelease_uring)(void *user, unsigned long long tag, int res, int copied);
+
+typedef struct {
+  unsigned long long tag;
+  int res;
+  unsigned int next; // free-list link
+} ZcSlot_uring;
+
+// Tracks SEND_ZC/SENDMSG_ZC requests through their two CQEs: the result (with
+// IORING_CQE_F_MORE) and the later IORING_CQE_F_NOTIF that releases the buffer.
+typedef struct {
+  ZcSlot_uring *slots;
+  unsigned int count;
+  unsigned int free_head;
+  unsigned int inflight;
+  ZcRelease_uring release;
+  void *user;
+} ZcTracker_uring;
+
+// Called once per chunk, in file order: `off` is the chunk's file offset and
+// data[0, len) its bytes. ReadBulk_uring calls it after the chunk landed,
+// WriteBulk_uring before it is queued, to fill it. The buffer is reused once
+// the callback returns; a negative return stops the transfer.
+typedef long (*OnChunk_uring)(void *user, unsigned long long off, void *data, unsigned int len);
+
+// One O_DIRECT file streamed through `depth` registered buffers of `chunk`
+// bytes, each a READ_FIXED/WRITE_FIXED in flight on the fixed file 0.
+typedef struct {
+  Ring_uring ring;
+  int fd;
+  unsigned int depth;
+  unsigned int chunk;
+  unsigned int mem_align;    // STATX_DIOALIGN requirements of the file
+  unsigned int offset_align;
+  unsigned long long size;   // file size, grown by WriteBulk_uring
+  char *bufs;                // depth * chunk bytes, then depth results
+  int *res;                  // per buffer: PENDING_bulk while in flight, else the CQE result
+  unsigned long bufs_size;
+} Bulk_uring;
+
+// One file of a LoadFiles_uring batch: the caller sets path, buf and cap.
+typedef struct {
+  const char *path;
+  void *buf;
+  unsigned int cap;
+  int res;          // bytes read (at most cap), or -errno of the first failing step
+  statx_t_linux st; // STATX_BASIC_STATS, st.stx_size > res means the file did not fit
+} FileLoad_uring;
+
+// Loads files through linked OPENAT -> STATX -> READ -> CLOSE chains, each
+// chain working on its own direct descriptor so no fd ever reaches the
+// process table.
+typedef struct {
+  Ring_uring ring;
+  unsigned int slots;       // direct descriptors, i.e. files in flight
+  unsigned int *free_slots; // stack of idle slots
+  unsigned int free_count;
+  unsigned long long enters; // io_uring_enter calls made by LoadFiles_uring
+} Loader_uring;
+
+#define ZC_DATA_uring (1ULL << 63)
+
+//
+// Ring setup & teardown
+//
+long Init_uring(Ring_uring *ring, unsigned int entries, unsigned int flags);
+long InitParams_uring(Ring_uring *ring, unsigned int entries, io_uring_params_linux *p);
+void Exit_uring(Ring_uring *ring);
+//
+// Submission & completion
+//
+long Submit_uring(Ring_uring *ring);
+long SubmitAndWait_uring(Ring_uring *ring, unsigned int wait_nr);
+long WaitCqe_uring(Ring_uring *ring, io_uring_cqe_linux **cqe);
+long WaitCqeTimeout_uring(Ring_uring *ring, io_uring_cqe_linux **cqe, const __kernel_timespec_linux *ts);
+//
+// Registered files & buffers
+//
+long RegisterFiles_uring(Ring_uring *ring, const int *fds, unsigned int nr);
+long RegisterFilesSparse_uring(Ring_uring *ring, unsigned int nr);
+long UpdateFiles_uring(Ring_uring *ring, unsigned int off, const int *fds, unsigned int nr);
+long UnregisterFiles_uring(Ring_uring *ring);
+long RegisterBuffers_uring(Ring_uring *ring, const iovec_linux *iovs, unsigned int nr);
+long RegisterBuffersSparse_uring(Ring_uring *ring, unsigned int nr);
+long UpdateBuffers_uring(Ring_uring *ring, unsigned int off, const iovec_linux *iovs, unsigned int nr);
+long UnregisterBuffers_uring(Ring_uring *ring);
+//
+// Provided-buffer rings
+//
+long InitBufRing_uring(Ring_uring *ring, BufRing_uring *br, unsigned short bgid, unsigned short entries, unsigned int buf_size);
+void FreeBufRing_uring(Ring_uring *ring, BufRing_uring *br);
+//
+// TCP server engine
+//
+long ListenTcp_uring(unsigned int addr, unsigned short port, int backlog);
+long InitServer_uring(Server_uring *srv, const ServerConfig_uring *cfg, int listen_fd);
+long RunServer_uring(Server_uring *srv, const volatile int *stop);
+void FreeServer_uring(Server_uring *srv);
+long SpawnWorkers_uring(const ServerConfig_uring *cfg, int *pids, unsigned int max_workers);
+//
+// Zero-copy send tracking
+//
+long InitZc_uring(ZcTracker_uring *zc, unsigned int slots, ZcRelease_uring release, void *user);
+void FreeZc_uring(ZcTracker_uring *zc);
+io_uring_sqe_linux *SendZc_uring(Ring_uring *ring, ZcTracker_uring *zc, int fd, const void *buf, unsigned int len, int buf_index, unsigned long long tag);
+io_uring_sqe_linux *SendmsgZc_uring(Ring_uring *ring, ZcTracker_uring *zc, int fd, const user_msghdr_linux *msg, unsigned long long tag);
+int CompleteZc_uring(ZcTracker_uring *zc, const io_uring_cqe_linux *cqe);
+//
+// Bulk O_DIRECT file I/O
+//
+long OpenBulk_uring(Bulk_uring *b, const char *path, int flags, int mode, unsigned int depth, unsigned int chunk);
+long long ReadBulk_uring(Bulk_uring *b, unsigned long long off, unsigned long long len, OnChunk_uring consume, void *user);
+long long WriteBulk_uring(Bulk_uring *b, unsigned long long off, unsigned long long len, OnChunk_uring fill, void *user);
+void CloseBulk_uring(Bulk_uring *b);
+//
+// Small-file batch loader
+//
+long InitLoader_uring(Loader_uring *l, unsigned int slots);
+long LoadFiles_uring(Loader_uring *l, FileLoad_uring *files, unsigned int count);
+void FreeLoader_uring(Loader_uring *l);
+
+static inline io_uring_sqe_linux *GetSqe_uring(Ring_uring *ring) {
+  Sq_uring *sq = &ring->sq;
+  unsigned int head = __atomic_load_n(sq->head, __ATOMIC_ACQUIRE);
+  if (sq->sqe_tail - head >= sq->entries) {
+    return 0;
+  }
+  io_uring_sqe_linux *sqe = &sq->sqes[sq->sqe_tail & sq->mask];
+  sq->sqe_tail++;
+  unsigned long long *words = (unsigned long long *)sqe;
+  for (int i = 0; i < 8; ++i) {
+    words[i] = 0;
+  }
+  return sqe;
+}
+
+static inline unsigned int SqSpace_uring(const Ring_uring *ring) {
+  return ring->sq.entries - (ring->sq.sqe_tail - __atomic_load_n(ring->sq.head, __ATOMIC_ACQUIRE));
+}
+
+static inline io_uring_cqe_linux *PeekCqe_uring(Ring_uring *ring) {
+  Cq_uring *cq = &ring->cq;
+  unsigned int head = *cq->head;
+  if (head == __atomic_load_n(cq->tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+  return &cq->cqes[head & cq->mask];
+}
+
+// Copies up to `max` ready CQE pointers into `cqes`; release them with CqAdvance_uring.
+static inline unsigned int PeekBatchCqe_uring(Ring_uring *ring, io_uring_cqe_linux **cqes, unsigned int max) {
+  Cq_uring *cq = &ring->cq;
+  unsigned int head = *cq->head;
+  unsigned int ready = __atomic_load_n(cq->tail, __ATOMIC_ACQUIRE) - head;
+  if (ready > max) {
+    ready = max;
+  }
+  for (unsigned int i = 0; i < ready; ++i) {
+    cqes[i] = &cq->cqes[(head + i) & cq->mask];
+  }
+  return ready;
+}
+
+static inline void CqAdvance_uring(Ring_uring *ring, unsigned int nr) {
+  __atomic_store_n(ring->cq.head, *ring->cq.head + nr, __ATOMIC_RELEASE);
+}
+
+static inline void CqeSeen_uring(Ring_uring *ring) {
+  CqAdvance_uring(ring, 1);
+}
+
+//
+// Provided-buffer ring helpers
+//
+static inline void *BufAddr_uring(const BufRing_uring *br, unsigned short bid) {
+  return br->bufs + (unsigned long)bid * br->buf_size;
+}
+
+// Buffer id picked by the kernel for a CQE flagged IORING_CQE_F_BUFFER.
+static inline unsigned short CqeBid_uring(const io_uring_cqe_linux *cqe) {
+  return (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT_linux);
+}
+
+// Stages buffer `bid` at tail + `offset`, invisible to the kernel until AdvanceBufRing_uring.
+static inline void AddBuf_uring(BufRing_uring *br, unsigned short bid, unsigned int offset) {
+  io_uring_buf_linux *buf = &br->br->bufs[(unsigned short)(br->tail + offset) & br->mask];
+  buf->addr = (unsigned long)BufAddr_uring(br, bid);
+  buf->len = br->buf_size;
+  buf->bid = bid;
+}
+
+static inline void AdvanceBufRing_uring(BufRing_uring *br, unsigned int count) {
+  br->tail = (unsigned short)(br->tail + count);
+  __atomic_store_n(&br->br->tail, br->tail, __ATOMIC_RELEASE);
+}
+
+// Hands a consumed buffer back to the kernel.
+static inline void RecycleBuf_uring(BufRing_uring *br, unsigned short bid) {
+  AddBuf_uring(br, bid, 0);
+  AdvanceBufRing_uring(br, 1);
+}
+
+//
+// SQE builders
+//
+static inline void PrepRw_uring(io_uring_sqe_linux *sqe, int op, int fd, const void *addr, unsigned int len, unsigned long long off) {
+  sqe->opcode = (unsigned char)op;
+  sqe->fd = fd;
+  sqe->off = off;
+  sqe->addr = (unsigned long)addr;
+  sqe->len = len;
+}
+
+static inline void PrepNop_uring(io_uring_sqe_linux *sqe) {
+  PrepRw_uring(sqe, IORING_OP_NOP_linux, -1, 0, 0, 0);
+}
+
+static inline void PrepRead_uring(io_uring_sqe_linux *sqe, int fd, void *buf, unsigned int len, unsigned long long off) {
+  PrepRw_uring(sqe, IORING_OP_READ_linux, fd, buf, len, off);
+}
+
+static inline void PrepWrite_uring(io_uring_sqe_linux *sqe, int fd, const void *buf, unsigned int len, unsigned long long off) {
+  PrepRw_uring(sqe, IORING_OP_WRITE_linux, fd, buf, len, off);
+}
+
+static inline void PrepReadv_uring(io_uring_sqe_linux *sqe, int fd, const iovec_linux *iovs, unsigned int nr, unsigned long long off) {
+  PrepRw_uring(sqe, IORING_OP_READV_linux, fd, iovs, nr, off);
+}
+
+static inline void PrepWritev_uring(io_uring_sqe_linux *sqe, int fd, const iovec_linux *iovs, unsigned int nr, unsigned long long off) {
+  PrepRw_uring(sqe, IORING_OP_WRITEV_linux, fd, iovs, nr, off);
+}
+
+// `buf` must lie inside registered buffer `buf_index` (RegisterBuffers_uring).
+static inline void PrepReadFixed_uring(io_uring_sqe_linux *sqe, int fd, void *buf, unsigned int len, unsigned long long off, unsigned short buf_index) {
+  PrepRw_uring(sqe, IORING_OP_READ_FIXED_linux, fd, buf, len, off);
+  sqe->buf_index = buf_index;
+}
+
+static inline void PrepWriteFixed_uring(io_uring_sqe_linux *sqe, int fd, const void *buf, unsigned int len, unsigned long long off, unsigned short buf_index) {
+  PrepRw_uring(sqe, IORING_OP_WRITE_FIXED_linux, fd, buf, len, off);
+  sqe->buf_index = buf_index;
+}
+
+// Read into a buffer the kernel picks from provided-buffer group `bgid`.
+static inline void PrepReadSelect_uring(io_uring_sqe_linux *sqe, int fd, unsigned int len, unsigned long long off, unsigned short bgid) {
+  PrepRw_uring(sqe, IORING_OP_READ_linux, fd, 0, len, off);
+  sqe->flags |= IOSQE_BUFFER_SELECT_linux;
+  sqe->buf_group = bgid;
+}
+
+// Interpret sqe->fd as an index into the registered file table.
+static inline void SetFixedFile_uring(io_uring_sqe_linux *sqe) {
+  sqe->flags |= IOSQE_FIXED_FILE_linux;
+}
+
+// One SQE, one CQE per accepted connection (res = new fd) while IORING_CQE_F_MORE is set.
+static inline void PrepMultishotAccept_uring(io_uring_sqe_linux *sqe, int fd, sockaddr_linux *addr, int *addrlen, int flags) {
+  PrepRw_uring(sqe, IORING_OP_ACCEPT_linux, fd, addr, 0, (unsigned long)addrlen);
+  sqe->accept_flags = (unsigned int)flags;
+  sqe->ioprio |= IORING_ACCEPT_MULTISHOT_linux;
+}
+
+// One SQE, one CQE per received chunk, each landing in a buffer picked from group `bgid`.
+static inline void PrepMultishotRecv_uring(io_uring_sqe_linux *sqe, int fd, unsigned short bgid, int flags) {
+  PrepRw_uring(sqe, IORING_OP_RECV_linux, fd, 0, 0, 0);
+  sqe->msg_flags = (unsigned int)flags;
+  sqe->flags |= IOSQE_BUFFER_SELECT_linux;
+  sqe->buf_group = bgid;
+  sqe->ioprio |= IORING_RECV_MULTISHOT_linux;
+}
+
+static inline void PrepRecv_uring(io_uring_sqe_linux *sqe, int fd, void *buf, unsigned int len, int flags) {
+  PrepRw_uring(sqe, IORING_OP_RECV_linux, fd, buf, len, 0);
+  sqe->msg_flags = (unsigned int)flags;
+}
+
+static inline void PrepSend_uring(io_uring_sqe_linux *sqe, int fd, const void *buf, unsigned int len, int flags) {
+  PrepRw_uring(sqe, IORING_OP_SEND_linux, fd, buf, len, 0);
+  sqe->msg_flags = (unsigned int)flags;
+}
+
+static inline void PrepShutdown_uring(io_uring_sqe_linux *sqe, int fd, int how) {
+  PrepRw_uring(sqe, IORING_OP_SHUTDOWN_linux, fd, 0, (unsigned int)how, 0);
+}
+
+static inline void PrepClose_uring(io_uring_sqe_linux *sqe, int fd) {
+  PrepRw_uring(sqe, IORING_OP_CLOSE_linux, fd, 0, 0, 0);
+}
+
+// Zero-copy send: CQE #1 carries the result with IORING_CQE_F_MORE, CQE #2
+// (IORING_CQE_F_NOTIF) tells when `buf` may be reused. `zc_flags` go in ioprio.
+static inline void PrepSendZc_uring(io_uring_sqe_linux *sqe, int fd, const void *buf, unsigned int len, int flags, unsigned int zc_flags) {
+  PrepRw_uring(sqe, IORING_OP_SEND_ZC_linux, fd, buf, len, 0);
+  sqe->msg_flags = (unsigned int)flags;
+  sqe->ioprio = (unsigned short)zc_flags;
+}
+
+// Same, from inside registered buffer `buf_index`, skipping the per-send page pinning.
+static inline void PrepSendZcFixed_uring(io_uring_sqe_linux *sqe, int fd, const void *buf, unsigned int len, int flags, unsigned int zc_flags, unsigned short buf_index) {
+  PrepSendZc_uring(sqe, fd, buf, len, flags, zc_flags | IORING_RECVSEND_FIXED_BUF_linux);
+  sqe->buf_index = buf_index;
+}
+
+static inline void PrepSendmsgZc_uring(io_uring_sqe_linux *sqe, int fd, const user_msghdr_linux *msg, int flags) {
+  PrepRw_uring(sqe, IORING_OP_SENDMSG_ZC_linux, fd, msg, 1, 0);
+  sqe->msg_flags = (unsigned int)flags;
+}
+
+static inline int IsZcCqe_uring(const io_uring_cqe_linux *cqe) {
+  return (cqe->user_data & ZC_DATA_uring) != 0;
+}
+
+// Opens `path` straight into direct descriptor `slot`, bypassing the fd table;
+// IORING_FILE_INDEX_ALLOC_linux lets the kernel pick a free slot and return it in cqe->res.
+// Direct descriptors are never inherited, `flags` must not carry O_CLOEXEC.
+static inline void PrepOpenatDirect_uring(io_uring_sqe_linux *sqe, int dfd, const char *path, int flags, unsigned int mode, unsigned int slot) {
+  PrepRw_uring(sqe, IORING_OP_OPENAT_linux, dfd, path, mode, 0);
+  sqe->open_flags = (unsigned int)flags;
+  sqe->file_index = slot == IORING_FILE_INDEX_ALLOC_linux ? slot : slot + 1;
+}
+
+static inline void PrepCloseDirect_uring(io_uring_sqe_linux *sqe, unsigned int slot) {
+  PrepClose_uring(sqe, 0);
+  sqe->file_index = slot + 1;
+}
+
+// The kernel fills `st` when the request runs, by path: STATX takes no direct descriptor.
+static inline void PrepStatx_uring(io_uring_sqe_linux *sqe, int dfd, const char *path, int flags, unsigned int mask, statx_t_linux *st) {
+  PrepRw_uring(sqe, IORING_OP_STATX_linux, dfd, path, mask, (unsigned long)st);
+  sqe->statx_flags = (unsigned int)flags;
+}
+
+// Cancels the previous (IOSQE_IO_LINK-ed) SQE if it has not completed within `ts`.
+// The kernel reads `ts` at submission time, so it must outlive the next submit.
+static inline void PrepLinkTimeout_uring(io_uring_sqe_linux *sqe, const __kernel_timespec_linux *ts, unsigned int flags) {
+  PrepRw_uring(sqe, IORING_OP_LINK_TIMEOUT_linux, -1, ts, 1, 0);
+  sqe->timeout_flags = flags;
+}
+
+#endif // C_URING_HEADER
+#ifdef C_URING_IMPLEMENTATION
+
+static long Mmap_uring(int fd, unsigned long size, unsigned long long off) {
+  return mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_SHARED_linux | MAP_POPULATE_linux, fd, off);
+}
+
+static void Unmap_uring(Ring_uring *ring) {
+  if (ring->sq.sqes) {
+    munmap_linux(ring->sq.sqes, ring->sq.sqes_size);
+  }
+  if (ring->cq.ring_ptr && ring->cq.ring_ptr != ring->sq.ring_ptr) {
+    munmap_linux(ring->cq.ring_ptr, ring->cq.ring_size);
+  }
+  if (ring->sq.ring_ptr) {
+    munmap_linux(ring->sq.ring_ptr, ring->sq.ring_size);
+  }
+}
+
+//
+// Ring setup & teardown
+//
+long Init_uring(Ring_uring *ring, unsigned int entries, unsigned int flags) {
+  io_uring_params_linux p = {0};
+  p.flags = flags;
+  return InitParams_uring(ring, entries, &p);
+}
+
+long InitParams_uring(Ring_uring *ring, unsigned int entries, io_uring_params_linux *p) {
+  Sq_uring *sq = &ring->sq;
+  Cq_uring *cq = &ring->cq;
+  sq->ring_ptr = cq->ring_ptr = sq->sqes = 0;
+
+  long fd = io_uring_setup_linux(entries, p);
+  if (fd < 0) {
+    return fd;
+  }
+  ring->fd = (int)fd;
+  ring->flags = p->flags;
+  ring->features = p->features;
+
+  sq->ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned int);
+  cq->ring_size = p->cq_off.cqes + p->cq_entries * sizeof(io_uring_cqe_linux);
+  if (p->features & IORING_FEAT_SINGLE_MMAP_linux) {
+    if (cq->ring_size > sq->ring_size) {
+      sq->ring_size = cq->ring_size;
+    }
+    cq->ring_size = sq->ring_size;
+  }
+
+  long ret = Mmap_uring(ring->fd, sq->ring_size, IORING_OFF_SQ_RING_linux);
+  if (ret < 0 && ret > -4096) {
+    goto fail;
+  }
+  sq->ring_ptr = (void *)ret;
+  if (p->features & IORING_FEAT_SINGLE_MMAP_linux) {
+    cq->ring_ptr = sq->ring_ptr;
+  } else {
+    ret = Mmap_uring(ring->fd, cq->ring_size, IORING_OFF_CQ_RING_linux);
+    if (ret < 0 && ret > -4096) {
+      goto fail;
+    }
+    cq->ring_ptr = (void *)ret;
+  }
+  sq->sqes_size = p->sq_entries * sizeof(io_uring_sqe_linux);
+  ret = Mmap_uring(ring->fd, sq->sqes_size, IORING_OFF_SQES_linux);
+  if (ret < 0 && ret > -4096) {
+    goto fail;
+  }
+  sq->sqes = (io_uring_sqe_linux *)ret;
+
+  char *sqp = (char *)sq->ring_ptr;
+  sq->head = (unsigned int *)(sqp + p->sq_off.head);
+  sq->tail = (unsigned int *)(sqp + p->sq_off.tail);
+  sq->flags = (unsigned int *)(sqp + p->sq_off.flags);
+  sq->array = (unsigned int *)(sqp + p->sq_off.array);
+  sq->mask = *(unsigned int *)(sqp + p->sq_off.ring_mask);
+  sq->entries = *(unsigned int *)(sqp + p->sq_off.ring_entries);
+  sq->sqe_tail = *sq->tail;
+  // Identity-map the indirection array once so submission never touches it again.
+  if (!(p->flags & IORING_SETUP_NO_SQARRAY_linux)) {
+    for (unsigned int i = 0; i < sq->entries; ++i) {
+      sq->array[i] = i;
+    }
+  }
+
+  char *cqp = (char *)cq->ring_ptr;
+  cq->head = (unsigned int *)(cqp + p->cq_off.head);
+  cq->tail = (unsigned int *)(cqp + p->cq_off.tail);
+  cq->flags = p->cq_off.flags ? (unsigned int *)(cqp + p->cq_off.flags) : 0;
+  cq->overflow = (unsigned int *)(cqp + p->cq_off.overflow);
+  cq->cqes = (io_uring_cqe_linux *)(cqp + p->cq_off.cqes);
+  cq->mask = *(unsigned int *)(cqp + p->cq_off.ring_mask);
+  cq->entries = *(unsigned int *)(cqp + p->cq_off.ring_entries);
+  return 0;
+
+fail:
+  Unmap_uring(ring);
+  close_linux(ring->fd);
+  return ret;
+}
+
+void Exit_uring(Ring_uring *ring) {
+  Unmap_uring(ring);
+  close_linux(ring->fd);
+}
+
+//
+// Submission & completion
+//
+static unsigned int Flush_uring(Ring_uring *ring) {
+  Sq_uring *sq = &ring->sq;
+  __atomic_store_n(sq->tail, sq->sqe_tail, __ATOMIC_RELEASE);
+  return sq->sqe_tail - __atomic_load_n(sq->head, __ATOMIC_ACQUIRE);
+}
+
+long Submit_uring(Ring_uring *ring) {
+  return SubmitAndWait_uring(ring, 0);
+}
+
+long SubmitAndWait_uring(Ring_uring *ring, unsigned int wait_nr) {
+  unsigned int submitted = Flush_uring(ring);
+  unsigned int flags = 0;
+  if (wait_nr || (ring->flags & IORING_SETUP_IOPOLL_linux)) {
+    flags |= IORING_ENTER_GETEVENTS_linux;
+  }
+  // The kernel may need a syscall to flush overflowed CQEs or run deferred task work.
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  unsigned int sq_flags = __atomic_load_n(ring->sq.flags, __ATOMIC_RELAXED);
+  if (sq_flags & (IORING_SQ_CQ_OVERFLOW_linux | IORING_SQ_TASKRUN_linux)) {
+    flags |= IORING_ENTER_GETEVENTS_linux;
+  }
+  if (ring->flags & IORING_SETUP_SQPOLL_linux) {
+    if (sq_flags & IORING_SQ_NEED_WAKEUP_linux) {
+      flags |= IORING_ENTER_SQ_WAKEUP_linux;
+    }
+    if (!flags) {
+      return submitted;
+    }
+  } else if (!submitted && !flags) {
+    return 0;
+  }
+  return io_uring_enter_linux(ring->fd, submitted, wait_nr, flags, 0, 0);
+}
+
+long WaitCqe_uring(Ring_uring *ring, io_uring_cqe_linux **cqe) {
+  for (;;) {
+    *cqe = PeekCqe_uring(ring);
+    if (*cqe) {
+      return 0;
+    }
+    long ret = io_uring_enter_linux(ring->fd, Flush_uring(ring), 1, IORING_ENTER_GETEVENTS_linux, 0, 0);
+    if (ret < 0 && ret != -EINTR_linux) {
+      return ret;
+    }
+  }
+}
+
+// Returns -ETIME_linux if nothing completed within the relative timeout `ts`.
+long WaitCqeTimeout_uring(Ring_uring *ring, io_uring_cqe_linux **cqe, const __kernel_timespec_linux *ts) {
+  if (!(ring->features & IORING_FEAT_EXT_ARG_linux)) {
+    return -EINVAL_linux;
+  }
+  io_uring_getevents_arg_linux arg = {0};
+  arg.ts = (unsigned long)ts;
+  for (;;) {
+    *cqe = PeekCqe_uring(ring);
+    if (*cqe) {
+      return 0;
+    }
+    long ret = io_uring_enter_linux(ring->fd, Flush_uring(ring), 1, IORING_ENTER_GETEVENTS_linux | IORING_ENTER_EXT_ARG_linux, &arg, sizeof(arg));
+    if (ret == -ETIME_linux) {
+      *cqe = PeekCqe_uring(ring);
+      return *cqe ? 0 : ret;
+    }
+    if (ret < 0 && ret != -EINTR_linux) {
+      return ret;
+    }
+  }
+}
+
+//
+// Registered files & buffers
+//
+static long RegisterRsrc_uring(Ring_uring *ring, unsigned int op, const void *data, unsigned int nr) {
+  io_uring_rsrc_register_linux reg = {0};
+  reg.nr = nr;
+  reg.flags = data ? 0 : IORING_RSRC_REGISTER_SPARSE_linux;
+  reg.data = (unsigned long)data;
+  return io_uring_register_linux(ring->fd, op, &reg, sizeof(reg));
+}
+
+static long UpdateRsrc_uring(Ring_uring *ring, unsigned int op, unsigned int off, const void *data, unsigned int nr) {
+  io_uring_rsrc_update2_linux up = {0};
+  up.offset = off;
+  up.data = (unsigned long)data;
+  up.nr = nr;
+  return io_uring_register_linux(ring->fd, op, &up, sizeof(up));
+}
+
+long RegisterFiles_uring(Ring_uring *ring, const int *fds, unsigned int nr) {
+  return RegisterRsrc_uring(ring, IORING_REGISTER_FILES2_linux, fds, nr);
+}
+
+// Reserves `nr` empty slots to be filled by UpdateFiles_uring or direct-descriptor ops.
+long RegisterFilesSparse_uring(Ring_uring *ring, unsigned int nr) {
+  return RegisterRsrc_uring(ring, IORING_REGISTER_FILES2_linux, 0, nr);
+}
+
+// Replaces slots [off, off + nr); -1 clears a slot, IORING_REGISTER_FILES_SKIP_linux keeps it.
+long UpdateFiles_uring(Ring_uring *ring, unsigned int off, const int *fds, unsigned int nr) {
+  return UpdateRsrc_uring(ring, IORING_REGISTER_FILES_UPDATE2_linux, off, fds, nr);
+}
+
+long UnregisterFiles_uring(Ring_uring *ring) {
+  return io_uring_register_linux(ring->fd, IORING_UNREGISTER_FILES_linux, 0, 0);
+}
+
+long RegisterBuffers_uring(Ring_uring *ring, const iovec_linux *iovs, unsigned int nr) {
+  return RegisterRsrc_uring(ring, IORING_REGISTER_BUFFERS2_linux, iovs, nr);
+}
+
+long RegisterBuffersSparse_uring(Ring_uring *ring, unsigned int nr) {
+  return RegisterRsrc_uring(ring, IORING_REGISTER_BUFFERS2_linux, 0, nr);
+}
+
+// Replaces buffer slots [off, off + nr); an iovec with a null base clears a slot.
+long UpdateBuffers_uring(Ring_uring *ring, unsigned int off, const iovec_linux *iovs, unsigned int nr) {
+  return UpdateRsrc_uring(ring, IORING_REGISTER_BUFFERS_UPDATE_linux, off, iovs, nr);
+}
+
+long UnregisterBuffers_uring(Ring_uring *ring) {
+  return io_uring_register_linux(ring->fd, IORING_UNREGISTER_BUFFERS_linux, 0, 0);
+}
+
+//
+// Provided-buffer rings
+//
+// `entries` must be a power of two (at most 32768); every buffer starts out owned by the kernel.
+long InitBufRing_uring(Ring_uring *ring, BufRing_uring *br, unsigned short bgid, unsigned short entries, unsigned int buf_size) {
+  if (!entries || (entries & (entries - 1)) || entries > 32768) {
+    return -EINVAL_linux;
+  }
+  br->entries = entries;
+  br->mask = (unsigned short)(entries - 1);
+  br->bgid = bgid;
+  br->buf_size = buf_size;
+  br->tail = 0;
+  br->ring_size = (entries * sizeof(io_uring_buf_linux) + 4095) & ~4095UL;
+  br->bufs_size = ((unsigned long)entries * buf_size + 4095) & ~4095UL;
+
+  long ret = mmap_linux(0, br->ring_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  br->br = (io_uring_buf_ring_linux *)ret;
+  ret = mmap_linux(0, br->bufs_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    munmap_linux(br->br, br->ring_size);
+    return ret;
+  }
+  br->bufs = (char *)ret;
+
+  io_uring_buf_reg_linux reg = {0};
+  reg.ring_addr = (unsigned long)br->br;
+  reg.ring_entries = entries;
+  reg.bgid = bgid;
+  ret = io_uring_register_linux(ring->fd, IORING_REGISTER_PBUF_RING_linux, &reg, 1);
+  if (ret < 0) {
+    munmap_linux(br->bufs, br->bufs_size);
+    munmap_linux(br->br, br->ring_size);
+    return ret;
+  }
+
+  for (unsigned int i = 0; i < entries; ++i) {
+    AddBuf_uring(br, (unsigned short)i, i);
+  }
+  AdvanceBufRing_uring(br, entries);
+  return 0;
+}
+
+void FreeBufRing_uring(Ring_uring *ring, BufRing_uring *br) {
+  io_uring_buf_reg_linux reg = {0};
+  reg.bgid = br->bgid;
+  io_uring_register_linux(ring->fd, IORING_UNREGISTER_PBUF_RING_linux, &reg, 1);
+  munmap_linux(br->bufs, br->bufs_size);
+  munmap_linux(br->br, br->ring_size);
+}
+
+//
+// TCP server engine
+//
+// One ring per worker process, workers pinned one per CPU and sharded by
+// SO_REUSEPORT. A connection costs one multishot accept CQE, then one
+// multishot recv CQE per chunk (buffer from the provided-buffer ring) and one
+// send linked to a LINK_TIMEOUT per reply batch; teardown is a hard-linked
+// SHUTDOWN -> CLOSE pair. Steady state needs a single io_uring_enter per loop.
+enum {
+  OP_ACCEPT_uring = 1,
+  OP_RECV_uring,
+  OP_SEND_uring,
+  OP_TIMEOUT_uring,
+  OP_CLOSE_uring,
+};
+
+enum {
+  CONN_FREE_uring,
+  CONN_OPEN_uring,
+  CONN_CLOSING_uring,
+};
+
+static unsigned short Be16_uring(unsigned short x) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap16(x);
+#else
+  return x;
+#endif
+}
+
+static unsigned int Be32_uring(unsigned int x) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return __builtin_bswap32(x);
+#else
+  return x;
+#endif
+}
+
+static void Move_uring(char *dst, const char *src, unsigned long len) {
+  if (dst < src) {
+    for (unsigned long i = 0; i < len; ++i) {
+      dst[i] = src[i];
+    }
+  } else {
+    while (len--) {
+      dst[len] = src[len];
+    }
+  }
+}
+
+static unsigned long long Data_uring(unsigned int op, int fd, unsigned int gen) {
+  return (unsigned long long)gen << 32 | (unsigned long long)fd << 8 | op;
+}
+
+static void Entered_server(Server_uring *srv) {
+  if (srv->cfg->enters) {
+    __atomic_fetch_add(srv->cfg->enters, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// Gets an SQE, flushing the SQ to the kernel first if fewer than `need` slots are free
+// so that linked chains never straddle two submissions. Returns 0 when the flush did
+// not free `need` slots, e.g. -EBUSY while the CQ overflows.
+static io_uring_sqe_linux *Sqe_server(Server_uring *srv, unsigned int need) {
+  if (SqSpace_uring(&srv->ring) < need) {
+    Submit_uring(&srv->ring);
+    Entered_server(srv); // a short SQ always has requests to flush
+    if (SqSpace_uring(&srv->ring) < need) {
+      return 0;
+    }
+  }
+  return GetSqe_uring(&srv->ring);
+}
+
+long ListenTcp_uring(unsigned int addr, unsigned short port, int backlog) {
+  long fd = socket_linux(AF_INET_linux, SOCK_STREAM_linux | SOCK_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  int one = 1;
+  setsockopt_linux((int)fd, SOL_SOCKET_linux, SO_REUSEADDR_linux, &one, sizeof(one));
+  setsockopt_linux((int)fd, IPPROTO_TCP_linux, TCP_NODELAY_linux, &one, sizeof(one)); // inherited by accepted sockets
+  long ret = setsockopt_linux((int)fd, SOL_SOCKET_linux, SO_REUSEPORT_linux, &one, sizeof(one));
+  if (ret >= 0) {
+    sockaddr_in_linux sin = {0};
+    sin.sin_family = AF_INET_linux;
+    sin.sin_port = Be16_uring(port);
+    sin.sin_addr = Be32_uring(addr);
+    ret = bind_linux((int)fd, (const sockaddr_linux *)&sin, sizeof(sin));
+  }
+  if (ret >= 0) {
+    ret = listen_linux((int)fd, backlog);
+  }
+  if (ret < 0) {
+    close_linux((unsigned int)fd);
+    return ret;
+  }
+  return fd;
+}
+
+// Without an SQE the accept is retried by RunServer_uring after the next reap.
+static void ArmAccept_server(Server_uring *srv) {
+  io_uring_sqe_linux *sqe = Sqe_server(srv, 1);
+  srv->accept_idle = !sqe;
+  if (!sqe) {
+    return;
+  }
+  PrepMultishotAccept_uring(sqe, srv->listen_fd, 0, 0, SOCK_CLOEXEC_linux);
+  sqe->user_data = Data_uring(OP_ACCEPT_uring, srv->listen_fd, 0);
+}
+
+static void Close_server(Server_uring *srv, int fd);
+
+static int ArmRecv_server(Server_uring *srv, int fd) {
+  io_uring_sqe_linux *sqe = Sqe_server(srv, 1);
+  if (!sqe) {
+    return 0;
+  }
+  PrepMultishotRecv_uring(sqe, fd, srv->br.bgid, 0);
+  sqe->user_data = Data_uring(OP_RECV_uring, fd, srv->conns[fd].gen);
+  return 1;
+}
+
+// A reply that cannot be queued closes the connection.
+static void StartSend_server(Server_uring *srv, int fd) {
+  Conn_uring *conn = &srv->conns[fd];
+  io_uring_sqe_linux *sqe = Sqe_server(srv, 2);
+  if (!sqe) {
+    conn->out_len = 0;
+    Close_server(srv, fd);
+    return;
+  }
+  PrepSend_uring(sqe, fd, conn->out, conn->out_len, MSG_NOSIGNAL_linux);
+  sqe->flags |= IOSQE_IO_LINK_linux;
+  sqe->user_data = Data_uring(OP_SEND_uring, fd, conn->gen);
+  sqe = GetSqe_uring(&srv->ring);
+  PrepLinkTimeout_uring(sqe, &srv->send_timeout, 0);
+  sqe->user_data = Data_uring(OP_TIMEOUT_uring, fd, conn->gen);
+  conn->out_inflight = conn->out_len;
+}
+
+// SHUTDOWN wakes the multishot recv (which pins the file) and CLOSE releases the fd;
+// the hard link runs CLOSE even if the peer already tore the socket down. Without
+// SQEs both run as plain syscalls; the recv CQEs that follow are stale by `gen`.
+static void Close_server(Server_uring *srv, int fd) {
+  Conn_uring *conn = &srv->conns[fd];
+  conn->state = CONN_CLOSING_uring;
+  if (conn->out_inflight) {
+    return; // finished by the send completion
+  }
+  io_uring_sqe_linux *sqe = Sqe_server(srv, 2);
+  if (!sqe) {
+    shutdown_linux(fd, SHUT_RDWR_linux);
+    close_linux(fd);
+    conn->gen++;
+    conn->state = CONN_FREE_uring;
+    return;
+  }
+  PrepShutdown_uring(sqe, fd, SHUT_RDWR_linux);
+  sqe->flags |= IOSQE_IO_HARDLINK_linux | IOSQE_CQE_SKIP_SUCCESS_linux;
+  sqe->user_data = Data_uring(OP_CLOSE_uring, fd, conn->gen);
+  sqe = GetSqe_uring(&srv->ring);
+  PrepClose_uring(sqe, fd);
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS_linux;
+  sqe->user_data = Data_uring(OP_CLOSE_uring, fd, conn->gen);
+  conn->gen++;
+  conn->state = CONN_FREE_uring;
+}
+
+static void Input_server(Server_uring *srv, int fd, const char *data, unsigned long len) {
+  Conn_uring *conn = &srv->conns[fd];
+  unsigned int cap = srv->cfg->io_size;
+  if (conn->in_len) {
+    if (conn->in_len + len > cap) {
+      Close_server(srv, fd);
+      return;
+    }
+    Move_uring(conn->in + conn->in_len, data, len);
+    conn->in_len += (unsigned int)len;
+    data = conn->in;
+    len = conn->in_len;
+  }
+
+  unsigned long out_len = conn->out_len;
+  long used = srv->cfg->on_data(srv->cfg->user, data, len, conn->out, &out_len, cap);
+  if (used < 0 || (used == 0 && len == cap)) {
+    Close_server(srv, fd);
+    return;
+  }
+  if (len - used > cap) {
+    Close_server(srv, fd); // the leftover would not fit the input buffer
+    return;
+  }
+  conn->out_len = (unsigned int)out_len;
+  conn->in_len = (unsigned int)(len - used);
+  Move_uring(conn->in, data + used, conn->in_len);
+
+  if (conn->out_len && !conn->out_inflight) {
+    StartSend_server(srv, fd);
+  }
+}
+
+static void Complete_server(Server_uring *srv, const io_uring_cqe_linux *cqe) {
+  unsigned int op = (unsigned int)(cqe->user_data & 0xff);
+  int fd = (int)((cqe->user_data >> 8) & 0xffffff);
+  unsigned int gen = (unsigned int)(cqe->user_data >> 32);
+  int more = (cqe->flags & IORING_CQE_F_MORE_linux) != 0;
+
+  if (op == OP_ACCEPT_uring) {
+    if (cqe->res >= 0) {
+      int cfd = cqe->res;
+      if (cfd >= srv->cfg->max_conns) {
+        io_uring_sqe_linux *sqe = Sqe_server(srv, 1);
+        if (!sqe) {
+          close_linux(cfd);
+        } else {
+          PrepClose_uring(sqe, cfd);
+          sqe->flags |= IOSQE_CQE_SKIP_SUCCESS_linux;
+          sqe->user_data = Data_uring(OP_CLOSE_uring, cfd, 0);
+        }
+      } else {
+        Conn_uring *conn = &srv->conns[cfd];
+        conn->state = CONN_OPEN_uring;
+        conn->in_len = conn->out_len = conn->out_inflight = 0;
+        if (!ArmRecv_server(srv, cfd)) {
+          Close_server(srv, cfd);
+        }
+      }
+    }
+    if (!more) {
+      ArmAccept_server(srv);
+    }
+    return;
+  }
+
+  Conn_uring *conn = &srv->conns[fd];
+  int stale = conn->gen != gen;
+  if (op == OP_RECV_uring) {
+    if (cqe->flags & IORING_CQE_F_BUFFER_linux) {
+      unsigned short bid = CqeBid_uring(cqe);
+      if (!stale && conn->state == CONN_OPEN_uring && cqe->res > 0) {
+        Input_server(srv, fd, (const char *)BufAddr_uring(&srv->br, bid), (unsigned long)cqe->res);
+      }
+      RecycleBuf_uring(&srv->br, bid);
+    }
+    if (stale || conn->state != CONN_OPEN_uring || more) {
+      return;
+    }
+    // multishot ended early, e.g. ran out of provided buffers
+    if ((cqe->res > 0 || cqe->res == -ENOBUFS_linux) && ArmRecv_server(srv, fd)) {
+      return;
+    }
+    Close_server(srv, fd);
+  } else if (op == OP_SEND_uring && !stale) {
+    unsigned int sent = cqe->res > 0 ? (unsigned int)cqe->res : 0;
+    conn->out_len -= sent;
+    conn->out_inflight = 0;
+    Move_uring(conn->out, conn->out + sent, conn->out_len);
+    if (cqe->res < 0) {
+      conn->out_len = 0;
+      Close_server(srv, fd); // includes -ECANCELED from the link timeout
+    } else if (conn->state == CONN_CLOSING_uring) {
+      Close_server(srv, fd);
+    } else if (conn->out_len) {
+      StartSend_server(srv, fd);
+    }
+  }
+}
+
+static long MapAnon_uring(unsigned long size) {
+  return mmap_linux(0, size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+}
+
+// A recv buffer must fit the connection's input buffer, which keeps what on_data leaves over.
+long InitServer_uring(Server_uring *srv, const ServerConfig_uring *cfg, int listen_fd) {
+  if (cfg->buf_size > cfg->io_size) {
+    return -EINVAL_linux;
+  }
+  srv->cfg = cfg;
+  srv->listen_fd = listen_fd;
+  srv->send_timeout.tv_sec = cfg->send_timeout_ms / 1000;
+  srv->send_timeout.tv_nsec = (long)(cfg->send_timeout_ms % 1000) * 1000000;
+
+  io_uring_params_linux p = {0};
+  p.flags = IORING_SETUP_CQSIZE_linux | IORING_SETUP_SINGLE_ISSUER_linux | IORING_SETUP_DEFER_TASKRUN_linux;
+  p.cq_entries = cfg->ring_entries * 4;
+  long ret = InitParams_uring(&srv->ring, cfg->ring_entries, &p);
+  if (ret == -EINVAL_linux) { // pre-6.1 kernels
+    io_uring_params_linux q = {0};
+    q.flags = IORING_SETUP_CQSIZE_linux;
+    q.cq_entries = cfg->ring_entries * 4;
+    ret = InitParams_uring(&srv->ring, cfg->ring_entries, &q);
+  }
+  if (ret < 0) {
+    return ret;
+  }
+  ret = InitBufRing_uring(&srv->ring, &srv->br, 0, cfg->buf_count, cfg->buf_size);
+  if (ret < 0) {
+    Exit_uring(&srv->ring);
+    return ret;
+  }
+
+  srv->conns_size = cfg->max_conns * sizeof(Conn_uring);
+  srv->io_size = (unsigned long)cfg->max_conns * cfg->io_size * 2;
+  ret = MapAnon_uring(srv->conns_size);
+  if (ret < 0 && ret > -4096) {
+    FreeBufRing_uring(&srv->ring, &srv->br);
+    Exit_uring(&srv->ring);
+    return ret;
+  }
+  srv->conns = (Conn_uring *)ret;
+  ret = MapAnon_uring(srv->io_size);
+  if (ret < 0 && ret > -4096) {
+    munmap_linux(srv->conns, srv->conns_size);
+    FreeBufRing_uring(&srv->ring, &srv->br);
+    Exit_uring(&srv->ring);
+    return ret;
+  }
+  srv->io = (char *)ret;
+  for (unsigned int i = 0; i < cfg->max_conns; ++i) {
+    srv->conns[i].in = srv->io + (unsigned long)i * cfg->io_size * 2;
+    srv->conns[i].out = srv->conns[i].in + cfg->io_size;
+  }
+
+  ArmAccept_server(srv);
+  return 0;
+}
+
+long RunServer_uring(Server_uring *srv, const volatile int *stop) {
+  io_uring_cqe_linux *cqes[64];
+  while (!stop || !*stop) {
+    long ret = SubmitAndWait_uring(&srv->ring, 1);
+    Entered_server(srv);
+    if (ret < 0 && ret != -EINTR_linux && ret != -EBUSY_linux && ret != -EAGAIN_linux) {
+      return ret;
+    }
+    unsigned int n;
+    while ((n = PeekBatchCqe_uring(&srv->ring, cqes, 64))) {
+      for (unsigned int i = 0; i < n; ++i) {
+        Complete_server(srv, cqes[i]);
+      }
+      CqAdvance_uring(&srv->ring, n);
+    }
+    if (srv->accept_idle) {
+      ArmAccept_server(srv);
+    }
+  }
+  return 0;
+}
+
+void FreeServer_uring(Server_uring *srv) {
+  munmap_linux(srv->io, srv->io_size);
+  munmap_linux(srv->conns, srv->conns_size);
+  FreeBufRing_uring(&srv->ring, &srv->br);
+  Exit_uring(&srv->ring);
+}
+
+// Forks one worker per CPU in the affinity mask (at most `max_workers`), each
+// pinned to its CPU with its own SO_REUSEPORT listener. Listeners are bound
+// before returning so clients can connect immediately. Returns the worker count.
+long SpawnWorkers_uring(const ServerConfig_uring *cfg, int *pids, unsigned int max_workers) {
+  unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+  long ret = sched_getaffinity_linux(0, sizeof(mask), mask);
+  if (ret < 0) {
+    return ret;
+  }
+  unsigned int cpus[256];
+  int listeners[256];
+  unsigned int count = 0;
+  for (unsigned int cpu = 0; cpu < 1024 && count < max_workers && count < 256; ++cpu) {
+    if (mask[cpu / (8 * sizeof(unsigned long))] & (1UL << (cpu % (8 * sizeof(unsigned long))))) {
+      ret = ListenTcp_uring(cfg->addr, cfg->port, SOMAXCONN_linux);
+      if (ret < 0) {
+        break;
+      }
+      cpus[count] = cpu;
+      listeners[count++] = (int)ret;
+    }
+  }
+  unsigned int started = 0;
+  for (unsigned int i = 0; ret >= 0 && i < count; ++i) {
+    long pid = fork_linux();
+    if (pid == 0) {
+      for (unsigned int j = 0; j < count; ++j) {
+        if (j != i) close_linux(listeners[j]);
+      }
+      unsigned long one[1024 / (8 * sizeof(unsigned long))] = {0};
+      one[cpus[i] / (8 * sizeof(unsigned long))] = 1UL << (cpus[i] % (8 * sizeof(unsigned long)));
+      sched_setaffinity_linux(0, sizeof(one), one);
+      Server_uring srv;
+      long err = InitServer_uring(&srv, cfg, listeners[i]);
+      if (err >= 0) {
+        err = RunServer_uring(&srv, 0);
+      }
+      exit_linux(err < 0 ? 1 : 0);
+    }
+    if (pid < 0) {
+      ret = pid;
+      break;
+    }
+    pids[started++] = (int)pid;
+  }
+  for (unsigned int i = 0; i < count; ++i) {
+    close_linux(listeners[i]);
+  }
+  return started ? (long)started : ret;
+}
+
+//
+// Zero-copy send tracking
+//
+long InitZc_uring(ZcTracker_uring *zc, unsigned int slots, ZcRelease_uring release, void *user) {
+  long ret = MapAnon_uring(slots * sizeof(ZcSlot_uring));
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  zc->slots = (ZcSlot_uring *)ret;
+  for (unsigned int i = 0; i < slots; ++i) {
+    zc->slots[i].next = i + 1;
+  }
+  zc->count = slots;
+  zc->free_head = 0;
+  zc->inflight = 0;
+  zc->release = release;
+  zc->user = user;
+  return 0;
+}
+
+void FreeZc_uring(ZcTracker_uring *zc) {
+  munmap_linux(zc->slots, zc->count * sizeof(ZcSlot_uring));
+}
+
+static io_uring_sqe_linux *Slot_zc(Ring_uring *ring, ZcTracker_uring *zc, unsigned long long tag) {
+  if (zc->free_head == zc->count) {
+    return 0;
+  }
+  io_uring_sqe_linux *sqe = GetSqe_uring(ring);
+  if (!sqe) {
+    return 0;
+  }
+  unsigned int slot = zc->free_head;
+  zc->free_head = zc->slots[slot].next;
+  zc->slots[slot].tag = tag;
+  zc->slots[slot].res = 0;
+  zc->inflight++;
+  sqe->user_data = ZC_DATA_uring | slot;
+  return sqe;
+}
+
+// Queues a zero-copy send of buf[0, len); `buf_index` >= 0 selects a registered buffer.
+// Returns 0 (nothing queued) when the ring or the tracker is full.
+io_uring_sqe_linux *SendZc_uring(Ring_uring *ring, ZcTracker_uring *zc, int fd, const void *buf, unsigned int len, int buf_index, unsigned long long tag) {
+  io_uring_sqe_linux *sqe = Slot_zc(ring, zc, tag);
+  if (sqe) {
+    unsigned long long data = sqe->user_data;
+    if (buf_index >= 0) {
+      PrepSendZcFixed_uring(sqe, fd, buf, len, MSG_NOSIGNAL_linux, IORING_SEND_ZC_REPORT_USAGE_linux, (unsigned short)buf_index);
+    } else {
+      PrepSendZc_uring(sqe, fd, buf, len, MSG_NOSIGNAL_linux, IORING_SEND_ZC_REPORT_USAGE_linux);
+    }
+    sqe->user_data = data;
+  }
+  return sqe;
+}
+
+// `msg` and its iovecs must stay valid until the release callback runs.
+io_uring_sqe_linux *SendmsgZc_uring(Ring_uring *ring, ZcTracker_uring *zc, int fd, const user_msghdr_linux *msg, unsigned long long tag) {
+  io_uring_sqe_linux *sqe = Slot_zc(ring, zc, tag);
+  if (sqe) {
+    unsigned long long data = sqe->user_data;
+    PrepSendmsgZc_uring(sqe, fd, msg, MSG_NOSIGNAL_linux);
+    sqe->ioprio = IORING_SEND_ZC_REPORT_USAGE_linux;
+    sqe->user_data = data;
+  }
+  return sqe;
+}
+
+// Feeds one CQE tagged by SendZc_uring/SendmsgZc_uring (see IsZcCqe_uring).
+// Returns 1 when it released a buffer through the callback, 0 otherwise.
+int CompleteZc_uring(ZcTracker_uring *zc, const io_uring_cqe_linux *cqe) {
+  unsigned int slot = (unsigned int)(cqe->user_data & ~ZC_DATA_uring);
+  ZcSlot_uring *s = &zc->slots[slot];
+  int copied = 0;
+  if (cqe->flags & IORING_CQE_F_NOTIF_linux) {
+    copied = (cqe->res & IORING_NOTIF_USAGE_ZC_COPIED_linux) != 0;
+  } else {
+    s->res = cqe->res;
+    if (cqe->flags & IORING_CQE_F_MORE_linux) {
+      return 0; // payload still pinned, wait for the notification
+    }
+  }
+  unsigned long long tag = s->tag;
+  int res = s->res;
+  s->next = zc->free_head;
+  zc->free_head = slot;
+  zc->inflight--;
+  if (zc->release) {
+    zc->release(zc->user, tag, res, copied);
+  }
+  return 1;
+}
+
+//
+// Bulk O_DIRECT file I/O
+//
+// Requests are numbered in submission order and request `seq` owns buffer
+// seq % depth, so completions that arrive out of order park their result in
+// `res` until every earlier chunk has been handed to the callback.
+#define PENDING_bulk (-0x7fffffff - 1)
+
+// Opens `path` with O_DIRECT added to `flags`; `chunk` must be a multiple of
+// the file's STATX_DIOALIGN offset and memory alignment.
+long OpenBulk_uring(Bulk_uring *b, const char *path, int flags, int mode, unsigned int depth, unsigned int chunk) {
+  if (!depth || !chunk) {
+    return -EINVAL_linux;
+  }
+  long fd = openat_linux(AT_FDCWD_linux, path, flags | O_DIRECT_linux | O_CLOEXEC_linux, mode);
+  if (fd < 0) {
+    return fd;
+  }
+  b->fd = (int)fd;
+  b->depth = depth;
+  b->chunk = chunk;
+
+  statx_t_linux st;
+  long ret = statx_linux(b->fd, "", AT_EMPTY_PATH_linux, STATX_SIZE_linux | STATX_DIOALIGN_linux, &st);
+  if (ret >= 0 && (!(st.stx_mask & STATX_DIOALIGN_linux) || !st.stx_dio_offset_align)) {
+    ret = -EINVAL_linux; // the filesystem does not do O_DIRECT
+  }
+  if (ret < 0) {
+    close_linux(b->fd);
+    return ret;
+  }
+  b->mem_align = st.stx_dio_mem_align;
+  b->offset_align = st.stx_dio_offset_align;
+  b->size = st.stx_size;
+  // mmap hands out page-aligned memory, so chunk-sized slots stay aligned too.
+  if (chunk & (b->offset_align - 1) || chunk & (b->mem_align - 1) || b->mem_align > 4096) {
+    close_linux(b->fd);
+    return -EINVAL_linux;
+  }
+
+  b->bufs_size = (unsigned long)depth * chunk + depth * sizeof(int);
+  ret = mmap_linux(0, b->bufs_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_POPULATE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    close_linux(b->fd);
+    return ret;
+  }
+  b->bufs = (char *)ret;
+  b->res = (int *)(b->bufs + (unsigned long)depth * chunk);
+
+  ret = Init_uring(&b->ring, depth, 0);
+  if (ret < 0) {
+    munmap_linux(b->bufs, b->bufs_size);
+    close_linux(b->fd);
+    return ret;
+  }
+  ret = RegisterFiles_uring(&b->ring, &b->fd, 1);
+  if (ret >= 0) {
+    ret = RegisterBuffersSparse_uring(&b->ring, depth);
+  }
+  for (unsigned int i = 0; ret >= 0 && i < depth; ++i) {
+    iovec_linux iov = {b->bufs + (unsigned long)i * chunk, chunk};
+    ret = UpdateBuffers_uring(&b->ring, i, &iov, 1);
+  }
+  if (ret < 0) {
+    CloseBulk_uring(b);
+    return ret;
+  }
+  return 0;
+}
+
+void CloseBulk_uring(Bulk_uring *b) {
+  Exit_uring(&b->ring);
+  munmap_linux(b->bufs, b->bufs_size);
+  close_linux(b->fd);
+}
+
+// Keeps up to `depth` chunks of [off, end) in flight and retires them in
+// order. Stops queueing on the first error, short transfer or callback
+// refusal, but always waits out what is already in flight before returning.
+static long long Run_bulk(Bulk_uring *b, unsigned long long off, unsigned long long end, OnChunk_uring fn, void *user, int write) {
+  unsigned int head = 0, tail = 0;
+  unsigned long long next = off, done = 0;
+  long err = 0;
+  int stop = 0;
+  while (head != tail || (next < end && !stop)) {
+    while (!stop && next < end && tail - head < b->depth) {
+      unsigned int slot = tail % b->depth;
+      char *buf = b->bufs + (unsigned long)slot * b->chunk;
+      unsigned int len = end - next < b->chunk ? (unsigned int)(end - next) : b->chunk;
+      io_uring_sqe_linux *sqe = GetSqe_uring(&b->ring);
+      if (!sqe) {
+        break;
+      }
+      if (write && fn(user, next, buf, len) < 0) {
+        b->ring.sq.sqe_tail--; // not published yet, hand the SQE back
+        err = -ECANCELED_linux;
+        stop = 1;
+        break;
+      }
+      // The last read may reach past the end of the file, O_DIRECT wants whole blocks.
+      unsigned int io_len = write ? len : (len + b->offset_align - 1) & ~(b->offset_align - 1);
+      if (write) {
+        PrepWriteFixed_uring(sqe, 0, buf, io_len, next, (unsigned short)slot);
+      } else {
+        PrepReadFixed_uring(sqe, 0, buf, io_len, next, (unsigned short)slot);
+      }
+      SetFixedFile_uring(sqe);
+      sqe->user_data = tail;
+      b->res[slot] = PENDING_bulk;
+      ++tail;
+      next += len;
+    }
+
+    int ready = head != tail && b->res[head % b->depth] != PENDING_bulk;
+    long ret = SubmitAndWait_uring(&b->ring, ready || head == tail ? 0 : 1);
+    if (ret < 0 && ret != -EINTR_linux && ret != -EAGAIN_linux && ret != -EBUSY_linux) {
+      return ret; // the ring is unusable, CloseBulk_uring still waits for the kernel
+    }
+    io_uring_cqe_linux *cqes[64];
+    unsigned int n;
+    while ((n = PeekBatchCqe_uring(&b->ring, cqes, 64))) {
+      for (unsigned int i = 0; i < n; ++i) {
+        b->res[(unsigned int)cqes[i]->user_data % b->depth] = cqes[i]->res;
+      }
+      CqAdvance_uring(&b->ring, n);
+    }
+
+    while (head != tail && b->res[head % b->depth] != PENDING_bulk) {
+      unsigned int slot = head % b->depth;
+      unsigned long long at = off + (unsigned long long)head * b->chunk;
+      unsigned int want = end - at < b->chunk ? (unsigned int)(end - at) : b->chunk;
+      int res = b->res[slot];
+      ++head;
+      if (stop) {
+        continue; // an earlier chunk failed, later ones are not delivered
+      }
+      if (res < 0) {
+        err = res;
+        stop = 1;
+        continue;
+      }
+      unsigned int got = (unsigned int)res < want ? (unsigned int)res : want;
+      if (write) {
+        if (got < want) {
+          err = -EIO_linux;
+          stop = 1;
+        }
+      } else if (got && fn(user, at, b->bufs + (unsigned long)slot * b->chunk, got) < 0) {
+        err = -ECANCELED_linux;
+        stop = 1;
+      } else if (got < want) {
+        stop = 1; // the file shrank under us, deliver what is there
+      }
+      done += got;
+    }
+  }
+  if (write && off + done > b->size) {
+    b->size = off + done;
+  }
+  return err ? err : (long long)done;
+}
+
+// Streams [off, off + len) of the file, clipped to its size, to `consume` in
+// order. `off` must be a multiple of offset_align. Returns the bytes delivered
+// (a long long, scans pass 4 GiB on 32-bit too).
+long long ReadBulk_uring(Bulk_uring *b, unsigned long long off, unsigned long long len, OnChunk_uring consume, void *user) {
+  if (off & (b->offset_align - 1)) {
+    return -EINVAL_linux;
+  }
+  unsigned long long end = off + len < b->size ? off + len : b->size;
+  return off < end ? Run_bulk(b, off, end, consume, user, 0) : 0;
+}
+
+// Writes [off, off + len) chunk by chunk as `fill` produces them; `off` and
+// `len` must be multiples of offset_align. Returns the bytes written.
+long long WriteBulk_uring(Bulk_uring *b, unsigned long long off, unsigned long long len, OnChunk_uring fill, void *user) {
+  if ((off | len) & (b->offset_align - 1)) {
+    return -EINVAL_linux;
+  }
+  return len ? Run_bulk(b, off, off + len, fill, user, 1) : 0;
+}
+
+//
+// Small-file batch loader
+//
+// A chain is OPENAT -(link)-> STATX -(hardlink)-> READ -(hardlink)-> CLOSE.
+// OPENAT and STATX only post a CQE when they fail. A failed open ends the
+// chain: the requests behind it are cancelled without CQEs, since
+// IOSQE_CQE_SKIP_SUCCESS on a failed request drops the CQEs of its links.
+// Past the open, the hard links make sure CLOSE always runs, even after a
+// READ that came back short, which io_uring counts as a link failure. The
+// slot is recycled on the CLOSE completion, the last of the chain.
+//
+// IORING_FILE_INDEX_ALLOC_linux would hand the slot number back in the
+// OPENAT CQE, too late for the READ and CLOSE linked behind it, so the
+// loader hands out slots from its own free stack instead.
+enum {
+  LOAD_OPEN_uring,
+  LOAD_STATX_uring,
+  LOAD_READ_uring,
+  LOAD_CLOSE_uring,
+};
+
+#define PENDING_loader (-0x7fffffff - 1)
+
+static unsigned long long Data_loader(unsigned int step, unsigned int slot, unsigned int index) {
+  return (unsigned long long)step << 56 | (unsigned long long)slot << 32 | index;
+}
+
+long InitLoader_uring(Loader_uring *l, unsigned int slots) {
+  if (!slots || slots > 65536) {
+    return -EINVAL_linux;
+  }
+  l->slots = slots;
+  long ret = MapAnon_uring(slots * sizeof(unsigned int));
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  l->free_slots = (unsigned int *)ret;
+  ret = Init_uring(&l->ring, slots * 4, 0);
+  if (ret < 0) {
+    munmap_linux(l->free_slots, slots * sizeof(unsigned int));
+    return ret;
+  }
+  ret = RegisterFilesSparse_uring(&l->ring, slots);
+  if (ret < 0) {
+    FreeLoader_uring(l);
+    return ret;
+  }
+  for (unsigned int i = 0; i < slots; ++i) {
+    l->free_slots[i] = slots - 1 - i;
+  }
+  l->free_count = slots;
+  l->enters = 0;
+  return 0;
+}
+
+void FreeLoader_uring(Loader_uring *l) {
+  Exit_uring(&l->ring);
+  munmap_linux(l->free_slots, l->slots * sizeof(unsigned int));
+}
+
+static void Chain_loader(Loader_uring *l, FileLoad_uring *f, unsigned int index) {
+  unsigned int slot = l->free_slots[--l->free_count];
+  f->res = PENDING_loader;
+  io_uring_sqe_linux *sqe = GetSqe_uring(&l->ring);
+  PrepOpenatDirect_uring(sqe, AT_FDCWD_linux, f->path, O_RDONLY_linux, 0, slot);
+  sqe->flags |= IOSQE_IO_LINK_linux | IOSQE_CQE_SKIP_SUCCESS_linux;
+  sqe->user_data = Data_loader(LOAD_OPEN_uring, slot, index);
+  sqe = GetSqe_uring(&l->ring);
+  PrepStatx_uring(sqe, AT_FDCWD_linux, f->path, 0, STATX_BASIC_STATS_linux, &f->st);
+  sqe->flags |= IOSQE_IO_HARDLINK_linux | IOSQE_CQE_SKIP_SUCCESS_linux;
+  sqe->user_data = Data_loader(LOAD_STATX_uring, slot, index);
+  sqe = GetSqe_uring(&l->ring);
+  PrepRead_uring(sqe, (int)slot, f->buf, f->cap, 0);
+  SetFixedFile_uring(sqe);
+  sqe->flags |= IOSQE_IO_HARDLINK_linux;
+  sqe->user_data = Data_loader(LOAD_READ_uring, slot, index);
+  sqe = GetSqe_uring(&l->ring);
+  PrepCloseDirect_uring(sqe, slot);
+  sqe->user_data = Data_loader(LOAD_CLOSE_uring, slot, index);
+}
+
+// Loads every file of the batch, keeping up to `slots` chains in flight, and
+// returns how many loaded without error; each file's outcome is in its res.
+long LoadFiles_uring(Loader_uring *l, FileLoad_uring *files, unsigned int count) {
+  unsigned int next = 0, done = 0, ok = 0;
+  while (done < count) {
+    while (next < count && l->free_count && SqSpace_uring(&l->ring) >= 4) {
+      Chain_loader(l, &files[next], next);
+      ++next;
+    }
+    // Every chain in flight posts at least one CQE, so waiting for as many
+    // CQEs as chains lets about half of them retire before the next refill.
+    long ret = SubmitAndWait_uring(&l->ring, next - done);
+    ++l->enters;
+    if (ret < 0 && ret != -EINTR_linux && ret != -EAGAIN_linux && ret != -EBUSY_linux) {
+      return ret;
+    }
+    io_uring_cqe_linux *cqes[64];
+    unsigned int n;
+    while ((n = PeekBatchCqe_uring(&l->ring, cqes, 64))) {
+      for (unsigned int i = 0; i < n; ++i) {
+        unsigned long long data = cqes[i]->user_data;
+        unsigned int step = (unsigned int)(data >> 56);
+        FileLoad_uring *f = &files[(unsigned int)data];
+        int res = cqes[i]->res;
+        // The first real error wins over the -ECANCELED it caused down the chain.
+        if (res < 0 && (f->res == PENDING_loader || f->res == -ECANCELED_linux)) {
+          f->res = res;
+        } else if (step == LOAD_READ_uring && f->res == PENDING_loader) {
+          f->res = res;
+        }
+        if (step == LOAD_CLOSE_uring || step == LOAD_OPEN_uring) {
+          l->free_slots[l->free_count++] = (unsigned int)(data >> 32) & 0xffffff;
+          ok += f->res >= 0;
+          ++done;
+        }
+      }
+      CqAdvance_uring(&l->ring, n);
+    }
+  }
+  return ok;
+}
+
+#endif // C_URING_IMPLEMENTATION
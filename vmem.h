@@ -0,0 +1,367 @@
+#ifndef C_VMEM_HEADER
+#define C_VMEM_HEADER
+
+// === vmem.h: reserve/commit regions, mremap-grown vectors & hash maps ========
+//
+// Contents:
+//   * regions                      (jump: Reserve_vmem)
+//   * vectors                      (jump: Vector_vmem)
+//   * hash maps                    (jump: Map_vmem)
+//
+// Usage:
+//   vmem.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/vmem.h" // use as header file
+//
+//   #define C_VMEM_IMPLEMENTATION
+//   #include "c/vmem.h" // use as implementation file
+//
+//   A region reserves address space with PROT_NONE and commits it front to
+//   back with mprotect_linux as it grows, so pages are only faulted in when
+//   touched. Once the reservation is exhausted it is grown with mremap_linux
+//   (MREMAP_MAYMOVE): the kernel moves page table entries, never the bytes,
+//   so a multi-GB vector doubles in microseconds instead of a full copy.
+//   Pointers into a region are invalidated whenever it grows.
+//
+//   Map_vmem keeps its entries dense in a vector (the large tier, grown in
+//   place) and only rebuilds its small open-addressing index of 4-byte slots.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers; functions returning pointers return 0 on failure.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "vmem.h depends on linux.h, include it first"
+#endif
+
+// Commit granularity, a multiple of every page size Linux uses.
+#define GRANULE_vmem (64UL << 10)
+
+typedef struct {
+  char *base;
+  unsigned long committed; // [0, committed) is PROT_READ | PROT_WRITE
+  unsigned long reserved;  // [committed, reserved) is PROT_NONE
+} Region_vmem;
+
+typedef struct {
+  Region_vmem mem;
+  unsigned long len; // elements
+  unsigned long elem_size;
+} Vector_vmem;
+
+typedef struct {
+  unsigned long long key;
+  unsigned long long value;
+} Entry_vmem;
+
+// u64 -> u64 map: entries stay dense in insertion order (until removals swap
+// the last one into the hole); index slots hold entry number + 1, 0 is empty.
+typedef struct {
+  Vector_vmem entries;
+  Region_vmem index;
+  unsigned int mask;
+} Map_vmem;
+
+//
+// Regions
+//
+long Reserve_vmem(Region_vmem *r, unsigned long reserve);
+long Commit_vmem(Region_vmem *r, unsigned long size);
+long Trim_vmem(Region_vmem *r, unsigned long size);
+void Release_vmem(Region_vmem *r);
+//
+// Vectors
+//
+long InitVector_vmem(Vector_vmem *v, unsigned long elem_size, unsigned long reserve);
+void *GrowVector_vmem(Vector_vmem *v, unsigned long n);
+void FreeVector_vmem(Vector_vmem *v);
+//
+// Hash maps
+//
+long InitMap_vmem(Map_vmem *m, unsigned long reserve_entries);
+unsigned long long *PutMap_vmem(Map_vmem *m, unsigned long long key);
+unsigned long long *GetMap_vmem(const Map_vmem *m, unsigned long long key);
+int RemoveMap_vmem(Map_vmem *m, unsigned long long key);
+void FreeMap_vmem(Map_vmem *m);
+
+static inline void *AtVector_vmem(const Vector_vmem *v, unsigned long i) {
+  return v->mem.base + i * v->elem_size;
+}
+
+// Appends `n` uninitialized elements and returns the first one.
+static inline void *PushVector_vmem(Vector_vmem *v, unsigned long n) {
+  unsigned long end = (v->len + n) * v->elem_size;
+  if (end > v->mem.committed) {
+    return GrowVector_vmem(v, n);
+  }
+  void *p = v->mem.base + v->len * v->elem_size;
+  v->len += n;
+  return p;
+}
+
+static inline unsigned long CountMap_vmem(const Map_vmem *m) {
+  return m->entries.len;
+}
+
+static inline Entry_vmem *EntriesMap_vmem(const Map_vmem *m) {
+  return (Entry_vmem *)m->entries.mem.base;
+}
+
+#endif // C_VMEM_HEADER
+#ifdef C_VMEM_IMPLEMENTATION
+
+//
+// Regions
+//
+
+// Reserves `reserve` bytes (rounded up to GRANULE_vmem) of address space
+// without committing any of it.
+long Reserve_vmem(Region_vmem *r, unsigned long reserve) {
+  reserve = (reserve + GRANULE_vmem - 1) & ~(GRANULE_vmem - 1);
+  if (!reserve) {
+    reserve = GRANULE_vmem;
+  }
+  long ret = mmap_linux(0, reserve, PROT_NONE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  r->base = (char *)ret;
+  r->committed = 0;
+  r->reserved = reserve;
+  return 0;
+}
+
+// Makes [0, size) accessible, doubling the reservation with mremap_linux when
+// `size` exceeds it. The base may move.
+long Commit_vmem(Region_vmem *r, unsigned long size) {
+  size = (size + GRANULE_vmem - 1) & ~(GRANULE_vmem - 1);
+  if (size <= r->committed) {
+    return 0;
+  }
+  if (size > r->reserved) {
+    unsigned long reserve = r->reserved;
+    while (reserve < size) {
+      if (reserve * 2 < reserve) {
+        return -ENOMEM_linux;
+      }
+      reserve *= 2;
+    }
+    // mremap_linux resizes a single mapping, so the PROT_NONE tail must join
+    // the committed head first; the extension inherits its protection.
+    long ret = mprotect_linux(r->base, r->reserved, PROT_READ_linux | PROT_WRITE_linux);
+    if (ret < 0) {
+      return ret;
+    }
+    ret = mremap_linux(r->base, r->reserved, reserve, MREMAP_MAYMOVE_linux, 0);
+    if (ret < 0 && ret > -4096) {
+      mprotect_linux(r->base + r->committed, r->reserved - r->committed, PROT_NONE_linux);
+      return ret;
+    }
+    r->base = (char *)ret;
+    r->committed = reserve;
+    r->reserved = reserve;
+    return Trim_vmem(r, size); // the unused extension goes back to PROT_NONE
+  }
+  long ret = mprotect_linux(r->base + r->committed, size - r->committed, PROT_READ_linux | PROT_WRITE_linux);
+  if (ret < 0) {
+    return ret;
+  }
+  r->committed = size;
+  return 0;
+}
+
+// Decommits everything past `size` (rounded up to GRANULE_vmem): the pages
+// are freed and read back as zeros once committed again.
+long Trim_vmem(Region_vmem *r, unsigned long size) {
+  size = (size + GRANULE_vmem - 1) & ~(GRANULE_vmem - 1);
+  if (size >= r->committed) {
+    return 0;
+  }
+  long ret = madvise_linux(r->base + size, r->committed - size, MADV_DONTNEED_linux);
+  if (ret >= 0) {
+    ret = mprotect_linux(r->base + size, r->committed - size, PROT_NONE_linux);
+  }
+  if (ret >= 0) {
+    r->committed = size;
+  }
+  return ret;
+}
+
+void Release_vmem(Region_vmem *r) {
+  munmap_linux(r->base, r->reserved);
+  r->base = 0;
+  r->committed = 0;
+  r->reserved = 0;
+}
+
+//
+// Vectors
+//
+
+// `reserve` is the address space reserved up front, in bytes; growing past it
+// costs one mremap_linux per doubling.
+long InitVector_vmem(Vector_vmem *v, unsigned long elem_size, unsigned long reserve) {
+  v->len = 0;
+  v->elem_size = elem_size;
+  return Reserve_vmem(&v->mem, reserve);
+}
+
+// Slow path of PushVector_vmem: commits at least twice the current size so
+// pushes cost O(1) mprotect_linux calls amortized.
+void *GrowVector_vmem(Vector_vmem *v, unsigned long n) {
+  unsigned long end = (v->len + n) * v->elem_size;
+  unsigned long want = v->mem.committed * 2 > end ? v->mem.committed * 2 : end;
+  if (Commit_vmem(&v->mem, want) < 0 && Commit_vmem(&v->mem, end) < 0) {
+    return 0;
+  }
+  void *p = v->mem.base + v->len * v->elem_size;
+  v->len += n;
+  return p;
+}
+
+void FreeVector_vmem(Vector_vmem *v) {
+  Release_vmem(&v->mem);
+  v->len = 0;
+}
+
+//
+// Hash maps
+//
+static unsigned long long Hash_vmem(unsigned long long key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+static unsigned int *Slots_vmem(const Map_vmem *m) {
+  return (unsigned int *)m->index.base;
+}
+
+// Returns the index slot holding `key`, or the empty slot ending its probe.
+static unsigned int Find_vmem(const Map_vmem *m, unsigned long long key) {
+  const unsigned int *slots = Slots_vmem(m);
+  const Entry_vmem *entries = EntriesMap_vmem(m);
+  unsigned int i = (unsigned int)Hash_vmem(key) & m->mask;
+  while (slots[i] && entries[slots[i] - 1].key != key) {
+    i = (i + 1) & m->mask;
+  }
+  return i;
+}
+
+// Rebuilds the index with `count` slots; entries don't move.
+static long Reindex_vmem(Map_vmem *m, unsigned long count) {
+  long ret = Trim_vmem(&m->index, 0); // decommitted pages come back zeroed
+  if (ret >= 0) {
+    ret = Commit_vmem(&m->index, count * sizeof(unsigned int));
+  }
+  if (ret < 0) {
+    return ret;
+  }
+  m->mask = (unsigned int)(count - 1);
+  unsigned int *slots = Slots_vmem(m);
+  const Entry_vmem *entries = EntriesMap_vmem(m);
+  for (unsigned long e = 0; e < m->entries.len; ++e) {
+    unsigned int i = (unsigned int)Hash_vmem(entries[e].key) & m->mask;
+    while (slots[i]) {
+      i = (i + 1) & m->mask;
+    }
+    slots[i] = (unsigned int)(e + 1);
+  }
+  return 0;
+}
+
+// Reserves address space for `reserve_entries` entries and their index up front.
+long InitMap_vmem(Map_vmem *m, unsigned long reserve_entries) {
+  unsigned long slots = 1024;
+  while (slots < reserve_entries * 2) {
+    slots *= 2;
+  }
+  long ret = InitVector_vmem(&m->entries, sizeof(Entry_vmem), reserve_entries * sizeof(Entry_vmem));
+  if (ret < 0) {
+    return ret;
+  }
+  ret = Reserve_vmem(&m->index, slots * sizeof(unsigned int));
+  if (ret >= 0) {
+    ret = Reindex_vmem(m, 1024);
+  }
+  if (ret < 0) {
+    FreeVector_vmem(&m->entries);
+  }
+  return ret;
+}
+
+// Returns the value for `key`, inserting it with value 0 if missing; 0 when out
+// of memory. The pointer is valid until the next insertion or removal.
+unsigned long long *PutMap_vmem(Map_vmem *m, unsigned long long key) {
+  unsigned int i = Find_vmem(m, key);
+  if (Slots_vmem(m)[i]) {
+    return &EntriesMap_vmem(m)[Slots_vmem(m)[i] - 1].value;
+  }
+  if (m->entries.len >= 0xffffffffUL) {
+    return 0;
+  }
+  if ((m->entries.len + 1) * 2 > (unsigned long)m->mask + 1) { // keep the load factor <= 1/2
+    if (Reindex_vmem(m, ((unsigned long)m->mask + 1) * 2) < 0) {
+      return 0;
+    }
+    i = Find_vmem(m, key);
+  }
+  Entry_vmem *e = (Entry_vmem *)PushVector_vmem(&m->entries, 1);
+  if (!e) {
+    return 0;
+  }
+  e->key = key;
+  e->value = 0;
+  Slots_vmem(m)[i] = (unsigned int)m->entries.len;
+  return &e->value;
+}
+
+unsigned long long *GetMap_vmem(const Map_vmem *m, unsigned long long key) {
+  unsigned int i = Find_vmem(m, key);
+  unsigned int slot = Slots_vmem(m)[i];
+  return slot ? &EntriesMap_vmem(m)[slot - 1].value : 0;
+}
+
+// Returns 1 when `key` was removed, 0 when it was missing.
+int RemoveMap_vmem(Map_vmem *m, unsigned long long key) {
+  unsigned int *slots = Slots_vmem(m);
+  Entry_vmem *entries = EntriesMap_vmem(m);
+  unsigned int i = Find_vmem(m, key);
+  unsigned int slot = slots[i];
+  if (!slot) {
+    return 0;
+  }
+  // Backward-shift deletion: pull later cluster members into the hole when
+  // their home slot doesn't lie cyclically in (hole, j].
+  for (unsigned int j = (i + 1) & m->mask; slots[j]; j = (j + 1) & m->mask) {
+    unsigned int home = (unsigned int)Hash_vmem(entries[slots[j] - 1].key) & m->mask;
+    if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+      slots[i] = slots[j];
+      i = j;
+    }
+  }
+  slots[i] = 0;
+  // Keep entries dense: the last one takes the removed one's place.
+  unsigned int last = (unsigned int)m->entries.len;
+  if (slot != last) {
+    slots[Find_vmem(m, entries[last - 1].key)] = slot;
+    entries[slot - 1] = entries[last - 1];
+  }
+  m->entries.len--;
+  return 1;
+}
+
+void FreeMap_vmem(Map_vmem *m) {
+  FreeVector_vmem(&m->entries);
+  Release_vmem(&m->index);
+}
+
+#endif // C_VMEM_IMPLEMENTATION
@@ -0,0 +1,327 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o vmem_demo vmem_demo.c -e main && ./vmem_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_VMEM_IMPLEMENTATION
+#include "vmem.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+unsigned long long Xorshift(unsigned long long *state) {
+  unsigned long long x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return *state = x;
+}
+
+//
+// Growing past the reservation moves the mapping, contents intact
+//
+void Vector_demo(void) {
+  Vector_vmem v;
+  Assert(InitVector_vmem(&v, sizeof(unsigned int), 1) == 0);
+  Assert(v.mem.reserved == GRANULE_vmem && v.mem.committed == 0);
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    unsigned int *p = (unsigned int *)PushVector_vmem(&v, 1);
+    Assert(p != NULL);
+    *p = i;
+  }
+  Assert(v.len == 1000000 && v.mem.reserved >= v.len * sizeof(unsigned int));
+  for (unsigned int i = 0; i < 1000000; ++i) {
+    Assert(*(unsigned int *)AtVector_vmem(&v, i) == i);
+  }
+  // Trimmed pages come back zeroed.
+  Assert(Trim_vmem(&v.mem, GRANULE_vmem) == 0 && v.mem.committed == GRANULE_vmem);
+  Assert(Commit_vmem(&v.mem, 2 * GRANULE_vmem) == 0);
+  Assert(*(unsigned int *)AtVector_vmem(&v, GRANULE_vmem / sizeof(unsigned int)) == 0);
+  Assert(*(unsigned int *)AtVector_vmem(&v, 5) == 5);
+  FreeVector_vmem(&v);
+  Print(STDOUT_FILENO_linux, "vector: mremap growth, trim: ok\n");
+}
+
+//
+// Put/get/remove against a shadow of which keys should be present
+//
+#define MAP_KEYS 200000
+
+void Map_demo(void) {
+  static unsigned long long keys[MAP_KEYS];
+  Map_vmem m;
+  Assert(InitMap_vmem(&m, 0) == 0);
+  unsigned long long seed = 88172645463325252ULL;
+  for (unsigned long i = 0; i < MAP_KEYS; ++i) {
+    keys[i] = Xorshift(&seed) & 0xffffff; // small key space: some repeats
+    *PutMap_vmem(&m, keys[i]) += 1;
+  }
+  unsigned long long total = 0;
+  for (unsigned long i = 0; i < CountMap_vmem(&m); ++i) {
+    total += EntriesMap_vmem(&m)[i].value;
+  }
+  Assert(total == MAP_KEYS);
+  // Remove every key with an odd index (possibly twice), then check the rest.
+  for (unsigned long i = 1; i < MAP_KEYS; i += 2) {
+    RemoveMap_vmem(&m, keys[i]);
+  }
+  for (unsigned long i = 1; i < MAP_KEYS; i += 2) {
+    Assert(GetMap_vmem(&m, keys[i]) == NULL);
+  }
+  unsigned long present = 0;
+  for (unsigned long i = 0; i < MAP_KEYS; i += 2) {
+    present += GetMap_vmem(&m, keys[i]) != NULL;
+  }
+  for (unsigned long i = 0; i < CountMap_vmem(&m); ++i) {
+    unsigned long long *value = GetMap_vmem(&m, EntriesMap_vmem(&m)[i].key);
+    Assert(value == &EntriesMap_vmem(&m)[i].value); // index and entries agree
+  }
+  Assert(present > 0);
+  FreeMap_vmem(&m);
+  Print(STDOUT_FILENO_linux, "hash map: put, get, remove: ok\n");
+}
+
+//
+// Growth-heavy benchmarks against the realloc-and-copy strategy
+//
+
+// What realloc does for large blocks when it can't extend in place: map a
+// bigger block, copy everything, unmap the old one.
+typedef struct {
+  char *base;
+  unsigned long len;
+  unsigned long cap; // bytes
+} CopyVector;
+
+void *CopyVectorGrow(CopyVector *v, unsigned long bytes) {
+  if (v->len + bytes > v->cap) {
+    unsigned long cap = v->cap ? v->cap * 2 : GRANULE_vmem;
+    long ret = mmap_linux(0, cap, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+    Assert(ret > 0 || ret < -4095);
+    unsigned long long *dst = (unsigned long long *)ret;
+    const unsigned long long *src = (const unsigned long long *)v->base;
+    for (unsigned long i = 0; i < v->len / sizeof(unsigned long long); ++i) {
+      dst[i] = src[i];
+    }
+    if (v->base) {
+      munmap_linux(v->base, v->cap);
+    }
+    v->base = (char *)ret;
+    v->cap = cap;
+  }
+  void *p = v->base + v->len;
+  v->len += bytes;
+  return p;
+}
+
+// Sized to fit the old and new copies of the baseline in a few GB of RAM.
+#define BENCH_BYTES (sizeof(long) == 8 ? 2UL << 30 : 256UL << 20)
+#define BENCH_ELEMS (BENCH_BYTES / sizeof(unsigned long long))
+
+void ReportPush(const char *name, unsigned long long elapsed, unsigned long long worst) {
+  Print(STDOUT_FILENO_linux, name);
+  PrintU64(STDOUT_FILENO_linux, elapsed / 1000000);
+  Print(STDOUT_FILENO_linux, " ms, ");
+  PrintU64(STDOUT_FILENO_linux, BENCH_ELEMS * 1000 / elapsed);
+  Print(STDOUT_FILENO_linux, " M pushes/s, worst push ");
+  PrintU64(STDOUT_FILENO_linux, worst / 1000);
+  Print(STDOUT_FILENO_linux, " us\n");
+}
+
+// Timestamps are only taken on pushes that cross a power of two so the fast
+// path stays unmeasured; growth only happens there.
+#define Boundary(i) (((i) & ((i) - 1)) == 0)
+
+void VectorBench(int reserveAll) {
+  Vector_vmem v;
+  Assert(InitVector_vmem(&v, sizeof(unsigned long long), reserveAll ? BENCH_BYTES : 0) == 0);
+  unsigned long long worst = 0;
+  unsigned long long start = Now_ns();
+  for (unsigned long i = 0; i < BENCH_ELEMS; ++i) {
+    unsigned long long t = Boundary(i) ? Now_ns() : 0;
+    *(unsigned long long *)PushVector_vmem(&v, 1) = i;
+    if (t && Now_ns() - t > worst) {
+      worst = Now_ns() - t;
+    }
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(*(unsigned long long *)AtVector_vmem(&v, BENCH_ELEMS - 1) == BENCH_ELEMS - 1);
+  ReportPush(reserveAll ? "vector, reserved up front: " : "vector, mremap growth:     ", elapsed, worst);
+  FreeVector_vmem(&v);
+}
+
+void CopyVectorBench(void) {
+  CopyVector v = {0};
+  unsigned long long worst = 0;
+  unsigned long long start = Now_ns();
+  for (unsigned long i = 0; i < BENCH_ELEMS; ++i) {
+    unsigned long long t = Boundary(i) ? Now_ns() : 0;
+    *(unsigned long long *)CopyVectorGrow(&v, sizeof(unsigned long long)) = i;
+    if (t && Now_ns() - t > worst) {
+      worst = Now_ns() - t;
+    }
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(((unsigned long long *)v.base)[BENCH_ELEMS - 1] == BENCH_ELEMS - 1);
+  ReportPush("vector, realloc-and-copy:  ", elapsed, worst);
+  munmap_linux(v.base, v.cap);
+}
+
+// The classic flat table: entries inline in the slots (key 0 is empty),
+// rehashed into a freshly mapped table twice the size on growth.
+typedef struct {
+  Entry_vmem *slots;
+  unsigned long mask;
+  unsigned long count;
+} CopyMap;
+
+unsigned long long Mix(unsigned long long key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+Entry_vmem *CopyMapAlloc(unsigned long slots) {
+  long ret = mmap_linux(0, slots * sizeof(Entry_vmem), PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  Assert(ret > 0 || ret < -4095);
+  return (Entry_vmem *)ret;
+}
+
+unsigned long long *CopyMapPut(CopyMap *m, unsigned long long key) {
+  if ((m->count + 1) * 2 > m->mask + 1) {
+    unsigned long mask = m->mask * 2 + 1;
+    Entry_vmem *slots = CopyMapAlloc(mask + 1);
+    for (unsigned long i = 0; i <= m->mask; ++i) {
+      if (m->slots[i].key) {
+        unsigned long j = Mix(m->slots[i].key) & mask;
+        while (slots[j].key) {
+          j = (j + 1) & mask;
+        }
+        slots[j] = m->slots[i];
+      }
+    }
+    munmap_linux(m->slots, (m->mask + 1) * sizeof(Entry_vmem));
+    m->slots = slots;
+    m->mask = mask;
+  }
+  unsigned long i = Mix(key) & m->mask;
+  while (m->slots[i].key && m->slots[i].key != key) {
+    i = (i + 1) & m->mask;
+  }
+  if (!m->slots[i].key) {
+    m->slots[i].key = key;
+    m->count++;
+  }
+  return &m->slots[i].value;
+}
+
+#define BENCH_KEYS (sizeof(long) == 8 ? 32UL << 20 : 4UL << 20)
+
+void ReportPut(const char *name, unsigned long long elapsed, unsigned long long worst) {
+  Print(STDOUT_FILENO_linux, name);
+  PrintU64(STDOUT_FILENO_linux, elapsed / 1000000);
+  Print(STDOUT_FILENO_linux, " ms, ");
+  PrintU64(STDOUT_FILENO_linux, BENCH_KEYS * 1000 / elapsed);
+  Print(STDOUT_FILENO_linux, " M inserts/s, worst insert ");
+  PrintU64(STDOUT_FILENO_linux, worst / 1000);
+  Print(STDOUT_FILENO_linux, " us\n");
+}
+
+void MapBench(void) {
+  Map_vmem m;
+  Assert(InitMap_vmem(&m, 0) == 0);
+  unsigned long long seed = 88172645463325252ULL; // never yields 0
+  unsigned long long worst = 0;
+  unsigned long long start = Now_ns();
+  for (unsigned long i = 0; i < BENCH_KEYS; ++i) {
+    unsigned long long t = Boundary(i) ? Now_ns() : 0;
+    *PutMap_vmem(&m, Xorshift(&seed)) = i;
+    if (t && Now_ns() - t > worst) {
+      worst = Now_ns() - t;
+    }
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(CountMap_vmem(&m) == BENCH_KEYS);
+  ReportPut("hash map, vmem (index rebuild only): ", elapsed, worst);
+  FreeMap_vmem(&m);
+}
+
+void CopyMapBench(void) {
+  CopyMap m = {CopyMapAlloc(1024), 1023, 0};
+  unsigned long long seed = 88172645463325252ULL;
+  unsigned long long worst = 0;
+  unsigned long long start = Now_ns();
+  for (unsigned long i = 0; i < BENCH_KEYS; ++i) {
+    unsigned long long t = Boundary(i) ? Now_ns() : 0;
+    *CopyMapPut(&m, Xorshift(&seed)) = i;
+    if (t && Now_ns() - t > worst) {
+      worst = Now_ns() - t;
+    }
+  }
+  unsigned long long elapsed = Now_ns() - start;
+  Assert(m.count == BENCH_KEYS);
+  ReportPut("hash map, realloc-and-copy rehash:   ", elapsed, worst);
+  munmap_linux(m.slots, (m.mask + 1) * sizeof(Entry_vmem));
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Vector_demo();
+  Map_demo();
+  VectorBench(false);
+  VectorBench(true);
+  CopyVectorBench();
+  MapBench();
+  CopyMapBench();
+  exit_linux(0);
+  return 0;
+}
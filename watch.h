@@ -0,0 +1,1195 @@
+#ifndef C_WATCH_HEADER
+#define C_WATCH_HEADER
+
+// === watch.h: recursive inotify watcher and fanotify change journal ==========
+//
+// Contents:
+//   * watcher                      (jump: Init_watch)
+//   * events                       (jump: Poll_watch)
+//   * journal                      (jump: InitJournal_watch)
+//
+// Usage:
+//   watch.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/watch.h" // use as header file
+//
+//   #define C_WATCH_IMPLEMENTATION
+//   #include "c/watch.h" // use as implementation file
+//
+//   Watches whole directory trees for hot-reload and build caches. Add_watch
+//   walks a tree with getdents64 and puts an inotify watch on every
+//   directory; Poll_watch decodes thousands of events per read_linux,
+//   coalesces repeats of the same path within `debounce_ns` and hands the
+//   changes to a callback with full paths:
+//
+//     void Changed(void *user, const Change_watch *change) { ... }
+//
+//     Watcher_watch w;
+//     Init_watch(&w, 1 << 20, IN_CLOSE_WRITE_linux | IN_CREATE_linux | IN_DELETE_linux |
+//                             IN_MOVED_FROM_linux | IN_MOVED_TO_linux, 50000000);
+//     Add_watch(&w, "/srv/config");
+//     for (;;) Poll_watch(&w, -1, Changed, 0);
+//
+//   A change's mask is the union of the events seen for the path during the
+//   window, so a file created and deleted again shows both bits.
+//
+//   Directories are nodes holding their name and parent, not their path:
+//   500k directories take about 24 MB of nodes plus their names, reserved
+//   up front (MAP_NORESERVE) for `capacity` directories. Node lookups by
+//   watch descriptor and by (parent, name) go through hash tables.
+//
+//   The tree follows itself: a directory created inside gets a watch and is
+//   listed, its entries reported as IN_CREATE since they may predate the
+//   watch; a directory renamed inside keeps its watch under the new path; one
+//   moved out of the tree loses its watches. When the kernel queue overflows
+//   (IN_Q_OVERFLOW, fs.inotify.max_queued_events), only directories whose
+//   mtime moved since they were last listed are listed again: they are
+//   reported with IN_Q_OVERFLOW, new subdirectories get watches, removed
+//   ones are dropped. Writes into existing files during an overflow leave
+//   no trace in a directory's mtime and stay unreported.
+//
+//   Every directory costs one watch against fs.inotify.max_user_watches;
+//   failed additions are counted in `errors` with the last one in `error`.
+//
+//   For whole filesystems, the journal takes one fanotify mark instead of a
+//   watch per directory (FAN_MARK_FILESYSTEM, CAP_SYS_ADMIN). Events carry
+//   the directory's file handle and the entry name (FAN_REPORT_DFID_NAME),
+//   not a path. The journal keeps one record per (directory, name) over an
+//   interval. At the end of the interval it resolves each distinct
+//   directory once with open_by_handle_at_linux (CAP_DAC_READ_SEARCH) and
+//   emits the set. An indexer re-reads only those paths instead of
+//   rescanning its trees:
+//
+//     Journal_watch j;
+//     InitJournal_watch(&j, 0, JOURNAL_watch);
+//     MarkJournal_watch(&j, "/srv", FAN_MARK_FILESYSTEM_linux);
+//     for (;;) PollJournal_watch(&j, 60000, Reindex, 0); // a change set a minute
+//
+//   A directory deleted before its change set is emitted has no path left:
+//   its entries come with `path` 0 and only the handle and name. A set
+//   reaching ENTRIES_watch records goes out before the interval ends. After
+//   a queue overflow the set ends with one FAN_Q_OVERFLOW entry per mark,
+//   naming the marked path to rescan.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "watch.h depends on linux.h, include it first"
+#endif
+
+#define NONE_watch          0xffffffffU
+#define READ_watch          (256U << 10) // inotify read buffer
+#define LIST_watch          (32U << 10)  // getdents64 buffer
+#define NAMES_watch         32           // name bytes reserved per directory
+#define PENDING_watch       8192         // distinct paths per debounce window
+#define PENDING_BYTES_watch (1U << 20)
+#define PATH_watch          4096
+
+// Always watched on every directory, to keep the tree in sync.
+#define TREE_watch (IN_CREATE_linux | IN_MOVED_FROM_linux | IN_MOVED_TO_linux)
+
+typedef struct {
+  int wd;                   // -1 when free
+  unsigned int parent;      // NONE_watch for a root or a directory being moved
+  unsigned int child;       // first child
+  unsigned int next;        // sibling, or the next free node
+  unsigned int prev;
+  unsigned int name;        // offset in the names arena
+  unsigned int name_len;
+  unsigned int flags;       // LIST_* for the next listing
+  unsigned int seen;        // epoch of the parent's last listing that found it
+  unsigned int mtime_ns;
+  long long mtime;          // at the last listing
+} Node_watch;
+
+typedef struct {
+  const char *path;
+  unsigned int len;
+  unsigned int mask;        // union of the IN_* events, IN_Q_OVERFLOW after a rescan
+} Change_watch;
+
+typedef void (*Emit_watch)(void *user, const Change_watch *change);
+
+typedef struct {
+  unsigned int path;        // offset in pending_paths
+  unsigned int len;
+  unsigned int mask;
+  unsigned int hash;
+} Pending_watch;
+
+typedef struct {
+  int fd;
+  unsigned int mask;        // caller's events, reported
+  unsigned long long debounce_ns;
+  unsigned int capacity;
+  unsigned int used;        // nodes ever handed out
+  unsigned int free;
+  unsigned int count;       // directories watched
+  unsigned int epoch;
+  Node_watch *nodes;
+  unsigned int *by_wd;      // node + 1, 0 when empty
+  unsigned int *by_name;
+  unsigned int table_mask;
+  unsigned int *stack;      // directories waiting to be listed
+  unsigned int stack_count;
+  char *names;
+  unsigned long names_used;
+  unsigned long names_size;
+  char *buffer;             // READ_watch
+  char *list;               // LIST_watch
+  Pending_watch *pending;
+  unsigned int *pending_table;
+  unsigned int pending_count;
+  unsigned int pending_bytes;
+  char *pending_paths;
+  unsigned long long window; // time of the first pending change, 0 without
+  unsigned int moving;      // directory between IN_MOVED_FROM and IN_MOVED_TO
+  unsigned int cookie;
+  Emit_watch emit;
+  void *user;
+  long emitted;
+  char *memory;
+  unsigned long memory_size;
+  unsigned long long events;
+  unsigned long long reads;
+  unsigned long long coalesced;
+  unsigned long overflows;
+  unsigned long rescanned;
+  unsigned long errors;
+  long error;
+} Watcher_watch;
+
+//
+// Watcher
+//
+long Init_watch(Watcher_watch *w, unsigned int capacity, unsigned int mask, unsigned long long debounce_ns);
+long Add_watch(Watcher_watch *w, const char *path);
+void Free_watch(Watcher_watch *w);
+
+//
+// Events
+//
+long Poll_watch(Watcher_watch *w, long timeout_ms, Emit_watch emit, void *user);
+long Flush_watch(Watcher_watch *w);
+
+//
+// Journal
+//
+#define JOURNAL_watch (FAN_CREATE_linux | FAN_DELETE_linux | FAN_MOVED_FROM_linux | FAN_MOVED_TO_linux | \
+                       FAN_CLOSE_WRITE_linux | FAN_ATTRIB_linux | FAN_ONDIR_linux)
+#define MARKS_watch        16
+#define ENTRIES_watch      65536      // distinct (directory, name) records per interval
+#define ENTRY_BYTES_watch  (8U << 20) // their handles and names
+
+typedef struct {
+  const char *path;             // "<directory>/<name>", 0 when the directory is gone
+  unsigned int len;
+  unsigned int mask;            // FAN_* events of the interval, FAN_ONDIR for directories
+  const file_handle_linux *dir; // as reported, 0 for FAN_Q_OVERFLOW
+  const char *name;
+  unsigned int name_len;
+} Entry_watch;
+
+typedef void (*EmitJournal_watch)(void *user, const Entry_watch *entry);
+
+typedef struct {
+  unsigned int handle;          // offset in `bytes`
+  unsigned int name;
+  unsigned int name_len;
+  unsigned int mask;
+  unsigned int hash;            // of the filesystem, handle and name
+  unsigned int dir_hash;        // of the filesystem and handle
+  unsigned int mark;            // NONE_watch for a filesystem without a mark
+  unsigned int dir;             // resolved path offset in `paths` while collecting
+  unsigned int dir_len;
+} Record_watch;
+
+typedef struct {
+  int fd;                       // the mount for open_by_handle_at (which refuses O_PATH)
+  fsid_t_linux fsid;
+  const char *path;
+} Mark_watch;
+
+typedef struct {
+  int fd;
+  unsigned long long mask;
+  Mark_watch marks[MARKS_watch];
+  unsigned int mark_count;
+  Record_watch *records;
+  unsigned int *table;          // record + 1 by hash
+  unsigned int *dirs;           // record + 1 of a resolved directory, while collecting
+  unsigned int count;
+  unsigned int bytes_used;
+  unsigned int paths_used;
+  int overflow;
+  char *bytes;                  // ENTRY_BYTES_watch
+  char *paths;                  // resolved directories, ENTRY_BYTES_watch
+  char *buffer;                 // READ_watch
+  EmitJournal_watch emit;
+  void *user;
+  long emitted;
+  char *memory;
+  unsigned long memory_size;
+  unsigned long long events;
+  unsigned long long reads;
+  unsigned long long coalesced;
+  unsigned long resolved;       // open_by_handle_at calls
+  unsigned long stale;          // directories gone before resolution
+} Journal_watch;
+
+long InitJournal_watch(Journal_watch *j, unsigned int flags, unsigned long long mask);
+long MarkJournal_watch(Journal_watch *j, const char *path, unsigned int how);
+long PollJournal_watch(Journal_watch *j, long interval_ms, EmitJournal_watch emit, void *user);
+long CollectJournal_watch(Journal_watch *j);
+void FreeJournal_watch(Journal_watch *j);
+
+#endif // C_WATCH_HEADER
+
+#ifdef C_WATCH_IMPLEMENTATION
+
+#define LIST_EMIT_watch   1 // report every entry: the directory is new
+#define LIST_RESCAN_watch 2 // report new subdirectories, drop vanished ones
+
+static unsigned long long Now_watch(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static unsigned int Hash_watch(unsigned int seed, const char *bytes, unsigned int len) {
+  unsigned int hash = 2166136261U ^ seed;
+  for (unsigned int i = 0; i < len; ++i) {
+    hash = (hash ^ (unsigned char)bytes[i]) * 16777619U;
+  }
+  return hash;
+}
+
+static unsigned int Home_watch(Watcher_watch *w, unsigned int *table, unsigned int node) {
+  Node_watch *n = &w->nodes[node];
+  unsigned int hash = table == w->by_wd ? (unsigned int)n->wd * 0x9e3779b1U : Hash_watch(n->parent, w->names + n->name, n->name_len);
+  return hash & w->table_mask;
+}
+
+static void Insert_watch(Watcher_watch *w, unsigned int *table, unsigned int node) {
+  unsigned int i = Home_watch(w, table, node);
+  while (table[i]) {
+    i = (i + 1) & w->table_mask;
+  }
+  table[i] = node + 1;
+}
+
+// Linear-probing delete: later entries of the run shift back into the hole.
+static void Erase_watch(Watcher_watch *w, unsigned int *table, unsigned int node) {
+  unsigned int i = Home_watch(w, table, node);
+  while (table[i] != node + 1) {
+    if (!table[i]) {
+      return;
+    }
+    i = (i + 1) & w->table_mask;
+  }
+  for (unsigned int j = i;;) {
+    j = (j + 1) & w->table_mask;
+    if (!table[j]) {
+      break;
+    }
+    unsigned int home = Home_watch(w, table, table[j] - 1);
+    if ((j > i && (home <= i || home > j)) || (j < i && home <= i && home > j)) {
+      table[i] = table[j];
+      i = j;
+    }
+  }
+  table[i] = 0;
+}
+
+static unsigned int FindWd_watch(Watcher_watch *w, int wd) {
+  for (unsigned int i = (unsigned int)wd * 0x9e3779b1U & w->table_mask; w->by_wd[i]; i = (i + 1) & w->table_mask) {
+    if (w->nodes[w->by_wd[i] - 1].wd == wd) {
+      return w->by_wd[i] - 1;
+    }
+  }
+  return NONE_watch;
+}
+
+static int SameName_watch(const char *a, const char *b, unsigned int len) {
+  for (unsigned int i = 0; i < len; ++i) {
+    if (a[i] != b[i]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static unsigned int FindChild_watch(Watcher_watch *w, unsigned int parent, const char *name, unsigned int len) {
+  for (unsigned int i = Hash_watch(parent, name, len) & w->table_mask; w->by_name[i]; i = (i + 1) & w->table_mask) {
+    Node_watch *n = &w->nodes[w->by_name[i] - 1];
+    if (n->parent == parent && n->name_len == len && SameName_watch(w->names + n->name, name, len)) {
+      return w->by_name[i] - 1;
+    }
+  }
+  return NONE_watch;
+}
+
+// Copies the live names into a fresh arena once appends reach its end.
+static long CompactNames_watch(Watcher_watch *w) {
+  long ret = mmap_linux(0, w->names_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  char *names = (char *)ret;
+  unsigned long used = 0;
+  for (unsigned int i = 0; i < w->used; ++i) {
+    Node_watch *n = &w->nodes[i];
+    if (n->wd >= 0) {
+      for (unsigned int b = 0; b < n->name_len; ++b) {
+        names[used + b] = w->names[n->name + b];
+      }
+      n->name = (unsigned int)used;
+      used += n->name_len;
+    }
+  }
+  munmap_linux(w->names, w->names_size);
+  w->names = names;
+  w->names_used = used;
+  return 0;
+}
+
+// Links a node under `parent` (NONE_watch for a root) with a copy of `name`.
+static long Attach_watch(Watcher_watch *w, unsigned int node, unsigned int parent, const char *name, unsigned int len) {
+  if (w->names_used + len > w->names_size) {
+    long ret = CompactNames_watch(w);
+    if (ret < 0 || w->names_used + len > w->names_size) {
+      return ret < 0 ? ret : -ENOMEM_linux;
+    }
+  }
+  Node_watch *n = &w->nodes[node];
+  for (unsigned int b = 0; b < len; ++b) {
+    w->names[w->names_used + b] = name[b];
+  }
+  n->name = (unsigned int)w->names_used;
+  n->name_len = len;
+  w->names_used += len;
+  n->parent = parent;
+  n->prev = NONE_watch;
+  n->next = NONE_watch;
+  if (parent != NONE_watch) {
+    n->next = w->nodes[parent].child;
+    if (n->next != NONE_watch) {
+      w->nodes[n->next].prev = node;
+    }
+    w->nodes[parent].child = node;
+    Insert_watch(w, w->by_name, node);
+  }
+  return 0;
+}
+
+static void Detach_watch(Watcher_watch *w, unsigned int node) {
+  Node_watch *n = &w->nodes[node];
+  if (n->parent == NONE_watch) {
+    return;
+  }
+  Erase_watch(w, w->by_name, node);
+  if (n->prev != NONE_watch) {
+    w->nodes[n->prev].next = n->next;
+  } else {
+    w->nodes[n->parent].child = n->next;
+  }
+  if (n->next != NONE_watch) {
+    w->nodes[n->next].prev = n->prev;
+  }
+  n->parent = NONE_watch;
+}
+
+// 1 when a '/' goes between the node and its parent (not under a root "/").
+static unsigned int Separator_watch(Watcher_watch *w, Node_watch *n) {
+  if (n->parent == NONE_watch) {
+    return 0;
+  }
+  Node_watch *parent = &w->nodes[n->parent];
+  return !parent->name_len || w->names[parent->name + parent->name_len - 1] != '/';
+}
+
+// Writes a node's path NUL-terminated, returns its length (0 when it
+// doesn't fit in `cap`).
+static unsigned int Path_watch(Watcher_watch *w, unsigned int node, char *buf, unsigned int cap) {
+  unsigned int len = 0;
+  for (unsigned int n = node; n != NONE_watch; n = w->nodes[n].parent) {
+    Node_watch *p = &w->nodes[n];
+    len += p->name_len + Separator_watch(w, p);
+  }
+  if (len + 1 > cap) {
+    return 0;
+  }
+  buf[len] = 0;
+  unsigned int at = len;
+  for (unsigned int n = node; n != NONE_watch; n = w->nodes[n].parent) {
+    Node_watch *p = &w->nodes[n];
+    at -= p->name_len;
+    for (unsigned int b = 0; b < p->name_len; ++b) {
+      buf[at + b] = w->names[p->name + b];
+    }
+    if (Separator_watch(w, p)) {
+      buf[--at] = '/';
+    }
+  }
+  return len;
+}
+
+// Watches a new directory: returns its node, NONE_watch when the directory
+// is gone, already watched or over a limit.
+static unsigned int AddDir_watch(Watcher_watch *w, unsigned int parent, const char *name, unsigned int len, unsigned int flags) {
+  unsigned int node = w->free;
+  if (node != NONE_watch) {
+    w->free = w->nodes[node].next;
+  } else if (w->used < w->capacity) {
+    node = w->used++;
+  } else {
+    ++w->errors;
+    w->error = -ENOSPC_linux;
+    return NONE_watch;
+  }
+  Node_watch *n = &w->nodes[node];
+  n->wd = -1;
+  n->child = NONE_watch;
+  n->flags = flags;
+  n->seen = w->epoch;
+  n->mtime = 0;
+  n->mtime_ns = 0;
+  long ret = Attach_watch(w, node, parent, name, len);
+  char path[PATH_watch];
+  if (ret == 0) {
+    ret = Path_watch(w, node, path, sizeof(path)) ? 0 : -ENAMETOOLONG_linux;
+  }
+  if (ret == 0) {
+    unsigned int mask = w->mask | TREE_watch | IN_ONLYDIR_linux | IN_DONT_FOLLOW_linux | IN_EXCL_UNLINK_linux;
+    ret = inotify_add_watch_linux(w->fd, path, mask);
+  }
+  if (ret >= 0 && FindWd_watch(w, (int)ret) != NONE_watch) {
+    ret = -EEXIST_linux; // the same directory through a bind mount
+  }
+  if (ret < 0) {
+    if (ret != -ENOENT_linux && ret != -ENOTDIR_linux && ret != -EEXIST_linux) {
+      ++w->errors;
+      w->error = ret;
+    }
+    Detach_watch(w, node);
+    n->next = w->free;
+    w->free = node;
+    return NONE_watch;
+  }
+  n->wd = (int)ret;
+  Insert_watch(w, w->by_wd, node);
+  ++w->count;
+  w->stack[w->stack_count++] = node;
+  return node;
+}
+
+// Drops a directory and everything under it; `unwatch` removes the kernel
+// watches too (a subtree moved out of the tree still has them).
+static void RemoveTree_watch(Watcher_watch *w, unsigned int root, int unwatch) {
+  Detach_watch(w, root);
+  for (unsigned int node = root;;) {
+    while (w->nodes[node].child != NONE_watch) {
+      node = w->nodes[node].child;
+    }
+    Node_watch *n = &w->nodes[node];
+    unsigned int up = n->parent;
+    if (unwatch) {
+      inotify_rm_watch_linux(w->fd, n->wd);
+    }
+    Erase_watch(w, w->by_wd, node);
+    Detach_watch(w, node);
+    n->wd = -1;
+    n->next = w->free;
+    w->free = node;
+    --w->count;
+    if (node == root) {
+      break;
+    }
+    node = up;
+  }
+}
+
+// Adds a change for `node`/`name` to the window, merging it into an earlier
+// change of the same path.
+static void Queue_watch(Watcher_watch *w, unsigned int node, const char *name, unsigned int name_len, unsigned int mask) {
+  if (w->pending_count == PENDING_watch || w->pending_bytes + PATH_watch > PENDING_BYTES_watch) {
+    Flush_watch(w);
+  }
+  char *path = w->pending_paths + w->pending_bytes;
+  unsigned int len = Path_watch(w, node, path, PATH_watch);
+  if (!len || len + 1 + name_len + 1 > PATH_watch) {
+    return;
+  }
+  if (name_len) {
+    if (path[len - 1] != '/') {
+      path[len++] = '/';
+    }
+    for (unsigned int b = 0; b < name_len; ++b) {
+      path[len++] = name[b];
+    }
+    path[len] = 0;
+  }
+  unsigned int hash = Hash_watch(0, path, len);
+  unsigned int slot = hash & (2 * PENDING_watch - 1);
+  for (; w->pending_table[slot]; slot = (slot + 1) & (2 * PENDING_watch - 1)) {
+    Pending_watch *p = &w->pending[w->pending_table[slot] - 1];
+    if (p->hash == hash && p->len == len && SameName_watch(w->pending_paths + p->path, path, len)) {
+      p->mask |= mask;
+      ++w->coalesced;
+      return;
+    }
+  }
+  Pending_watch *p = &w->pending[w->pending_count++];
+  p->path = w->pending_bytes;
+  p->len = len;
+  p->mask = mask;
+  p->hash = hash;
+  w->pending_table[slot] = w->pending_count;
+  w->pending_bytes += len + 1;
+  if (!w->window) {
+    w->window = Now_watch();
+  }
+}
+
+// Lists a directory: new subdirectories get watches, and its mtime is kept
+// for overflow rescans.
+static void List_watch(Watcher_watch *w, unsigned int node) {
+  char path[PATH_watch];
+  Node_watch *n = &w->nodes[node];
+  unsigned int flags = n->flags;
+  n->flags = 0;
+  if (!Path_watch(w, node, path, sizeof(path))) {
+    return;
+  }
+  long fd = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return; // gone already, its IN_IGNORED follows
+  }
+  statx_t_linux st;
+  if (statx_linux((int)fd, "", AT_EMPTY_PATH_linux, STATX_MTIME_linux, &st) == 0) {
+    n->mtime = st.stx_mtime.tv_sec;
+    n->mtime_ns = st.stx_mtime.tv_nsec;
+  }
+  unsigned int epoch = ++w->epoch;
+  for (;;) {
+    long got = getdents64_linux((unsigned int)fd, (linux_dirent64_linux *)w->list, LIST_watch);
+    if (got <= 0) {
+      break;
+    }
+    for (long at = 0; at < got;) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(w->list + at);
+      at += d->d_reclen;
+      const char *name = d->d_name;
+      unsigned int len = 0;
+      while (name[len]) {
+        ++len;
+      }
+      if (name[0] == '.' && (len == 1 || (len == 2 && name[1] == '.'))) {
+        continue;
+      }
+      int dir = d->d_type == DT_DIR_linux;
+      if (d->d_type == DT_UNKNOWN_linux && statx_linux((int)fd, name, AT_SYMLINK_NOFOLLOW_linux, STATX_TYPE_linux, &st) == 0) {
+        dir = (st.stx_mode & S_IFMT_linux) == S_IFDIR_linux;
+      }
+      unsigned int child = dir ? FindChild_watch(w, node, name, len) : NONE_watch;
+      if (child != NONE_watch) {
+        w->nodes[child].seen = epoch;
+        continue;
+      }
+      if (dir) {
+        child = AddDir_watch(w, node, name, len, flags ? LIST_EMIT_watch : 0);
+        if (child != NONE_watch) {
+          w->nodes[child].seen = epoch;
+        }
+      }
+      if ((flags & LIST_EMIT_watch || (flags & LIST_RESCAN_watch && dir)) && w->mask & IN_CREATE_linux) {
+        Queue_watch(w, node, name, len, IN_CREATE_linux | (dir ? IN_ISDIR_linux : 0));
+      }
+    }
+  }
+  close_linux((unsigned int)fd);
+  if (flags & LIST_RESCAN_watch) {
+    for (unsigned int child = n->child; child != NONE_watch;) {
+      unsigned int next = w->nodes[child].next;
+      if (w->nodes[child].seen != epoch) {
+        RemoveTree_watch(w, child, 1);
+      }
+      child = next;
+    }
+  }
+}
+
+static void Drain_watch(Watcher_watch *w) {
+  while (w->stack_count) {
+    unsigned int node = w->stack[--w->stack_count];
+    if (w->nodes[node].wd >= 0) {
+      List_watch(w, node);
+    }
+  }
+}
+
+// After IN_Q_OVERFLOW: lists again only the directories whose entries
+// changed since their last listing.
+static void Rescan_watch(Watcher_watch *w) {
+  ++w->overflows;
+  char path[PATH_watch];
+  for (unsigned int node = 0; node < w->used; ++node) {
+    Node_watch *n = &w->nodes[node];
+    statx_t_linux st;
+    if (n->wd < 0 || !Path_watch(w, node, path, sizeof(path)) ||
+        statx_linux(AT_FDCWD_linux, path, AT_SYMLINK_NOFOLLOW_linux, STATX_MTIME_linux, &st) != 0) {
+      continue;
+    }
+    if (st.stx_mtime.tv_sec != n->mtime || st.stx_mtime.tv_nsec != n->mtime_ns) {
+      n->flags = LIST_RESCAN_watch;
+      w->stack[w->stack_count++] = node;
+      Queue_watch(w, node, "", 0, IN_Q_OVERFLOW_linux | IN_ISDIR_linux);
+      ++w->rescanned;
+    }
+  }
+  Drain_watch(w);
+}
+
+// A directory that left with IN_MOVED_FROM and didn't come back with the
+// matching IN_MOVED_TO is out of the tree.
+static void Moved_watch(Watcher_watch *w) {
+  if (w->moving != NONE_watch) {
+    unsigned int node = w->moving;
+    w->moving = NONE_watch;
+    RemoveTree_watch(w, node, 1);
+  }
+}
+
+static void Event_watch(Watcher_watch *w, inotify_event_linux *ev) {
+  ++w->events;
+  if (w->moving != NONE_watch && !(ev->mask & IN_MOVED_TO_linux && ev->cookie == w->cookie)) {
+    Moved_watch(w);
+  }
+  if (ev->mask & IN_Q_OVERFLOW_linux) {
+    Rescan_watch(w);
+    return;
+  }
+  unsigned int node = FindWd_watch(w, ev->wd);
+  if (node == NONE_watch) {
+    return; // a watch removed since
+  }
+  if (ev->mask & IN_IGNORED_linux) {
+    RemoveTree_watch(w, node, 0);
+    return;
+  }
+  unsigned int len = 0;
+  while (len < ev->len && ev->name[len]) {
+    ++len;
+  }
+  if (ev->mask & IN_ISDIR_linux && len) {
+    if (ev->mask & IN_CREATE_linux) {
+      if (FindChild_watch(w, node, ev->name, len) == NONE_watch) {
+        AddDir_watch(w, node, ev->name, len, LIST_EMIT_watch);
+      }
+    } else if (ev->mask & IN_MOVED_FROM_linux) {
+      unsigned int child = FindChild_watch(w, node, ev->name, len);
+      if (child != NONE_watch) {
+        Detach_watch(w, child);
+        w->moving = child;
+        w->cookie = ev->cookie;
+      }
+    } else if (ev->mask & IN_MOVED_TO_linux) {
+      if (w->moving != NONE_watch) {
+        unsigned int moved = w->moving;
+        w->moving = NONE_watch;
+        if (Attach_watch(w, moved, node, ev->name, len) < 0) {
+          RemoveTree_watch(w, moved, 1);
+        }
+      } else {
+        AddDir_watch(w, node, ev->name, len, LIST_EMIT_watch);
+      }
+    }
+  }
+  if (ev->mask & w->mask) {
+    Queue_watch(w, node, ev->name, len, ev->mask & (w->mask | IN_ISDIR_linux));
+  }
+}
+
+// Decodes everything the kernel has queued, a buffer of events per read.
+static long Read_watch(Watcher_watch *w) {
+  for (;;) {
+    long got = read_linux((unsigned int)w->fd, w->buffer, READ_watch);
+    if (got == -EAGAIN_linux) {
+      return 0;
+    }
+    if (got <= 0) {
+      return got < 0 ? got : -EIO_linux;
+    }
+    ++w->reads;
+    for (long at = 0; at < got;) {
+      inotify_event_linux *ev = (inotify_event_linux *)(w->buffer + at);
+      at += (long)sizeof(*ev) + ev->len;
+      Event_watch(w, ev);
+    }
+    Drain_watch(w);
+  }
+}
+
+long Init_watch(Watcher_watch *w, unsigned int capacity, unsigned int mask, unsigned long long debounce_ns) {
+  unsigned int table = 1;
+  while (table < 2 * capacity) {
+    table <<= 1;
+  }
+  unsigned long nodes = (unsigned long)capacity * sizeof(Node_watch);
+  unsigned long tables = 2UL * table * sizeof(unsigned int);
+  unsigned long stack = 2UL * capacity * sizeof(unsigned int); // a freed node can be queued again
+  unsigned long pending = PENDING_watch * sizeof(Pending_watch) + 2 * PENDING_watch * sizeof(unsigned int);
+  w->memory_size = (nodes + tables + stack + READ_watch + LIST_watch + pending + PENDING_BYTES_watch + 4095) & ~4095UL;
+  w->names_size = ((unsigned long)capacity * NAMES_watch + PATH_watch + 4095) & ~4095UL;
+  long ret = mmap_linux(0, w->memory_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  w->memory = (char *)ret;
+  ret = mmap_linux(0, w->names_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    munmap_linux(w->memory, w->memory_size);
+    return ret;
+  }
+  w->names = (char *)ret;
+  w->buffer = w->memory;
+  w->list = w->buffer + READ_watch;
+  w->pending_paths = w->list + LIST_watch;
+  w->nodes = (Node_watch *)(w->pending_paths + PENDING_BYTES_watch);
+  w->pending = (Pending_watch *)((char *)w->nodes + nodes);
+  w->pending_table = (unsigned int *)(w->pending + PENDING_watch);
+  w->by_wd = w->pending_table + 2 * PENDING_watch;
+  w->by_name = w->by_wd + table;
+  w->stack = w->by_name + table;
+  w->table_mask = table - 1;
+  ret = inotify_init1_linux(IN_NONBLOCK_linux | IN_CLOEXEC_linux);
+  if (ret < 0) {
+    munmap_linux(w->memory, w->memory_size);
+    munmap_linux(w->names, w->names_size);
+    return ret;
+  }
+  w->fd = (int)ret;
+  w->mask = mask;
+  w->debounce_ns = debounce_ns;
+  w->capacity = capacity;
+  w->used = 0;
+  w->free = NONE_watch;
+  w->count = 0;
+  w->epoch = 0;
+  w->stack_count = 0;
+  w->names_used = 0;
+  w->pending_count = 0;
+  w->pending_bytes = 0;
+  w->window = 0;
+  w->moving = NONE_watch;
+  w->cookie = 0;
+  w->emit = 0;
+  w->user = 0;
+  w->emitted = 0;
+  w->events = 0;
+  w->reads = 0;
+  w->coalesced = 0;
+  w->overflows = 0;
+  w->rescanned = 0;
+  w->errors = 0;
+  w->error = 0;
+  return 0;
+}
+
+// Watches `path` and every directory under it; returns the number of
+// directories watched in total.
+long Add_watch(Watcher_watch *w, const char *path) {
+  unsigned int len = 0;
+  while (path[len]) {
+    ++len;
+  }
+  while (len > 1 && path[len - 1] == '/') {
+    --len;
+  }
+  unsigned long errors = w->errors;
+  if (AddDir_watch(w, NONE_watch, path, len, 0) == NONE_watch) {
+    return w->errors != errors ? w->error : -ENOENT_linux;
+  }
+  Drain_watch(w);
+  return w->count;
+}
+
+void Free_watch(Watcher_watch *w) {
+  close_linux((unsigned int)w->fd);
+  munmap_linux(w->memory, w->memory_size);
+  munmap_linux(w->names, w->names_size);
+}
+
+// Hands the window's changes to the callback in arrival order.
+long Flush_watch(Watcher_watch *w) {
+  Moved_watch(w);
+  long count = w->pending_count;
+  for (unsigned int i = 0; i < w->pending_count; ++i) {
+    Change_watch change = {w->pending_paths + w->pending[i].path, w->pending[i].len, w->pending[i].mask};
+    if (w->emit) {
+      w->emit(w->user, &change);
+    }
+  }
+  for (unsigned int i = 0; i < 2 * PENDING_watch; ++i) {
+    w->pending_table[i] = 0;
+  }
+  w->pending_count = 0;
+  w->pending_bytes = 0;
+  w->window = 0;
+  w->emitted += count;
+  return count;
+}
+
+// Waits up to `timeout_ms` (-1 forever) for changes and returns once a
+// window was flushed, with the number of changes emitted.
+long Poll_watch(Watcher_watch *w, long timeout_ms, Emit_watch emit, void *user) {
+  w->emit = emit;
+  w->user = user;
+  w->emitted = 0;
+  unsigned long long now = Now_watch();
+  unsigned long long deadline = timeout_ms < 0 ? ~0ULL : now + (unsigned long long)timeout_ms * 1000000ULL;
+  for (;;) {
+    unsigned long long until = deadline;
+    if (w->window && w->window + w->debounce_ns < until) {
+      until = w->window + w->debounce_ns;
+    }
+    __kernel_timespec_linux ts = {0, 0};
+    if (until > now && until - now >= 1000000000ULL) {
+      ts.tv_sec = 1; // long waits go a second at a time, without 64-bit division
+    } else if (until > now) {
+      ts.tv_nsec = (long long)(until - now);
+    }
+    pollfd_linux fds = {w->fd, POLLIN_linux, 0};
+    long ret = ppoll_time64_linux(&fds, 1, &ts, 0);
+    if (ret < 0 && ret != -EINTR_linux) {
+      return ret;
+    }
+    if (ret > 0 && (ret = Read_watch(w)) < 0) {
+      return ret;
+    }
+    now = Now_watch();
+    if (w->window && now - w->window >= w->debounce_ns) {
+      Flush_watch(w);
+    }
+    if (w->emitted || now >= deadline) {
+      return w->emitted;
+    }
+  }
+}
+
+//
+// Journal
+//
+
+static int SameHandle_watch(const file_handle_linux *a, const file_handle_linux *b) {
+  return a->handle_bytes == b->handle_bytes && a->handle_type == b->handle_type &&
+         SameName_watch((const char *)a->f_handle, (const char *)b->f_handle, a->handle_bytes);
+}
+
+// Adds one event to the interval's set, merging it into the record of the
+// same directory and name.
+static void RecordJournal_watch(Journal_watch *j, const fsid_t_linux *fsid, const file_handle_linux *handle, const char *name, unsigned long long mask) {
+  unsigned int name_len = 0;
+  while (name[name_len]) {
+    ++name_len;
+  }
+  unsigned int handle_size = (unsigned int)sizeof(*handle) + handle->handle_bytes;
+  unsigned int dir_hash = Hash_watch(Hash_watch(0, (const char *)fsid, sizeof(*fsid)), (const char *)handle, handle_size);
+  unsigned int hash = Hash_watch(dir_hash, name, name_len);
+  if (j->count == ENTRIES_watch || j->bytes_used + handle_size + name_len + 4 > ENTRY_BYTES_watch) {
+    CollectJournal_watch(j); // a full set goes out early
+  }
+  unsigned int slot = hash & (2 * ENTRIES_watch - 1);
+  for (; j->table[slot]; slot = (slot + 1) & (2 * ENTRIES_watch - 1)) {
+    Record_watch *r = &j->records[j->table[slot] - 1];
+    if (r->hash == hash && r->name_len == name_len && SameName_watch(j->bytes + r->name, name, name_len) &&
+        SameHandle_watch((const file_handle_linux *)(j->bytes + r->handle), handle)) {
+      r->mask |= (unsigned int)mask;
+      ++j->coalesced;
+      return;
+    }
+  }
+  unsigned int mark = NONE_watch;
+  for (unsigned int m = 0; m < j->mark_count; ++m) {
+    if (j->marks[m].fsid.val[0] == fsid->val[0] && j->marks[m].fsid.val[1] == fsid->val[1]) {
+      mark = m;
+    }
+  }
+  Record_watch *r = &j->records[j->count++];
+  r->handle = j->bytes_used;
+  for (unsigned int b = 0; b < handle_size; ++b) {
+    j->bytes[j->bytes_used++] = ((const char *)handle)[b];
+  }
+  r->name = j->bytes_used;
+  for (unsigned int b = 0; b < name_len; ++b) {
+    j->bytes[j->bytes_used++] = name[b];
+  }
+  j->bytes_used = (j->bytes_used + 3) & ~3U; // the next handle stays aligned
+  r->name_len = name_len;
+  r->mask = (unsigned int)mask;
+  r->hash = hash;
+  r->dir_hash = dir_hash;
+  r->mark = mark;
+  j->table[slot] = j->count;
+}
+
+// Decodes one buffer of events: metadata, then info records of which the
+// directory handle and name (or a bare handle without name) are kept.
+static void DecodeJournal_watch(Journal_watch *j, long got) {
+  for (long at = 0; at + (long)sizeof(fanotify_event_metadata_linux) <= got;) {
+    fanotify_event_metadata_linux *m = (fanotify_event_metadata_linux *)(j->buffer + at);
+    if (m->event_len < sizeof(*m) || at + (long)m->event_len > got) {
+      break;
+    }
+    at += m->event_len;
+    ++j->events;
+    if (m->fd >= 0) {
+      close_linux((unsigned int)m->fd);
+    }
+    if (m->vers != FANOTIFY_METADATA_VERSION_linux || m->mask & FAN_Q_OVERFLOW_linux) {
+      j->overflow = 1;
+      continue;
+    }
+    fanotify_event_info_fid_linux *best = 0;
+    for (unsigned int info = m->metadata_len; info + sizeof(fanotify_event_info_header_linux) <= m->event_len;) {
+      fanotify_event_info_fid_linux *fid = (fanotify_event_info_fid_linux *)((char *)m + info);
+      if (!fid->hdr.len) {
+        break;
+      }
+      info += fid->hdr.len;
+      int type = fid->hdr.info_type;
+      if (type == FAN_EVENT_INFO_TYPE_DFID_NAME_linux ||
+          (!best && (type == FAN_EVENT_INFO_TYPE_DFID_linux || type == FAN_EVENT_INFO_TYPE_FID_linux))) {
+        best = fid;
+      }
+    }
+    if (best) {
+      const file_handle_linux *handle = (const file_handle_linux *)best->handle;
+      const char *name = best->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME_linux ? (const char *)(handle->f_handle + handle->handle_bytes) : "";
+      RecordJournal_watch(j, &best->fsid, handle, name, m->mask);
+    }
+  }
+}
+
+// The directory's path, through a descriptor from its handle; once per
+// distinct directory in a change set.
+static void Resolve_watch(Journal_watch *j, Record_watch *r) {
+  const file_handle_linux *handle = (const file_handle_linux *)(j->bytes + r->handle);
+  unsigned int slot = r->dir_hash & (2 * ENTRIES_watch - 1);
+  for (; j->dirs[slot]; slot = (slot + 1) & (2 * ENTRIES_watch - 1)) {
+    Record_watch *o = &j->records[j->dirs[slot] - 1];
+    if (o->dir_hash == r->dir_hash && o->mark == r->mark && SameHandle_watch((const file_handle_linux *)(j->bytes + o->handle), handle)) {
+      r->dir = o->dir;
+      r->dir_len = o->dir_len;
+      return;
+    }
+  }
+  r->dir = NONE_watch;
+  r->dir_len = 0;
+  j->dirs[slot] = (unsigned int)(r - j->records) + 1;
+  if (r->mark == NONE_watch || j->paths_used + PATH_watch > ENTRY_BYTES_watch) {
+    return;
+  }
+  ++j->resolved;
+  long fd = open_by_handle_at_linux(j->marks[r->mark].fd, (file_handle_linux *)handle, O_PATH_linux | O_CLOEXEC_linux);
+  if (fd < 0) {
+    ++j->stale;
+    return;
+  }
+  char link[32] = "/proc/self/fd/";
+  char digits[12];
+  int d = 0, at = 14;
+  for (unsigned int n = (unsigned int)fd; d == 0 || n; n /= 10) {
+    digits[d++] = (char)('0' + n % 10);
+  }
+  while (d) {
+    link[at++] = digits[--d];
+  }
+  link[at] = 0;
+  char *path = j->paths + j->paths_used;
+  long len = readlinkat_linux(AT_FDCWD_linux, link, path, PATH_watch);
+  close_linux((unsigned int)fd);
+  if (len <= 0 || len >= PATH_watch || (len > 10 && SameName_watch(path + len - 10, " (deleted)", 10))) {
+    ++j->stale;
+    return;
+  }
+  r->dir = j->paths_used;
+  r->dir_len = (unsigned int)len;
+  j->paths_used += (unsigned int)len;
+}
+
+long InitJournal_watch(Journal_watch *j, unsigned int flags, unsigned long long mask) {
+  unsigned long records = ENTRIES_watch * sizeof(Record_watch);
+  unsigned long tables = 2 * 2 * ENTRIES_watch * sizeof(unsigned int);
+  j->memory_size = (records + tables + 2 * ENTRY_BYTES_watch + READ_watch + 4095) & ~4095UL;
+  long ret = mmap_linux(0, j->memory_size, PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux | MAP_NORESERVE_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  j->memory = (char *)ret;
+  j->bytes = j->memory;
+  j->paths = j->bytes + ENTRY_BYTES_watch;
+  j->buffer = j->paths + ENTRY_BYTES_watch;
+  j->records = (Record_watch *)(j->buffer + READ_watch);
+  j->table = (unsigned int *)(j->records + ENTRIES_watch);
+  j->dirs = j->table + 2 * ENTRIES_watch;
+  ret = fanotify_init_linux(FAN_CLASS_NOTIF_linux | FAN_CLOEXEC_linux | FAN_NONBLOCK_linux | FAN_REPORT_DFID_NAME_linux | flags,
+                            O_RDONLY_linux | O_LARGEFILE_linux | O_CLOEXEC_linux);
+  if (ret < 0) {
+    munmap_linux(j->memory, j->memory_size);
+    return ret;
+  }
+  j->fd = (int)ret;
+  j->mask = mask;
+  j->mark_count = 0;
+  j->count = 0;
+  j->bytes_used = 0;
+  j->paths_used = 0;
+  j->overflow = 0;
+  j->emit = 0;
+  j->user = 0;
+  j->emitted = 0;
+  j->events = 0;
+  j->reads = 0;
+  j->coalesced = 0;
+  j->resolved = 0;
+  j->stale = 0;
+  return 0;
+}
+
+// Marks the filesystem (FAN_MARK_FILESYSTEM_linux) or mount
+// (FAN_MARK_MOUNT_linux) holding `path`, which must outlive the journal.
+// Directory entry events need a filesystem mark. Returns the mark's index.
+long MarkJournal_watch(Journal_watch *j, const char *path, unsigned int how) {
+  if (j->mark_count == MARKS_watch) {
+    return -ENOSPC_linux;
+  }
+  long fd = openat_linux(AT_FDCWD_linux, path, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return fd;
+  }
+  Mark_watch *mark = &j->marks[j->mark_count];
+  statfs64_t_linux st;
+  long ret = fstatfs64_linux((unsigned int)fd, &st);
+  if (ret == 0) {
+    ret = fanotify_mark_linux(j->fd, FAN_MARK_ADD_linux | how, j->mask, AT_FDCWD_linux, path);
+  }
+  if (ret < 0) {
+    close_linux((unsigned int)fd);
+    return ret;
+  }
+  mark->fd = (int)fd;
+  mark->fsid = st.f_fsid;
+  mark->path = path;
+  return j->mark_count++;
+}
+
+// Emits the set gathered since the last collection, resolving directories
+// on the way, and starts a new one.
+long CollectJournal_watch(Journal_watch *j) {
+  char path[PATH_watch];
+  for (unsigned int i = 0; i < j->count; ++i) {
+    Record_watch *r = &j->records[i];
+    Resolve_watch(j, r);
+    Entry_watch entry = {0, 0, r->mask, (const file_handle_linux *)(j->bytes + r->handle), j->bytes + r->name, r->name_len};
+    int self = !r->name_len || (r->name_len == 1 && entry.name[0] == '.');
+    if (r->dir != NONE_watch && r->dir_len + 1 + r->name_len < PATH_watch) {
+      unsigned int len = 0;
+      for (unsigned int b = 0; b < r->dir_len; ++b) {
+        path[len++] = j->paths[r->dir + b];
+      }
+      if (!self) {
+        if (len && path[len - 1] != '/') {
+          path[len++] = '/';
+        }
+        for (unsigned int b = 0; b < r->name_len; ++b) {
+          path[len++] = entry.name[b];
+        }
+      }
+      path[len] = 0;
+      entry.path = path;
+      entry.len = len;
+    }
+    if (j->emit) {
+      j->emit(j->user, &entry);
+    }
+  }
+  long count = j->count;
+  if (j->overflow) {
+    for (unsigned int m = 0; m < j->mark_count; ++m) {
+      unsigned int len = 0;
+      while (j->marks[m].path[len]) {
+        ++len;
+      }
+      Entry_watch entry = {j->marks[m].path, len, FAN_Q_OVERFLOW_linux, 0, "", 0};
+      if (j->emit) {
+        j->emit(j->user, &entry);
+      }
+      ++count;
+    }
+  }
+  for (unsigned int i = 0; i < 2 * ENTRIES_watch; ++i) {
+    j->table[i] = 0;
+    j->dirs[i] = 0;
+  }
+  j->count = 0;
+  j->bytes_used = 0;
+  j->paths_used = 0;
+  j->overflow = 0;
+  j->emitted += count;
+  return count;
+}
+
+// Gathers events for `interval_ms`, then emits the change set; returns the
+// number of entries emitted.
+long PollJournal_watch(Journal_watch *j, long interval_ms, EmitJournal_watch emit, void *user) {
+  j->emit = emit;
+  j->user = user;
+  j->emitted = 0;
+  unsigned long long now = Now_watch();
+  unsigned long long deadline = now + (unsigned long long)(interval_ms > 0 ? interval_ms : 0) * 1000000ULL;
+  for (;;) {
+    long got;
+    while ((got = read_linux((unsigned int)j->fd, j->buffer, READ_watch)) > 0) {
+      ++j->reads;
+      DecodeJournal_watch(j, got);
+    }
+    if (got < 0 && got != -EAGAIN_linux) {
+      return got;
+    }
+    now = Now_watch();
+    if (now >= deadline) {
+      break;
+    }
+    __kernel_timespec_linux ts = {0, 0};
+    if (deadline - now >= 1000000000ULL) {
+      ts.tv_sec = 1;
+    } else {
+      ts.tv_nsec = (long long)(deadline - now);
+    }
+    pollfd_linux fds = {j->fd, POLLIN_linux, 0};
+    long ret = ppoll_time64_linux(&fds, 1, &ts, 0);
+    if (ret < 0 && ret != -EINTR_linux) {
+      return ret;
+    }
+  }
+  CollectJournal_watch(j);
+  return j->emitted;
+}
+
+void FreeJournal_watch(Journal_watch *j) {
+  for (unsigned int m = 0; m < j->mark_count; ++m) {
+    close_linux((unsigned int)j->marks[m].fd);
+  }
+  close_linux((unsigned int)j->fd);
+  munmap_linux(j->memory, j->memory_size);
+}
+
+#endif // C_WATCH_IMPLEMENTATION
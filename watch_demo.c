@@ -0,0 +1,488 @@
+// clang -O2 -nostdlib -static -fuse-ld=lld -ffreestanding -o watch_demo watch_demo.c -e main && ./watch_demo
+
+#define C_LINUX_IMPLEMENTATION
+#include "linux.h"
+#define C_WATCH_IMPLEMENTATION
+#include "watch.h"
+
+#define true        1
+#define false       0
+
+#define NULL 0
+
+// Helpers
+unsigned long Size_chars(const char* chars) {
+  unsigned long size = 0;
+  while (*chars++) {
+    ++size;
+  }
+  return size;
+}
+
+void _Assert(int condition, const char* message) {
+  if (!condition) {
+    write_linux(STDERR_FILENO_linux, message, Size_chars(message));
+    exit_linux(1);
+  }
+}
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define Assert(condition) _Assert((condition), ("FATAL: Assert failed at " __FILE__ ":" TOSTRING(__LINE__) "\n"))
+
+long Print(int fd, const char* data) {
+  return write_linux(fd, data, Size_chars(data));
+}
+
+void PrintU64(int fd, unsigned long long value) {
+  char buf[24];
+  int i = sizeof(buf);
+  buf[--i] = 0;
+  do {
+    buf[--i] = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  Print(fd, buf + i);
+}
+
+unsigned long long Now_ns(void) {
+  __kernel_timespec_linux ts;
+  clock_gettime64_linux(CLOCK_MONOTONIC_linux, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Builds "<root>/<a>/<b>..." from path parts into a static buffer.
+char path[PATH_watch];
+
+const char *Join(const char *a, const char *b, const char *c) {
+  unsigned long len = 0;
+  const char *parts[3] = {a, b, c};
+  for (int p = 0; p < 3 && parts[p]; ++p) {
+    if (p) {
+      path[len++] = '/';
+    }
+    for (const char *s = parts[p]; *s; ++s) {
+      path[len++] = *s;
+    }
+  }
+  path[len] = 0;
+  return path;
+}
+
+void Number(char *out, const char *prefix, unsigned int n) {
+  while (*prefix) {
+    *out++ = *prefix++;
+  }
+  char digits[12];
+  int d = 0;
+  do {
+    digits[d++] = (char)('0' + n % 10);
+    n /= 10;
+  } while (n);
+  while (d) {
+    *out++ = digits[--d];
+  }
+  *out = 0;
+}
+
+void Touch(const char *file, int bytes) {
+  long fd = openat_linux(AT_FDCWD_linux, file, O_WRONLY_linux | O_CREAT_linux | O_TRUNC_linux | O_CLOEXEC_linux, 0644);
+  Assert(fd >= 0);
+  Assert(write_linux((unsigned int)fd, "config=1\n", (unsigned long)bytes) == bytes);
+  close_linux((unsigned int)fd);
+}
+
+// rm -rf without libc.
+void Remove(const char *dir) {
+  char self[PATH_watch];
+  unsigned long len = Size_chars(dir);
+  for (unsigned long i = 0; i <= len; ++i) {
+    self[i] = dir[i];
+  }
+  long fd = openat_linux(AT_FDCWD_linux, self, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  if (fd < 0) {
+    return;
+  }
+  char entries[8192];
+  for (;;) {
+    long got = getdents64_linux((unsigned int)fd, (linux_dirent64_linux *)entries, sizeof(entries));
+    if (got <= 0) {
+      break;
+    }
+    for (long at = 0; at < got;) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(entries + at);
+      at += d->d_reclen;
+      if (d->d_name[0] == '.' && (!d->d_name[1] || (d->d_name[1] == '.' && !d->d_name[2]))) {
+        continue;
+      }
+      if (d->d_type == DT_DIR_linux) {
+        Remove(Join(self, d->d_name, NULL));
+      } else {
+        unlinkat_linux((int)fd, d->d_name, 0);
+      }
+    }
+  }
+  close_linux((unsigned int)fd);
+  unlinkat_linux(AT_FDCWD_linux, self, AT_REMOVEDIR_linux);
+}
+
+//
+// Changes seen by the callback, and a path being waited for
+//
+unsigned long changes;
+const char *expect;
+unsigned int expect_mask;
+
+int Equal(const char *a, const char *b, unsigned int len) {
+  for (unsigned int i = 0; i < len; ++i) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return !b[len];
+}
+
+void Changed(void *user, const Change_watch *change) {
+  (void)user;
+  ++changes;
+  Assert(Size_chars(change->path) == change->len);
+  if (expect && Equal(change->path, expect, change->len)) {
+    expect_mask |= change->mask;
+  }
+}
+
+// Polls until the expected path showed up or a second passed.
+unsigned int Await(Watcher_watch *w, const char *wanted) {
+  static char copy[PATH_watch];
+  unsigned long len = Size_chars(wanted);
+  for (unsigned long i = 0; i <= len; ++i) {
+    copy[i] = wanted[i];
+  }
+  expect = copy;
+  expect_mask = 0;
+  unsigned long long t0 = Now_ns();
+  while (!expect_mask && Now_ns() - t0 < 1000000000ULL) {
+    Assert(Poll_watch(w, 100, Changed, NULL) >= 0);
+  }
+  expect = NULL;
+  return expect_mask;
+}
+
+#define ROOT    "/tmp/watch_demo"
+#define OUTSIDE "/tmp/watch_demo_outside"
+#define TOP     10
+#define MIDDLE  40
+#define LEAVES  50 // 10 + 400 + 20000 directories
+
+#define MASK (IN_CLOSE_WRITE_linux | IN_CREATE_linux | IN_DELETE_linux | IN_MOVED_FROM_linux | IN_MOVED_TO_linux)
+
+Watcher_watch w;
+
+//
+// A 20k-directory tree: time to watch it, then a hot-reload burst of
+// rewrites coalesced per file
+//
+void Tree_demo(void) {
+  Remove(ROOT);
+  Remove(OUTSIDE);
+  Assert(mkdirat_linux(AT_FDCWD_linux, ROOT, 0755) == 0);
+  Assert(mkdirat_linux(AT_FDCWD_linux, OUTSIDE, 0755) == 0);
+  char top[16], middle[16], leaf[16];
+  for (unsigned int t = 0; t < TOP; ++t) {
+    Number(top, "top", t);
+    Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, top, NULL), 0755) == 0);
+    for (unsigned int m = 0; m < MIDDLE; ++m) {
+      Number(middle, "mid", m);
+      char dir[PATH_watch];
+      const char *joined = Join(ROOT, top, middle);
+      for (unsigned long i = 0; i <= Size_chars(joined); ++i) {
+        dir[i] = joined[i];
+      }
+      Assert(mkdirat_linux(AT_FDCWD_linux, dir, 0755) == 0);
+      for (unsigned int l = 0; l < LEAVES; ++l) {
+        Number(leaf, "leaf", l);
+        Assert(mkdirat_linux(AT_FDCWD_linux, Join(dir, leaf, NULL), 0755) == 0);
+      }
+    }
+  }
+
+  unsigned long long t0 = Now_ns();
+  long watched = Add_watch(&w, ROOT);
+  unsigned long long elapsed = Now_ns() - t0;
+  if (watched == -ENOSPC_linux) {
+    Print(STDOUT_FILENO_linux, "fs.inotify.max_user_watches too low for the demo tree\n");
+    exit_linux(0);
+  }
+  Assert(watched == 1 + TOP + TOP * MIDDLE + TOP * MIDDLE * LEAVES);
+  Print(STDOUT_FILENO_linux, "watched ");
+  PrintU64(STDOUT_FILENO_linux, (unsigned long long)watched);
+  Print(STDOUT_FILENO_linux, " directories in ");
+  PrintU64(STDOUT_FILENO_linux, elapsed / 1000000);
+  Print(STDOUT_FILENO_linux, " ms (");
+  PrintU64(STDOUT_FILENO_linux, elapsed / (unsigned long long)watched);
+  Print(STDOUT_FILENO_linux, " ns each), ");
+  PrintU64(STDOUT_FILENO_linux, (unsigned long long)w.used * sizeof(Node_watch) + w.names_used);
+  Print(STDOUT_FILENO_linux, " bytes of nodes and names\n");
+
+  // 500 config files rewritten 20 times each, as an editor or deploy does.
+  char file[16];
+  for (int round = 0; round < 20; ++round) {
+    for (unsigned int f = 0; f < 500; ++f) {
+      Number(top, "top", f % TOP);
+      Number(file, "app", f);
+      Touch(Join(ROOT, top, file), 9);
+    }
+  }
+  changes = 0;
+  unsigned long long events = w.events, reads = w.reads;
+  t0 = Now_ns();
+  while (Poll_watch(&w, 200, Changed, NULL) > 0) {
+  }
+  elapsed = Now_ns() - t0;
+  Assert(changes == 500);
+  Print(STDOUT_FILENO_linux, "burst: ");
+  PrintU64(STDOUT_FILENO_linux, w.events - events);
+  Print(STDOUT_FILENO_linux, " events in ");
+  PrintU64(STDOUT_FILENO_linux, w.reads - reads);
+  Print(STDOUT_FILENO_linux, " reads, coalesced into ");
+  PrintU64(STDOUT_FILENO_linux, changes);
+  Print(STDOUT_FILENO_linux, " changes (");
+  PrintU64(STDOUT_FILENO_linux, w.debounce_ns / 1000000);
+  Print(STDOUT_FILENO_linux, " ms debounce)\n");
+}
+
+//
+// The tree follows itself: new directories, renames inside, moves out
+//
+void Follow_demo(void) {
+  // A nested directory made in one go, a file dropped in right away.
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, "new", NULL), 0755) == 0);
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, "new", "b"), 0755) == 0);
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, "new/b", "c"), 0755) == 0);
+  Touch(Join(ROOT, "new/b/c", "fresh.conf"), 9);
+  Assert(Await(&w, Join(ROOT, "new/b/c", "fresh.conf")) & (IN_CREATE_linux | IN_CLOSE_WRITE_linux));
+  Touch(Join(ROOT, "new/b/c", "later.conf"), 9);
+  Assert(Await(&w, Join(ROOT, "new/b/c", "later.conf")) & IN_CLOSE_WRITE_linux);
+  Print(STDOUT_FILENO_linux, "new nested directories: watched, early files reported\n");
+
+  // Renamed inside the tree: same watches, new paths.
+  char from[PATH_watch];
+  const char *joined = Join(ROOT, "top0", "mid0");
+  for (unsigned long i = 0; i <= Size_chars(joined); ++i) {
+    from[i] = joined[i];
+  }
+  Assert(renameat_linux(AT_FDCWD_linux, from, AT_FDCWD_linux, Join(ROOT, "top1", "renamed")) == 0);
+  Assert(Await(&w, Join(ROOT, "top1", "renamed")) & IN_MOVED_TO_linux);
+  Touch(Join(ROOT, "top1/renamed/leaf7", "moved.conf"), 9);
+  Assert(Await(&w, Join(ROOT, "top1/renamed/leaf7", "moved.conf")) & IN_CLOSE_WRITE_linux);
+  Print(STDOUT_FILENO_linux, "renamed subtree: reported under its new path\n");
+
+  // Moved out: its 2000 directories stop being watched.
+  unsigned int before = w.count;
+  joined = Join(ROOT, "top2", NULL);
+  for (unsigned long i = 0; i <= Size_chars(joined); ++i) {
+    from[i] = joined[i];
+  }
+  Assert(renameat_linux(AT_FDCWD_linux, from, AT_FDCWD_linux, Join(OUTSIDE, "top2", NULL)) == 0);
+  Assert(Await(&w, from) & IN_MOVED_FROM_linux);
+  Assert(w.count == before - (1 + MIDDLE + MIDDLE * LEAVES));
+  Touch(Join(OUTSIDE, "top2/mid0", "gone.conf"), 9);
+  Assert(!Await(&w, Join(OUTSIDE, "top2/mid0", "gone.conf")));
+  Print(STDOUT_FILENO_linux, "moved-out subtree: ");
+  PrintU64(STDOUT_FILENO_linux, before - w.count);
+  Print(STDOUT_FILENO_linux, " watches dropped\n");
+}
+
+//
+// Queue overflow: more events than fs.inotify.max_queued_events while
+// nobody reads, then a rescan of only the directories that changed
+//
+void Overflow_demo(void) {
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, "flood", NULL), 0755) == 0);
+  Assert(Await(&w, Join(ROOT, "flood", NULL)) & IN_CREATE_linux);
+  char file[16];
+  for (unsigned int f = 0; f < 20000; ++f) {
+    Number(file, "f", f);
+    Touch(Join(ROOT, "flood", file), 1);
+  }
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(ROOT, "top3/mid5", "late"), 0755) == 0);
+  changes = 0;
+  unsigned long long t0 = Now_ns();
+  unsigned int mask = Await(&w, Join(ROOT, "top3/mid5", NULL));
+  unsigned long long elapsed = Now_ns() - t0;
+  Assert(w.overflows >= 1 && mask & IN_Q_OVERFLOW_linux);
+  Touch(Join(ROOT, "top3/mid5/late", "after.conf"), 9);
+  Assert(Await(&w, Join(ROOT, "top3/mid5/late", "after.conf")) & IN_CLOSE_WRITE_linux);
+  Print(STDOUT_FILENO_linux, "overflow: rescanned ");
+  PrintU64(STDOUT_FILENO_linux, w.rescanned);
+  Print(STDOUT_FILENO_linux, " of ");
+  PrintU64(STDOUT_FILENO_linux, w.count);
+  Print(STDOUT_FILENO_linux, " directories in ");
+  PrintU64(STDOUT_FILENO_linux, elapsed / 1000000);
+  Print(STDOUT_FILENO_linux, " ms, directory made meanwhile now watched\n");
+}
+
+//
+// Filesystem journal: one fanotify mark, a change set per interval, against
+// the full getdents + statx rescan an indexer otherwise runs
+//
+#define JROOT "/tmp/watch_journal"
+#define JDIRS  100
+#define JFILES 1000
+
+unsigned long entries, unresolved, lost;
+
+void Journaled(void *user, const Entry_watch *entry) {
+  (void)user;
+  if (!entry->path) {
+    unresolved += entry->name_len == 1 && entry->name[0] == 'x';
+    return;
+  }
+  if (entry->mask & FAN_Q_OVERFLOW_linux) {
+    ++lost;
+  }
+  unsigned int prefix = (unsigned int)Size_chars(JROOT "/");
+  if (entry->len > prefix && Equal(entry->path, JROOT, prefix - 1) && entry->path[prefix - 1] == '/') {
+    ++entries; // the rest of the filesystem is busy too
+  }
+}
+
+unsigned long Rescan(const char *dir) {
+  char self[PATH_watch];
+  unsigned long len = Size_chars(dir), files = 0;
+  for (unsigned long i = 0; i <= len; ++i) {
+    self[i] = dir[i];
+  }
+  long fd = openat_linux(AT_FDCWD_linux, self, O_RDONLY_linux | O_DIRECTORY_linux | O_CLOEXEC_linux, 0);
+  Assert(fd >= 0);
+  char buffer[32768];
+  for (;;) {
+    long got = getdents64_linux((unsigned int)fd, (linux_dirent64_linux *)buffer, sizeof(buffer));
+    if (got <= 0) {
+      break;
+    }
+    for (long at = 0; at < got;) {
+      linux_dirent64_linux *d = (linux_dirent64_linux *)(buffer + at);
+      at += d->d_reclen;
+      if (d->d_name[0] == '.' && (!d->d_name[1] || (d->d_name[1] == '.' && !d->d_name[2]))) {
+        continue;
+      }
+      statx_t_linux st;
+      Assert(statx_linux((int)fd, d->d_name, AT_SYMLINK_NOFOLLOW_linux, STATX_BASIC_STATS_linux, &st) == 0);
+      ++files;
+      if ((st.stx_mode & S_IFMT_linux) == S_IFDIR_linux) {
+        files += Rescan(Join(self, d->d_name, NULL));
+      }
+    }
+  }
+  close_linux((unsigned int)fd);
+  return files;
+}
+
+void Journal_demo(void) {
+  Journal_watch j;
+  long ret = InitJournal_watch(&j, 0, JOURNAL_watch);
+  if (ret < 0) {
+    Print(STDOUT_FILENO_linux, "\nfanotify journal unavailable (needs CAP_SYS_ADMIN and 5.9+), errno ");
+    PrintU64(STDOUT_FILENO_linux, (unsigned long long)-ret);
+    Print(STDOUT_FILENO_linux, "\n");
+    return;
+  }
+  Remove(JROOT);
+  Assert(mkdirat_linux(AT_FDCWD_linux, JROOT, 0755) == 0);
+  char dir[16], file[16], full[PATH_watch];
+  for (unsigned int d = 0; d < JDIRS; ++d) {
+    Number(dir, "d", d);
+    Assert(mkdirat_linux(AT_FDCWD_linux, Join(JROOT, dir, NULL), 0755) == 0);
+    for (unsigned int f = 0; f < JFILES; ++f) {
+      Number(file, "f", f);
+      Touch(Join(JROOT, dir, file), 9);
+    }
+  }
+  if ((ret = MarkJournal_watch(&j, JROOT, FAN_MARK_FILESYSTEM_linux)) < 0) {
+    Print(STDOUT_FILENO_linux, "\nfanotify filesystem mark refused, errno ");
+    PrintU64(STDOUT_FILENO_linux, (unsigned long long)-ret);
+    Print(STDOUT_FILENO_linux, "\n");
+    FreeJournal_watch(&j);
+    Remove(JROOT);
+    return;
+  }
+
+  // An hour of activity: 2000 files rewritten 5 times, 100 created, 100
+  // deleted, 10 new directories, and a directory that came and went.
+  for (int round = 0; round < 5; ++round) {
+    for (unsigned int i = 0; i < 2000; ++i) {
+      Number(dir, "d", i % JDIRS);
+      Number(file, "f", i / JDIRS * 50);
+      Touch(Join(JROOT, dir, file), 9);
+    }
+  }
+  for (unsigned int i = 0; i < 100; ++i) {
+    Number(dir, "d", i);
+    Number(file, "new", i);
+    Touch(Join(JROOT, dir, file), 9);
+    Number(file, "f", 999);
+    Assert(unlinkat_linux(AT_FDCWD_linux, Join(JROOT, dir, file), 0) == 0);
+  }
+  for (unsigned int i = 0; i < 10; ++i) {
+    Number(dir, "added", i);
+    Assert(mkdirat_linux(AT_FDCWD_linux, Join(JROOT, dir, NULL), 0755) == 0);
+  }
+  Assert(mkdirat_linux(AT_FDCWD_linux, Join(JROOT, "doomed", NULL), 0755) == 0);
+  const char *joined = Join(JROOT, "doomed", "x");
+  for (unsigned long i = 0; i <= Size_chars(joined); ++i) {
+    full[i] = joined[i];
+  }
+  Touch(full, 9);
+  Assert(unlinkat_linux(AT_FDCWD_linux, full, 0) == 0);
+  Assert(unlinkat_linux(AT_FDCWD_linux, Join(JROOT, "doomed", NULL), AT_REMOVEDIR_linux) == 0);
+
+  unsigned long long t0 = Now_ns();
+  Assert(PollJournal_watch(&j, 0, Journaled, NULL) >= 0);
+  unsigned long long journal = Now_ns() - t0;
+  Assert(entries == 2000 + 100 + 100 + 10 + 1 && unresolved == 1 && lost == 0);
+
+  t0 = Now_ns();
+  unsigned long files = Rescan(JROOT);
+  unsigned long long rescan = Now_ns() - t0;
+  Assert(files == JDIRS + JDIRS * JFILES + 10);
+
+  Print(STDOUT_FILENO_linux, "\njournal: ");
+  PrintU64(STDOUT_FILENO_linux, j.events);
+  Print(STDOUT_FILENO_linux, " events in ");
+  PrintU64(STDOUT_FILENO_linux, j.reads);
+  Print(STDOUT_FILENO_linux, " reads -> ");
+  PrintU64(STDOUT_FILENO_linux, entries);
+  Print(STDOUT_FILENO_linux, " changed paths (");
+  PrintU64(STDOUT_FILENO_linux, j.resolved);
+  Print(STDOUT_FILENO_linux, " directories resolved, ");
+  PrintU64(STDOUT_FILENO_linux, j.stale);
+  Print(STDOUT_FILENO_linux, " gone) in ");
+  PrintU64(STDOUT_FILENO_linux, journal / 1000);
+  Print(STDOUT_FILENO_linux, " us\nfull rescan: ");
+  PrintU64(STDOUT_FILENO_linux, files);
+  Print(STDOUT_FILENO_linux, " entries, getdents64 + statx, in ");
+  PrintU64(STDOUT_FILENO_linux, rescan / 1000);
+  Print(STDOUT_FILENO_linux, " us\n");
+  FreeJournal_watch(&j);
+  Remove(JROOT);
+}
+
+// The kernel enters `main` (-e main) with a 16-byte aligned stack but no pushed
+// return address, so realign it for SSE spills on x86.
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((force_align_arg_pointer))
+#endif
+int main(void) {
+  Assert(Init_watch(&w, 1 << 16, MASK, 20000000) == 0);
+  Tree_demo();
+  Follow_demo();
+  Overflow_demo();
+  Assert(w.errors == 0);
+  Free_watch(&w);
+  Remove(ROOT);
+  Remove(OUTSIDE);
+  Journal_demo();
+  exit_linux(0);
+  return 0;
+}
@@ -0,0 +1,258 @@
+#ifndef C_ZEROCOPY_HEADER
+#define C_ZEROCOPY_HEADER
+
+// === zerocopy.h: MSG_ZEROCOPY socket sends with error-queue reaping ==========
+//
+// Contents:
+//   * socket setup & teardown      (jump: Init_zerocopy)
+//   * sending                      (jump: Sendmsg_zerocopy)
+//   * completion reaping           (jump: Reap_zerocopy)
+//
+// Usage:
+//   zerocopy.h is a libc-free header-only library for C & C++, it depends on linux.h
+//
+//   #include "c/linux.h"
+//   #include "c/zerocopy.h" // use as header file
+//
+//   #define C_ZEROCOPY_IMPLEMENTATION
+//   #include "c/zerocopy.h" // use as implementation file
+//
+//   Every send carries a caller tag. Once the kernel no longer references the
+//   payload, the release callback runs with that tag and the buffer may be
+//   reused. Zero-copy sends are released from Reap_zerocopy/Wait_zerocopy;
+//   sends below the threshold (or when zero-copy is unavailable) are copied
+//   and released before Sendmsg_zerocopy returns.
+//
+//   Functions return 0 (or a count) on success and -errno on failure, like
+//   the linux.h wrappers.
+//
+// License:
+//   MIT License (c) Tristan CADET
+//
+// =============================================================================
+
+#ifndef C_LINUX_HEADER
+  #error "zerocopy.h depends on linux.h, include it first"
+#endif
+
+// `copied` is set when the payload was copied, either by the threshold
+// fallback or by the kernel (SO_EE_CODE_ZEROCOPY_COPIED_linux, e.g. loopback).
+typedef void (*Release_zerocopy)(void *user, unsigned long long tag, int copied);
+
+typedef struct {
+  unsigned long long tag;
+  int busy;
+} Slot_zerocopy;
+
+// The kernel numbers MSG_ZEROCOPY sends per socket (32-bit, wrapping) and
+// reports completed [lo, hi] ranges on the error queue; slot = id & mask.
+typedef struct {
+  int fd;
+  int enabled;            // SO_ZEROCOPY accepted by the socket
+  unsigned int threshold; // sends shorter than this are copied
+  unsigned int next;      // id of the next zero-copy send
+  unsigned int mask;
+  unsigned int inflight;
+  Slot_zerocopy *slots;
+  Release_zerocopy release;
+  void *user;
+  unsigned long long zerocopy_sends;
+  unsigned long long copy_sends;
+  unsigned long long kernel_copies; // completions flagged as copied by the kernel
+} Socket_zerocopy;
+
+#define THRESHOLD_zerocopy (16U << 10)
+
+//
+// Socket setup & teardown
+//
+long Init_zerocopy(Socket_zerocopy *zs, int fd, unsigned int slots, unsigned int threshold, Release_zerocopy release, void *user);
+long Flush_zerocopy(Socket_zerocopy *zs);
+void Free_zerocopy(Socket_zerocopy *zs);
+//
+// Sending
+//
+long Sendmsg_zerocopy(Socket_zerocopy *zs, const iovec_linux *iov, unsigned int iovcnt, unsigned int flags, unsigned long long tag);
+long Send_zerocopy(Socket_zerocopy *zs, const void *buf, unsigned long len, unsigned int flags, unsigned long long tag);
+//
+// Completion reaping
+//
+long Reap_zerocopy(Socket_zerocopy *zs);
+long Wait_zerocopy(Socket_zerocopy *zs, int timeout_ms);
+
+#endif // C_ZEROCOPY_HEADER
+#ifdef C_ZEROCOPY_IMPLEMENTATION
+
+//
+// Socket setup & teardown
+//
+
+// `slots` (rounded up to a power of two) bounds the zero-copy sends in flight;
+// past it sends are copied until completions are reaped. `threshold` of 0
+// selects THRESHOLD_zerocopy, below which page pinning costs more than a copy.
+long Init_zerocopy(Socket_zerocopy *zs, int fd, unsigned int slots, unsigned int threshold, Release_zerocopy release, void *user) {
+  unsigned int count = 1;
+  while (count < slots) {
+    count <<= 1;
+  }
+  long ret = mmap_linux(0, count * sizeof(Slot_zerocopy), PROT_READ_linux | PROT_WRITE_linux, MAP_PRIVATE_linux | MAP_ANONYMOUS_linux, -1, 0);
+  if (ret < 0 && ret > -4096) {
+    return ret;
+  }
+  int one = 1;
+  zs->fd = fd;
+  zs->enabled = setsockopt_linux(fd, SOL_SOCKET_linux, SO_ZEROCOPY_linux, &one, sizeof(one)) == 0;
+  zs->threshold = threshold ? threshold : THRESHOLD_zerocopy;
+  zs->next = 0;
+  zs->mask = count - 1;
+  zs->inflight = 0;
+  zs->slots = (Slot_zerocopy *)ret;
+  zs->release = release;
+  zs->user = user;
+  zs->zerocopy_sends = 0;
+  zs->copy_sends = 0;
+  zs->kernel_copies = 0;
+  return 0;
+}
+
+// Blocks until every zero-copy send has been released, e.g. before close.
+long Flush_zerocopy(Socket_zerocopy *zs) {
+  while (zs->inflight) {
+    long ret = Wait_zerocopy(zs, -1);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  return 0;
+}
+
+void Free_zerocopy(Socket_zerocopy *zs) {
+  munmap_linux(zs->slots, (zs->mask + 1) * sizeof(Slot_zerocopy));
+}
+
+//
+// Sending
+//
+static long Copy_zerocopy(Socket_zerocopy *zs, user_msghdr_linux *msg, unsigned int flags, unsigned long long tag) {
+  long ret = sendmsg_linux(zs->fd, msg, flags);
+  if (ret >= 0) {
+    zs->copy_sends++;
+    if (zs->release) {
+      zs->release(zs->user, tag, 1);
+    }
+  }
+  return ret;
+}
+
+// Returns the bytes queued (possibly short on non-blocking sockets) or -errno.
+// The tag is released once per call that queued bytes.
+long Sendmsg_zerocopy(Socket_zerocopy *zs, const iovec_linux *iov, unsigned int iovcnt, unsigned int flags, unsigned long long tag) {
+  user_msghdr_linux msg = {0};
+  msg.msg_iov = (iovec_linux *)iov;
+  msg.msg_iovlen = iovcnt;
+  flags |= MSG_NOSIGNAL_linux;
+
+  unsigned long len = 0;
+  for (unsigned int i = 0; i < iovcnt; ++i) {
+    len += iov[i].iov_len;
+  }
+  if (!zs->enabled || len < zs->threshold) {
+    return Copy_zerocopy(zs, &msg, flags, tag);
+  }
+  Slot_zerocopy *slot = &zs->slots[zs->next & zs->mask];
+  if (slot->busy) {
+    Reap_zerocopy(zs);
+    if (slot->busy) {
+      return Copy_zerocopy(zs, &msg, flags, tag); // completions lag behind, don't stall the sender
+    }
+  }
+  long ret = sendmsg_linux(zs->fd, &msg, flags | MSG_ZEROCOPY_linux);
+  if (ret == -ENOBUFS_linux) {
+    return Copy_zerocopy(zs, &msg, flags, tag); // optmem limit hit, the send id was not consumed
+  }
+  if (ret < 0) {
+    return ret; // nothing queued, the kernel rolled the id back
+  }
+  slot->tag = tag;
+  slot->busy = 1;
+  zs->next++;
+  zs->inflight++;
+  zs->zerocopy_sends++;
+  return ret;
+}
+
+long Send_zerocopy(Socket_zerocopy *zs, const void *buf, unsigned long len, unsigned int flags, unsigned long long tag) {
+  iovec_linux iov;
+  iov.iov_base = (void *)buf;
+  iov.iov_len = len;
+  return Sendmsg_zerocopy(zs, &iov, 1, flags, tag);
+}
+
+//
+// Completion reaping
+//
+static unsigned int Complete_zerocopy(Socket_zerocopy *zs, const sock_extended_err_linux *ee) {
+  int copied = (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED_linux) != 0;
+  unsigned int released = 0;
+  for (unsigned int id = ee->ee_info;; ++id) {
+    Slot_zerocopy *slot = &zs->slots[id & zs->mask];
+    if (slot->busy) {
+      slot->busy = 0;
+      zs->inflight--;
+      zs->kernel_copies += copied;
+      released++;
+      if (zs->release) {
+        zs->release(zs->user, slot->tag, copied);
+      }
+    }
+    if (id == ee->ee_data) {
+      break;
+    }
+  }
+  return released;
+}
+
+// Drains the error queue without blocking; returns the number of sends released.
+long Reap_zerocopy(Socket_zerocopy *zs) {
+  long released = 0;
+  while (zs->inflight) {
+    unsigned long control[16];
+    user_msghdr_linux msg = {0};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    long ret = recvmsg_linux(zs->fd, &msg, MSG_ERRQUEUE_linux | MSG_DONTWAIT_linux);
+    if (ret == -EAGAIN_linux) {
+      break;
+    }
+    if (ret < 0) {
+      return ret;
+    }
+    for (cmsghdr_linux *cmsg = CMSG_FIRSTHDR_linux(&msg); cmsg; cmsg = CMSG_NXTHDR_linux(&msg, cmsg)) {
+      int recverr = (cmsg->cmsg_level == SOL_IP_linux && cmsg->cmsg_type == IP_RECVERR_linux) ||
+                    (cmsg->cmsg_level == SOL_IPV6_linux && cmsg->cmsg_type == IPV6_RECVERR_linux);
+      sock_extended_err_linux *ee = (sock_extended_err_linux *)CMSG_DATA_linux(cmsg);
+      if (recverr && ee->ee_origin == SO_EE_ORIGIN_ZEROCOPY_linux && ee->ee_errno == 0) {
+        released += Complete_zerocopy(zs, ee);
+      }
+    }
+  }
+  return released;
+}
+
+// Waits up to `timeout_ms` (-1: forever) for completions (reported as POLLERR),
+// then reaps them; returns the number of sends released.
+long Wait_zerocopy(Socket_zerocopy *zs, int timeout_ms) {
+  long released = Reap_zerocopy(zs);
+  if (released || !zs->inflight) {
+    return released;
+  }
+  pollfd_linux pfd = {0};
+  pfd.fd = zs->fd;
+  long ret = poll_linux(&pfd, 1, timeout_ms);
+  if (ret <= 0) {
+    return ret;
+  }
+  return Reap_zerocopy(zs);
+}
+
+#endif // C_ZEROCOPY_IMPLEMENTATION